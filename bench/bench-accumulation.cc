@@ -0,0 +1,118 @@
+/*===========================================================================*/
+/*
+ * Misura il cumulo di precipitazione (ACRR) di 24 ore da 288 composite RATE
+ * a 5 minuti, con qualche frame mancante, al variare del numero di thread
+ *
+ *===========================================================================*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+
+#include <radarlib/radar.hpp>
+#include <radarlib/parallel.hpp>
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+#define FRAMES 288
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed_ms(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static std::string framePath(int i)
+{
+	std::ostringstream ss;
+	ss << "BENCH-ACRR-" << std::setw(3) << std::setfill('0') << i << ".h5";
+	return ss.str();
+}
+
+/* un frame ogni 50 manca */
+static bool missing(int i)
+{
+	return i % 50 == 49;
+}
+
+/* cella di pioggia che si sposta verso est di un pixel per frame */
+static void createFrame(int i, const CartesianGrid& grid, time_t time)
+{
+	OdimFactory factory;
+	std::unique_ptr<CompObject> comp(factory.createCompObject(framePath(i)));
+	comp->setDateTime(time);
+	SourceInfo source;
+	source.setOperaRadarNode("itcmp");
+	comp->setSource(source);
+	grid.writeTo(*comp);
+
+	std::unique_ptr<Product_COMP> dataset(comp->createProductCOMP());
+	dataset->setStartDateTime(time - 300);
+	dataset->setEndDateTime(time);
+	grid.writeTo(*dataset);
+	DataMatrix<float> values(grid.ysize, grid.xsize);
+	for (int r=0; r<grid.ysize; r++)
+		for (int c=0; c<grid.xsize; c++)
+		{
+			int dx = (c - i) % grid.xsize - grid.xsize / 2;
+			int dy = r - grid.ysize / 2;
+			double d2 = (double)dx * dx + (double)dy * dy;
+			values.elem(r, c) = d2 < 10000. ? (float)(20. * (1. - d2 / 10000.)) : UNDETECT;
+		}
+	std::unique_ptr<Product_2D_Data> data(dataset->createQuantityData(PRODUCT_QUANTITY_RATE));
+	Encoding(RAW_UINT16, 0.01, 0., 65535., 0.).write(values, *data);
+}
+
+int main(int argc, char* argv[])
+{
+	int size = argc > 1 ? atoi(argv[1]) : 500;
+
+	try
+	{
+		CartesianGrid grid = CartesianGrid::centeredOn(44.5, 11.5, size, size, 1000., 1000.);
+		time_t t0 = Radar::timeutils::mktime(2000,1,2,0,5,0);
+		for (int i=0; i<FRAMES; i++)
+			if (!missing(i))
+				createFrame(i, grid, t0 + i * 300);
+
+		int cores = Radar::parallel::threadCount(0);
+		std::vector<int> counts;
+		for (int t=1; t<cores; t*=2)
+			counts.push_back(t);
+		counts.push_back(cores);
+
+		for (size_t c=0; c<counts.size(); c++)
+		{
+			RainAccumulator acc(grid, counts[c]);
+			Clock::time_point t = Clock::now();
+			for (int i=0; i<FRAMES; i++)
+				if (!missing(i))
+					acc.addFile(framePath(i));
+			double add = elapsed_ms(t);
+
+			t = Clock::now();
+			std::unique_ptr<CompObject> comp(OdimFactory().createCompObject("BENCH-ACRR.h5"));
+			std::unique_ptr<Product_RR> rr(acc.generate(*comp));
+			double generate = elapsed_ms(t);
+
+			std::cout << std::fixed << std::setprecision(1)
+				<< "threads=" << std::setw(3) << counts[c]
+				<< "  frames=" << acc.getFrameCount()
+				<< "  grid=" << size << "x" << size
+				<< "  add " << std::setw(8) << add << " ms"
+				<< " (" << std::setprecision(2) << add / acc.getFrameCount() << " ms/frame)"
+				<< "  generate " << std::setprecision(1) << std::setw(7) << generate << " ms" << std::endl;
+		}
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Errore di esecuzione: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,138 @@
+/*===========================================================================*/
+/*
+ * Misura la scalabilita' del compositing multi radar al variare del numero
+ * di thread: volumi sintetici di N radar distribuiti su una griglia nazionale
+ *
+ *===========================================================================*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+
+#include <radarlib/radar.hpp>
+#include <radarlib/parallel.hpp>
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+#define NUMRAYS 360
+#define NUMBINS 250
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed_ms(Clock::time_point start, int iterations)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+}
+
+static std::string volumePath(int i)
+{
+	std::ostringstream ss;
+	ss << "BENCH-COMPOSITE-" << std::setw(2) << std::setfill('0') << i << ".h5";
+	return ss.str();
+}
+
+/* radar disposti su una griglia 5 x N/5 distanziati circa 150 km */
+static void createVolume(int i)
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.createPolarVolume(volumePath(i)));
+	volume->setDateTime(Radar::timeutils::mktime(2000,1,2,3,5,0));
+	SourceInfo source;
+	std::ostringstream node;
+	node << "rad" << i;
+	source.setOperaRadarNode(node.str());
+	volume->setSource(source);
+	volume->setLatitude(40. + (i / 5) * 1.4);
+	volume->setLongitude(7. + (i % 5) * 1.9);
+	volume->setAltitude(100.);
+
+	std::unique_ptr<PolarScan> scan(volume->createScan());
+	scan->setStartDateTime(Radar::timeutils::mktime(2000,1,2,3,5,0));
+	scan->setEndDateTime(Radar::timeutils::mktime(2000,1,2,3,5,30));
+	scan->setEAngle(0.5);
+	scan->setA1Gate(0);
+	scan->setNumBins(NUMBINS);
+	scan->setNumRays(NUMRAYS);
+	scan->setRangeStart(0);
+	scan->setRangeScale(1000);
+
+	std::unique_ptr<PolarScanData> data(scan->createQuantityData(PRODUCT_QUANTITY_DBZH));
+	data->setNodata(255.);
+	data->setUndetect(0.);
+	data->setOffset(-32.);
+	data->setGain(0.5);
+	RayMatrix<unsigned char> matrix(NUMRAYS, NUMBINS);
+	for (int r=0; r<NUMRAYS; r++)
+		for (int b=0; b<NUMBINS; b++)
+			matrix.elem(r,b) = (unsigned char)((r * 7 + b * 3 + i * 11) % 200);
+	data->writeData(matrix);
+}
+
+int main(int argc, char* argv[])
+{
+	int radars	= argc > 1 ? atoi(argv[1]) : 20;
+	int iterations	= argc > 2 ? atoi(argv[2]) : 5;
+
+	try
+	{
+		for (int i=0; i<radars; i++)
+			createVolume(i);
+
+		OdimFactory factory;
+		std::vector<PolarVolume*> volumes;
+		for (int i=0; i<radars; i++)
+			volumes.push_back(factory.openPolarVolume(volumePath(i)));
+
+		CartesianGrid grid = CartesianGrid::centeredOn(40. + (radars / 5) * 0.7, 10.8, 1000, 1000, 1000., 1000.);
+		int cores = Radar::parallel::threadCount(0);
+		std::vector<int> counts;
+		for (int t=1; t<cores; t*=2)
+			counts.push_back(t);
+		counts.push_back(cores);
+
+		double single = 0;
+		for (size_t c=0; c<counts.size(); c++)
+		{
+			Compositor comp(grid, COMPOSITE_MAXIMUM, counts[c]);
+
+			/* il primo giro calcola le tabelle di remap, poi restano in cache */
+			CartesianGenerator::cache().setCapacity(radars);
+			Clock::time_point t = Clock::now();
+			for (int it=0; it<iterations; it++)
+			{
+				comp.clear();
+				for (int i=0; i<radars; i++)
+					comp.addVolume(*volumes[i], PRODUCT_PPI, 0.5, PRODUCT_QUANTITY_DBZH);
+			}
+			double add = elapsed_ms(t, iterations);
+
+			DataMatrix<float> out;
+			t = Clock::now();
+			for (int it=0; it<iterations; it++)
+				comp.compute(out);
+			double compute = elapsed_ms(t, iterations);
+			if (c == 0)
+				single = compute;
+
+			std::cout << std::fixed << std::setprecision(1)
+				<< "threads=" << std::setw(3) << counts[c]
+				<< "  radars=" << radars
+				<< "  add " << std::setw(8) << add << " ms"
+				<< "  composite " << std::setw(8) << compute << " ms"
+				<< "  speedup " << std::setprecision(2) << single / compute << std::endl;
+		}
+
+		for (size_t i=0; i<volumes.size(); i++)
+			delete volumes[i];
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Errore di esecuzione: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
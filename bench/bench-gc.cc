@@ -0,0 +1,171 @@
+/*===========================================================================*/
+/*
+ * Misura il costo della garbage collection di HDF5 in una scansione di molti
+ * file piccoli, aprendo ogni file con una factory nuova come fanno gli
+ * scanner. La scansione e' ripetuta con ogni politica di HDF5Library: a ogni
+ * factory (il comportamento storico), mai, ogni N file e oltre una soglia di
+ * memoria delle free list.
+ *
+ * Uso: bench-gc [-n file] [-e N] [-m byte]
+ *
+ *===========================================================================*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <memory>
+
+#include <radarlib/radar.hpp>
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+#define DIRECTORY	"BENCH-GC"
+
+typedef std::chrono::steady_clock Clock;
+
+/* un volume piccolo come quelli prodotti ogni 5 minuti da un radar */
+static void createVolume(const std::string& path)
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.createPolarVolume(path));
+	volume->setDateTime(Radar::timeutils::mktime(2000,1,2,3,4,5));
+	SourceInfo source;
+	source.setOperaRadarSite("itspc");
+	volume->setSource(source);
+	volume->setLongitude(11.6236);
+	volume->setLatitude(44.4567);
+	volume->setAltitude(31.);
+	for (int s=0; s<3; s++)
+	{
+		std::unique_ptr<PolarScan> scan(volume->createScan());
+		scan->setEAngle(0.5 + s);
+		scan->setNumRays(36);
+		scan->setNumBins(50);
+		std::unique_ptr<PolarScanData> data(scan->createQuantityData(PRODUCT_QUANTITY_DBZH));
+		data->setGain(0.5);
+		data->setOffset(-32.);
+		RayMatrix<unsigned char> raw(36, 50, 10);
+		data->writeData(raw);
+	}
+}
+
+static void copyFile(const std::string& src, const std::string& dst)
+{
+	std::ifstream in(src.c_str(), std::ios::binary);
+	std::ofstream out(dst.c_str(), std::ios::binary);
+	out << in.rdbuf();
+	if (!out)
+		throw std::runtime_error("Impossibile scrivere " + dst);
+}
+
+/* i metadati letti da uno scanner: data, sorgente, elevazioni e grandezze */
+static int scanFile(const std::string& path)
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(path, H5F_ACC_RDONLY));
+	volume->getDateTime();
+	volume->getSource();
+	std::vector<double> elevations = volume->getScanAngles();
+	std::set<std::string> quantities = volume->getStoredQuantities();
+	return (int)(elevations.size() + quantities.size());
+}
+
+struct Policy {
+	const char*	name;
+	HDF5GCPolicy	policy;
+	uint64_t	parameter;
+};
+
+int main(int argc, char* argv[])
+{
+	int files = 10000;
+	uint64_t every = 100, threshold = 4 * 1024 * 1024;
+	for (int i=1; i<argc; i++)
+	{
+		std::string opt = argv[i];
+		if (opt == "-n" && i + 1 < argc)	files = atoi(argv[++i]);
+		else if (opt == "-e" && i + 1 < argc)	every = strtoull(argv[++i], NULL, 10);
+		else if (opt == "-m" && i + 1 < argc)	threshold = strtoull(argv[++i], NULL, 10);
+		else
+		{
+			std::cerr << "Uso: " << argv[0] << " [-n file] [-e N] [-m byte]" << std::endl;
+			return -1;
+		}
+	}
+
+	try
+	{
+		HDF5Library& library = HDF5Library::instance();
+
+		/* i file sono copie di un unico volume, creato una volta sola */
+		Radar::FileSystem::mkDirTree(DIRECTORY);
+		std::vector<std::string> paths;
+		std::string first = DIRECTORY "/GC-00000.h5";
+		createVolume(first);
+		for (int i=0; i<files; i++)
+		{
+			char name[64];
+			snprintf(name, sizeof(name), DIRECTORY "/GC-%05d.h5", i);
+			paths.push_back(name);
+			if (i)
+				copyFile(first, name);
+		}
+
+		std::ostringstream everyName, thresholdName;
+		everyName << "every " << every << " files";
+		thresholdName << "above " << threshold / 1024 << " KB";
+		std::string everyLabel = everyName.str(), thresholdLabel = thresholdName.str();
+		std::vector<Policy> policies;
+		Policy p1 = { "every factory", HDF5_GC_EVERY_FACTORY, 0 };	policies.push_back(p1);
+		Policy p2 = { "never", HDF5_GC_NEVER, 0 };			policies.push_back(p2);
+		Policy p3 = { everyLabel.c_str(), HDF5_GC_EVERY_N_FILES, every };	policies.push_back(p3);
+		Policy p4 = { thresholdLabel.c_str(), HDF5_GC_MEMORY_THRESHOLD, threshold };
+		try {
+			library.setGCPolicy(p4.policy, p4.parameter);
+			policies.push_back(p4);
+		} catch (std::invalid_argument&) {
+			std::cerr << "HDF5 non fornisce la dimensione delle free list, politica a soglia esclusa" << std::endl;
+		}
+
+		std::cout << "Scan of " << files << " files, one factory per file" << std::endl
+			  << std::left << std::setw(18) << "policy" << std::right << std::setw(12) << "total ms" << std::setw(12) << "us/file"
+			  << std::setw(10) << "GCs" << std::setw(16) << "free lists KB" << std::endl;
+
+		for (size_t p=0; p<policies.size(); p++)
+		{
+			library.setGCPolicy(policies[p].policy, policies[p].parameter);
+			library.garbageCollect();
+			scanFile(paths[0]);	/* riscaldamento */
+			uint64_t gc = library.getGCCount();
+			long check = 0;
+
+			Clock::time_point t = Clock::now();
+			for (int i=0; i<files; i++)
+				check += scanFile(paths[i]);
+			double ms = std::chrono::duration<double, std::milli>(Clock::now() - t).count();
+
+			if (check != (long)files * 4)
+				throw std::runtime_error("Letture errate");
+			std::cout << std::left << std::setw(18) << policies[p].name << std::right << std::fixed
+				  << std::setw(12) << std::setprecision(1) << ms
+				  << std::setw(12) << std::setprecision(1) << ms * 1000. / files
+				  << std::setw(10) << library.getGCCount() - gc
+				  << std::setw(16) << HDF5Library::getFreeListSize() / 1024 << std::endl;
+		}
+		library.setGCPolicy(HDF5_GC_EVERY_FACTORY);
+
+		for (size_t i=0; i<paths.size(); i++)
+			std::remove(paths[i].c_str());
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Errore di esecuzione: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,492 @@
+/*===========================================================================*/
+/*
+ * Misura le operazioni di I/O di base della libreria su file PVOL e COMP
+ * sintetici piccoli, medi e grandi: apertura, visita dei dataset, lettura e
+ * scrittura di attributi, readData, readTranslatedData, writeAndTranslate e
+ * MetadataGroup::import. I risultati sono scritti in CSV o JSON per poterli
+ * confrontare tra una versione e l'altra della libreria.
+ *
+ * Uso: bench-io [-f csv|json] [-o file] [-s small,medium,large] [-n volte]
+ *
+ *===========================================================================*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <algorithm>
+#include <functional>
+
+#include <radarlib/radar.hpp>
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+#define ATTRIBUTES 20
+
+typedef std::chrono::steady_clock Clock;
+
+/* dimensioni dei file sintetici */
+struct Size {
+	const char*	name;
+	int		scans, rays, bins;	/* PVOL: scan di DBZH (uint8) e VRAD (uint16) */
+	int		datasets, pixels;	/* COMP: prodotti DBZH (uint8) di pixels x pixels */
+	int		iterations;
+};
+
+static const Size SIZES[] = {
+	{ "small",   1, 360,  250, 1,  250, 50 },
+	{ "medium", 10, 360,  500, 2, 1000, 10 },
+	{ "large",  15, 720, 1000, 4, 2000,  3 },
+};
+static const int SIZECOUNT = sizeof(SIZES) / sizeof(SIZES[0]);
+
+/* risultato di una misura, i tempi sono per iterazione */
+struct Result {
+	std::string	benchmark, object, size;
+	int		iterations;
+	double		mean_us, min_us, max_us;
+	long		items;			/* attributi, dataset o valori trattati per iterazione */
+};
+
+static std::vector<Result> results;
+
+static void measure(const std::string& benchmark, const std::string& object, const Size& size, long items, const std::function<void()>& func)
+{
+	Result r;
+	r.benchmark	= benchmark;
+	r.object	= object;
+	r.size		= size.name;
+	r.iterations	= size.iterations;
+	r.items		= items;
+	r.mean_us	= 0;
+	r.min_us	= 1e300;
+	r.max_us	= 0;
+
+	func();		/* riscaldamento, non misurato */
+	for (int it=0; it<size.iterations; it++)
+	{
+		Clock::time_point t = Clock::now();
+		func();
+		double us = std::chrono::duration<double, std::micro>(Clock::now() - t).count();
+		r.mean_us += us;
+		r.min_us = std::min(r.min_us, us);
+		r.max_us = std::max(r.max_us, us);
+	}
+	r.mean_us /= size.iterations;
+	results.push_back(r);
+	std::cerr << std::fixed << std::setprecision(1) << "  " << std::setw(20) << std::left << benchmark << std::right
+		<< std::setw(5) << object << std::setw(7) << size.name << std::setw(14) << r.mean_us << " us" << std::endl;
+}
+
+static std::string filePath(const char* object, const Size& size, const char* suffix = "")
+{
+	std::ostringstream ss;
+	ss << "BENCH-IO-" << object << "-" << size.name << suffix << ".h5";
+	return ss.str();
+}
+
+static void setSource(OdimObject& object, const char* node)
+{
+	SourceInfo source;
+	source.setOperaRadarNode(node);
+	object.setSource(source);
+}
+
+/* attributi how/ aggiuntivi, per dare corpo a visita e import */
+static void fillHow(MetadataGroup* how, int rays)
+{
+	for (int i=0; i<ATTRIBUTES; i++)
+	{
+		std::ostringstream name;
+		name << "bench" << i;
+		how->set(name.str().c_str(), i * 1.5);
+	}
+	if (rays > 0)
+	{
+		std::vector<double> start(rays), stop(rays);
+		for (int r=0; r<rays; r++)
+		{
+			start[r] = 360. / rays * r;
+			stop[r] = 360. / rays * (r + 1);
+		}
+		how->setSimpleArray(ATTRIBUTE_HOW_STARTAZA, start);
+		how->setSimpleArray(ATTRIBUTE_HOW_STOPAZA, stop);
+	}
+}
+
+static void createVolume(const std::string& path, const Size& size)
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.createPolarVolume(path));
+	volume->setDateTime(Radar::timeutils::mktime(2000,1,2,3,5,0));
+	setSource(*volume, "itspc");
+	volume->setLatitude(44.65);
+	volume->setLongitude(11.62);
+	volume->setAltitude(31.);
+
+	RayMatrix<float> dbzh(size.rays, size.bins), vrad(size.rays, size.bins);
+	for (int r=0; r<size.rays; r++)
+		for (int b=0; b<size.bins; b++)
+		{
+			dbzh.elem(r, b) = (float)((r * 7 + b * 3) % 120) * 0.5f - 10.f;
+			vrad.elem(r, b) = (float)((r + b) % 60) - 30.f;
+		}
+	for (int s=0; s<size.scans; s++)
+	{
+		std::unique_ptr<PolarScan> scan(volume->createScan());
+		scan->setEAngle(0.5 + s);
+		scan->setA1Gate(0);
+		scan->setNumBins(size.bins);
+		scan->setNumRays(size.rays);
+		scan->setRangeStart(0);
+		scan->setRangeScale(250000. / size.bins);
+		fillHow(scan->getHow(), size.rays);
+
+		std::unique_ptr<PolarScanData> data(scan->createQuantityData(PRODUCT_QUANTITY_DBZH));
+		data->setGain(0.5);
+		data->setOffset(-32.);
+		data->setNodata(255.);
+		data->setUndetect(0.);
+		data->writeAndTranslate(dbzh, -32.f, 0.5f, H5::PredType::NATIVE_UINT8);
+		data.reset(scan->createQuantityData(PRODUCT_QUANTITY_VRAD));
+		data->setGain(0.01);
+		data->setOffset(-327.68);
+		data->setNodata(65535.);
+		data->setUndetect(0.);
+		data->writeAndTranslate(vrad, -327.68f, 0.01f, H5::PredType::NATIVE_UINT16);
+	}
+}
+
+static void createComp(const std::string& path, const Size& size)
+{
+	OdimFactory factory;
+	std::unique_ptr<CompObject> comp(factory.createCompObject(path));
+	comp->setDateTime(Radar::timeutils::mktime(2000,1,2,3,5,0));
+	setSource(*comp, "itcmp");
+	CartesianGrid grid = CartesianGrid::centeredOn(42., 12.5, size.pixels, size.pixels, 1000., 1000.);
+	grid.writeTo(*comp);
+
+	DataMatrix<float> values(size.pixels, size.pixels);
+	for (int r=0; r<size.pixels; r++)
+		for (int c=0; c<size.pixels; c++)
+			values.elem(r, c) = (float)((r * 5 + c) % 120) * 0.5f - 10.f;
+	for (int d=0; d<size.datasets; d++)
+	{
+		std::unique_ptr<Product_COMP> dataset(comp->createProductCOMP());
+		grid.writeTo(*dataset);
+		fillHow(dataset->getHow(), 0);
+		std::unique_ptr<Product_2D_Data> data(dataset->createQuantityData(PRODUCT_QUANTITY_DBZH));
+		data->setGain(0.5);
+		data->setOffset(-32.);
+		data->setNodata(255.);
+		data->setUndetect(0.);
+		data->writeAndTranslate(values, -32.f, 0.5f, H5::PredType::NATIVE_UINT8);
+	}
+}
+
+/* attributi letti e scritti dal benchmark su un gruppo how/ */
+static long attributes(MetadataGroup* how, bool write)
+{
+	double sum = 0;
+	for (int i=0; i<ATTRIBUTES; i++)
+	{
+		std::ostringstream name;
+		name << "bench" << i;
+		if (write)
+			how->set(name.str().c_str(), i * 2.5);
+		else
+			sum += how->getDouble(name.str().c_str());
+	}
+	return (long)sum;
+}
+
+static void benchVolume(const Size& size)
+{
+	OdimFactory factory;
+	std::string path = filePath("PVOL", size);
+	std::string copy = filePath("PVOL", size, "-COPY");
+	createVolume(path, size);
+	createVolume(copy, size);
+	long gates = (long)size.scans * size.rays * size.bins;
+
+	measure("open", "PVOL", size, 1, [&]() {
+		delete factory.openPolarVolume(path, H5F_ACC_RDONLY);
+	});
+
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(path, H5F_ACC_RDONLY));
+	measure("catalog", "PVOL", size, size.scans * 2, [&]() {
+		int count = volume->getScanCount();
+		for (int s=0; s<count; s++)
+		{
+			std::unique_ptr<PolarScan> scan(volume->getScan(s));
+			scan->getEAngle();
+			scan->getNumRays();
+			scan->getNumBins();
+			int datacount = scan->getQuantityDataCount();
+			for (int d=0; d<datacount; d++)
+			{
+				std::unique_ptr<PolarScanData> data(scan->getQuantityData(d));
+				data->getQuantity();
+				data->getGain();
+				data->getOffset();
+			}
+		}
+	});
+
+	std::unique_ptr<PolarScan> scan(volume->getScan(0));
+	measure("attribute_get", "PVOL", size, ATTRIBUTES, [&]() {
+		attributes(scan->getHow(), false);
+	});
+
+	std::unique_ptr<PolarVolume> target(factory.openPolarVolume(copy, H5F_ACC_RDWR));
+	std::unique_ptr<PolarScan> targetScan(target->getScan(0));
+	measure("attribute_set", "PVOL", size, ATTRIBUTES, [&]() {
+		attributes(targetScan->getHow(), true);
+	});
+
+	std::vector<unsigned char> buffer((size_t)size.rays * size.bins * 2);
+	measure("readData", "PVOL", size, gates * 2, [&]() {
+		for (int s=0; s<size.scans; s++)
+		{
+			std::unique_ptr<PolarScan> scan(volume->getScan(s));
+			for (int d=0; d<2; d++)
+			{
+				std::unique_ptr<PolarScanData> data(scan->getQuantityData(d));
+				data->readData(&buffer[0]);
+			}
+		}
+	});
+
+	RayMatrix<float> matrix;
+	measure("readTranslatedData", "PVOL", size, gates * 2, [&]() {
+		for (int s=0; s<size.scans; s++)
+		{
+			std::unique_ptr<PolarScan> scan(volume->getScan(s));
+			for (int d=0; d<2; d++)
+			{
+				std::unique_ptr<PolarScanData> data(scan->getQuantityData(d));
+				data->readTranslatedData(matrix);
+			}
+		}
+	});
+
+	measure("writeAndTranslate", "PVOL", size, gates, [&]() {
+		for (int s=0; s<size.scans; s++)
+		{
+			std::unique_ptr<PolarScan> scan(target->getScan(s));
+			std::unique_ptr<PolarScanData> data(scan->getQuantityData(PRODUCT_QUANTITY_DBZH));
+			data->writeAndTranslate(matrix, -32.f, 0.5f, H5::PredType::NATIVE_UINT8);
+		}
+	});
+
+	measure("import", "PVOL", size, size.scans, [&]() {
+		for (int s=0; s<size.scans; s++)
+		{
+			std::unique_ptr<PolarScan> src(volume->getScan(s));
+			std::unique_ptr<PolarScan> dst(target->getScan(s));
+			dst->getHow()->import(src->getHow());
+		}
+	});
+}
+
+static void benchComp(const Size& size)
+{
+	OdimFactory factory;
+	std::string path = filePath("COMP", size);
+	std::string copy = filePath("COMP", size, "-COPY");
+	createComp(path, size);
+	createComp(copy, size);
+	long pixels = (long)size.datasets * size.pixels * size.pixels;
+
+	measure("open", "COMP", size, 1, [&]() {
+		delete factory.openCompObject(path, H5F_ACC_RDONLY);
+	});
+
+	std::unique_ptr<CompObject> comp(factory.openCompObject(path, H5F_ACC_RDONLY));
+	measure("catalog", "COMP", size, size.datasets, [&]() {
+		int count = comp->getProductCount();
+		for (int p=0; p<count; p++)
+		{
+			std::unique_ptr<Product_2D> product(comp->getProduct(p));
+			product->getProduct();
+			int datacount = product->getQuantityDataCount();
+			for (int d=0; d<datacount; d++)
+			{
+				std::unique_ptr<Product_2D_Data> data(product->getQuantityData(d));
+				data->getQuantity();
+				data->getGain();
+				data->getOffset();
+			}
+		}
+	});
+
+	std::unique_ptr<Product_2D> product(comp->getProduct(0));
+	measure("attribute_get", "COMP", size, ATTRIBUTES, [&]() {
+		attributes(product->getHow(), false);
+	});
+
+	std::unique_ptr<CompObject> target(factory.openCompObject(copy, H5F_ACC_RDWR));
+	std::unique_ptr<Product_2D> targetProduct(target->getProduct(0));
+	measure("attribute_set", "COMP", size, ATTRIBUTES, [&]() {
+		attributes(targetProduct->getHow(), true);
+	});
+
+	std::vector<unsigned char> buffer((size_t)size.pixels * size.pixels);
+	measure("readData", "COMP", size, pixels, [&]() {
+		for (int p=0; p<size.datasets; p++)
+		{
+			std::unique_ptr<Product_2D> product(comp->getProduct(p));
+			std::unique_ptr<Product_2D_Data> data(product->getQuantityData(0));
+			data->readData(&buffer[0]);
+		}
+	});
+
+	DataMatrix<float> matrix;
+	measure("readTranslatedData", "COMP", size, pixels, [&]() {
+		for (int p=0; p<size.datasets; p++)
+		{
+			std::unique_ptr<Product_2D> product(comp->getProduct(p));
+			std::unique_ptr<Product_2D_Data> data(product->getQuantityData(0));
+			data->readTranslatedData(matrix);
+		}
+	});
+
+	measure("writeAndTranslate", "COMP", size, pixels, [&]() {
+		for (int p=0; p<size.datasets; p++)
+		{
+			std::unique_ptr<Product_2D> product(target->getProduct(p));
+			std::unique_ptr<Product_2D_Data> data(product->getQuantityData(0));
+			data->writeAndTranslate(matrix, -32.f, 0.5f, H5::PredType::NATIVE_UINT8);
+		}
+	});
+
+	measure("import", "COMP", size, size.datasets, [&]() {
+		for (int p=0; p<size.datasets; p++)
+		{
+			std::unique_ptr<Product_2D> src(comp->getProduct(p));
+			std::unique_ptr<Product_2D> dst(target->getProduct(p));
+			dst->getHow()->import(src->getHow());
+		}
+	});
+}
+
+static std::string libraryVersion()
+{
+#ifdef PACKAGE_VERSION
+	return PACKAGE_VERSION;
+#else
+	return "unknown";
+#endif
+}
+
+static std::string hdf5Version()
+{
+	unsigned major, minor, release;
+	H5get_libversion(&major, &minor, &release);
+	std::ostringstream ss;
+	ss << major << "." << minor << "." << release;
+	return ss.str();
+}
+
+static void writeCSV(std::ostream& out)
+{
+	out << "benchmark,object,size,iterations,items,mean_us,min_us,max_us,items_per_s" << std::endl;
+	out << std::fixed << std::setprecision(3);
+	for (size_t i=0; i<results.size(); i++)
+	{
+		const Result& r = results[i];
+		out << r.benchmark << "," << r.object << "," << r.size << "," << r.iterations << "," << r.items << ","
+		    << r.mean_us << "," << r.min_us << "," << r.max_us << "," << r.items / r.mean_us * 1e6 << std::endl;
+	}
+}
+
+static void writeJSON(std::ostream& out)
+{
+	time_t now = time(NULL);
+	out << "{" << std::endl
+	    << "  \"radarlib\": \"" << libraryVersion() << "\"," << std::endl
+	    << "  \"hdf5\": \"" << hdf5Version() << "\"," << std::endl
+	    << "  \"date\": \"" << Radar::timeutils::absoluteToString(now) << "\"," << std::endl
+	    << "  \"results\": [" << std::endl;
+	out << std::fixed << std::setprecision(3);
+	for (size_t i=0; i<results.size(); i++)
+	{
+		const Result& r = results[i];
+		out << "    { \"benchmark\": \"" << r.benchmark << "\", \"object\": \"" << r.object << "\", \"size\": \"" << r.size << "\""
+		    << ", \"iterations\": " << r.iterations << ", \"items\": " << r.items
+		    << ", \"mean_us\": " << r.mean_us << ", \"min_us\": " << r.min_us << ", \"max_us\": " << r.max_us
+		    << ", \"items_per_s\": " << r.items / r.mean_us * 1e6 << " }" << (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+	out << "  ]" << std::endl << "}" << std::endl;
+}
+
+static void usage()
+{
+	std::cerr << "Uso: bench-io [-f csv|json] [-o file] [-s small,medium,large] [-n volte]" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string format = "csv";
+	std::string output;
+	std::string sizes = "small,medium,large";
+	int iterations = 0;
+
+	for (int i=1; i<argc; i++)
+	{
+		if (i + 1 < argc && !strcmp(argv[i], "-f"))		format = argv[++i];
+		else if (i + 1 < argc && !strcmp(argv[i], "-o"))	output = argv[++i];
+		else if (i + 1 < argc && !strcmp(argv[i], "-s"))	sizes = argv[++i];
+		else if (i + 1 < argc && !strcmp(argv[i], "-n"))	iterations = atoi(argv[++i]);
+		else
+		{
+			usage();
+			return 2;
+		}
+	}
+	if (format != "csv" && format != "json")
+	{
+		usage();
+		return 2;
+	}
+	sizes = "," + sizes + ",";
+
+	try
+	{
+		for (int s=0; s<SIZECOUNT; s++)
+		{
+			if (sizes.find(std::string(",") + SIZES[s].name + ",") == std::string::npos)
+				continue;
+			Size size = SIZES[s];
+			if (iterations > 0)
+				size.iterations = iterations;
+			benchVolume(size);
+			benchComp(size);
+		}
+
+		std::ofstream file;
+		if (!output.empty())
+		{
+			file.open(output.c_str());
+			if (!file)
+				throw std::runtime_error("impossibile scrivere " + output);
+		}
+		std::ostream& out = output.empty() ? std::cout : file;
+		if (format == "json")
+			writeJSON(out);
+		else
+			writeCSV(out);
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Errore di esecuzione: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
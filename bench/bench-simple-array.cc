@@ -0,0 +1,107 @@
+/*===========================================================================*/
+/*
+ * Confronta la scrittura/lettura degli array per raggio di how/ (startazA,
+ * stopazA, startazT, stopazT, elangles, TXpower) come sequenze di stringhe
+ * e come simple array HDF5 nativi
+ *
+ *===========================================================================*/
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+
+#include <radarlib/radar.hpp>
+using namespace OdimH5v21;
+
+static const char* NAMES[] = {
+	ATTRIBUTE_HOW_STARTAZA, ATTRIBUTE_HOW_STOPAZA,
+	ATTRIBUTE_HOW_STARTAZT, ATTRIBUTE_HOW_STOPAZT,
+	ATTRIBUTE_HOW_ELANGLES, ATTRIBUTE_HOW_TXPOWER,
+};
+static const int NAMECOUNT = sizeof(NAMES) / sizeof(NAMES[0]);
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed_us(Clock::time_point start, int iterations)
+{
+	return std::chrono::duration<double, std::micro>(Clock::now() - start).count() / iterations;
+}
+
+static void bench(PolarScan* scan, int numrays, int iterations)
+{
+	MetadataGroup* how = scan->getHow();
+
+	std::vector<double> values(numrays);
+	for (int i=0; i<numrays; i++)
+		values[i] = 360. / numrays * i + 0.123456789;
+
+	/* sequenze di stringhe separate da virgole */
+	Clock::time_point t = Clock::now();
+	for (int it=0; it<iterations; it++)
+		for (int n=0; n<NAMECOUNT; n++)
+			how->set((std::string("str_") + NAMES[n]).c_str(), values, 17);
+	double strWrite = elapsed_us(t, iterations);
+
+	t = Clock::now();
+	size_t check = 0;
+	for (int it=0; it<iterations; it++)
+		for (int n=0; n<NAMECOUNT; n++)
+			check += how->getDoubles((std::string("str_") + NAMES[n]).c_str()).size();
+	double strRead = elapsed_us(t, iterations);
+
+	/* simple array nativi */
+	t = Clock::now();
+	for (int it=0; it<iterations; it++)
+		for (int n=0; n<NAMECOUNT; n++)
+			how->setSimpleArray(NAMES[n], &(values[0]), values.size());
+	double arrWrite = elapsed_us(t, iterations);
+
+	std::vector<double> result;
+	t = Clock::now();
+	for (int it=0; it<iterations; it++)
+		for (int n=0; n<NAMECOUNT; n++)
+			check += how->getSimpleArray(NAMES[n], result).size();
+	double arrRead = elapsed_us(t, iterations);
+
+	if (check != (size_t)(2 * iterations * NAMECOUNT * numrays))
+	{
+		std::cerr << "unexpected array sizes" << std::endl;
+		exit(1);
+	}
+
+	std::cout << std::fixed << std::setprecision(1)
+		<< "rays=" << std::setw(4) << numrays
+		<< "  string write " << std::setw(8) << strWrite << " us"
+		<< "  read " << std::setw(8) << strRead << " us"
+		<< "  | native write " << std::setw(8) << arrWrite << " us"
+		<< "  read " << std::setw(8) << arrRead << " us"
+		<< "  (per scan, " << NAMECOUNT << " arrays)" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	int iterations = argc > 1 ? atoi(argv[1]) : 200;
+
+	OdimFactory	factory;
+	PolarVolume*	volume	= NULL;
+	PolarScan*	scan	= NULL;
+	try
+	{
+		volume	= factory.createPolarVolume("BENCH-SIMPLE-ARRAY.h5");
+		scan	= volume->createScan();
+		bench(scan, 360, iterations);
+		bench(scan, 720, iterations);
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Errore di esecuzione: " << e.what() << std::endl;
+		delete scan;
+		delete volume;
+		return 1;
+	}
+	delete scan;
+	delete volume;
+	return 0;
+}
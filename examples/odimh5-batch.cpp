@@ -0,0 +1,183 @@
+/*===========================================================================*/
+/*
+ * Questo programma esegue un task della libreria su molti file odimh5 con
+ * un gruppo di processi worker: i file piu' grandi vengono distribuiti per
+ * primi, i file falliti vengono elencati e con un checkpoint un'elaborazione
+ * interrotta riprende da dove era arrivata
+ *
+ * Esempi:
+ *	odimh5-batch -t check /archivio/2013
+ *	odimh5-batch -j 8 -t dump -o output=/tmp/dump -c dump.ckp /archivio
+ *	find /archivio -name '*.h5' | odimh5-batch -t check -l -
+ *
+ *===========================================================================*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <cstdlib>
+
+#include <radarlib/radar.hpp>
+
+using namespace OdimH5v21;
+
+/*===========================================================================*/
+
+/* una riga per file fallito e l'avanzamento ogni 100 file */
+class Progress : public BatchListener {
+ public:
+	bool	verbose;
+
+	Progress(bool verbose) : verbose(verbose) { }
+
+	virtual void fileDone(const BatchResult& result, int finished, int total)
+	{
+		if (!result.ok)
+			std::cerr << "FAILED " << result.path << ": " << result.message << std::endl;
+		else if (verbose)
+			std::cerr << "done " << result.path << " (" << std::fixed << std::setprecision(3) << result.seconds << " s)" << std::endl;
+		if (finished % 100 == 0 || finished == total)
+			std::cerr << finished << "/" << total << " files" << std::endl;
+	}
+};
+
+static bool readList(std::istream& in, std::vector<std::string>& paths)
+{
+	std::string line;
+	while (std::getline(in, line))
+		if (!line.empty())
+			paths.push_back(line);
+	return !in.bad();
+}
+
+static void usage(const char* name)
+{
+	std::cerr << "Usage: " << name << " [options] <file|dir>..." << std::endl
+		  << std::endl
+		  << "  -t task          task to run on each file (check)" << std::endl
+		  << "  -j N             worker processes, 0 for one per core (0)" << std::endl
+		  << "  -o key=value     option of the task, may be repeated" << std::endl
+		  << "  -c file          checkpoint file, a new run resumes from it" << std::endl
+		  << "  -r               retry the files that failed in the checkpoint" << std::endl
+		  << "  -T seconds       fail a file and restart its worker after this time" << std::endl
+		  << "  -l file          read the paths from a file, one per line, - for stdin" << std::endl
+		  << "  -e ext           extension of the files searched in directories (.h5)" << std::endl
+		  << "  -n               do not search subdirectories" << std::endl
+		  << "  -v               print every file" << std::endl
+		  << "  --list-tasks     print the available tasks" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string			task		= "check";
+	int				workers		= 0;
+	BatchOptions			options;
+	std::string			checkpoint;
+	bool				retry		= false;
+	int				timeout		= 0;
+	std::vector<std::string>	lists;
+	std::string			extension	= ".h5";
+	bool				recursive	= true;
+	bool				verbose		= false;
+	std::vector<std::string>	inputs;
+
+	for (int i=1; i<argc; i++)
+	{
+		std::string opt = argv[i];
+		bool value = i + 1 < argc;
+		if (opt == "--list-tasks")
+		{
+			std::vector<std::string> names = BatchTasks::getNames();
+			for (size_t n=0; n<names.size(); n++)
+				std::cout << std::left << std::setw(12) << names[n] << BatchTasks::getDescription(names[n]) << std::endl;
+			return 0;
+		}
+		else if (opt == "-t" && value)	task		= argv[++i];
+		else if (opt == "-j" && value)	workers		= atoi(argv[++i]);
+		else if (opt == "-c" && value)	checkpoint	= argv[++i];
+		else if (opt == "-T" && value)	timeout		= atoi(argv[++i]);
+		else if (opt == "-l" && value)	lists.push_back(argv[++i]);
+		else if (opt == "-e" && value)	extension	= argv[++i];
+		else if (opt == "-r")		retry		= true;
+		else if (opt == "-n")		recursive	= false;
+		else if (opt == "-v")		verbose		= true;
+		else if (opt == "-o" && value)
+		{
+			std::string option = argv[++i];
+			size_t eq = option.find('=');
+			if (eq == std::string::npos || eq == 0)
+			{
+				usage(argv[0]);
+				return -1;
+			}
+			options[option.substr(0, eq)] = option.substr(eq + 1);
+		}
+		else if (!opt.empty() && opt[0] != '-')
+			inputs.push_back(opt);
+		else
+		{
+			usage(argv[0]);
+			return -1;
+		}
+	}
+	if ((inputs.empty() && lists.empty()) || workers < 0 || timeout < 0)
+	{
+		usage(argv[0]);
+		return -1;
+	}
+
+	try
+	{
+		std::vector<std::string> paths;
+		for (size_t i=0; i<lists.size(); i++)
+		{
+			bool ok;
+			if (lists[i] == "-")
+				ok = readList(std::cin, paths);
+			else
+			{
+				std::ifstream in(lists[i].c_str());
+				ok = in && readList(in, paths);
+			}
+			if (!ok)
+				throw std::runtime_error("Cannot read the list " + lists[i]);
+		}
+		for (size_t i=0; i<inputs.size(); i++)
+		{
+			if (Radar::FileSystem::dirExists(inputs[i]))
+			{
+				std::vector<std::string> files = BatchRunner::listFiles(inputs[i], extension, recursive);
+				paths.insert(paths.end(), files.begin(), files.end());
+			}
+			else
+				paths.push_back(inputs[i]);
+		}
+
+		BatchRunner runner(task, workers);
+		Progress progress(verbose);
+		runner.setOptions(options);
+		runner.setCheckpoint(checkpoint);
+		runner.setRetryFailed(retry);
+		runner.setTimeout(timeout);
+		runner.setListener(&progress);
+		BatchReport report = runner.run(paths);
+
+		std::cout << "Task " << task << " with " << runner.getWorkers() << " workers: "
+			  << report.files << " files, " << report.done << " done, "
+			  << report.failures.size() << " failed, " << report.resumed << " from the checkpoint" << std::endl
+			  << std::fixed << std::setprecision(1) << report.seconds << " s";
+		if (report.seconds > 0)
+			std::cout << ", " << report.done / report.seconds << " files/s, "
+				  << report.bytes / (1024. * 1024.) / report.seconds << " MB/s";
+		std::cout << std::endl;
+		for (size_t i=0; i<report.failures.size(); i++)
+			std::cout << "  " << report.failures[i].path << ": " << report.failures[i].message << std::endl;
+		return report.failures.empty() ? 0 : 1;
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Error: " << e.what() << std::endl;
+		return -1;
+	}
+}
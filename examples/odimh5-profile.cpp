@@ -0,0 +1,491 @@
+/*===========================================================================*/
+/*
+ * Questo programma analizza un file odimh5 per capire perche' la lettura e'
+ * lenta: layout dei chunk, filtri e compressione di ogni dataset, dimensione
+ * dei metadati, tempi di apertura, navigazione e decodifica con la libreria,
+ * e infine alcuni suggerimenti
+ *
+ * Esempi:
+ *	odimh5-profile volume.h5
+ *	odimh5-profile -n 10 composite.h5
+ *
+ *===========================================================================*/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+
+#include <radarlib/radar.hpp>
+
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+/*===========================================================================*/
+/* LAYOUT */
+/*===========================================================================*/
+
+struct DatasetInfo {
+	std::string			path;
+	std::string			type;
+	std::vector<hsize_t>		dims;
+	std::vector<hsize_t>		chunk;		/* vuoto se non a chunk */
+	std::string			layout;
+	std::string			filters;
+	int				deflate;	/* livello, -1 se assente */
+	bool				shuffle;
+	size_t				elemSize;
+	uint64_t			logical;	/* byte decompressi */
+	uint64_t			stored;		/* byte su disco */
+};
+
+struct FileLayout {
+	std::vector<DatasetInfo>	datasets;
+	int				groups;
+	int				attributes;
+	uint64_t			fileSize;
+	uint64_t			stored;
+	uint64_t			logical;
+
+	FileLayout() : groups(0), attributes(0), fileSize(0), stored(0), logical(0) { }
+};
+
+static std::string typeName(const H5::DataSet& dataset, size_t& size)
+{
+	H5::DataType type = dataset.getDataType();
+	size = type.getSize();
+	std::ostringstream ss;
+	switch (type.getClass())
+	{
+		case H5T_INTEGER:
+			ss << (H5::IntType(dataset).getSign() == H5T_SGN_NONE ? "uint" : "int") << size * 8;
+			break;
+		case H5T_FLOAT:
+			ss << "float" << size * 8;
+			break;
+		case H5T_STRING:
+			ss << "string";
+			break;
+		default:
+			ss << "class " << (int)type.getClass();
+	}
+	return ss.str();
+}
+
+static DatasetInfo describe(const H5::DataSet& dataset, const std::string& path)
+{
+	DatasetInfo info;
+	info.path	= path;
+	info.type	= typeName(dataset, info.elemSize);
+	info.deflate	= -1;
+	info.shuffle	= false;
+
+	H5::DataSpace space = dataset.getSpace();
+	int rank = space.getSimpleExtentNdims();
+	info.dims.resize(rank > 0 ? rank : 0);
+	if (rank > 0)
+		space.getSimpleExtentDims(&info.dims[0]);
+	info.logical	= (uint64_t)space.getSimpleExtentNpoints() * info.elemSize;
+	info.stored	= dataset.getStorageSize();
+
+	H5::DSetCreatPropList plist = dataset.getCreatePlist();
+	switch (plist.getLayout())
+	{
+		case H5D_COMPACT:	info.layout = "compact";	break;
+		case H5D_CONTIGUOUS:	info.layout = "contiguous";	break;
+		case H5D_CHUNKED:
+			info.layout = "chunked";
+			info.chunk.resize(rank);
+			plist.getChunk(rank, &info.chunk[0]);
+			break;
+		default:		info.layout = "other";
+	}
+
+	int nfilters = plist.getNfilters();
+	for (int i=0; i<nfilters; i++)
+	{
+		unsigned int	flags, config;
+		size_t		nelmts = 4;
+		unsigned int	values[4];
+		char		name[64];
+		H5Z_filter_t filter = H5Pget_filter2(plist.getId(), i, &flags, &nelmts, values, sizeof(name), name, &config);
+		if (!info.filters.empty())
+			info.filters += ",";
+		if (filter == H5Z_FILTER_DEFLATE)
+		{
+			info.deflate = nelmts > 0 ? (int)values[0] : 0;
+			std::ostringstream ss; ss << "deflate(" << info.deflate << ")";
+			info.filters += ss.str();
+		}
+		else if (filter == H5Z_FILTER_SHUFFLE)
+		{
+			info.shuffle = true;
+			info.filters += "shuffle";
+		}
+		else
+			info.filters += name;
+	}
+	if (info.filters.empty())
+		info.filters = "none";
+	return info;
+}
+
+static void walk(H5::Group& group, const std::string& path, FileLayout& layout)
+{
+	layout.groups++;
+	layout.attributes += group.getNumAttrs();
+	hsize_t count = group.getNumObjs();
+	for (hsize_t i=0; i<count; i++)
+	{
+		std::string name = group.getObjnameByIdx(i);
+		std::string child = (path == "/" ? "" : path) + "/" + name;
+		switch (group.getObjTypeByIdx(i))
+		{
+			case H5G_GROUP:
+			{
+				H5::Group sub = group.openGroup(name);
+				walk(sub, child, layout);
+				break;
+			}
+			case H5G_DATASET:
+			{
+				H5::DataSet dataset = group.openDataSet(name);
+				layout.attributes += dataset.getNumAttrs();
+				layout.datasets.push_back(describe(dataset, child));
+				layout.stored	+= layout.datasets.back().stored;
+				layout.logical	+= layout.datasets.back().logical;
+				break;
+			}
+			default:
+				break;
+		}
+	}
+}
+
+static std::string dimsToString(const std::vector<hsize_t>& dims)
+{
+	std::ostringstream ss;
+	for (size_t i=0; i<dims.size(); i++)
+		ss << (i ? "x" : "") << dims[i];
+	return dims.empty() ? "scalar" : ss.str();
+}
+
+static std::string bytesToString(double bytes)
+{
+	char buff[32];
+	if (bytes >= 1024. * 1024.)
+		snprintf(buff, sizeof(buff), "%.1f MB", bytes / (1024. * 1024.));
+	else if (bytes >= 1024.)
+		snprintf(buff, sizeof(buff), "%.1f KB", bytes / 1024.);
+	else
+		snprintf(buff, sizeof(buff), "%.0f B", bytes);
+	return buff;
+}
+
+/*===========================================================================*/
+/* TEMPI */
+/*===========================================================================*/
+
+struct Phase {
+	const char*		name;
+	double			best;		/* ms */
+	HDF5StatsSnapshot	stats;		/* dell'ultima ripetizione */
+	uint64_t		values;
+
+	Phase(const char* name) : name(name), best(-1.), values(0) { }
+};
+
+/* scansioni o prodotti e dati di un oggetto gia' aperto */
+static void traverse(OdimObject* object, bool decode, uint64_t& values)
+{
+	std::vector<float> buffer;
+	if (PolarVolume* volume = dynamic_cast<PolarVolume*>(object))
+	{
+		int scans = volume->getScanCount();
+		for (int s=0; s<scans; s++)
+		{
+			std::unique_ptr<PolarScan> scan(volume->getScan(s));
+			scan->getEAngle();
+			int count = scan->getQuantityDataCount();
+			for (int d=0; d<count; d++)
+			{
+				std::unique_ptr<PolarScanData> data(scan->getQuantityData(d));
+				data->getQuantity();
+				data->getGain();
+				data->getOffset();
+				data->getNodata();
+				data->getUndetect();
+				if (!decode)
+					continue;
+				buffer.resize((size_t)data->getNumRays() * data->getNumBins());
+				data->readTranslatedData(&buffer[0], NODATA, UNDETECT);
+				values += buffer.size();
+			}
+		}
+	}
+	else if (Object_2D* object2d = dynamic_cast<Object_2D*>(object))
+	{
+		int products = object2d->getProductCount();
+		for (int p=0; p<products; p++)
+		{
+			std::unique_ptr<Product_2D> product(object2d->getProduct(p));
+			product->getProduct();
+			int count = product->getQuantityDataCount();
+			for (int d=0; d<count; d++)
+			{
+				std::unique_ptr<Product_2D_Data> data(product->getQuantityData(d));
+				data->getQuantity();
+				data->getGain();
+				data->getOffset();
+				data->getNodata();
+				data->getUndetect();
+				if (!decode)
+					continue;
+				buffer.resize((size_t)data->getNumXElem() * data->getNumYElem());
+				data->readTranslatedData(&buffer[0], NODATA, UNDETECT);
+				values += buffer.size();
+			}
+		}
+	}
+}
+
+static void measure(Phase& phase, OdimFactory& factory, const std::string& path, int iterations)
+{
+	for (int i=0; i<iterations; i++)
+	{
+		std::unique_ptr<OdimObject> object;
+		bool open = std::string(phase.name) == "open";
+		if (!open)
+			object.reset(factory.open(path, H5F_ACC_RDONLY));
+		HDF5Stats::reset();
+		phase.values = 0;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if (open)
+			object.reset(factory.open(path, H5F_ACC_RDONLY));
+		else
+			traverse(object.get(), std::string(phase.name) == "decode", phase.values);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		phase.stats = HDF5Stats::snapshot();
+		if (phase.best < 0 || ms < phase.best)
+			phase.best = ms;
+	}
+}
+
+/*===========================================================================*/
+/* SUGGERIMENTI */
+/*===========================================================================*/
+
+static void recommend(const FileLayout& layout, const std::vector<Phase>& phases, std::ostream& out)
+{
+	std::vector<std::string> tips;
+	int whole = 0, uncompressed = 0, tiny = 0, poor = 0, noshuffle = 0, heavy = 0;
+	uint64_t wholeMax = 0, uncompressedBytes = 0;
+	size_t tinyMin = 0;
+	for (size_t i=0; i<layout.datasets.size(); i++)
+	{
+		const DatasetInfo& d = layout.datasets[i];
+		if (d.dims.size() != 2 || d.logical < 64 * 1024)
+			continue;	/* array di how/ e dataset piccoli */
+		if (!d.chunk.empty() && d.chunk == d.dims)
+		{
+			whole++;
+			wholeMax = std::max(wholeMax, d.logical);
+		}
+		if (!d.chunk.empty())
+		{
+			size_t bytes = d.elemSize;
+			for (size_t k=0; k<d.chunk.size(); k++)
+				bytes *= (size_t)d.chunk[k];
+			if (bytes < 4096)
+			{
+				tiny++;
+				tinyMin = tinyMin ? std::min(tinyMin, bytes) : bytes;
+			}
+		}
+		if (d.deflate < 0)
+		{
+			uncompressed++;
+			uncompressedBytes += d.logical;
+		}
+		else
+		{
+			if (d.stored && (double)d.logical / d.stored < 1.2)
+				poor++;
+			if (d.elemSize > 1 && !d.shuffle)
+				noshuffle++;
+			if (d.deflate > 6)
+				heavy++;
+		}
+	}
+
+	std::ostringstream ss;
+	if (whole)
+	{
+		ss.str(""); ss << whole << " dataset(s) with a single whole-matrix chunk; sector reads will inflate " << bytesToString((double)wholeMax)
+			<< (whole > 1 ? " each (largest)" : "") << " - chunk by blocks of rays or rows";
+		tips.push_back(ss.str());
+	}
+	if (tiny)
+	{
+		ss.str(""); ss << tiny << " dataset(s) with chunks of " << bytesToString((double)tinyMin) << " or less; per-chunk overhead dominates full reads";
+		tips.push_back(ss.str());
+	}
+	if (uncompressed)
+	{
+		ss.str(""); ss << uncompressed << " dataset(s) stored without compression (" << bytesToString((double)uncompressedBytes)
+			<< "); fine for local disks, deflate 1-6 if I/O bound";
+		tips.push_back(ss.str());
+	}
+	if (poor)
+	{
+		ss.str(""); ss << poor << " compressed dataset(s) with ratio below 1.2; every read pays inflate for little saving";
+		tips.push_back(ss.str());
+	}
+	if (noshuffle)
+	{
+		ss.str(""); ss << noshuffle << " multi-byte compressed dataset(s) without the shuffle filter; shuffle usually improves their ratio";
+		tips.push_back(ss.str());
+	}
+	if (heavy)
+	{
+		ss.str(""); ss << heavy << " dataset(s) with deflate level above 6; higher levels slow writes for little gain";
+		tips.push_back(ss.str());
+	}
+	if (layout.fileSize > 0 && layout.stored < layout.fileSize)
+	{
+		double metadata = (double)(layout.fileSize - layout.stored) / layout.fileSize;
+		if (metadata > 0.5 && layout.fileSize - layout.stored > 256 * 1024)
+		{
+			ss.str(""); ss << "metadata is " << (int)(metadata * 100.) << "% of the file (" << layout.attributes
+				<< " attributes); consider fewer per-ray how/ arrays";
+			tips.push_back(ss.str());
+		}
+	}
+	if (phases.size() == 3 && phases[1].best > phases[2].best - phases[1].best && phases[1].best > 1.)
+	{
+		ss.str(""); ss << "traversal (" << std::fixed << std::setprecision(1) << phases[1].best << " ms, "
+			<< phases[1].stats[HDF5_STATS_ATTRIBUTE_READ].calls << " attribute reads) costs more than decoding; cache metadata between reads";
+		tips.push_back(ss.str());
+	}
+
+	out << "Recommendations:" << std::endl;
+	if (tips.empty())
+		out << "  none, the layout looks fine" << std::endl;
+	for (size_t i=0; i<tips.size(); i++)
+		out << "  - " << tips[i] << std::endl;
+}
+
+/*===========================================================================*/
+
+static void usage(const char* name)
+{
+	std::cerr << "Usage: " << name << " [-n iterations] <odimh5file>" << std::endl
+		  << std::endl
+		  << "  -n N    repetitions of each timed phase, the best is reported (3)" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string path;
+	int iterations = 3;
+	for (int i=1; i<argc; i++)
+	{
+		std::string opt = argv[i];
+		if (opt == "-n" && i + 1 < argc)
+			iterations = atoi(argv[++i]);
+		else if (!opt.empty() && opt[0] != '-' && path.empty())
+			path = opt;
+		else
+		{
+			usage(argv[0]);
+			return -1;
+		}
+	}
+	if (path.empty() || iterations < 1)
+	{
+		usage(argv[0]);
+		return -1;
+	}
+
+	try
+	{
+		FileLayout layout;
+		layout.fileSize = Radar::FileSystem::getFileSize(path);
+		{
+			std::unique_ptr<H5::H5File> file(HDF5File::open(path, H5F_ACC_RDONLY));
+			std::unique_ptr<H5::Group> root(HDF5File::getRoot(file.get()));
+			walk(*root, "/", layout);
+		}
+
+		std::cout << "File: " << path << std::endl
+			  << "  size " << bytesToString((double)layout.fileSize)
+			  << ", raw data " << bytesToString((double)layout.stored)
+			  << " (" << bytesToString((double)layout.logical) << " decoded)"
+			  << ", metadata " << bytesToString((double)(layout.fileSize > layout.stored ? layout.fileSize - layout.stored : 0)) << std::endl
+			  << "  " << layout.groups << " groups, " << layout.datasets.size() << " datasets, " << layout.attributes << " attributes" << std::endl
+			  << std::endl;
+
+		std::cout << std::left << std::setw(36) << "Dataset" << std::setw(9) << "type" << std::setw(12) << "dims"
+			  << std::setw(12) << "layout" << std::setw(12) << "chunk" << std::setw(20) << "filters" << "ratio" << std::endl;
+		for (size_t i=0; i<layout.datasets.size(); i++)
+		{
+			const DatasetInfo& d = layout.datasets[i];
+			if (d.dims.size() != 2 && d.logical < 64 * 1024)
+				continue;	/* gli array di how/ sono riassunti nel conteggio */
+			char ratio[16];
+			snprintf(ratio, sizeof(ratio), "%.2f", d.stored ? (double)d.logical / d.stored : 0.);
+			std::cout << std::left << std::setw(36) << d.path << std::setw(9) << d.type << std::setw(12) << dimsToString(d.dims)
+				  << std::setw(12) << d.layout << std::setw(12) << (d.chunk.empty() ? "-" : dimsToString(d.chunk))
+				  << std::setw(20) << d.filters << ratio << std::endl;
+		}
+		std::cout << std::right << std::endl;
+
+		OdimFactory factory;
+		bool enabled = HDF5Stats::isEnabled();
+		HDF5Stats::enable();
+		std::vector<Phase> phases;
+		phases.push_back(Phase("open"));
+		phases.push_back(Phase("traverse"));
+		phases.push_back(Phase("decode"));
+		for (size_t i=0; i<phases.size(); i++)
+			measure(phases[i], factory, path, iterations);
+		HDF5Stats::enable(enabled);
+
+		std::cout << "Timings (best of " << iterations << "):" << std::endl;
+		for (size_t i=0; i<phases.size(); i++)
+		{
+			const Phase& p = phases[i];
+			uint64_t attributes = p.stats[HDF5_STATS_ATTRIBUTE_READ].calls + p.stats[HDF5_STATS_ATTRIBUTE_EXISTS].calls;
+			std::cout << "  " << std::left << std::setw(10) << p.name << std::right << std::fixed << std::setprecision(3)
+				  << std::setw(10) << p.best << " ms"
+				  << "  " << attributes << " attribute lookups"
+				  << ", " << p.stats[HDF5_STATS_GROUP_ITERATE].calls << " group walks";
+			if (p.values)
+				std::cout << ", " << p.stats[HDF5_STATS_DATA_READ].calls << " reads, "
+					  << std::setprecision(1) << p.values / (p.best * 1000.) << " Mvalues/s";
+			std::cout << std::endl;
+		}
+		std::cout << "  (traverse and decode include the metadata access, decode includes traverse)" << std::endl
+			  << std::endl;
+
+		recommend(layout, phases, std::cout);
+		return 0;
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << "Error: " << e.what() << std::endl;
+		return -1;
+	}
+	catch (H5::Exception& e)
+	{
+		/* l'analisi del layout usa direttamente la libreria HDF5 */
+		std::cerr << "HDF5 error: " << e.getFuncName() << ": " << e.getDetailMsg() << std::endl;
+		return -1;
+	}
+}
@@ -0,0 +1,208 @@
+/*
+ * Radar Library
+ *
+ * Copyright (C) 2009-2010  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*! \file
+ *  \brief Thread safe caches
+ */
+
+#ifndef __RADAR_CACHE_HPP__
+#define __RADAR_CACHE_HPP__
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include <radarlib/defs.h>
+
+namespace Radar {
+
+/*===========================================================================*/
+/* LRU CACHE */
+/*===========================================================================*/
+
+/*!
+ * \brief Bounded cache that evicts the least recently used values
+ *
+ * Values are stored as shared pointers: a value evicted from the cache stays
+ * valid for the users still holding it. \n
+ * All methods are thread safe. Values are computed outside the lock, so that
+ * other threads can use the cache in the meantime, and values removed from
+ * the cache are released after unlocking it, so that their destructors can
+ * take other locks. \n
+ * Values can be stored with a weight, e.g. their size in bytes: when a
+ * maximum weight is set, values are evicted also to keep the total weight
+ * within it. \n
+ * KEY must be copyable and ordered by operator<.
+ */
+template <class KEY, class VALUE> class LRUCache
+{
+public:
+	typedef std::shared_ptr<VALUE> ValuePtr;
+
+	/*!
+	 * \brief Create a cache
+	 * \param capacity		maximum number of values kept in the cache
+	 */
+	LRUCache(size_t capacity)
+	:mutex()
+	,capacity(capacity)
+	,maxWeight(0)
+	,weight(0)
+	,hits(0)
+	,misses(0)
+	,lru()
+	,index()
+	{
+	}
+
+	/*!
+	 * \brief Get the value for the given key, without computing it
+	 * \returns			the cached value or an empty pointer
+	 */
+	ValuePtr find(const KEY& key)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		typename Index::iterator i = index.find(key);
+		if (i == index.end())
+			return ValuePtr();
+		lru.splice(lru.begin(), lru, i->second);
+		return i->second->value;
+	}
+	/*!
+	 * \brief Get the value for the given key, computing it with create(key) if it is not cached
+	 *
+	 * \param key			the key
+	 * \param create		functor called as create(key) and returning a new VALUE*
+	 */
+	template <class CREATE> ValuePtr get(const KEY& key, CREATE create)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			typename Index::iterator i = index.find(key);
+			if (i != index.end())
+			{
+				++hits;
+				lru.splice(lru.begin(), lru, i->second);
+				return i->second->value;
+			}
+			++misses;
+		}
+		return insert(key, ValuePtr(create(key)));
+	}
+	/*!
+	 * \brief Store a value
+	 *
+	 * If another value is already stored with the same key that value is kept.
+	 * A value heavier than the maximum weight is returned without being stored.
+	 * \param weight		weight of the value, counted against the maximum weight
+	 * \returns			the value stored in the cache for the key
+	 */
+	ValuePtr insert(const KEY& key, ValuePtr value, size_t weight = 0)
+	{
+		List evicted;
+		std::lock_guard<std::mutex> lock(mutex);
+		typename Index::iterator i = index.find(key);
+		if (i != index.end())
+		{
+			lru.splice(lru.begin(), lru, i->second);
+			return i->second->value;
+		}
+		if (capacity == 0 || (maxWeight && weight > maxWeight))
+			return value;
+		lru.push_front(Entry(key, value, weight));
+		index[key] = lru.begin();
+		this->weight += weight;
+		evict(evicted);
+		return value;
+	}
+	/*!
+	 * \brief Remove the value stored with the given key, if any
+	 */
+	void erase(const KEY& key)
+	{
+		List evicted;
+		std::lock_guard<std::mutex> lock(mutex);
+		typename Index::iterator i = index.find(key);
+		if (i == index.end())
+			return;
+		weight -= i->second->weight;
+		evicted.splice(evicted.begin(), lru, i->second);
+		index.erase(i);
+	}
+
+	/*! \brief Change the capacity, evicting the least recently used values if needed */
+	void setCapacity(size_t val)	{ List evicted; std::lock_guard<std::mutex> lock(mutex); capacity = val; evict(evicted);	}
+	/*! \brief Maximum number of values kept in the cache */
+	size_t getCapacity() const	{ std::lock_guard<std::mutex> lock(mutex); return capacity;		}
+	/*! \brief Change the maximum total weight, 0 for no limit */
+	void setMaxWeight(size_t val)	{ List evicted; std::lock_guard<std::mutex> lock(mutex); maxWeight = val; evict(evicted);	}
+	/*! \brief Maximum total weight of the cached values, 0 for no limit */
+	size_t getMaxWeight() const	{ std::lock_guard<std::mutex> lock(mutex); return maxWeight;		}
+	/*! \brief Total weight of the cached values */
+	size_t getWeight() const	{ std::lock_guard<std::mutex> lock(mutex); return weight;		}
+	/*! \brief Number of cached values */
+	size_t size() const		{ std::lock_guard<std::mutex> lock(mutex); return lru.size();		}
+	/*! \brief Remove every value from the cache */
+	void clear()			{ List evicted; std::lock_guard<std::mutex> lock(mutex); index.clear(); evicted.swap(lru); weight = 0;	}
+	/*! \brief Number of get() calls satisfied by the cache */
+	size_t getHits() const		{ std::lock_guard<std::mutex> lock(mutex); return hits;			}
+	/*! \brief Number of get() calls that computed a value */
+	size_t getMisses() const	{ std::lock_guard<std::mutex> lock(mutex); return misses;		}
+
+private:
+	struct Entry {
+		KEY		key;
+		ValuePtr	value;
+		size_t		weight;
+
+		Entry(const KEY& key, ValuePtr value, size_t weight) : key(key), value(value), weight(weight) { }
+	};
+	typedef std::list<Entry>				List;		/* most recently used first */
+	typedef std::map<KEY, typename List::iterator>		Index;
+
+	mutable std::mutex	mutex;
+	size_t			capacity;
+	size_t			maxWeight;
+	size_t			weight;
+	size_t			hits;
+	size_t			misses;
+	List			lru;
+	Index			index;
+
+	/* moves the values to remove to evicted, that the caller destroys after unlocking */
+	void evict(List& evicted)
+	{
+		while (lru.size() > capacity || (maxWeight && weight > maxWeight))
+		{
+			weight -= lru.back().weight;
+			index.erase(lru.back().key);
+			evicted.splice(evicted.begin(), lru, --lru.end());
+		}
+	}
+};
+
+/*===========================================================================*/
+
+}
+
+#endif
@@ -33,6 +33,7 @@
 #include <radarlib/odimh5v20_const.hpp>
 #include <radarlib/odimh5v20_format.hpp>
 #include <radarlib/odimh5v20_metadata.hpp>
+#include <radarlib/odimh5v21_hdf5.hpp>
 
 namespace OdimH5v20
 {
@@ -126,8 +127,8 @@ OdimObject::~OdimObject()
 		delete meta_how;	
 		delete group;	
 		delete file;
-		/* alla chiusura di un file costringiamo la libreria a fare un po' di pulizia */
-		H5::H5Library::garbageCollect();
+		/* alla chiusura di un file la libreria puo' fare un po' di pulizia */
+		OdimH5v21::HDF5Library::instance().fileClosed();
 		
 	}
 	catch (...)
@@ -23,6 +23,7 @@
 #include <radarlib/odimh5v20_factory.hpp>
 
 #include <radarlib/debug.hpp>
+#include <radarlib/odimh5v21_hdf5.hpp>
 
 namespace OdimH5v20 {
 
@@ -36,9 +37,9 @@ OdimFactory::~OdimFactory()
 {
 	try
 	{
-		/* quando si chiude una factory si pulisce la memoria */
-		/* per obbligare HDF5 a chiudere quello che va chiuso */
-		H5::H5Library::garbageCollect();
+		/* quando si chiude una factory si pulisce la memoria di HDF5 */
+		/* secondo la politica scelta in OdimH5v21::HDF5Library, comune a tutto il processo */
+		OdimH5v21::HDF5Library::instance().factoryReleased();
 	}
 	catch (...)
 	{
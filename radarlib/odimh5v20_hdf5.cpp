@@ -33,6 +33,7 @@
 #include <radarlib/string.hpp>
 #include <radarlib/odimh5v20_const.hpp>
 #include <radarlib/odimh5v20_exceptions.hpp>
+#include <radarlib/odimh5v21_hdf5.hpp>
 
 namespace OdimH5v20 {
 
@@ -82,6 +83,7 @@ static void initLibrary()
 H5::H5File* HDF5File::open(const std::string& path, int h5flags) 
 {
 	initLibrary();
+	OdimH5v21::HDF5Library::instance().fileOpening();
 	try
 	{	
 		return new H5::H5File(path.c_str(), h5flags);
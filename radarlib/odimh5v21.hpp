@@ -36,6 +36,21 @@
 #include <radarlib/odimh5v21_dump.hpp>		/* odim h5 v21 dumper */
 #include <radarlib/odimh5v21_factory.hpp>	/* odim h5 v21 factory class */
 #include <radarlib/odimh5v21_utils.hpp>		/* odim h5 v21 utilities */
+#include <radarlib/odimh5v21_geometry.hpp>	/* polar gates geolocation */
+#include <radarlib/odimh5v21_cartesian.hpp>	/* polar to cartesian products */
+#include <radarlib/odimh5v21_composite.hpp>	/* multi radar composites */
+#include <radarlib/odimh5v21_xsec.hpp>		/* vertical cross sections */
+#include <radarlib/odimh5v21_rainrate.hpp>	/* Z-R and K-R rain rates */
+#include <radarlib/odimh5v21_accumulation.hpp>	/* rainfall accumulation */
+#include <radarlib/odimh5v21_clutter.hpp>		/* ground clutter maps */
+#include <radarlib/odimh5v21_extraction.hpp>	/* point and polygon extraction */
+#include <radarlib/odimh5v21_expression.hpp>	/* gate filters and derived quantities */
+#include <radarlib/odimh5v21_synthetic.hpp>	/* synthetic volumes and composites */
+#include <radarlib/odimh5v21_stats.hpp>		/* HDF5 operation counters */
+#include <radarlib/odimh5v21_trace.hpp>		/* tracing hooks */
+#include <radarlib/odimh5v21_filecache.hpp>	/* cache of open read-only files */
+#include <radarlib/odimh5v21_batch.hpp>		/* multi-process batch runner */
+#include <radarlib/odimh5v21_watcher.hpp>	/* inotify watcher of incoming files */
 
 /*===========================================================================*/
 
@@ -0,0 +1,250 @@
+/*
+ * odimh5v21_accumulation - rainfall accumulation over sequences of products
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <radarlib/odimh5v21_accumulation.hpp>
+#include <radarlib/odimh5v21_const.hpp>
+#include <radarlib/odimh5v21_exceptions.hpp>
+#include <radarlib/odimh5v21_factory.hpp>
+#include <radarlib/parallel.hpp>
+
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+
+namespace OdimH5v21 {
+namespace products {
+
+namespace {
+
+/* corners read back from files differ from the computed ones by rounding errors */
+bool sameGrid(const CartesianGrid& a, const CartesianGrid& b)
+{
+	return a.projdef == b.projdef && a.xsize == b.xsize && a.ysize == b.ysize
+		&& fabs(a.xscale - b.xscale) <= a.xscale * 1e-6 && fabs(a.yscale - b.yscale) <= a.yscale * 1e-6
+		&& fabs(a.ulx - b.ulx) <= a.xscale * 1e-3 && fabs(a.uly - b.uly) <= a.yscale * 1e-3;
+}
+
+}
+
+struct RainAccumulator::UpdateTask
+{
+	const float*	rates;
+	double*		sum;
+	float*		observed;
+	double		hours;
+	float		seconds;
+	int		xsize;
+
+	void operator()(size_t begin, size_t end) const
+	{
+		for (size_t i = begin * xsize, last = end * xsize; i < last; ++i)
+		{
+			float r = rates[i];
+			if (r != r)
+				continue;
+			if (r != UNDETECT && r > 0)
+				sum[i] += r * hours;
+			observed[i] += seconds;
+		}
+	}
+};
+
+struct RainAccumulator::ComputeTask
+{
+	const double*	sum;
+	const float*	observed;
+	double		period;
+	double		minObserved;
+	float*		out;
+	int		xsize;
+
+	void operator()(size_t begin, size_t end) const
+	{
+		for (size_t i = begin * xsize, last = end * xsize; i < last; ++i)
+		{
+			double o = observed[i];
+			out[i] = o <= 0 || o < minObserved ? NODATA : (float)(sum[i] * (period / o));
+		}
+	}
+};
+
+RainAccumulator::RainAccumulator(int threads)
+	: grid(), fixedGrid(false), threads(threads), rowsPerBlock(16), timeStep(300), maxGap(0), minCoverage(0.5),
+	  frames(0), start(0), end(0), source(), sum(), observed(), frame()
+{
+}
+
+RainAccumulator::RainAccumulator(const CartesianGrid& grid, int threads)
+	: grid(grid), fixedGrid(true), threads(threads), rowsPerBlock(16), timeStep(300), maxGap(0), minCoverage(0.5),
+	  frames(0), start(0), end(0), source(), sum(), observed(), frame()
+{
+}
+
+void RainAccumulator::setTimeStep(int val)
+{
+	if (val <= 0)
+		throw std::invalid_argument("Time step must be positive");
+	timeStep = val;
+}
+
+void RainAccumulator::setMaxGap(int val)
+{
+	if (val < 0)
+		throw std::invalid_argument("Maximum gap must not be negative");
+	maxGap = val;
+}
+
+void RainAccumulator::clear()
+{
+	if (!fixedGrid)
+		grid = CartesianGrid();
+	frames = 0;
+	start = end = 0;
+	source = SourceInfo();
+	std::vector<double>().swap(sum);
+	std::vector<float>().swap(observed);
+	std::vector<float>().swap(frame);
+}
+
+void RainAccumulator::update(time_t time, const float* rates)
+{
+	if (frames > 0 && time <= end)
+		throw std::invalid_argument("Frames must be added in increasing time order");
+
+	size_t size = (size_t)grid.xsize * grid.ysize;
+	int interval = timeStep;
+	if (frames == 0)
+	{
+		sum.assign(size, 0.);
+		observed.assign(size, 0.f);
+		start = time - timeStep;
+	}
+	else
+	{
+		interval = (int)(time - end);
+		if (interval > getMaxGap())
+			interval = getMaxGap();
+	}
+	end = time;
+	++frames;
+	if (!size)
+		return;
+
+	UpdateTask task = { rates, &sum[0], &observed[0], interval / 3600., (float)interval, grid.xsize };
+	Radar::parallel::forBlocks((size_t)grid.ysize, rowsPerBlock, threads, task);
+}
+
+void RainAccumulator::addFrame(time_t time, const DataMatrix<float>& rates)
+{
+	if (grid.xsize == 0 && grid.ysize == 0)
+		throw std::invalid_argument("Frames without metadata need an accumulator with a grid");
+	if (rates.getColCount() != grid.xsize || rates.getRowCount() != grid.ysize)
+		throw std::invalid_argument("Frame size does not match the accumulation grid");
+	update(time, rates.get());
+}
+
+void RainAccumulator::addFrame(HorizontalObject_2D& object, int dataset, const std::string& quantity)
+{
+	if (dataset < 0)
+	{
+		int count = object.getProductCount();
+		for (int i = 0; i < count && dataset < 0; ++i)
+		{
+			std::unique_ptr<Product_2D> product(object.getProduct(i));
+			if (product->hasQuantityData(quantity))
+				dataset = i;
+		}
+		if (dataset < 0)
+			throw OdimH5Exception("No dataset contains quantity " + quantity);
+	}
+
+	CartesianGrid frameGrid = CartesianGrid::readFrom(object);
+	if (grid.xsize == 0 && grid.ysize == 0)
+		grid = frameGrid;
+	else if (!sameGrid(frameGrid, grid))
+		throw std::invalid_argument("Frame grid does not match the accumulation grid");
+
+	std::unique_ptr<Product_2D> product(object.getProduct(dataset));
+	if (product.get() == NULL)
+		throw OdimH5Exception("Dataset not found in the image");
+	std::unique_ptr<Product_2D_Data> data(product->getQuantityData(quantity));
+	if (data.get() == NULL)
+		throw OdimH5Exception("Quantity " + quantity + " not found in the image dataset");
+	if (data->getNumXElem() != grid.xsize || data->getNumYElem() != grid.ysize)
+		throw OdimH5FormatException("Size of quantity " + quantity + " does not match the image size");
+
+	/* HDF5 reads stay in this thread, the buffer is reused by the next frames */
+	frame.resize((size_t)grid.xsize * grid.ysize + 1);
+	data->readTranslatedData(&frame[0], NODATA, UNDETECT);
+	if (frames == 0)
+		source = object.getSource();
+	update(object.getDateTime(), &frame[0]);
+}
+
+void RainAccumulator::addFile(const std::string& path, const std::string& quantity)
+{
+	OdimFactory factory;
+	std::unique_ptr<OdimObject> object(factory.open(path));
+	HorizontalObject_2D* image = dynamic_cast<HorizontalObject_2D*>(object.get());
+	if (image == NULL)
+		throw OdimH5Exception(path + " is not an image or composite object");
+	addFrame(*image, -1, quantity);
+}
+
+void RainAccumulator::compute(DataMatrix<float>& out)
+{
+	if (frames == 0)
+		throw OdimH5Exception("No frame in the accumulation");
+	out.resize(grid.ysize, grid.xsize);
+	if (sum.empty())
+		return;
+
+	double period = (double)(end - start);
+	ComputeTask task = { &sum[0], &observed[0], period, period * minCoverage, &out.elem(0, 0), grid.xsize };
+	Radar::parallel::forBlocks((size_t)grid.ysize, rowsPerBlock, threads, task);
+}
+
+Product_RR* RainAccumulator::generate(HorizontalObject_2D& object, const Encoding& encoding)
+{
+	DataMatrix<float> values;
+	compute(values);
+
+	object.setDateTime(end);
+	if (!source.toString().empty())
+		object.setSource(source);
+	grid.writeTo(object);
+
+	std::unique_ptr<Product_RR> dataset(object.createProductRR());
+	dataset->setStartDateTime(start);
+	dataset->setEndDateTime(end);
+	grid.writeTo(*dataset);
+	dataset->setCCnum(frames);
+
+	std::unique_ptr<Product_2D_Data> data(dataset->createQuantityData(PRODUCT_QUANTITY_ACRR));
+	encoding.write(values, *data);
+	return dataset.release();
+}
+
+Encoding RainAccumulator::defaultEncoding()
+{
+	return Encoding(RAW_UINT16, 0.01, 0., 65535., 0.);
+}
+
+}
+}
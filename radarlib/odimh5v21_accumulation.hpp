@@ -0,0 +1,176 @@
+/*
+ * odimh5v21_accumulation - rainfall accumulation over sequences of products
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef __RADAR_ODIMH5V21_ACCUMULATION_HPP__
+#define __RADAR_ODIMH5V21_ACCUMULATION_HPP__
+/*!
+ * \file
+ * \brief Streaming rainfall accumulation (ACRR) of rain rate products
+ */
+
+#include <radarlib/odimh5v21_cartesian.hpp>
+
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace OdimH5v21 {
+namespace products {
+
+/*!
+ * \brief Accumulation of a time ordered sequence of rain rate fields
+ *
+ * Frames are added one at a time, in increasing time order, and only the
+ * running sums are kept: a grid of doubles with the accumulated rain (mm) and
+ * a grid of floats with the time (s) each pixel has been observed, besides
+ * the buffer of the frame being added. \n
+ * A frame valid at time t holds the rate (mm/h) of the interval since the
+ * previous frame, at most getMaxGap() seconds long; the first frame holds
+ * getTimeStep() seconds. Longer intervals, as the ones left by missing
+ * frames, are observed only for getMaxGap() seconds, and NODATA pixels are
+ * not observed at all. UNDETECT pixels have no rain. \n
+ * Pixels observed for less than getMinCoverage() of the whole period are
+ * NODATA, the others are scaled to the whole period. Pixels are updated in
+ * parallel blocks of rows, HDF5 reads stay in the calling thread.
+ */
+class RADAR_API RainAccumulator {
+ public:
+	/*!
+	 * \brief Create an accumulator whose grid is the one of the first frame
+	 * \param threads	number of threads, 0 for one thread per core
+	 */
+	RainAccumulator(int threads = 0);
+	/*!
+	 * \brief Create an accumulator for the given grid
+	 */
+	RainAccumulator(const CartesianGrid& grid, int threads = 0);
+
+	void setThreads(int val)		{ threads = val; }
+	int getThreads() const			{ return threads; }
+	/*!
+	 * \brief Number of rows assigned to a thread at a time
+	 */
+	void setRowsPerBlock(int val)		{ rowsPerBlock = val > 0 ? val : 1; }
+	/*!
+	 * \brief Nominal interval between frames (s), default 300
+	 */
+	void setTimeStep(int val);
+	int getTimeStep() const			{ return timeStep; }
+	/*!
+	 * \brief Longest interval (s) covered by a single frame, 0 (default) for twice the time step
+	 */
+	void setMaxGap(int val);
+	int getMaxGap() const			{ return maxGap > 0 ? maxGap : 2 * timeStep; }
+	/*!
+	 * \brief Minimum fraction of the period a pixel must be observed, default 0.5
+	 */
+	void setMinCoverage(double val)		{ minCoverage = val; }
+	double getMinCoverage() const		{ return minCoverage; }
+
+	/*!
+	 * \brief Remove every frame, keeping the grid if it was given to the constructor
+	 */
+	void clear();
+
+	/*!
+	 * \brief Add the rain rates of a frame
+	 * \param time		time the frame is valid at, after the one of the previous frame
+	 * \param rates		rain rates (mm/h) on the grid
+	 * \throws std::invalid_argument	if the time or the size are wrong
+	 */
+	void addFrame(time_t time, const DataMatrix<float>& rates);
+	/*!
+	 * \brief Add a rain rate product of an image or composite object
+	 *
+	 * The frame is valid at the date and time of the object, its grid must be
+	 * the one of the accumulator.
+	 * \param dataset	index of the dataset, -1 for the first one that has the quantity
+	 * \param quantity	rain rate quantity, in mm/h
+	 */
+	void addFrame(HorizontalObject_2D& object, int dataset = -1, const std::string& quantity = PRODUCT_QUANTITY_RATE);
+	/*!
+	 * \brief Open an image or composite file and add its rain rate product
+	 */
+	void addFile(const std::string& path, const std::string& quantity = PRODUCT_QUANTITY_RATE);
+
+	/*!
+	 * \brief Number of frames added
+	 */
+	int getFrameCount() const		{ return frames; }
+	/*!
+	 * \brief Beginning of the accumulation period
+	 */
+	time_t getStartDateTime() const		{ return start; }
+	/*!
+	 * \brief End of the accumulation period, the time of the last frame
+	 */
+	time_t getEndDateTime() const		{ return end; }
+	/*!
+	 * \brief Grid of the accumulation, empty before the first frame when not given
+	 */
+	const CartesianGrid& getGrid() const	{ return grid; }
+
+	/*!
+	 * \brief Compute the accumulated rain (mm) of the period
+	 * \param out		resized to the grid
+	 */
+	void compute(DataMatrix<float>& out);
+
+	/*!
+	 * \brief Store the accumulation in an image or composite object as an RR product
+	 *
+	 * Root what/ and where/ of the object are set from the last frame and the
+	 * grid, what/source only when frames have been read from objects. The
+	 * new dataset stores the period in startdate/enddate and the number of
+	 * frames in how/ACCnum.
+	 * \returns		the new dataset, with quantity ACRR
+	 * \remarks		User is responsible for deleting the returned object
+	 */
+	Product_RR* generate(HorizontalObject_2D& object, const Encoding& encoding = defaultEncoding());
+
+	/*!
+	 * \brief 16 bit unsigned, gain 0.01 mm, offset 0, nodata 65535, undetect 0
+	 */
+	static Encoding defaultEncoding();
+
+ private:
+	struct UpdateTask;
+	struct ComputeTask;
+
+	CartesianGrid		grid;
+	bool			fixedGrid;
+	int			threads;
+	int			rowsPerBlock;
+	int			timeStep;
+	int			maxGap;
+	double			minCoverage;
+	int			frames;
+	time_t			start, end;
+	SourceInfo		source;
+	std::vector<double>	sum;		/* mm */
+	std::vector<float>	observed;	/* s */
+	std::vector<float>	frame;		/* buffer of the frame being added */
+
+	void update(time_t time, const float* rates);
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,705 @@
+/*
+ * odimh5v21_batch - multi-process batch processing of ODIM files
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <radarlib/odimh5v21_batch.hpp>
+#include <radarlib/odimh5v21_factory.hpp>
+#include <radarlib/odimh5v21_dump.hpp>
+#include <radarlib/odimh5v21_exceptions.hpp>
+#include <radarlib/io.hpp>
+#include <radarlib/parallel.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+#if !defined(WIN32)
+	#include <errno.h>
+	#include <poll.h>
+	#include <signal.h>
+	#include <unistd.h>
+	#include <sys/types.h>
+	#include <sys/wait.h>
+#endif
+
+namespace OdimH5v21 {
+
+/*===========================================================================*/
+/* BUILT-IN TASKS */
+/*===========================================================================*/
+
+BatchTask::~BatchTask()
+{
+}
+
+void BatchTask::start(const BatchOptions& /*options*/)
+{
+}
+
+void BatchTask::finish()
+{
+}
+
+namespace {
+
+/* legge tutti i dataset di dati e di qualita' come float, come farebbe una conversione */
+class CheckTask : public BatchTask {
+ public:
+	virtual void process(const std::string& path)
+	{
+		OdimFactory factory;
+		std::unique_ptr<OdimObject> object(factory.open(path, H5F_ACC_RDONLY));
+		std::vector<char> buffer;
+		int datasets = object->getDatasetCount();
+		for (int d=0; d<datasets; d++)
+		{
+			std::unique_ptr<OdimDataset> dataset(object->getDataset(d));
+			for (int q=0; q<dataset->getQualityCount(); q++)
+			{
+				std::unique_ptr<OdimQuality> quality(dataset->getQuality(q));
+				readQuality(quality.get(), buffer);
+			}
+			for (int i=0; i<dataset->getDataCount(); i++)
+			{
+				std::unique_ptr<OdimData> data(dataset->getData(i));
+				buffer.resize((size_t)data->getDataWidth() * data->getDataHeight() * sizeof(float));
+				if (buffer.size())
+					data->readData(&buffer[0], RAW_FLOAT);
+				for (int q=0; q<data->getQualityCount(); q++)
+				{
+					std::unique_ptr<OdimQuality> quality(data->getQuality(q));
+					readQuality(quality.get(), buffer);
+				}
+			}
+		}
+	}
+
+	static BatchTask* create()	{ return new CheckTask(); }
+
+ private:
+	static void readQuality(OdimQuality* quality, std::vector<char>& buffer)
+	{
+		buffer.resize((size_t)quality->getQualityWidth() * quality->getQualityHeight() * sizeof(float));
+		if (buffer.size())
+			quality->readQuality(&buffer[0], RAW_FLOAT);
+	}
+};
+
+class DumpTask : public BatchTask {
+ public:
+	virtual void start(const BatchOptions& options)
+	{
+		BatchOptions::const_iterator i = options.find("output");
+		if (i == options.end() || i->second.empty())
+			throw std::invalid_argument("The dump task needs the output option");
+		output = i->second;
+		Radar::FileSystem::mkDirTree(output);
+	}
+
+	virtual void process(const std::string& path)
+	{
+		OdimFactory factory;
+		std::unique_ptr<OdimObject> object(factory.open(path, H5F_ACC_RDONLY));
+		std::string dst = output + "/" + Radar::Path::getFileName(path) + ".txt";
+		std::ofstream out(dst.c_str());
+		std::unique_ptr<OdimObjectDumper> dumper(factory.getDumper());
+		dumper->dump(object.get(), out);
+		out.close();
+		if (!out)
+			throw std::runtime_error("Cannot write " + dst);
+	}
+
+	static BatchTask* create()	{ return new DumpTask(); }
+
+ private:
+	std::string	output;
+};
+
+struct TaskInfo {
+	BatchTaskFactory	factory;
+	std::string		description;
+};
+
+typedef std::map<std::string, TaskInfo> TaskMap;
+
+std::mutex& registryMutex()
+{
+	static std::mutex mutex;
+	return mutex;
+}
+
+TaskMap& registry()
+{
+	/* chiamata con il mutex acquisito */
+	static TaskMap tasks;
+	if (tasks.empty())
+	{
+		TaskInfo check	= { CheckTask::create, "open the file and read every data and quality dataset" };
+		TaskInfo dump	= { DumpTask::create, "write the dump of the file to the directory given by output=DIR" };
+		tasks["check"]	= check;
+		tasks["dump"]	= dump;
+	}
+	return tasks;
+}
+
+}
+
+void BatchTasks::add(const std::string& name, BatchTaskFactory factory, const std::string& description)
+{
+	std::lock_guard<std::mutex> lock(registryMutex());
+	TaskInfo info = { factory, description };
+	registry()[name] = info;
+}
+
+BatchTask* BatchTasks::create(const std::string& name)
+{
+	BatchTaskFactory factory = NULL;
+	{
+		std::lock_guard<std::mutex> lock(registryMutex());
+		TaskMap::const_iterator i = registry().find(name);
+		if (i == registry().end())
+			throw std::invalid_argument("Unknown batch task " + name);
+		factory = i->second.factory;
+	}
+	return factory();
+}
+
+bool BatchTasks::exists(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(registryMutex());
+	return registry().count(name) > 0;
+}
+
+std::vector<std::string> BatchTasks::getNames()
+{
+	std::lock_guard<std::mutex> lock(registryMutex());
+	std::vector<std::string> result;
+	for (TaskMap::const_iterator i = registry().begin(); i != registry().end(); ++i)
+		result.push_back(i->first);
+	return result;
+}
+
+std::string BatchTasks::getDescription(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(registryMutex());
+	TaskMap::const_iterator i = registry().find(name);
+	return i == registry().end() ? std::string() : i->second.description;
+}
+
+BatchListener::~BatchListener()
+{
+}
+
+/*===========================================================================*/
+/* CHECKPOINT */
+/*===========================================================================*/
+
+namespace {
+
+/* una riga per file: "done\tpath" oppure "failed\tpath\tmessaggio" */
+struct Checkpoint {
+	std::map<std::string, BatchResult>	results;
+	bool					truncated;	/* l'ultima riga non e' terminata */
+
+	void load(const std::string& path)
+	{
+		std::ifstream in(path.c_str());
+		std::string line;
+		truncated = false;
+		while (std::getline(in, line))
+		{
+			truncated = in.eof();
+			size_t tab1 = line.find('\t');
+			if (tab1 == std::string::npos)
+				continue;		/* riga troncata da un'interruzione */
+			size_t tab2 = line.find('\t', tab1 + 1);
+			std::string status = line.substr(0, tab1);
+			BatchResult result;
+			result.path	= line.substr(tab1 + 1, tab2 == std::string::npos ? std::string::npos : tab2 - tab1 - 1);
+			result.ok	= status == "done";
+			result.message	= tab2 == std::string::npos ? std::string() : line.substr(tab2 + 1);
+			result.seconds	= 0;
+			if (status == "done" || status == "failed")
+				results[result.path] = result;
+		}
+	}
+};
+
+std::string oneLine(const std::string& text)
+{
+	std::string result = text;
+	for (size_t i=0; i<result.size(); i++)
+		if (result[i] == '\t' || result[i] == '\n' || result[i] == '\r')
+			result[i] = ' ';
+	return result;
+}
+
+}
+
+/*===========================================================================*/
+/* WORKERS */
+/*===========================================================================*/
+
+#if !defined(WIN32)
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/* messaggio di un worker: indice del file, esito e lunghezza del testo che segue */
+struct ResultHeader {
+	uint32_t	index;
+	uint32_t	ok;
+	uint32_t	length;
+};
+
+const size_t MAX_MESSAGE = 1024;
+
+bool readFully(int fd, void* buffer, size_t size)
+{
+	char* p = (char*)buffer;
+	while (size)
+	{
+		ssize_t n = ::read(fd, p, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		size -= (size_t)n;
+	}
+	return true;
+}
+
+bool writeFully(int fd, const void* buffer, size_t size)
+{
+	const char* p = (const char*)buffer;
+	while (size)
+	{
+		ssize_t n = ::write(fd, p, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		size -= (size_t)n;
+	}
+	return true;
+}
+
+struct Worker {
+	pid_t			pid;
+	int			commands;	/* indici dei file da elaborare */
+	int			results;	/* esiti */
+	int			current;	/* file in elaborazione, -1 se libero */
+	Clock::time_point	started;
+	bool			timedOut;
+};
+
+/* il ciclo di un worker, non ritorna */
+void workerMain(const std::string& taskName, const BatchOptions& options, const std::vector<std::string>& paths, int commands, int results)
+{
+	/* nessuna eccezione deve risalire nel codice del padre copiato con fork() */
+	try {
+		std::unique_ptr<BatchTask> task;
+		std::string startError;
+		try {
+			task.reset(BatchTasks::create(taskName));
+			task->start(options);
+		} catch (std::exception& e) {
+			startError = e.what();
+			task.reset();
+		}
+
+		uint32_t index;
+		while (readFully(commands, &index, sizeof(index)))
+		{
+			std::string message = startError;
+			bool ok = false;
+			if (task.get())
+			{
+				try {
+					task->process(paths.at(index));
+					ok = true;
+				} catch (std::exception& e) {
+					message = e.what();
+				} catch (...) {
+					message = "unknown error";
+				}
+			}
+			if (message.size() > MAX_MESSAGE)
+				message.resize(MAX_MESSAGE);
+			ResultHeader header = { index, ok ? 1u : 0u, (uint32_t)message.size() };
+			if (!writeFully(results, &header, sizeof(header)) || !writeFully(results, message.data(), message.size()))
+				break;
+		}
+
+		int status = 0;
+		if (task.get())
+		{
+			try {
+				task->finish();
+			} catch (std::exception& e) {
+				std::cerr << "Batch task " << taskName << " failed to finish: " << e.what() << std::endl;
+				status = 1;
+			}
+		}
+		task.reset();
+		std::cout.flush();
+		std::cerr.flush();
+		/* i distruttori statici e gli atexit appartengono al processo padre */
+		_exit(status);
+	} catch (...) {
+		_exit(2);
+	}
+}
+
+}
+
+#endif
+
+/*===========================================================================*/
+/* RUNNER */
+/*===========================================================================*/
+
+BatchRunner::BatchRunner(const std::string& task, int workers)
+:task(task)
+,workers(Radar::parallel::threadCount(workers))
+,options()
+,checkpoint()
+,retryFailed(false)
+,timeout(0)
+,listener(NULL)
+{
+	if (!BatchTasks::exists(task))
+		throw std::invalid_argument("Unknown batch task " + task);
+}
+
+void BatchRunner::setWorkers(int val)
+{
+	workers = Radar::parallel::threadCount(val);
+}
+
+std::vector<std::string> BatchRunner::listFiles(const std::string& dir, const std::string& extension, bool recursive)
+{
+	std::vector<std::string> result, names;
+	Radar::FileSystem::listFiles(names, dir);
+	std::sort(names.begin(), names.end());
+	for (size_t i=0; i<names.size(); i++)
+		if (extension.empty() || (names[i].size() >= extension.size() && names[i].compare(names[i].size() - extension.size(), extension.size(), extension) == 0))
+			result.push_back(dir + "/" + names[i]);
+	if (recursive)
+	{
+		std::vector<std::string> dirs;
+		Radar::FileSystem::listDirs(dirs, dir);
+		for (size_t i=0; i<dirs.size(); i++)
+		{
+			std::vector<std::string> sub = listFiles(dir + "/" + dirs[i], extension, true);
+			result.insert(result.end(), sub.begin(), sub.end());
+		}
+	}
+	return result;
+}
+
+#if defined(WIN32)
+
+BatchReport BatchRunner::run(const std::vector<std::string>& paths)
+{
+	throw OdimH5UnsupportedException("Batch processing needs fork(), not available on this system");
+}
+
+#else
+
+namespace {
+
+struct IgnoreSigpipe {
+	struct sigaction previous;
+
+	IgnoreSigpipe()
+	{
+		struct sigaction action;
+		memset(&action, 0, sizeof(action));
+		action.sa_handler = SIG_IGN;
+		sigaction(SIGPIPE, &action, &previous);
+	}
+	~IgnoreSigpipe()
+	{
+		sigaction(SIGPIPE, &previous, NULL);
+	}
+};
+
+/* file piu' grandi per primi: i worker finiscono insieme */
+struct LargerFirst {
+	const std::vector<uint64_t>& sizes;
+	LargerFirst(const std::vector<uint64_t>& sizes) : sizes(sizes) { }
+	bool operator()(int a, int b) const	{ return sizes[a] > sizes[b]; }
+};
+
+}
+
+BatchReport BatchRunner::run(const std::vector<std::string>& paths)
+{
+	Clock::time_point begin = Clock::now();
+	BatchReport report;
+	report.files	= (int)paths.size();
+	report.resumed	= 0;
+	report.done	= 0;
+	report.bytes	= 0;
+	report.seconds	= 0;
+
+	Checkpoint previous;
+	std::ofstream log;
+	if (!checkpoint.empty())
+	{
+		previous.load(checkpoint);
+		log.open(checkpoint.c_str(), std::ios::app);
+		if (previous.truncated)
+			log << "\n";
+		if (!log)
+			throw std::runtime_error("Cannot write checkpoint " + checkpoint);
+	}
+
+	std::vector<uint64_t> sizes(paths.size(), 0);
+	std::vector<int> pending;
+	for (size_t i=0; i<paths.size(); i++)
+	{
+		std::map<std::string, BatchResult>::const_iterator p = previous.results.find(paths[i]);
+		if (p != previous.results.end() && (p->second.ok || !retryFailed))
+		{
+			report.resumed++;
+			if (!p->second.ok)
+				report.failures.push_back(p->second);
+			continue;
+		}
+		try {
+			sizes[i] = Radar::FileSystem::getFileSize(paths[i]);
+		} catch (std::exception&) {
+			/* il task riportera' l'errore */
+		}
+		pending.push_back((int)i);
+	}
+	std::stable_sort(pending.begin(), pending.end(), LargerFirst(sizes));
+
+	IgnoreSigpipe sigpipe;
+	std::vector<Worker> pool;
+	size_t next = 0;
+	int finished = report.resumed;
+
+	/* l'esito di un file: report, checkpoint e listener */
+	auto record = [&](const BatchResult& result, uint64_t size) {
+		if (result.ok)
+		{
+			report.done++;
+			report.bytes += size;
+		}
+		else
+			report.failures.push_back(result);
+		if (log.is_open())
+		{
+			if (result.ok)	log << "done\t" << result.path << "\n";
+			else		log << "failed\t" << result.path << "\t" << oneLine(result.message) << "\n";
+			log.flush();
+			if (!log)
+				throw std::runtime_error("Cannot write checkpoint " + checkpoint);
+		}
+		finished++;
+		if (listener)
+			listener->fileDone(result, finished, report.files);
+	};
+
+	try
+	{
+		while (next < pending.size() || !pool.empty())
+		{
+			/* un worker per file in attesa, fino al massimo */
+			size_t idle = 0;
+			for (size_t w=0; w<pool.size(); w++)
+				if (pool[w].current < 0)
+					idle++;
+			for (; (int)pool.size() < workers && idle < pending.size() - next; idle++)
+			{
+				int commands[2], results[2];
+				if (pipe(commands) != 0)
+					throw std::runtime_error(std::string("Cannot create pipe: ") + strerror(errno));
+				if (pipe(results) != 0)
+				{
+					close(commands[0]); close(commands[1]);
+					throw std::runtime_error(std::string("Cannot create pipe: ") + strerror(errno));
+				}
+				std::cout.flush();
+				std::cerr.flush();
+				fflush(NULL);
+				pid_t pid = fork();
+				if (pid < 0)
+				{
+					close(commands[0]); close(commands[1]); close(results[0]); close(results[1]);
+					throw std::runtime_error(std::string("Cannot start worker: ") + strerror(errno));
+				}
+				if (pid == 0)
+				{
+					/* i worker non devono tenere aperte le pipe degli altri */
+					for (size_t w=0; w<pool.size(); w++)
+					{
+						close(pool[w].commands);
+						close(pool[w].results);
+					}
+					close(commands[1]);
+					close(results[0]);
+					workerMain(task, options, paths, commands[0], results[1]);
+				}
+				close(commands[0]);
+				close(results[1]);
+				Worker worker = { pid, commands[1], results[0], -1, Clock::now(), false };
+				pool.push_back(worker);
+			}
+
+			/* un file a ogni worker libero */
+			for (size_t w=0; w<pool.size() && next < pending.size(); w++)
+			{
+				if (pool[w].current >= 0)
+					continue;
+				uint32_t index = (uint32_t)pending[next++];
+				pool[w].current	= (int)index;
+				pool[w].started	= Clock::now();
+				if (!writeFully(pool[w].commands, &index, sizeof(index)))
+					kill(pool[w].pid, SIGKILL);	/* gestito come un crash */
+			}
+
+			/* i worker rimasti senza lavoro terminano */
+			for (size_t w=0; w<pool.size(); w++)
+				if (pool[w].current < 0 && pool[w].commands >= 0)
+				{
+					close(pool[w].commands);
+					pool[w].commands = -1;
+				}
+
+			std::vector<struct pollfd> fds(pool.size());
+			for (size_t w=0; w<pool.size(); w++)
+			{
+				fds[w].fd	= pool[w].results;
+				fds[w].events	= POLLIN;
+				fds[w].revents	= 0;
+			}
+			int wait = -1;
+			if (timeout > 0)
+			{
+				wait = 1000;
+				for (size_t w=0; w<pool.size(); w++)
+					if (pool[w].current >= 0)
+					{
+						long left = (long)timeout * 1000 - (long)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - pool[w].started).count();
+						if (left < wait)
+							wait = left > 0 ? (int)left : 0;
+					}
+			}
+			int ready = poll(fds.empty() ? NULL : &fds[0], fds.size(), wait);
+			if (ready < 0 && errno != EINTR)
+				throw std::runtime_error(std::string("poll failed: ") + strerror(errno));
+
+			for (size_t w=0; w<pool.size(); )
+			{
+				Worker& worker = pool[w];
+				bool gone = false;
+				if (ready > 0 && fds[w].revents)
+				{
+					ResultHeader header;
+					std::string message;
+					if (readFully(worker.results, &header, sizeof(header)) && header.length <= MAX_MESSAGE && header.index < paths.size())
+					{
+						message.resize(header.length);
+						if (header.length == 0 || readFully(worker.results, &message[0], header.length))
+						{
+							double seconds = std::chrono::duration<double>(Clock::now() - worker.started).count();
+							BatchResult result = { paths[header.index], header.ok != 0, message, seconds };
+							worker.current = -1;
+							record(result, sizes[header.index]);
+						}
+						else
+							gone = true;
+					}
+					else
+						gone = true;
+				}
+				else if (timeout > 0 && worker.current >= 0 && !worker.timedOut
+					 && Clock::now() - worker.started >= std::chrono::seconds(timeout))
+				{
+					worker.timedOut = true;
+					kill(worker.pid, SIGKILL);
+				}
+
+				if (!gone)
+				{
+					w++;
+					continue;
+				}
+
+				/* il worker e' terminato: normalmente o durante un file */
+				int status = 0;
+				while (waitpid(worker.pid, &status, 0) < 0 && errno == EINTR)
+					;
+				if (worker.current >= 0)
+				{
+					std::ostringstream ss;
+					if (worker.timedOut)
+						ss << "timeout after " << timeout << " s";
+					else if (WIFSIGNALED(status))
+						ss << "worker killed by signal " << WTERMSIG(status);
+					else
+						ss << "worker exited with status " << WEXITSTATUS(status);
+					double seconds = std::chrono::duration<double>(Clock::now() - worker.started).count();
+					BatchResult result = { paths[worker.current], false, ss.str(), seconds };
+					record(result, 0);
+				}
+				if (worker.commands >= 0)
+					close(worker.commands);
+				close(worker.results);
+				pool.erase(pool.begin() + w);
+				fds.erase(fds.begin() + w);
+			}
+		}
+	}
+	catch (...)
+	{
+		for (size_t w=0; w<pool.size(); w++)
+		{
+			kill(pool[w].pid, SIGKILL);
+			if (pool[w].commands >= 0)
+				close(pool[w].commands);
+			close(pool[w].results);
+			waitpid(pool[w].pid, NULL, 0);
+		}
+		throw;
+	}
+
+	report.seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+	return report;
+}
+
+#endif
+
+/*===========================================================================*/
+
+}
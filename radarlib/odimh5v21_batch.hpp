@@ -0,0 +1,204 @@
+/*
+ * odimh5v21_batch - multi-process batch processing of ODIM files
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef __RADAR_ODIMH5V21_BATCH_HPP__
+#define __RADAR_ODIMH5V21_BATCH_HPP__
+/*!
+ * \file
+ * \brief Processing of many ODIM files with a pool of worker processes
+ */
+
+#include <radarlib/defs.h>
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace OdimH5v21 {
+
+/*===========================================================================*/
+/* TASKS */
+/*===========================================================================*/
+
+/*!
+ * \brief Options of a task, as name=value pairs
+ */
+typedef std::map<std::string, std::string> BatchOptions;
+
+/*!
+ * \brief Work done on each file of a batch
+ *
+ * Every worker process creates its own task, calls start() once, process()
+ * for each file it receives and finish() when there are no more files. A
+ * file fails when process() throws.
+ */
+class RADAR_API BatchTask {
+ public:
+	virtual ~BatchTask();
+
+	/*!
+	 * \brief Called before the first file, options are those given to the runner
+	 */
+	virtual void start(const BatchOptions& options);
+	/*!
+	 * \brief Process a file
+	 */
+	virtual void process(const std::string& path) = 0;
+	/*!
+	 * \brief Called after the last file
+	 */
+	virtual void finish();
+};
+
+typedef BatchTask* (*BatchTaskFactory)();
+
+/*!
+ * \brief Tasks known to the batch runner, by name
+ *
+ * The library registers:
+ * - "check": open the file and read every data and quality dataset;
+ * - "dump": write the textual dump of the file to the "output" directory.
+ */
+class RADAR_API BatchTasks {
+ public:
+	/*!
+	 * \brief Register a task, replacing a task with the same name
+	 */
+	static void add(const std::string& name, BatchTaskFactory factory, const std::string& description);
+	/*!
+	 * \throws std::invalid_argument	if no task has the given name
+	 */
+	static BatchTask* create(const std::string& name);
+	static bool exists(const std::string& name);
+	/*!
+	 * \brief Names of the registered tasks, sorted
+	 */
+	static std::vector<std::string> getNames();
+	static std::string getDescription(const std::string& name);
+};
+
+/*===========================================================================*/
+/* RUNNER */
+/*===========================================================================*/
+
+/*!
+ * \brief Outcome of a file
+ */
+struct BatchResult {
+	std::string	path;
+	bool		ok;
+	std::string	message;	/*!< why the file failed */
+	double		seconds;	/*!< time spent on the file, 0 for files of the checkpoint */
+};
+
+/*!
+ * \brief Outcome of a batch
+ */
+struct BatchReport {
+	int				files;		/*!< files given to the runner */
+	int				resumed;	/*!< files skipped because the checkpoint lists them */
+	int				done;		/*!< files processed successfully by this run */
+	std::vector<BatchResult>	failures;	/*!< failed files, also those of the checkpoint not retried */
+	uint64_t			bytes;		/*!< size of the files processed by this run */
+	double				seconds;
+};
+
+/*!
+ * \brief Receives the outcome of each file as soon as it is known
+ *
+ * Called in the process of the runner, one file at a time.
+ */
+class RADAR_API BatchListener {
+ public:
+	virtual ~BatchListener();
+	virtual void fileDone(const BatchResult& result, int finished, int total) = 0;
+};
+
+/*!
+ * \brief Run a task on many files with a pool of worker processes
+ *
+ * HDF5 serializes I/O inside a process, so archive jobs use every core only
+ * with several processes. The runner forks the workers and hands out the
+ * files one at a time, largest first, so that the workers finish together
+ * and a worker never waits for a queue of its own. \n
+ * A worker that crashes or exceeds the timeout fails its current file and is
+ * replaced. \n
+ * With a checkpoint file every outcome is appended to it as soon as it is
+ * known. A run with the same checkpoint skips the files already done, and
+ * retries those that failed only if asked to. \n
+ * Available on POSIX systems only. The runner must be used by a single
+ * thread, and the calling process should not have HDF5 files open.
+ */
+class RADAR_API BatchRunner {
+ public:
+	/*!
+	 * \param task		name of a registered task
+	 * \param workers	number of worker processes, 0 for one per core
+	 * \throws std::invalid_argument	if no task has the given name
+	 */
+	BatchRunner(const std::string& task, int workers = 0);
+
+	void setWorkers(int val);
+	int getWorkers() const				{ return workers; }
+	void setOptions(const BatchOptions& val)	{ options = val; }
+	const BatchOptions& getOptions() const		{ return options; }
+	/*!
+	 * \brief File of the outcomes, empty for none
+	 */
+	void setCheckpoint(const std::string& path)	{ checkpoint = path; }
+	const std::string& getCheckpoint() const	{ return checkpoint; }
+	/*!
+	 * \brief Retry the files that failed in a previous run, default false
+	 */
+	void setRetryFailed(bool val)			{ retryFailed = val; }
+	bool getRetryFailed() const			{ return retryFailed; }
+	/*!
+	 * \brief Seconds after which a file fails and its worker is killed, 0 for no limit
+	 */
+	void setTimeout(int val)			{ timeout = val; }
+	int getTimeout() const				{ return timeout; }
+	void setListener(BatchListener* val)		{ listener = val; }
+
+	/*!
+	 * \brief Process the files
+	 * \throws std::runtime_error	if the checkpoint cannot be written or a worker cannot be started
+	 */
+	BatchReport run(const std::vector<std::string>& paths);
+
+	/*!
+	 * \brief Files of a directory, sorted
+	 * \param extension	keep only the files ending with it, empty for all
+	 * \param recursive	also list the subdirectories
+	 */
+	static std::vector<std::string> listFiles(const std::string& dir, const std::string& extension = ".h5", bool recursive = true);
+
+ private:
+	std::string	task;
+	int		workers;
+	BatchOptions	options;
+	std::string	checkpoint;
+	bool		retryFailed;
+	int		timeout;
+	BatchListener*	listener;
+};
+
+}
+
+#endif
@@ -0,0 +1,1156 @@
+/*
+ * odimh5v21_cartesian - polar to cartesian products
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <radarlib/odimh5v21_cartesian.hpp>
+#include <radarlib/odimh5v21_scans.hpp>
+#include <radarlib/odimh5v21_geometry.hpp>
+#include <radarlib/odimh5v21_const.hpp>
+#include <radarlib/odimh5v21_exceptions.hpp>
+#include <radarlib/parallel.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+namespace OdimH5v21 {
+namespace products {
+
+using namespace detail;
+
+namespace {
+
+/* parse a PROJ.4 angle like "44.7914", "44.7914N" or "10.5W" */
+double parseAngle(const std::string& value)
+{
+	char* end = NULL;
+	double result = strtod(value.c_str(), &end);
+	if (end == value.c_str())
+		throw std::invalid_argument("Invalid angle in projection: " + value);
+	if (*end == 'S' || *end == 's' || *end == 'W' || *end == 'w')
+		result = -result;
+	return result;
+}
+
+double parseNumber(const std::string& value)
+{
+	char* end = NULL;
+	double result = strtod(value.c_str(), &end);
+	if (end == value.c_str())
+		throw std::invalid_argument("Invalid number in projection: " + value);
+	return result;
+}
+
+/* clamp and round to the range of T */
+template <class T> inline T encodeValue(float value, double gain, double offset, double nodata, double undetect, double minval, double maxval)
+{
+	if (value != value)
+		return (T)nodata;
+	if (value == UNDETECT)
+		return (T)undetect;
+	double raw = (value - offset) / gain;
+	if (raw < minval) raw = minval;
+	if (raw > maxval) raw = maxval;
+	return (T)floor(raw + 0.5);
+}
+
+template <class T> void encodeValues(const float* values, size_t count, T* raw, const Encoding& enc, double minval, double maxval)
+{
+	for (size_t i = 0; i < count; ++i)
+		raw[i] = encodeValue<T>(values[i], enc.gain, enc.offset, enc.nodata, enc.undetect, minval, maxval);
+}
+
+}
+
+/*===========================================================================*/
+/* PROJECTION */
+/*===========================================================================*/
+
+Projection::Projection(const std::string& projdef)
+	: projdef(projdef), type(AEQD), lat0(0), lon0(0), x0(0), y0(0), radius(geometry::EARTH_RADIUS), sinlat0(0), coslat0(1)
+{
+	std::string proj;
+	std::istringstream in(projdef);
+	std::string token;
+	while (in >> token)
+	{
+		if (token[0] == '+')
+			token = token.substr(1);
+		std::string::size_type eq = token.find('=');
+		std::string name = token.substr(0, eq);
+		std::string value = eq == std::string::npos ? "" : token.substr(eq + 1);
+		if (name == "proj")		proj = value;
+		else if (name == "lat_0")	lat0 = parseAngle(value);
+		else if (name == "lon_0")	lon0 = parseAngle(value);
+		else if (name == "x_0")		x0 = parseNumber(value);
+		else if (name == "y_0")		y0 = parseNumber(value);
+		else if (name == "R" || name == "a")	radius = parseNumber(value);
+		else if (name == "ellps" && value == "sphere")	radius = 6370997.;
+	}
+	if (proj == "aeqd")
+		type = AEQD;
+	else if (proj == "gnom")
+		type = GNOM;
+	else if (proj == "latlong" || proj == "longlat" || proj == "latlon" || proj == "lonlat")
+		type = LATLONG;
+	else
+		throw std::invalid_argument("Unsupported projection: " + projdef);
+	sinlat0 = sin(lat0 * DEG2RAD);
+	coslat0 = cos(lat0 * DEG2RAD);
+}
+
+void Projection::forward(double lat, double lon, double& x, double& y) const
+{
+	if (type == LATLONG)
+	{
+		x = lon;
+		y = lat;
+		return;
+	}
+	double sinlat	= sin(lat * DEG2RAD);
+	double coslat	= cos(lat * DEG2RAD);
+	double dlon	= (lon - lon0) * DEG2RAD;
+	double cosc	= sinlat0 * sinlat + coslat0 * coslat * cos(dlon);
+	double k;
+	if (type == GNOM)
+	{
+		if (cosc <= 0)
+			throw std::invalid_argument("Point not visible in gnomonic projection");
+		k = 1. / cosc;
+	}
+	else
+	{
+		if (cosc > 1.) cosc = 1.;
+		if (cosc < -1.) cosc = -1.;
+		double c = acos(cosc);
+		k = c == 0 ? 1. : c / sin(c);
+	}
+	x = x0 + radius * k * coslat * sin(dlon);
+	y = y0 + radius * k * (coslat0 * sinlat - sinlat0 * coslat * cos(dlon));
+}
+
+void Projection::inverse(double x, double y, double& lat, double& lon) const
+{
+	if (type == LATLONG)
+	{
+		lat = y;
+		lon = x;
+		return;
+	}
+	x -= x0;
+	y -= y0;
+	double rho = sqrt(x * x + y * y);
+	if (rho == 0)
+	{
+		lat = lat0;
+		lon = lon0;
+		return;
+	}
+	double c = (type == GNOM) ? atan(rho / radius) : rho / radius;
+	double sinc = sin(c);
+	double cosc = cos(c);
+	lat = asin(cosc * sinlat0 + y * sinc * coslat0 / rho) * RAD2DEG;
+	lon = lon0 + atan2(x * sinc, rho * coslat0 * cosc - y * sinlat0 * sinc) * RAD2DEG;
+}
+
+/*===========================================================================*/
+/* CARTESIAN GRID */
+/*===========================================================================*/
+
+CartesianGrid::CartesianGrid()
+	: projdef(), xsize(0), ysize(0), xscale(0), yscale(0), ulx(0), uly(0)
+{
+}
+
+CartesianGrid CartesianGrid::centeredOn(double lat, double lon, int xsize, int ysize, double xscale, double yscale)
+{
+	CartesianGrid grid;
+	std::ostringstream projdef;
+	projdef << "+proj=aeqd +lat_0=" << formatKey(lat) << " +lon_0=" << formatKey(lon) << " +units=m +R=" << formatKey(geometry::EARTH_RADIUS);
+	grid.projdef	= projdef.str();
+	grid.xsize	= xsize;
+	grid.ysize	= ysize;
+	grid.xscale	= xscale;
+	grid.yscale	= yscale;
+	grid.ulx	= -xsize * xscale * 0.5;
+	grid.uly	= ysize * yscale * 0.5;
+	return grid;
+}
+
+void CartesianGrid::writeTo(WHEREImageMetadata& where) const
+{
+	Projection proj(projdef);
+	double right	= ulx + xsize * xscale;
+	double bottom	= uly - ysize * yscale;
+	double lat, lon;
+
+	where.setProjectionArguments(projdef);
+	where.setXSize(xsize);
+	where.setYSize(ysize);
+	where.setXScale(xscale);
+	where.setYScale(yscale);
+	proj.inverse(ulx, bottom, lat, lon);	where.setLL_Latitude(lat);	where.setLL_Longitude(lon);
+	proj.inverse(ulx, uly, lat, lon);	where.setUL_Latitude(lat);	where.setUL_Longitude(lon);
+	proj.inverse(right, uly, lat, lon);	where.setUR_Latitude(lat);	where.setUR_Longitude(lon);
+	proj.inverse(right, bottom, lat, lon);	where.setLR_Latitude(lat);	where.setLR_Longitude(lon);
+}
+
+CartesianGrid CartesianGrid::readFrom(WHEREImageMetadata& where)
+{
+	CartesianGrid grid;
+	grid.projdef	= where.getProjectionArguments();
+	grid.xsize	= where.getXSize();
+	grid.ysize	= where.getYSize();
+	grid.xscale	= where.getXScale();
+	grid.yscale	= where.getYScale();
+	Projection(grid.projdef).forward(where.getUL_Latitude(), where.getUL_Longitude(), grid.ulx, grid.uly);
+	return grid;
+}
+
+std::string CartesianGrid::key() const
+{
+	std::ostringstream out;
+	out << projdef << '|' << xsize << '|' << ysize << '|' << formatKey(xscale) << '|' << formatKey(yscale)
+	    << '|' << formatKey(ulx) << '|' << formatKey(uly);
+	return out.str();
+}
+
+/*===========================================================================*/
+/* ENCODING */
+/*===========================================================================*/
+
+Encoding::Encoding()
+	: rawtype(RAW_UINT8), gain(1.), offset(0.), nodata(255.), undetect(0.)
+{
+}
+
+Encoding::Encoding(RawType rawtype, double gain, double offset, double nodata, double undetect)
+	: rawtype(rawtype), gain(gain), offset(offset), nodata(nodata), undetect(undetect)
+{
+}
+
+Encoding Encoding::of(PolarScanData& data, RawType rawtype)
+{
+	return Encoding(rawtype, data.getGain(), data.getOffset(), data.getNodata(), data.getUndetect());
+}
+
+Encoding Encoding::of(PolarScanData& data)
+{
+	return of(data, data.getRawType());
+}
+
+void Encoding::encode(const float* values, size_t count, void* raw) const
+{
+	if (rawtype == RAW_UINT8)
+		encodeValues(values, count, (unsigned char*)raw, *this, 0., 255.);
+	else if (rawtype == RAW_INT8)
+		encodeValues(values, count, (signed char*)raw, *this, -128., 127.);
+	else if (rawtype == RAW_UINT16)
+		encodeValues(values, count, (unsigned short*)raw, *this, 0., 65535.);
+	else if (rawtype == RAW_INT16)
+		encodeValues(values, count, (short*)raw, *this, -32768., 32767.);
+	else if (rawtype == RAW_FLOAT)
+	{
+		/* floating point values are stored without rounding */
+		float* out = (float*)raw;
+		for (size_t i = 0; i < count; ++i)
+			out[i] = values[i] != values[i] ? (float)nodata : values[i] == UNDETECT ? (float)undetect : (float)((values[i] - offset) / gain);
+	}
+	else
+		throw OdimH5UnsupportedException("Unsupported data type for product encoding");
+}
+
+void Encoding::writeTo(WHATDatasetMetadata& what) const
+{
+	what.setGain(gain);
+	what.setOffset(offset);
+	what.setNodata(nodata);
+	what.setUndetect(undetect);
+}
+
+void Encoding::write(const DataMatrix<float>& values, Product_2D_Data& data) const
+{
+	int rows = values.getRowCount();
+	int cols = values.getColCount();
+	size_t count = (size_t)rows * cols;
+	std::vector<char> raw(count * getRawSize(rawtype) + 1);
+	encode(values.get(), count, &raw[0]);
+	writeTo(data);
+	data.writeData(&raw[0], cols, rows, rawtype);
+}
+
+/*===========================================================================*/
+/* REMAP TABLE */
+/*===========================================================================*/
+
+RemapTable::RemapTable()
+	: xsize(0), ysize(0), scans(), offsets(), gates()
+{
+}
+
+size_t RemapTable::memorySize() const
+{
+	return sizeof(*this) + scans.capacity() * sizeof(int) + offsets.capacity() * sizeof(size_t) + gates.capacity() * sizeof(int);
+}
+
+/*===========================================================================*/
+/* CARTESIAN GENERATOR */
+/*===========================================================================*/
+
+namespace {
+
+/* cache key of the given scans seen from the given grid */
+std::string geometryKey(const CartesianGrid& grid, PolarVolume& volume, const std::vector<int>& scans, double defaultBeamWidth)
+{
+	return grid.key() + scansKey(volume, scans, defaultBeamWidth);
+}
+
+/* set root what/ and where/ of a product image */
+void prepareImage(HorizontalObject_2D& image, PolarVolume& volume, const CartesianGrid& grid)
+{
+	image.setDateTime(volume.getDateTime());
+	image.setSource(volume.getSource());
+	grid.writeTo(image);
+}
+
+/* set start and end times of the scans used and the grid of a product dataset */
+void prepareDataset(Horizontal_Product_2D& dataset, PolarVolume& volume, const std::vector<int>& scans, const CartesianGrid& grid)
+{
+	setScanTimes(dataset, volume, scans);
+	grid.writeTo(dataset);
+}
+
+struct RemapTask
+{
+	const CartesianGrid&		grid;
+	const Projection&		proj;
+	const std::vector<ScanGeometry>& scans;
+	bool				ppi;
+	bool				pseudo;
+	double				target;
+	double				sitelat, sitelon, sitealt;
+	int*				gates;
+	const std::vector<size_t>&	offsets;
+
+	void operator()(size_t begin, size_t end) const
+	{
+		const double re		= geometry::EFFECTIVE_EARTH_RADIUS;
+		size_t nscans		= scans.size();
+
+		for (size_t row = begin; row < end; ++row)
+		{
+			double y = grid.pixelY((int)row);
+			int* out = gates + row * grid.xsize;
+			for (int col = 0; col < grid.xsize; ++col)
+			{
+				double lat, lon, s, az;
+				proj.inverse(grid.pixelX(col), y, lat, lon);
+				geometry::distanceAzimuth(sitelat, sitelon, lat, lon, s, az);
+				double theta = s / re;
+
+				int best = -1;
+				double bestdiff = 0;
+				for (size_t k = 0; k < nscans; ++k)
+				{
+					const ScanGeometry& g = scans[k];
+					double r, h;
+					int gate = beamGate(g, theta, az, r, h);
+					if (gate < 0)
+						continue;
+					gate += (int)offsets[k];
+					if (ppi)
+					{
+						best = gate;
+						break;
+					}
+					double diff = fabs(h + sitealt - target);
+					if (!pseudo && diff > r * tan(g.beamwidth * 0.5 * DEG2RAD))
+						continue;
+					if (best < 0 || diff < bestdiff)
+					{
+						best = gate;
+						bestdiff = diff;
+					}
+				}
+				out[col] = best;
+			}
+		}
+	}
+};
+
+}
+
+CartesianGenerator::CartesianGenerator(const CartesianGrid& grid, int threads)
+	: grid(grid), threads(threads), rowsPerBlock(16), defaultBeamWidth(1.)
+{
+	/* fail early on unsupported projections */
+	Projection check(grid.projdef);
+}
+
+Radar::LRUCache<std::string, const RemapTable>& CartesianGenerator::cache()
+{
+	static Radar::LRUCache<std::string, const RemapTable> tables(16);
+	return tables;
+}
+
+CartesianGenerator::RemapTablePtr CartesianGenerator::getRemapTable(PolarVolume& volume, const std::string& product, double prodpar, const std::string& quantity)
+{
+	bool ppi = product == PRODUCT_PPI;
+	if (!ppi && product != PRODUCT_CAPPI && product != PRODUCT_PCAPPI)
+		throw std::invalid_argument("Unsupported cartesian product: " + product);
+
+	std::vector<int> scans;
+	double bestdiff = 0;
+	int count = volume.getScanCount();
+	for (int i = 0; i < count; ++i)
+	{
+		std::unique_ptr<PolarScan> scan(volume.getScan(i));
+		if (!scan->hasQuantityData(quantity))
+			continue;
+		if (ppi)
+		{
+			double diff = fabs(scan->getEAngle() - prodpar);
+			if (scans.empty() || diff < bestdiff)
+			{
+				scans.assign(1, i);
+				bestdiff = diff;
+			}
+		}
+		else
+			scans.push_back(i);
+	}
+	if (scans.empty())
+		throw OdimH5Exception("No scan contains quantity " + quantity);
+
+	std::string key = product + '|' + formatKey(prodpar) + '|' + geometryKey(grid, volume, scans, defaultBeamWidth);
+	return cache().get(key, [&](const std::string&) { return buildRemapTable(volume, scans, product, prodpar); });
+}
+
+RemapTable* CartesianGenerator::buildRemapTable(PolarVolume& volume, const std::vector<int>& scans, const std::string& product, double prodpar)
+{
+	std::unique_ptr<RemapTable> table(new RemapTable());
+	std::vector<ScanGeometry> geometries;
+	readScanGeometries(volume, scans, defaultBeamWidth, geometries, table->offsets);
+	table->xsize	= grid.xsize;
+	table->ysize	= grid.ysize;
+	table->scans	= scans;
+	table->gates.resize((size_t)grid.xsize * grid.ysize);
+
+	Projection proj(grid.projdef);
+	RemapTask task = {
+		grid, proj, geometries,
+		product == PRODUCT_PPI, product == PRODUCT_PCAPPI, prodpar,
+		volume.getLatitude(), volume.getLongitude(), volume.getAltitude(),
+		table->gates.empty() ? NULL : &table->gates[0], table->offsets
+	};
+	Radar::parallel::forBlocks((size_t)grid.ysize, rowsPerBlock, threads, task);
+	return table.release();
+}
+
+namespace {
+
+struct FillTask
+{
+	const int*	gates;
+	const float*	values;
+	float*		out;
+	int		xsize;
+
+	void operator()(size_t begin, size_t end) const
+	{
+		for (size_t i = begin * xsize, last = end * xsize; i < last; ++i)
+			out[i] = gates[i] < 0 ? NODATA : values[gates[i]];
+	}
+};
+
+}
+
+void CartesianGenerator::compute(PolarVolume& volume, const std::string& product, double prodpar, const std::string& quantity, DataMatrix<float>& out)
+{
+	fill(volume, *getRemapTable(volume, product, prodpar, quantity), quantity, out);
+}
+
+void CartesianGenerator::fill(PolarVolume& volume, const RemapTable& table, const std::string& quantity, DataMatrix<float>& out)
+{
+	std::vector<float> values;
+	decodeScans(volume, table.getScans(), table.getScanOffsets(), quantity, values);
+
+	out.resize(grid.ysize, grid.xsize);
+	if (table.getGates().empty())
+		return;
+	FillTask task = { &table.getGates()[0], &values[0], &out.elem(0, 0), grid.xsize };
+	Radar::parallel::forBlocks((size_t)grid.ysize, rowsPerBlock, threads, task);
+}
+
+Horizontal_Product_2D* CartesianGenerator::generate(ImageObject& image, PolarVolume& volume, const std::string& product, double prodpar,
+						    const std::string& quantity, const Encoding& encoding)
+{
+	RemapTablePtr table = getRemapTable(volume, product, prodpar, quantity);
+	DataMatrix<float> values;
+	fill(volume, *table, quantity, values);
+
+	prepareImage(image, volume, grid);
+
+	std::unique_ptr<Horizontal_Product_2D> dataset;
+	if (product == PRODUCT_PPI)
+		dataset.reset(image.createProductPPI());
+	else if (product == PRODUCT_CAPPI)
+		dataset.reset(image.createProductCAPPI());
+	else
+		dataset.reset(image.createProductPCAPPI());
+
+	dataset->setProdPar(prodpar);
+	prepareDataset(*dataset, volume, table->getScans(), grid);
+
+	std::unique_ptr<Product_2D_Data> data(dataset->createQuantityData(quantity));
+	encoding.write(values, *data);
+	return dataset.release();
+}
+
+/*===========================================================================*/
+/* COLUMN TABLE */
+/*===========================================================================*/
+
+ColumnTable::ColumnTable()
+	: xsize(0), ysize(0), scans(), offsets(), gates(), heights()
+{
+}
+
+size_t ColumnTable::memorySize() const
+{
+	return sizeof(*this) + scans.capacity() * sizeof(int) + offsets.capacity() * sizeof(size_t)
+		+ gates.capacity() * sizeof(int) + heights.capacity() * sizeof(float);
+}
+
+/*===========================================================================*/
+/* COLUMN GENERATOR */
+/*===========================================================================*/
+
+namespace {
+
+/* gates above 56 dBZ are likely hail and would dominate VIL */
+const double VIL_MAX_DBZ = 56.;
+/* VIL = sum of 3.44e-6 * Z^(4/7) * dh, with Z^(4/7) = exp(dBZ * VIL_EXP) */
+const double VIL_COEFF = 3.44e-6;
+const double VIL_EXP = 4. / 70. * M_LN10;
+
+struct ColumnTableTask
+{
+	const CartesianGrid&		grid;
+	const Projection&		proj;
+	const std::vector<ScanGeometry>& scans;
+	double				sitelat, sitelon, sitealt;
+	const std::vector<size_t>&	offsets;
+	int*				gates;
+	float*				heights;
+
+	void operator()(size_t begin, size_t end) const
+	{
+		size_t levels		= scans.size();
+
+		for (size_t row = begin; row < end; ++row)
+		{
+			double y = grid.pixelY((int)row);
+			for (int col = 0; col < grid.xsize; ++col)
+			{
+				size_t base = (row * grid.xsize + col) * levels;
+				double lat, lon, s, az;
+				proj.inverse(grid.pixelX(col), y, lat, lon);
+				geometry::distanceAzimuth(sitelat, sitelon, lat, lon, s, az);
+				double theta = s / geometry::EFFECTIVE_EARTH_RADIUS;
+				for (size_t k = 0; k < levels; ++k)
+				{
+					double r, h = 0;
+					int gate = beamGate(scans[k], theta, az, r, h);
+					gates[base + k]		= gate < 0 ? -1 : gate + (int)offsets[k];
+					heights[base + k]	= (float)(h + sitealt);
+				}
+			}
+		}
+	}
+};
+
+struct ColumnTask
+{
+	const ColumnTable&	table;
+	const float*		values;
+	int			tileSize;
+	int			xtiles;
+	double			threshold;
+	double			bottom, top;
+	float*			max;
+	float*			etop;
+	float*			vil;
+
+	void operator()(size_t begin, size_t end) const
+	{
+		const int levels	= table.getLevels();
+		const int xsize		= table.getXSize();
+		const int ysize		= table.getYSize();
+		const int* gates	= &table.getGates()[0];
+		const float* heights	= &table.getHeights()[0];
+		std::vector<float> colv(levels), colh(levels);
+
+		for (size_t tile = begin; tile < end; ++tile)
+		{
+			int row0 = (int)(tile / xtiles) * tileSize;
+			int col0 = (int)(tile % xtiles) * tileSize;
+			int row1 = row0 + tileSize < ysize ? row0 + tileSize : ysize;
+			int col1 = col0 + tileSize < xsize ? col0 + tileSize : xsize;
+			for (int row = row0; row < row1; ++row)
+				for (int col = col0; col < col1; ++col)
+				{
+					size_t pixel = (size_t)row * xsize + col;
+					const int* g = gates + pixel * levels;
+					const float* h = heights + pixel * levels;
+
+					/* valid gates of the column, from the lowest */
+					int n = 0;
+					for (int k = 0; k < levels; ++k)
+					{
+						if (g[k] < 0)
+							continue;
+						float v = values[g[k]];
+						if (v != v)
+							continue;
+						colv[n] = v;
+						colh[n] = h[k];
+						++n;
+					}
+
+					if (max)	max[pixel]	= columnMax(&colv[0], n);
+					if (etop)	etop[pixel]	= columnTop(&colv[0], &colh[0], n);
+					if (vil)	vil[pixel]	= columnVIL(&colv[0], &colh[0], n);
+				}
+		}
+	}
+
+	static float columnMax(const float* v, int n)
+	{
+		if (n == 0)
+			return NODATA;
+		float result = v[0];
+		for (int i = 1; i < n; ++i)
+			if (v[i] > result)
+				result = v[i];
+		return result;
+	}
+
+	float columnTop(const float* v, const float* h, int n) const
+	{
+		if (n == 0)
+			return NODATA;
+		float result = UNDETECT;
+		for (int i = 0; i < n; ++i)
+			if (v[i] >= threshold && (result == UNDETECT || h[i] > result))
+				result = h[i];
+		return result == UNDETECT ? UNDETECT : result / 1000.f;
+	}
+
+	float columnVIL(const float* v, const float* h, int n) const
+	{
+		if (n == 0)
+			return NODATA;
+		double sum = 0;
+		for (int i = 0; i < n; ++i)
+		{
+			if (v[i] == UNDETECT)
+				continue;
+			double lower = i > 0 ? (h[i - 1] + h[i]) * 0.5 : (n > 1 ? h[0] - (h[1] - h[0]) * 0.5 : h[0]);
+			double upper = i < n - 1 ? (h[i] + h[i + 1]) * 0.5 : (n > 1 ? h[i] + (h[i] - h[i - 1]) * 0.5 : h[i]);
+			if (lower < bottom)	lower = bottom;
+			if (upper > top)	upper = top;
+			if (upper <= lower)
+				continue;
+			double dbz = v[i] < VIL_MAX_DBZ ? v[i] : VIL_MAX_DBZ;
+			sum += VIL_COEFF * exp(dbz * VIL_EXP) * (upper - lower);
+		}
+		return sum > 0 ? (float)sum : UNDETECT;
+	}
+};
+
+/* maximum of the gates of a block of grid columns (HSP) or grid rows (VSP) in each height layer */
+struct PanelTask
+{
+	const ColumnTable&	table;
+	const float*		values;
+	int			levels;
+	double			bottom, step;
+	bool			horizontal;
+	float*			out;
+
+	void operator()(size_t begin, size_t end) const
+	{
+		const int nscans	= table.getLevels();
+		const int xsize		= table.getXSize();
+		const int ysize		= table.getYSize();
+		const int* gates	= &table.getGates()[0];
+		const float* heights	= &table.getHeights()[0];
+		const int count		= horizontal ? ysize : xsize;
+		std::vector<int> colg(nscans);
+		std::vector<float> colh(nscans);
+
+		for (size_t line = begin; line < end; ++line)
+		{
+			for (int l = 0; l < levels; ++l)
+				cell(line, l) = NODATA;
+
+			for (int i = 0; i < count; ++i)
+			{
+				size_t pixel = horizontal ? (size_t)i * xsize + line : line * xsize + i;
+				const int* g = gates + pixel * nscans;
+				const float* h = heights + pixel * nscans;
+
+				int n = 0;
+				for (int k = 0; k < nscans; ++k)
+					if (g[k] >= 0)
+					{
+						colg[n] = g[k];
+						colh[n] = h[k];
+						++n;
+					}
+
+				for (int k = 0; k < n; ++k)
+				{
+					float v = values[colg[k]];
+					if (v != v)
+						continue;
+					double lower = k > 0 ? (colh[k - 1] + colh[k]) * 0.5 : (n > 1 ? colh[0] - (colh[1] - colh[0]) * 0.5 : colh[0]);
+					double upper = k < n - 1 ? (colh[k] + colh[k + 1]) * 0.5 : (n > 1 ? colh[k] + (colh[k] - colh[k - 1]) * 0.5 : colh[k]);
+					/* layers whose centre is covered by the gate, at least the one of the beam centre */
+					int l0 = (int)ceil((lower - bottom) / step - 0.5);
+					int l1 = (int)ceil((upper - bottom) / step - 0.5);
+					if (l1 <= l0)
+					{
+						l0 = (int)floor((colh[k] - bottom) / step);
+						l1 = l0 + 1;
+					}
+					if (l0 < 0)		l0 = 0;
+					if (l1 > levels)	l1 = levels;
+					for (int l = l0; l < l1; ++l)
+					{
+						float& c = cell(line, l);
+						if (c != c || v > c)
+							c = v;
+					}
+				}
+			}
+		}
+	}
+
+	/* HSP rows go from the top, VSP columns from the bottom */
+	float& cell(size_t line, int layer) const
+	{
+		if (horizontal)
+			return out[(size_t)(levels - 1 - layer) * table.getXSize() + line];
+		return out[line * levels + layer];
+	}
+};
+
+}
+
+ColumnRequest::ColumnRequest()
+	: max(true), etop(true), vil(true),
+	  etopThreshold(18.), vilHeights(0., 15000.),
+	  maxEncoding(RAW_UINT8, 0.5, -32., 255, 0),
+	  etopEncoding(RAW_UINT8, 0.1, 0., 255, 0),
+	  vilEncoding(RAW_UINT8, 0.5, 0., 255, 0)
+{
+}
+
+ColumnGenerator::ColumnGenerator(const CartesianGrid& grid, int threads)
+	: grid(grid), threads(threads), tileSize(64)
+{
+	/* fail early on unsupported projections */
+	Projection check(grid.projdef);
+}
+
+Radar::LRUCache<std::string, const ColumnTable>& ColumnGenerator::cache()
+{
+	static Radar::LRUCache<std::string, const ColumnTable> tables(8);
+	return tables;
+}
+
+ColumnGenerator::ColumnTablePtr ColumnGenerator::getColumnTable(PolarVolume& volume, const std::string& quantity)
+{
+	std::vector<int> scans = scansByElevation(volume, quantity);
+
+	std::string key = "COLUMN|" + geometryKey(grid, volume, scans, 1.);
+	return cache().get(key, [&](const std::string&) { return buildColumnTable(volume, scans); });
+}
+
+ColumnTable* ColumnGenerator::buildColumnTable(PolarVolume& volume, const std::vector<int>& scans)
+{
+	std::unique_ptr<ColumnTable> table(new ColumnTable());
+	std::vector<ScanGeometry> geometries;
+	readScanGeometries(volume, scans, 1., geometries, table->offsets);
+	table->xsize	= grid.xsize;
+	table->ysize	= grid.ysize;
+	table->scans	= scans;
+	size_t size = (size_t)grid.xsize * grid.ysize * scans.size();
+	table->gates.resize(size);
+	table->heights.resize(size);
+	if (!size)
+		return table.release();
+
+	Projection proj(grid.projdef);
+	ColumnTableTask task = {
+		grid, proj, geometries,
+		volume.getLatitude(), volume.getLongitude(), volume.getAltitude(),
+		table->offsets, &table->gates[0], &table->heights[0]
+	};
+	Radar::parallel::forBlocks((size_t)grid.ysize, tileSize, threads, task);
+	return table.release();
+}
+
+void ColumnGenerator::compute(PolarVolume& volume, const std::string& quantity, const ColumnRequest& request,
+			      DataMatrix<float>& max, DataMatrix<float>& etop, DataMatrix<float>& vil)
+{
+	fill(volume, *getColumnTable(volume, quantity), quantity, request, max, etop, vil);
+}
+
+void ColumnGenerator::fill(PolarVolume& volume, const ColumnTable& table, const std::string& quantity, const ColumnRequest& request,
+			   DataMatrix<float>& max, DataMatrix<float>& etop, DataMatrix<float>& vil)
+{
+	if (!request.max && !request.etop && !request.vil)
+		return;
+
+	std::vector<float> values;
+	decodeScans(volume, table.getScans(), table.getScanOffsets(), quantity, values);
+
+	if (request.max)	max.resize(grid.ysize, grid.xsize);
+	if (request.etop)	etop.resize(grid.ysize, grid.xsize);
+	if (request.vil)	vil.resize(grid.ysize, grid.xsize);
+	if (table.getGates().empty())
+		return;
+
+	int xtiles = (grid.xsize + tileSize - 1) / tileSize;
+	int ytiles = (grid.ysize + tileSize - 1) / tileSize;
+	ColumnTask task = {
+		table, &values[0], tileSize, xtiles,
+		request.etopThreshold, request.vilHeights.bottom, request.vilHeights.top,
+		request.max	? &max.elem(0, 0)	: NULL,
+		request.etop	? &etop.elem(0, 0)	: NULL,
+		request.vil	? &vil.elem(0, 0)	: NULL
+	};
+	Radar::parallel::forBlocks((size_t)xtiles * ytiles, 1, threads, task);
+}
+
+std::vector<Horizontal_Product_2D*> ColumnGenerator::generate(ImageObject& image, PolarVolume& volume, const std::string& quantity,
+							      const ColumnRequest& request)
+{
+	ColumnTablePtr table = getColumnTable(volume, quantity);
+	DataMatrix<float> max, etop, vil;
+	fill(volume, *table, quantity, request, max, etop, vil);
+
+	prepareImage(image, volume, grid);
+
+	std::vector<Horizontal_Product_2D*> result;
+	try
+	{
+		if (request.max)
+		{
+			std::unique_ptr<Product_MAX> dataset(image.createProductMAX());
+			prepareDataset(*dataset, volume, table->getScans(), grid);
+			std::unique_ptr<Product_2D_Data> data(dataset->createQuantityData(quantity));
+			request.maxEncoding.write(max, *data);
+			result.push_back(dataset.release());
+		}
+		if (request.etop)
+		{
+			std::unique_ptr<Product_ETOP> dataset(image.createProductETOP());
+			dataset->setProdPar(request.etopThreshold);
+			prepareDataset(*dataset, volume, table->getScans(), grid);
+			std::unique_ptr<Product_2D_Data> data(dataset->createQuantityData(PRODUCT_QUANTITY_HGHT));
+			request.etopEncoding.write(etop, *data);
+			result.push_back(dataset.release());
+		}
+		if (request.vil)
+		{
+			std::unique_ptr<Product_VIL> dataset(image.createProductVIL());
+			dataset->setProdPar(request.vilHeights);
+			prepareDataset(*dataset, volume, table->getScans(), grid);
+			std::unique_ptr<Product_2D_Data> data(dataset->createQuantityData(PRODUCT_QUANTITY_VIL));
+			request.vilEncoding.write(vil, *data);
+			result.push_back(dataset.release());
+		}
+	}
+	catch (...)
+	{
+		for (size_t i = 0; i < result.size(); ++i)
+			delete result[i];
+		throw;
+	}
+	return result;
+}
+
+void ColumnGenerator::computePanels(PolarVolume& volume, const std::string& quantity, int levels, double minHeight, double maxHeight,
+				    DataMatrix<float>& hsp, DataMatrix<float>& vsp)
+{
+	fillPanels(volume, *getColumnTable(volume, quantity), quantity, levels, minHeight, maxHeight, hsp, vsp);
+}
+
+void ColumnGenerator::fillPanels(PolarVolume& volume, const ColumnTable& table, const std::string& quantity, int levels,
+				 double minHeight, double maxHeight, DataMatrix<float>& hsp, DataMatrix<float>& vsp)
+{
+	if (levels <= 0 || !(maxHeight > minHeight))
+		throw std::invalid_argument("Invalid side panel levels or heights");
+
+	std::vector<float> values;
+	decodeScans(volume, table.getScans(), table.getScanOffsets(), quantity, values);
+
+	hsp.resize(levels, grid.xsize);
+	vsp.resize(grid.ysize, levels);
+	if (table.getGates().empty())
+		return;
+
+	double step = (maxHeight - minHeight) / levels;
+	PanelTask htask = { table, &values[0], levels, minHeight, step, true, &hsp.elem(0, 0) };
+	Radar::parallel::forBlocks((size_t)grid.xsize, tileSize, threads, htask);
+	PanelTask vtask = { table, &values[0], levels, minHeight, step, false, &vsp.elem(0, 0) };
+	Radar::parallel::forBlocks((size_t)grid.ysize, tileSize, threads, vtask);
+}
+
+std::vector<Product_Panel*> ColumnGenerator::generatePanels(ImageObject& image, PolarVolume& volume, const std::string& quantity,
+							    int levels, double minHeight, double maxHeight, const Encoding& encoding)
+{
+	ColumnTablePtr table = getColumnTable(volume, quantity);
+	DataMatrix<float> hsp, vsp;
+	fillPanels(volume, *table, quantity, levels, minHeight, maxHeight, hsp, vsp);
+
+	prepareImage(image, volume, grid);
+
+	Projection proj(grid.projdef);
+	double lry = grid.uly - grid.ysize * grid.yscale;
+	double lrx = grid.ulx + grid.xsize * grid.xscale;
+	double lllat, lllon, lrlat, lrlon, urlat, urlon;
+	proj.inverse(grid.ulx, lry, lllat, lllon);
+	proj.inverse(lrx, lry, lrlat, lrlon);
+	proj.inverse(lrx, grid.uly, urlat, urlon);
+	double step = (maxHeight - minHeight) / levels;
+
+	std::vector<Product_Panel*> result;
+	try
+	{
+		std::unique_ptr<Product_HSP> h(image.createProductHSP());
+		setScanTimes(*h, volume, table->getScans());
+		h->setXSize(grid.xsize);
+		h->setYSize(levels);
+		h->setXScale(grid.xscale);
+		h->setYScale(step);
+		h->setMinHeight(minHeight);
+		h->setMaxHeight(maxHeight);
+		h->setStartLatitude(lllat);
+		h->setStartLongitude(lllon);
+		h->setStopLatitude(lrlat);
+		h->setStopLongitude(lrlon);
+		std::unique_ptr<Product_2D_Data> hdata(h->createQuantityData(quantity));
+		encoding.write(hsp, *hdata);
+		result.push_back(h.release());
+
+		std::unique_ptr<Product_VSP> v(image.createProductVSP());
+		setScanTimes(*v, volume, table->getScans());
+		v->setXSize(levels);
+		v->setYSize(grid.ysize);
+		v->setXScale(step);
+		v->setYScale(grid.yscale);
+		v->setMinHeight(minHeight);
+		v->setMaxHeight(maxHeight);
+		v->setStartLatitude(urlat);
+		v->setStartLongitude(urlon);
+		v->setStopLatitude(lrlat);
+		v->setStopLongitude(lrlon);
+		std::unique_ptr<Product_2D_Data> vdata(v->createQuantityData(quantity));
+		encoding.write(vsp, *vdata);
+		result.push_back(v.release());
+	}
+	catch (...)
+	{
+		for (size_t i = 0; i < result.size(); ++i)
+			delete result[i];
+		throw;
+	}
+	return result;
+}
+
+/*===========================================================================*/
+/* CVOL TABLE */
+/*===========================================================================*/
+
+CvolTable::CvolTable()
+	: xsize(0), ysize(0), levels(0), scans(), offsets(), lower(), upper(), weights()
+{
+}
+
+size_t CvolTable::memorySize() const
+{
+	return sizeof(*this) + scans.capacity() * sizeof(int) + offsets.capacity() * sizeof(size_t)
+		+ (lower.capacity() + upper.capacity()) * sizeof(int) + weights.capacity() * sizeof(float);
+}
+
+/*===========================================================================*/
+/* CVOL GENERATOR */
+/*===========================================================================*/
+
+namespace {
+
+struct CvolTableTask
+{
+	const CartesianGrid&		grid;
+	const Projection&		proj;
+	const std::vector<ScanGeometry>& scans;
+	const std::vector<size_t>&	offsets;
+	const std::vector<double>&	levels;
+	bool				linear;
+	double				sitelat, sitelon, sitealt;
+	int*				lower;
+	int*				upper;
+	float*				weights;
+
+	void operator()(size_t begin, size_t end) const
+	{
+		const size_t pixels	= (size_t)grid.xsize * grid.ysize;
+		BeamColumn column(scans.size());
+
+		for (size_t row = begin; row < end; ++row)
+		{
+			double y = grid.pixelY((int)row);
+			for (int col = 0; col < grid.xsize; ++col)
+			{
+				double lat, lon, s, az;
+				proj.inverse(grid.pixelX(col), y, lat, lon);
+				geometry::distanceAzimuth(sitelat, sitelon, lat, lon, s, az);
+				column.collect(scans, offsets, s / geometry::EFFECTIVE_EARTH_RADIUS, az, sitealt);
+
+				size_t pixel = row * grid.xsize + col;
+				for (size_t l = 0; l < levels.size(); ++l)
+				{
+					size_t voxel = l * pixels + pixel;
+					column.interpolate(levels[l], linear, lower[voxel], upper[voxel], weights[voxel]);
+				}
+			}
+		}
+	}
+};
+
+}
+
+CvolGenerator::CvolGenerator(const CartesianGrid& grid, const std::vector<double>& heights, int threads)
+	: grid(grid), heights(heights), interpolation(VERTICAL_LINEAR), threads(threads), rowsPerBlock(16), defaultBeamWidth(1.)
+{
+	if (heights.empty())
+		throw std::invalid_argument("CVOL needs at least one level");
+	/* fail early on unsupported projections */
+	Projection check(grid.projdef);
+}
+
+Radar::LRUCache<std::string, const CvolTable>& CvolGenerator::cache()
+{
+	static Radar::LRUCache<std::string, const CvolTable> tables(4);
+	return tables;
+}
+
+CvolGenerator::CvolTablePtr CvolGenerator::getCvolTable(PolarVolume& volume, const std::string& quantity)
+{
+	std::vector<int> scans = scansByElevation(volume, quantity);
+
+	std::ostringstream key;
+	key << "CVOL|" << (interpolation == VERTICAL_LINEAR ? "LINEAR" : "NEAREST");
+	for (size_t l = 0; l < heights.size(); ++l)
+		key << (l ? ',' : '|') << formatKey(heights[l]);
+	key << '|' << geometryKey(grid, volume, scans, defaultBeamWidth);
+	return cache().get(key.str(), [&](const std::string&) { return buildCvolTable(volume, scans); });
+}
+
+CvolTable* CvolGenerator::buildCvolTable(PolarVolume& volume, const std::vector<int>& scans)
+{
+	std::unique_ptr<CvolTable> table(new CvolTable());
+	std::vector<ScanGeometry> geometries;
+	readScanGeometries(volume, scans, defaultBeamWidth, geometries, table->offsets);
+	table->xsize	= grid.xsize;
+	table->ysize	= grid.ysize;
+	table->levels	= (int)heights.size();
+	table->scans	= scans;
+	size_t size = (size_t)grid.xsize * grid.ysize * heights.size();
+	table->lower.resize(size);
+	table->upper.resize(size);
+	table->weights.resize(size);
+	if (!size)
+		return table.release();
+
+	Projection proj(grid.projdef);
+	CvolTableTask task = {
+		grid, proj, geometries, table->offsets, heights, interpolation == VERTICAL_LINEAR,
+		volume.getLatitude(), volume.getLongitude(), volume.getAltitude(),
+		&table->lower[0], &table->upper[0], &table->weights[0]
+	};
+	Radar::parallel::forBlocks((size_t)grid.ysize, rowsPerBlock, threads, task);
+	return table.release();
+}
+
+void CvolGenerator::fillLevel(const CvolTable& table, const std::vector<float>& values, int level, DataMatrix<float>& out)
+{
+	out.resize(grid.ysize, grid.xsize);
+	if (table.getLowerGates().empty())
+		return;
+	size_t base = (size_t)level * grid.xsize * grid.ysize;
+	VerticalFillTask task = {
+		&table.getLowerGates()[base], &table.getUpperGates()[base], &table.getWeights()[base],
+		&values[0], &out.elem(0, 0), grid.xsize
+	};
+	Radar::parallel::forBlocks((size_t)grid.ysize, rowsPerBlock, threads, task);
+}
+
+void CvolGenerator::compute(PolarVolume& volume, const std::string& quantity, std::vector<DataMatrix<float> >& levels)
+{
+	CvolTablePtr table = getCvolTable(volume, quantity);
+	std::vector<float> values;
+	decodeScans(volume, table->getScans(), table->getScanOffsets(), quantity, values);
+
+	levels.resize(heights.size());
+	for (size_t l = 0; l < heights.size(); ++l)
+		fillLevel(*table, values, (int)l, levels[l]);
+}
+
+void CvolGenerator::generate(CvolObject& object, PolarVolume& volume, const std::string& quantity, const Encoding& encoding)
+{
+	CvolTablePtr table = getCvolTable(volume, quantity);
+	std::vector<float> values;
+	decodeScans(volume, table->getScans(), table->getScanOffsets(), quantity, values);
+
+	prepareImage(object, volume, grid);
+
+	/* a dataset per level, each one written as a single chunk */
+	DataMatrix<float> level;
+	for (size_t l = 0; l < heights.size(); ++l)
+	{
+		fillLevel(*table, values, (int)l, level);
+		std::unique_ptr<Product_CAPPI> dataset(object.createProductCAPPI());
+		dataset->setProdPar(heights[l]);
+		prepareDataset(*dataset, volume, table->getScans(), grid);
+		std::unique_ptr<Product_2D_Data> data(dataset->createQuantityData(quantity));
+		encoding.write(level, *data);
+	}
+}
+
+}
+}
@@ -0,0 +1,667 @@
+/*
+ * odimh5v21_cartesian - polar to cartesian products
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef __RADAR_ODIMH5V21_CARTESIAN_HPP__
+#define __RADAR_ODIMH5V21_CARTESIAN_HPP__
+/*!
+ * \file
+ * \brief Cartesian products computed from polar volumes
+ */
+
+#include <radarlib/odimh5v21_classes.hpp>
+#include <radarlib/cache.hpp>
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace OdimH5v21 {
+/*!
+ * \brief Products computed from polar data
+ */
+namespace products {
+
+/*!
+ * \brief Value of decoded elements whose raw value is 'nodata'
+ */
+const float NODATA = std::numeric_limits<float>::quiet_NaN();
+/*!
+ * \brief Value of decoded elements whose raw value is 'undetect'
+ */
+const float UNDETECT = -std::numeric_limits<float>::infinity();
+
+/*===========================================================================*/
+/* PROJECTION */
+/*===========================================================================*/
+
+/*!
+ * \brief Spherical map projections described by PROJ.4 strings
+ *
+ * Only the projections needed by single radar products are supported:
+ * azimuthal equidistant (aeqd), gnomonic (gnom) and geographic
+ * coordinates (latlong, longlat). \n
+ * Recognized parameters are +lat_0, +lon_0 (with optional N/S/E/W suffix),
+ * +x_0, +y_0, +R and +ellps=sphere. Other parameters are ignored.
+ */
+class RADAR_API Projection {
+ public:
+	/*!
+	 * \brief Parse a PROJ.4 string
+	 * \throws std::invalid_argument if the projection is not supported
+	 */
+	Projection(const std::string& projdef);
+
+	/*!
+	 * \brief Convert latitude/longitude (degrees) to projected coordinates
+	 */
+	void forward(double lat, double lon, double& x, double& y) const;
+	/*!
+	 * \brief Convert projected coordinates to latitude/longitude (degrees)
+	 */
+	void inverse(double x, double y, double& lat, double& lon) const;
+
+	const std::string& getDefinition() const { return projdef; }
+
+ private:
+	enum Type { AEQD, GNOM, LATLONG };
+
+	std::string	projdef;
+	Type		type;
+	double		lat0, lon0;
+	double		x0, y0;
+	double		radius;
+	double		sinlat0, coslat0;
+};
+
+/*===========================================================================*/
+/* CARTESIAN GRID */
+/*===========================================================================*/
+
+/*!
+ * \brief Cartesian grid of an horizontal product
+ *
+ * The fields match the ones of WHEREImageMetadata. Pixels are stored row by
+ * row starting from the upper left corner, whose projected coordinates are
+ * (ulx, uly).
+ */
+struct RADAR_API CartesianGrid {
+	std::string	projdef;
+	int		xsize;
+	int		ysize;
+	double		xscale;
+	double		yscale;
+	double		ulx;
+	double		uly;
+
+	CartesianGrid();
+
+	/*!
+	 * \brief Grid of an azimuthal equidistant projection centred on the given point
+	 */
+	static CartesianGrid centeredOn(double lat, double lon, int xsize, int ysize, double xscale, double yscale);
+
+	/*!
+	 * \brief Projected coordinates of the centre of the pixel
+	 */
+	double pixelX(int col) const { return ulx + (col + 0.5) * xscale; }
+	double pixelY(int row) const { return uly - (row + 0.5) * yscale; }
+
+	/*!
+	 * \brief Write projection, size, scale and corners into the given metadata
+	 */
+	void writeTo(WHEREImageMetadata& where) const;
+	/*!
+	 * \brief Read projection, size, scale and upper left corner from the given metadata
+	 */
+	static CartesianGrid readFrom(WHEREImageMetadata& where);
+
+	/*!
+	 * \brief String that identifies the grid in caches
+	 */
+	std::string key() const;
+};
+
+/*===========================================================================*/
+/* ENCODING */
+/*===========================================================================*/
+
+/*!
+ * \brief Conversion between physical values and stored values
+ */
+struct RADAR_API Encoding {
+	RawType		rawtype;	/*!< element type, converted to HDF5 only when writing */
+	double		gain;
+	double		offset;
+	double		nodata;
+	double		undetect;
+
+	/*!
+	 * \brief 8 bit unsigned values, gain 1, offset 0, nodata 255, undetect 0
+	 */
+	Encoding();
+	Encoding(RawType rawtype, double gain, double offset, double nodata, double undetect);
+
+	/*!
+	 * \brief Read gain, offset, nodata and undetect of the given data, using the given type
+	 */
+	static Encoding of(PolarScanData& data, RawType rawtype);
+	/*!
+	 * \brief Read type, gain, offset, nodata and undetect of the given data
+	 */
+	static Encoding of(PolarScanData& data);
+
+	/*!
+	 * \brief Encode values rounding to the nearest raw value
+	 *
+	 * NODATA and UNDETECT are stored as 'nodata' and 'undetect', other values are
+	 * clamped to the range of the raw type.
+	 * \param values	physical values
+	 * \param count		number of values
+	 * \param raw		buffer of count elements of the raw type
+	 */
+	void encode(const float* values, size_t count, void* raw) const;
+	/*!
+	 * \brief Write gain, offset, nodata and undetect into the given data group
+	 */
+	void writeTo(WHATDatasetMetadata& what) const;
+	/*!
+	 * \brief Encode and write the values into the given data group, setting its attributes
+	 */
+	void write(const DataMatrix<float>& values, Product_2D_Data& data) const;
+};
+
+/*===========================================================================*/
+/* REMAP TABLE */
+/*===========================================================================*/
+
+/*!
+ * \brief Precomputed polar gate used by every pixel of a cartesian product
+ *
+ * Gates of the scans used by the product are numbered consecutively: the gates
+ * of scan k start at getScanOffsets()[k] and gate (ray, bin) of that scan has
+ * number offset + ray * nbins + bin. Pixels not covered by any gate are -1.
+ */
+class RADAR_API RemapTable {
+ public:
+	RemapTable();
+
+	/*!
+	 * \brief Indexes in the volume of the scans used by the table
+	 */
+	const std::vector<int>& getScans() const	{ return scans; }
+	/*!
+	 * \brief Number of the first gate of each scan, plus the total number of gates
+	 */
+	const std::vector<size_t>& getScanOffsets() const	{ return offsets; }
+	/*!
+	 * \brief Gate of each pixel
+	 */
+	const std::vector<int>& getGates() const	{ return gates; }
+	int getXSize() const	{ return xsize; }
+	int getYSize() const	{ return ysize; }
+
+	/*!
+	 * \brief Memory used by the table, in bytes
+	 */
+	size_t memorySize() const;
+
+ private:
+	friend class CartesianGenerator;
+	int			xsize, ysize;
+	std::vector<int>	scans;
+	std::vector<size_t>	offsets;
+	std::vector<int>	gates;
+};
+
+/*===========================================================================*/
+/* CARTESIAN GENERATOR */
+/*===========================================================================*/
+
+/*!
+ * \brief Generator of PPI, CAPPI and PCAPPI products from polar volumes
+ *
+ * Pixels take the value of the nearest gate: for PPI the gate of the scan
+ * nearest to the requested elevation, for CAPPI and PCAPPI the gate of the scan
+ * whose beam centre is nearest to the requested height. CAPPI pixels are
+ * NODATA when the requested height is farther than half beam width from every
+ * scan, PCAPPI pixels always use the nearest scan. \n
+ * Heights follow the 4/3 effective earth radius model, rays are assumed to
+ * have the same width and to start from north. \n
+ * Remap tables are cached by radar site, scan geometries, grid and product
+ * parameter, so products of volumes with the same geometry pay only the
+ * decoding of the data. Pixel rows are filled in parallel blocks.
+ */
+class RADAR_API CartesianGenerator {
+ public:
+	typedef std::shared_ptr<const RemapTable> RemapTablePtr;
+
+	/*!
+	 * \brief Create a generator for the given grid
+	 * \param grid		grid of the products
+	 * \param threads	number of threads, 0 for one thread per core
+	 */
+	CartesianGenerator(const CartesianGrid& grid, int threads = 0);
+
+	const CartesianGrid& getGrid() const { return grid; }
+	void setThreads(int val)	{ threads = val; }
+	int getThreads() const		{ return threads; }
+	/*!
+	 * \brief Number of pixel rows assigned to a thread at a time
+	 */
+	void setRowsPerBlock(int val)	{ rowsPerBlock = val > 0 ? val : 1; }
+	/*!
+	 * \brief Beam width (degrees) used for CAPPI when scans do not store how/beamwidth
+	 */
+	void setDefaultBeamWidth(double val)	{ defaultBeamWidth = val; }
+
+	/*!
+	 * \brief Get the remap table of a product, computing it if it is not cached
+	 * \param volume	the polar volume
+	 * \param product	PRODUCT_PPI, PRODUCT_CAPPI or PRODUCT_PCAPPI
+	 * \param prodpar	elevation angle (degrees) for PPI, height (m) above sea level for CAPPI and PCAPPI
+	 * \param quantity	only scans with this quantity are used
+	 * \throws std::invalid_argument if the product is not supported
+	 */
+	RemapTablePtr getRemapTable(PolarVolume& volume, const std::string& product, double prodpar, const std::string& quantity);
+
+	/*!
+	 * \brief Compute the physical values of a product
+	 * \param out		resized to the grid, undetect and nodata pixels are UNDETECT and NODATA
+	 * \see getRemapTable()
+	 */
+	void compute(PolarVolume& volume, const std::string& product, double prodpar, const std::string& quantity, DataMatrix<float>& out);
+
+	/*!
+	 * \brief Compute a product and store it in an image object
+	 *
+	 * Root what/ and where/ of the image are set from the volume and the grid,
+	 * a new product dataset is created with the grid, the product parameter and
+	 * the start/end times of the scans used.
+	 * \param image		destination object
+	 * \param encoding	encoding of the stored values
+	 * \returns		the new product dataset
+	 * \remarks		User is responsible for deleting the returned object
+	 * \see compute()
+	 */
+	Horizontal_Product_2D* generate(ImageObject& image, PolarVolume& volume, const std::string& product, double prodpar,
+					const std::string& quantity, const Encoding& encoding);
+
+	/*!
+	 * \brief Cache of remap tables shared by every generator
+	 */
+	static Radar::LRUCache<std::string, const RemapTable>& cache();
+
+ private:
+	CartesianGrid	grid;
+	int		threads;
+	int		rowsPerBlock;
+	double		defaultBeamWidth;
+
+	RemapTable* buildRemapTable(PolarVolume& volume, const std::vector<int>& scans, const std::string& product, double prodpar);
+	void fill(PolarVolume& volume, const RemapTable& table, const std::string& quantity, DataMatrix<float>& out);
+};
+
+/*===========================================================================*/
+/* COLUMN TABLE */
+/*===========================================================================*/
+
+/*!
+ * \brief Precomputed gates above every pixel of a cartesian product
+ *
+ * For each pixel the table stores, for every scan used and by increasing
+ * elevation, the gate above the pixel and the height (m above sea level) of its
+ * beam centre. The elements of pixel p start at p * getLevels(). Gates are
+ * numbered as in RemapTable, missing gates are -1.
+ */
+class RADAR_API ColumnTable {
+ public:
+	ColumnTable();
+
+	/*!
+	 * \brief Indexes in the volume of the scans used by the table, by increasing elevation
+	 */
+	const std::vector<int>& getScans() const	{ return scans; }
+	/*!
+	 * \brief Number of the first gate of each scan, plus the total number of gates
+	 */
+	const std::vector<size_t>& getScanOffsets() const	{ return offsets; }
+	/*!
+	 * \brief Gate of each pixel and scan
+	 */
+	const std::vector<int>& getGates() const	{ return gates; }
+	/*!
+	 * \brief Beam height of each pixel and scan
+	 */
+	const std::vector<float>& getHeights() const	{ return heights; }
+	/*!
+	 * \brief Number of scans stored for each pixel
+	 */
+	int getLevels() const	{ return (int)scans.size(); }
+	int getXSize() const	{ return xsize; }
+	int getYSize() const	{ return ysize; }
+
+	/*!
+	 * \brief Memory used by the table, in bytes
+	 */
+	size_t memorySize() const;
+
+ private:
+	friend class ColumnGenerator;
+	int			xsize, ysize;
+	std::vector<int>	scans;
+	std::vector<size_t>	offsets;
+	std::vector<int>	gates;
+	std::vector<float>	heights;
+};
+
+/*===========================================================================*/
+/* COLUMN GENERATOR */
+/*===========================================================================*/
+
+/*!
+ * \brief Products computed by a ColumnGenerator and their parameters
+ */
+struct RADAR_API ColumnRequest {
+	bool		max;		/*!< maximum value of the column (MAX) */
+	bool		etop;		/*!< echo top (ETOP) */
+	bool		vil;		/*!< vertically integrated liquid water (VIL) */
+	double		etopThreshold;	/*!< minimum reflectivity (dBZ) of the echo top */
+	VILHeights	vilHeights;	/*!< layer (m above sea level) integrated by VIL */
+	Encoding	maxEncoding;	/*!< encoding of MAX, in the units of the quantity */
+	Encoding	etopEncoding;	/*!< encoding of ETOP, in km */
+	Encoding	vilEncoding;	/*!< encoding of VIL, in kg/m2 */
+
+	/*!
+	 * \brief Request every product
+	 *
+	 * ETOP threshold is 18 dBZ and VIL integrates from 0 to 15 km. MAX is stored
+	 * as dBZ (gain 0.5, offset -32), ETOP with 0.1 km steps and VIL with
+	 * 0.5 kg/m2 steps, all of them as 8 bit values.
+	 */
+	ColumnRequest();
+};
+
+/*!
+ * \brief Generator of MAX, ETOP and VIL products from polar volumes
+ *
+ * Each pixel looks at the gates of every scan above it, as found by the same
+ * beam model of CartesianGenerator. The requested products are computed in a
+ * single pass over the columns: the grid is split in square tiles that are
+ * processed in parallel, so that the gates and heights of a tile stay in cache
+ * while every product is computed. \n
+ * MAX is the maximum value of the column. ETOP is the height (km above sea
+ * level) of the highest gate with at least etopThreshold dBZ. VIL integrates
+ * 3.44e-6 * Z^(4/7) kg/m3 (Z in mm6/m3, capped at 56 dBZ to limit the effect of
+ * hail) in the requested layer, each gate covering the heights between the
+ * midpoints to the gates of the scans above and below. \n
+ * Pixels without any valid gate are NODATA, pixels without echoes are
+ * UNDETECT. Column tables are cached like remap tables.
+ */
+class RADAR_API ColumnGenerator {
+ public:
+	typedef std::shared_ptr<const ColumnTable> ColumnTablePtr;
+
+	/*!
+	 * \brief Create a generator for the given grid
+	 * \param grid		grid of the products
+	 * \param threads	number of threads, 0 for one thread per core
+	 */
+	ColumnGenerator(const CartesianGrid& grid, int threads = 0);
+
+	const CartesianGrid& getGrid() const { return grid; }
+	void setThreads(int val)	{ threads = val; }
+	int getThreads() const		{ return threads; }
+	/*!
+	 * \brief Side (pixels) of the square tiles assigned to a thread at a time
+	 */
+	void setTileSize(int val)	{ tileSize = val > 0 ? val : 1; }
+	int getTileSize() const		{ return tileSize; }
+
+	/*!
+	 * \brief Get the column table of a volume, computing it if it is not cached
+	 * \param volume	the polar volume
+	 * \param quantity	only scans with this quantity are used
+	 */
+	ColumnTablePtr getColumnTable(PolarVolume& volume, const std::string& quantity);
+
+	/*!
+	 * \brief Compute the physical values of the requested products
+	 *
+	 * Matrices of products that are not requested are left untouched, the others
+	 * are resized to the grid.
+	 * \param volume	the polar volume
+	 * \param quantity	reflectivity quantity, usually PRODUCT_QUANTITY_DBZH
+	 */
+	void compute(PolarVolume& volume, const std::string& quantity, const ColumnRequest& request,
+		     DataMatrix<float>& max, DataMatrix<float>& etop, DataMatrix<float>& vil);
+
+	/*!
+	 * \brief Compute the requested products and store them in an image object
+	 *
+	 * Root what/ and where/ of the image are set from the volume and the grid, a
+	 * new dataset is created for each product: MAX stores the input quantity,
+	 * ETOP stores HGHT with the threshold as product parameter and VIL stores
+	 * VIL with the layer heights as product parameter.
+	 * \returns		the new datasets, in the order MAX, ETOP, VIL
+	 * \remarks		User is responsible for deleting the returned objects
+	 */
+	std::vector<Horizontal_Product_2D*> generate(ImageObject& image, PolarVolume& volume, const std::string& quantity,
+						     const ColumnRequest& request);
+
+	/*!
+	 * \brief Compute the side panels of the MAX product
+	 *
+	 * Panels use the gates of the cached column table: each gate covers the
+	 * heights between the midpoints to the gates of the scans above and below,
+	 * and every height layer of a panel takes the maximum of the gates that
+	 * cover it. hsp is resized to levels rows, from maxHeight down, and the
+	 * columns of the grid: each element is the maximum along a grid column.
+	 * vsp is resized to the rows of the grid and levels columns, from
+	 * minHeight up: each element is the maximum along a grid row.
+	 * \param levels	number of height layers of the panels
+	 * \param minHeight	bottom of the panels (m above sea level)
+	 * \param maxHeight	top of the panels (m above sea level)
+	 */
+	void computePanels(PolarVolume& volume, const std::string& quantity, int levels, double minHeight, double maxHeight,
+			   DataMatrix<float>& hsp, DataMatrix<float>& vsp);
+
+	/*!
+	 * \brief Compute the side panels of the MAX product and store them in an image object
+	 *
+	 * Root what/ and where/ of the image are set as generate() does. The HSP
+	 * goes from the lower left to the lower right corner of the grid, the VSP
+	 * from the upper right to the lower right corner.
+	 * \returns		the new datasets, in the order HSP, VSP
+	 * \remarks		User is responsible for deleting the returned objects
+	 * \see computePanels()
+	 */
+	std::vector<Product_Panel*> generatePanels(ImageObject& image, PolarVolume& volume, const std::string& quantity,
+						   int levels, double minHeight, double maxHeight, const Encoding& encoding);
+
+	/*!
+	 * \brief Cache of column tables shared by every generator
+	 */
+	static Radar::LRUCache<std::string, const ColumnTable>& cache();
+
+ private:
+	CartesianGrid	grid;
+	int		threads;
+	int		tileSize;
+
+	ColumnTable* buildColumnTable(PolarVolume& volume, const std::vector<int>& scans);
+	void fill(PolarVolume& volume, const ColumnTable& table, const std::string& quantity, const ColumnRequest& request,
+		  DataMatrix<float>& max, DataMatrix<float>& etop, DataMatrix<float>& vil);
+	void fillPanels(PolarVolume& volume, const ColumnTable& table, const std::string& quantity, int levels, double minHeight, double maxHeight,
+			DataMatrix<float>& hsp, DataMatrix<float>& vsp);
+};
+
+/*===========================================================================*/
+/* CVOL TABLE */
+/*===========================================================================*/
+
+/*!
+ * \brief Vertical interpolation used by CvolGenerator
+ */
+enum VerticalInterpolation {
+	VERTICAL_NEAREST,	/*!< value of the beam nearest in height */
+	VERTICAL_LINEAR		/*!< linear interpolation between the beams below and above */
+};
+
+/*!
+ * \brief Precomputed gates sampled by every voxel of a cartesian volume
+ *
+ * Each voxel has a lower and an upper gate and the weight of the upper one,
+ * -1 for missing gates, with gates numbered as in RemapTable. Voxels are
+ * stored level by level, each level row by row, so that the part of the table
+ * used by a level is contiguous.
+ */
+class RADAR_API CvolTable {
+ public:
+	CvolTable();
+
+	/*!
+	 * \brief Indexes in the volume of the scans used by the table, by increasing elevation
+	 */
+	const std::vector<int>& getScans() const		{ return scans; }
+	/*!
+	 * \brief Number of the first gate of each scan, plus the total number of gates
+	 */
+	const std::vector<size_t>& getScanOffsets() const	{ return offsets; }
+	/*!
+	 * \brief Gate of the lower beam of each voxel
+	 */
+	const std::vector<int>& getLowerGates() const		{ return lower; }
+	/*!
+	 * \brief Gate of the upper beam of each voxel
+	 */
+	const std::vector<int>& getUpperGates() const		{ return upper; }
+	/*!
+	 * \brief Weight of the upper gate of each voxel
+	 */
+	const std::vector<float>& getWeights() const		{ return weights; }
+	int getXSize() const		{ return xsize; }
+	int getYSize() const		{ return ysize; }
+	int getLevelCount() const	{ return levels; }
+
+	/*!
+	 * \brief Memory used by the table, in bytes
+	 */
+	size_t memorySize() const;
+
+ private:
+	friend class CvolGenerator;
+	int			xsize, ysize, levels;
+	std::vector<int>	scans;
+	std::vector<size_t>	offsets;
+	std::vector<int>	lower;
+	std::vector<int>	upper;
+	std::vector<float>	weights;
+};
+
+/*===========================================================================*/
+/* CVOL GENERATOR */
+/*===========================================================================*/
+
+/*!
+ * \brief Generator of 3D cartesian volumes (CVOL) from polar volumes
+ *
+ * Each level is a CAPPI at the given height (m above sea level), sampled with
+ * the beam model of CartesianGenerator. VERTICAL_NEAREST takes the beam nearest
+ * in height, as CAPPI products do; VERTICAL_LINEAR interpolates between the beams
+ * below and above the voxel and, above the highest or below the lowest beam,
+ * takes the nearest one. In both cases beams farther than half beam width are
+ * not used and voxels without beams are NODATA. With linear interpolation a
+ * voxel between a valid and a missing gate takes the valid value, one with
+ * UNDETECT gates the value of the nearest one. \n
+ * Tables are cached per radar geometry, grid, levels and interpolation. Levels
+ * are computed one at a time by parallel blocks of rows, so that only one level
+ * is kept in memory, and each level is written in its own dataset, where it can
+ * be read without touching the others.
+ */
+class RADAR_API CvolGenerator {
+ public:
+	typedef std::shared_ptr<const CvolTable> CvolTablePtr;
+
+	/*!
+	 * \brief Create a generator for the given grid and levels
+	 * \param grid		horizontal grid of the volume
+	 * \param heights	height (m above sea level) of every level
+	 * \param threads	number of threads, 0 for one thread per core
+	 */
+	CvolGenerator(const CartesianGrid& grid, const std::vector<double>& heights, int threads = 0);
+
+	const CartesianGrid& getGrid() const		{ return grid; }
+	const std::vector<double>& getHeights() const	{ return heights; }
+	void setInterpolation(VerticalInterpolation val)	{ interpolation = val; }
+	VerticalInterpolation getInterpolation() const	{ return interpolation; }
+	void setThreads(int val)	{ threads = val; }
+	int getThreads() const		{ return threads; }
+	/*!
+	 * \brief Number of rows assigned to a thread at a time
+	 */
+	void setRowsPerBlock(int val)	{ rowsPerBlock = val > 0 ? val : 1; }
+	/*!
+	 * \brief Beam width (degrees) used when scans do not store how/beamwidth
+	 */
+	void setDefaultBeamWidth(double val)	{ defaultBeamWidth = val; }
+
+	/*!
+	 * \brief Get the table of a volume, computing it if it is not cached
+	 * \param quantity	only scans with this quantity are used
+	 */
+	CvolTablePtr getCvolTable(PolarVolume& volume, const std::string& quantity);
+
+	/*!
+	 * \brief Compute the physical values of every level
+	 * \param levels	resized to the number of levels, each one to the grid
+	 */
+	void compute(PolarVolume& volume, const std::string& quantity, std::vector<DataMatrix<float> >& levels);
+
+	/*!
+	 * \brief Compute the volume and store it in a CVOL object
+	 *
+	 * Root what/ and where/ of the object are set from the volume and the grid.
+	 * Every level is stored in a new CAPPI dataset with its height as product
+	 * parameter, in the order of the heights. Levels are computed and written
+	 * one at a time.
+	 */
+	void generate(CvolObject& object, PolarVolume& volume, const std::string& quantity, const Encoding& encoding);
+
+	/*!
+	 * \brief Cache of CVOL tables shared by every generator
+	 */
+	static Radar::LRUCache<std::string, const CvolTable>& cache();
+
+ private:
+	CartesianGrid		grid;
+	std::vector<double>	heights;
+	VerticalInterpolation	interpolation;
+	int			threads;
+	int			rowsPerBlock;
+	double			defaultBeamWidth;
+
+	CvolTable* buildCvolTable(PolarVolume& volume, const std::vector<int>& scans);
+	void fillLevel(const CvolTable& table, const std::vector<float>& values, int level, DataMatrix<float>& out);
+};
+
+}
+}
+
+#endif
@@ -22,7 +22,10 @@
 
 #include <radarlib/odimh5v21_classes.hpp>
 
+#include <algorithm>
 #include <iomanip>
+#include <limits>
+#include <memory>
 #include <ctime>
 #include <cstdio>
 #include <cstdlib>
@@ -34,6 +37,9 @@
 #include <radarlib/odimh5v21_const.hpp>
 #include <radarlib/odimh5v21_format.hpp>
 #include <radarlib/odimh5v21_metadata.hpp>
+#include <radarlib/odimh5v21_stats.hpp>
+#include <radarlib/odimh5v21_trace.hpp>
+#include <radarlib/parallel.hpp>
 
 namespace OdimH5v21
 {
@@ -58,6 +64,33 @@ static time_t	getWhatDateTime	(MetadataGroup* meta)
 
 /*==============================================================*/
 
+/*
+ * Dettaglio di una traccia: what/quantity, se presente, e percorso HDF5 del
+ * gruppo (es. "DBZH /dataset1/data2"). Chiamata solo se la traccia e' attiva;
+ * gli errori sono ignorati perche' una traccia non deve far fallire l'operazione.
+ */
+template <class T> static std::string traceDetail(T& object)
+{
+	std::string detail;
+	try
+	{
+		HDF5Lock lock;
+		detail = object.getH5Object()->getObjName();
+		if (object.existWhat())
+		{
+			std::string quantity = object.getWhat()->getStr(ATTRIBUTE_WHAT_QUANTITY, "");
+			if (!quantity.empty())
+				detail = quantity + " " + detail;
+		}
+	}
+	catch (...)
+	{
+	}
+	return detail;
+}
+
+/*==============================================================*/
+
 static void	setWhatStartDateTime(MetadataGroup* meta, const time_t val)		
 {
 	meta->set	(ATTRIBUTE_WHAT_STARTDATE, Format::timeToYYYYMMDD(val));
@@ -132,13 +165,14 @@ OdimObject::~OdimObject()
 {
 	try
 	{
+		HDF5Lock lock;
 		delete meta_what;
 		delete meta_where;
 		delete meta_how;	
 		delete group;	
 		delete file;
-		/* alla chiusura di un file costringiamo la libreria a fare un po' di pulizia */
-		H5::H5Library::garbageCollect();
+		/* alla chiusura di un file la libreria puo' fare un po' di pulizia */
+		HDF5Library::instance().fileClosed();
 		
 	}
 	catch (...)
@@ -257,6 +291,7 @@ OdimDataset* OdimObject::getDataset(int index)
 
 static void renameChildren(H5::Group* parent, int removedElement, int count, const char* prefix)
 {
+	HDF5Lock lock;
 	char name1[100];
 	char name2[100];
 	for (int i=removedElement+1; i<count; i++)
@@ -293,6 +328,7 @@ void OdimObject::removeDataset(int index)
 
 H5::Group* OdimObject::createDatasetGroup()
 {
+	HDF5Lock lock;
 	int		num	= getDatasetCount();
 	std::string	name	= GROUP_DATASET + Radar::stringutils::toString(num + 1);
 	return new H5::Group( this->group->createGroup(name.c_str()));		
@@ -300,6 +336,7 @@ H5::Group* OdimObject::createDatasetGroup()
 
 H5::Group* OdimObject::getDatasetGroup(int index)
 {
+	HDF5Lock lock;
 	std::string name = GROUP_DATASET + Radar::stringutils::toString(index + 1);
 	return new H5::Group( this->group->openGroup(name.c_str()));	
 }
@@ -328,6 +365,7 @@ OdimDataset::~OdimDataset()
 { 
 	try
 	{
+		HDF5Lock lock;
 		delete meta_what;
 		delete meta_where;
 		delete meta_how;	
@@ -434,6 +472,7 @@ void OdimDataset::removeData(int index)
 
 H5::Group* OdimDataset::createDataGroup()
 {
+	HDF5Lock lock;
 	int		num	= getDataCount();
 	std::string	name	= GROUP_DATA + Radar::stringutils::toString(num + 1);
 	return new H5::Group( this->group->createGroup(name.c_str()));		
@@ -499,6 +538,7 @@ void OdimDataset::removeQuality(int index)
 
 H5::Group* OdimDataset::createQualityGroup()
 {
+	HDF5Lock lock;
 	int		num	= getQualityCount();
 	std::string	name	= GROUP_QUALITY + Radar::stringutils::toString(num + 1);
 	return new H5::Group( this->group->createGroup(name.c_str()));		
@@ -526,6 +566,7 @@ OdimData::~OdimData()
 {
 	try
 	{
+		HDF5Lock lock;
 		delete meta_what;
 		delete meta_where;
 		delete meta_how;
@@ -585,6 +626,7 @@ H5::DataSet*	OdimData::getData()
 
 H5::AtomType	OdimData::getDataType()
 {
+	HDF5Lock lock;
 	H5::DataSet* dataset = NULL;
 	try
 	{
@@ -612,6 +654,12 @@ H5::AtomType	OdimData::getDataType()
 	}
 }
 
+RawType OdimData::getRawType()
+{
+	HDF5Lock lock;
+	return OdimH5v21::getRawType(getDataType());
+}
+
 int OdimData::getDataWidth()
 {
 	int height, width;
@@ -628,6 +676,7 @@ int OdimData::getDataHeight()
 
 void OdimData::getDataDimension(int* height, int* width)
 {
+	HDF5Lock lock;
 	H5::DataSet* dataset = NULL;
 	try
 	{
@@ -663,6 +712,14 @@ void OdimData::getDataDimension(int* height, int* width)
 
 void OdimData::writeData(const void* buff, int width, int height, const H5::DataType& elemtype)
 {
+	writeData(buff, width, height, elemtype, 6);
+}
+void OdimData::writeData(const void* buff, int width, int height, const H5::DataType& elemtype, int compression)
+{
+	TraceScope trace("data", "writeData");
+	if (trace.isActive())
+		trace.setDetail(traceDetail(*this));
+	HDF5Lock lock;
 	H5::DataSet* dataset = NULL;
 	try
 	{		
@@ -673,9 +730,15 @@ void OdimData::writeData(const void* buff, int width, int height, const H5::Data
 		H5::DataSpace space(RANK, fdim);
 
 		H5::DSetCreatPropList ds_creatplist;  // create dataset creation prop list
-		ds_creatplist.setChunk( 2, fdim );  // then modify it for compression
-		ds_creatplist.setDeflate( 6 );
+		if (compression > 0)
+		{
+			ds_creatplist.setChunk( 2, fdim );  // then modify it for compression
+			ds_creatplist.setDeflate( compression );
+		}
 
+		HDF5StatsScope stats(HDF5_STATS_DATA_WRITE);
+		if (stats.isActive())
+			stats.setBytes((uint64_t)width * height * elemtype.getSize());
 		dataset = new H5::DataSet(group->createDataSet(DATASET_DATA, elemtype, space, ds_creatplist));			
 		dataset->write(buff, elemtype);	// mspace1, fspace );
 		if ((elemtype == H5::PredType::STD_U8BE) || (elemtype == H5::PredType::STD_U8LE) || (elemtype == H5::PredType::INTEL_U8) || 
@@ -698,6 +761,15 @@ void OdimData::writeData(const void* buff, int width, int height, const H5::Data
 		throw;
 	}
 }
+void OdimData::writeData(const void* buff, int width, int height, RawType elemtype)
+{
+	writeData(buff, width, height, elemtype, 6);
+}
+void OdimData::writeData(const void* buff, int width, int height, RawType elemtype, int compression)
+{
+	HDF5Lock lock;
+	writeData(buff, width, height, getH5Type(elemtype), compression);
+}
 void OdimData::writeData(const char* buff, int width, int height)
 {
 	writeData(buff, width, height, H5::PredType::NATIVE_INT8);
@@ -733,6 +805,10 @@ void	OdimData::writeData(const DataMatrix<float>& matrix)
 
 void OdimData::readData(void* buff)
 {
+	TraceScope trace("data", "readData");
+	if (trace.isActive())
+		trace.setDetail(traceDetail(*this));
+	HDF5Lock lock;
 	H5::DataSet* dataset = getData();
 	if (dataset == NULL) 
 		return;			
@@ -743,6 +819,9 @@ void OdimData::readData(void* buff)
 		//numsizes = dataset->getSpace().getSimpleExtentDims(sizes);
 		//DataSpace space(numsizes, sizes);
 		//dataset = new H5::DataSet(group->openDataSet(DATASET_DATA));
+		HDF5StatsScope stats(HDF5_STATS_DATA_READ);
+		if (stats.isActive())
+			stats.setBytes(dataset->getInMemDataSize());
 		dataset->read(buff, dataset->getDataType(), dataset->getSpace());	// mspace1, fspace );
 		delete dataset;
 	}
@@ -757,6 +836,41 @@ void OdimData::readData(void* buff)
 		throw;
 	}
 }
+
+void OdimData::readData(void* buff, const H5::DataType& memtype)
+{
+	TraceScope trace("data", "readData");
+	if (trace.isActive())
+		trace.setDetail(traceDetail(*this));
+	HDF5Lock lock;
+	H5::DataSet* dataset = getData();
+	if (dataset == NULL) 
+		return;			
+	try
+	{
+		HDF5StatsScope stats(HDF5_STATS_DATA_READ);
+		if (stats.isActive())
+			stats.setBytes((uint64_t)dataset->getSpace().getSimpleExtentNpoints() * memtype.getSize());
+		dataset->read(buff, memtype);
+		delete dataset;
+	}
+	catch (H5::Exception& h5e)
+	{
+		delete dataset;		
+		throw OdimH5HDF5LibException("Unable to read odim data from HDF5 dataset", h5e);
+	}
+	catch (...)
+	{
+		delete dataset;
+		throw;
+	}
+}
+
+void OdimData::readData(void* buff, RawType memtype)
+{
+	HDF5Lock lock;
+	readData(buff, getH5Type(memtype));
+}
 int OdimData::getQualityCount()	
 { 	
 	return HDF5Group::getChildCount(this->group, GROUP_QUALITY);
@@ -811,6 +925,7 @@ void OdimData::removeQuality(int index)
 
 H5::Group* OdimData::createQualityGroup()
 {
+	HDF5Lock lock;
 	int		num	= getQualityCount();
 	std::string	name	= GROUP_QUALITY + Radar::stringutils::toString(num + 1);
 	return new H5::Group( this->group->createGroup(name.c_str()));		
@@ -844,6 +959,7 @@ OdimQuality::~OdimQuality()
 {
 	try
 	{
+		HDF5Lock lock;
 		delete meta_what;
 		delete meta_where;
 		delete meta_how;
@@ -903,6 +1019,7 @@ H5::DataSet*	OdimQuality::getData()
 
 H5::AtomType	OdimQuality::getQualityType()
 {
+	HDF5Lock lock;
 	H5::DataSet* dataset = NULL;
 	try
 	{
@@ -946,6 +1063,7 @@ int OdimQuality::getQualityHeight()
 
 void OdimQuality::getQualityDimension(int* height, int* width)
 {
+	HDF5Lock lock;
 	H5::DataSet* dataset = NULL;
 	try
 	{
@@ -981,6 +1099,10 @@ void OdimQuality::getQualityDimension(int* height, int* width)
 
 void OdimQuality::writeQuality(const void* buff, int width, int height, const H5::DataType& elemtype)
 {
+	TraceScope trace("data", "writeQuality");
+	if (trace.isActive())
+		trace.setDetail(traceDetail(*this));
+	HDF5Lock lock;
 	H5::DataSet* dataset = NULL;
 	try
 	{		
@@ -994,6 +1116,9 @@ void OdimQuality::writeQuality(const void* buff, int width, int height, const H5
 		ds_creatplist.setChunk( 2, fdim );  // then modify it for compression
 		ds_creatplist.setDeflate( 6 );
 
+		HDF5StatsScope stats(HDF5_STATS_DATA_WRITE);
+		if (stats.isActive())
+			stats.setBytes((uint64_t)width * height * elemtype.getSize());
 		dataset = new H5::DataSet(group->createDataSet(DATASET_DATA, elemtype, space, ds_creatplist));			
 		dataset->write(buff, elemtype);	// mspace1, fspace );
 		if ((elemtype == H5::PredType::STD_U8BE) || (elemtype == H5::PredType::STD_U8LE) || (elemtype == H5::PredType::INTEL_U8) || 
@@ -1051,6 +1176,10 @@ void	OdimQuality::writeQuality(const DataMatrix<float>& matrix)
 
 void OdimQuality::readQuality(void* buff)
 {
+	TraceScope trace("data", "readQuality");
+	if (trace.isActive())
+		trace.setDetail(traceDetail(*this));
+	HDF5Lock lock;
 	H5::DataSet* dataset = getData();
 	if (dataset == NULL) 
 		return;			
@@ -1061,6 +1190,9 @@ void OdimQuality::readQuality(void* buff)
 		//numsizes = dataset->getSpace().getSimpleExtentDims(sizes);
 		//DataSpace space(numsizes, sizes);
 		//dataset = new H5::DataSet(group->openDataSet(DATASET_DATA));
+		HDF5StatsScope stats(HDF5_STATS_DATA_READ);
+		if (stats.isActive())
+			stats.setBytes(dataset->getInMemDataSize());
 		dataset->read(buff, dataset->getDataType(), dataset->getSpace());	// mspace1, fspace );
 		delete dataset;
 	}
@@ -1076,6 +1208,36 @@ void OdimQuality::readQuality(void* buff)
 	}
 }
 
+void OdimQuality::readQuality(void* buff, RawType memtype)
+{
+	TraceScope trace("data", "readQuality");
+	if (trace.isActive())
+		trace.setDetail(traceDetail(*this));
+	HDF5Lock lock;
+	H5::DataSet* dataset = getData();
+	if (dataset == NULL) 
+		return;			
+	try
+	{
+		const H5::DataType& type = getH5Type(memtype);
+		HDF5StatsScope stats(HDF5_STATS_DATA_READ);
+		if (stats.isActive())
+			stats.setBytes((uint64_t)dataset->getSpace().getSimpleExtentNpoints() * type.getSize());
+		dataset->read(buff, type);
+		delete dataset;
+	}
+	catch (H5::Exception& h5e)
+	{
+		delete dataset;		
+		throw OdimH5HDF5LibException("Unable to read odim data from HDF5 dataset", h5e);
+	}
+	catch (...)
+	{
+		delete dataset;
+		throw;
+	}
+}
+
 /*===========================================================================*/
 /* POLAR VOLUME */
 /*===========================================================================*/
@@ -1176,13 +1338,17 @@ PolarScan* PolarVolume::createScan()
 
 PolarScan* PolarVolume::getScan(int index) 
 {
+	TraceScope trace("object", "getScan", index);
 	H5::Group* h5group = NULL;
 	try
 	{
 		h5group = getDatasetGroup(index);
-		if (h5group)
-			return new PolarScan(this, h5group);
-		return NULL;	
+		if (!h5group)
+			return NULL;
+		PolarScan* scan = new PolarScan(this, h5group);
+		if (trace.isActive())
+			trace.setDetail(traceDetail(*scan));
+		return scan;
 	}
 	catch (...)
 	{
@@ -1360,6 +1526,140 @@ std::set<std::string> PolarVolume::getStoredQuantities()
 	}
 }
 
+namespace {
+
+struct CubeScanOrder
+{
+	int	index;
+	double	elangle;
+
+	bool operator<(const CubeScanOrder& o) const { return elangle < o.elangle; }
+};
+
+/* translates the raw values of a block of rays of the cube, rays are numbered across scans */
+struct CubeTask
+{
+	PolarCube&			cube;
+	const std::vector<float>&	raw;
+	const std::vector<size_t>&	offsets;	/* first raw value of each scan */
+	const std::vector<int>&		sources;	/* source ray of each cube ray, -1 for none */
+	const std::vector<float>&	nodata;
+	const std::vector<float>&	undetect;
+
+	void operator()(size_t begin, size_t end) const
+	{
+		const float nan		= std::numeric_limits<float>::quiet_NaN();
+		const float inf		= -std::numeric_limits<float>::infinity();
+		const size_t rays	= cube.getRayCount();
+
+		for (size_t i = begin; i < end; ++i)
+		{
+			int s			= (int)(i / rays);
+			const PolarCubeScan& g	= cube.getScan(s);
+			float* out		= cube.ray(s, (int)(i % rays));
+			int source		= sources[i];
+			if (source < 0)
+			{
+				std::fill(out, out + g.numbins, nan);
+				continue;
+			}
+			const float* in		= &raw[offsets[s] + (size_t)source * g.numbins];
+			const float gain	= (float)g.gain;
+			const float offset	= (float)g.offset;
+			const float nd		= nodata[s];
+			const float ud		= undetect[s];
+			for (int b = 0; b < g.numbins; ++b)
+			{
+				float v = in[b];
+				out[b] = (v == nd) ? nan : (v == ud) ? inf : v * gain + offset;
+			}
+		}
+	}
+};
+
+}
+
+void PolarVolume::readCube(const std::string& quantity, PolarCube& cube, bool northAligned, int threads)
+{
+	TraceScope trace("data", "readCube", quantity);
+	std::vector<CubeScanOrder> order;
+	int count = getScanCount();
+	for (int i=0; i<count; i++)
+	{
+		std::unique_ptr<PolarScan> scan(getScan(i));
+		if (!scan->hasQuantityData(quantity))
+			continue;
+		CubeScanOrder item = { i, scan->getEAngle() };
+		order.push_back(item);
+	}
+	if (order.empty())
+		throw OdimH5Exception("No scan contains quantity " + quantity);
+	std::stable_sort(order.begin(), order.end());
+
+	/* geometry and raw values, HDF5 is used only by the calling thread */
+	std::vector<PolarCubeScan> scans(order.size());
+	std::vector<size_t> offsets(order.size() + 1, 0);
+	std::vector<float> nodata(order.size()), undetect(order.size());
+	std::vector<std::vector<int> > sectors(order.size());
+	int rays = 0, bins = 0;
+	for (size_t k=0; k<order.size(); k++)
+	{
+		std::unique_ptr<PolarScan> scan(getScan(order[k].index));
+		std::unique_ptr<PolarScanData> data(scan->getQuantityData(quantity));
+		PolarCubeScan& g	= scans[k];
+		g.index			= order[k].index;
+		g.elangle		= order[k].elangle;
+		g.numrays		= data->getNumRays();
+		g.numbins		= data->getNumBins();
+		g.rangeStart		= scan->getRangeStart();
+		g.rangeScale		= scan->getRangeScale();
+		g.beamWidth		= scan->getBeamWidth(1.);
+		g.a1gate		= scan->getA1Gate();
+		g.startDateTime		= scan->getStartDateTime();
+		g.endDateTime		= scan->getEndDateTime();
+		g.gain			= data->getGain();
+		g.offset		= data->getOffset();
+		nodata[k]		= (float)data->getNodata();
+		undetect[k]		= (float)data->getUndetect();
+		offsets[k + 1]		= offsets[k] + (size_t)g.numrays * g.numbins;
+		if (g.numrays > rays)	rays = g.numrays;
+		if (g.numbins > bins)	bins = g.numbins;
+
+		if (northAligned)
+		{
+			const AzimuthIndex& index = scan->getAzimuthIndex();
+			sectors[k].resize(g.numrays);
+			for (int r=0; r<g.numrays; r++)
+				sectors[k][r] = index.size() == g.numrays ? index.findRay((r + 0.5) * 360. / g.numrays) : r;
+		}
+	}
+
+	std::vector<float> raw(offsets.back());
+	for (size_t k=0; k<order.size(); k++)
+	{
+		if (offsets[k + 1] == offsets[k])
+			continue;
+		std::unique_ptr<PolarScan> scan(getScan(order[k].index));
+		std::unique_ptr<PolarScanData> data(scan->getQuantityData(quantity));
+		/* HDF5 converts integer raw values to float exactly */
+		data->readData(&raw[offsets[k]], H5::PredType::NATIVE_FLOAT);
+	}
+
+	/* source ray of every ray of the cube, padding rays have none */
+	std::vector<int> sources((size_t)order.size() * rays, -1);
+	for (size_t k=0; k<order.size(); k++)
+		for (int r=0; r<scans[k].numrays; r++)
+			sources[k * rays + r] = northAligned ? sectors[k][r] : r;
+
+	cube.resize((int)order.size(), rays, bins);
+	cube.setNorthAligned(northAligned);
+	for (size_t k=0; k<order.size(); k++)
+		cube.getScan((int)k) = scans[k];
+
+	CubeTask task = { cube, raw, offsets, sources, nodata, undetect };
+	Radar::parallel::forBlocks(sources.size(), 32, threads, task);
+}
+
 /*===========================================================================*/
 /* POLAR VOLUME SCAN */
 /*===========================================================================*/
@@ -1392,11 +1692,15 @@ PolarScan::PolarScan(PolarVolume* volume, H5::Group* group)
 ,WHEREScanMetadata()
 ,HOWPolarMetadata()
 ,volume(volume)
+,rayTable(NULL)
+,azimuthIndex(NULL)
 {			
 }
 
 PolarScan::~PolarScan()
 {		
+	delete rayTable;
+	delete azimuthIndex;
 }
 
 void PolarScan::setMandatoryInformations()
@@ -1450,7 +1754,7 @@ void		PolarScan::setAltitude		(double val) 			{        getWhere()->set	(ATTRIBUT
 //--- WHERE DATASET ---
 
 double		PolarScan::getEAngle		()				{ return getWhere()->getDouble	(ATTRIBUTE_WHERE_ELANGLE);	}
-void		PolarScan::setEAngle		(double val)			{        getWhere()->set	(ATTRIBUTE_WHERE_ELANGLE, val);	}
+void		PolarScan::setEAngle		(double val)			{ invalidateRayTable();        getWhere()->set	(ATTRIBUTE_WHERE_ELANGLE, val);	}
 int		PolarScan::getNumBins		()				{ return getWhere()->getInt	(ATTRIBUTE_WHERE_NBINS);	}
 void		PolarScan::setNumBins		(int val)			{        getWhere()->set	(ATTRIBUTE_WHERE_NBINS, val);	}
 double		PolarScan::getRangeStart	()				{ return getWhere()->getDouble	(ATTRIBUTE_WHERE_RSTART);	}
@@ -1458,9 +1762,9 @@ void		PolarScan::setRangeStart	(double val)			{        getWhere()->set	(ATTRIBUT
 double		PolarScan::getRangeScale	()				{ return getWhere()->getDouble	(ATTRIBUTE_WHERE_RSCALE);	}
 void		PolarScan::setRangeScale	(double val)			{        getWhere()->set	(ATTRIBUTE_WHERE_RSCALE, val);	}
 int		PolarScan::getNumRays		()				{ return getWhere()->getInt	(ATTRIBUTE_WHERE_NRAYS);	}
-void		PolarScan::setNumRays		(int val)			{        getWhere()->set	(ATTRIBUTE_WHERE_NRAYS, val);	}
+void		PolarScan::setNumRays		(int val)			{ invalidateRayTable();        getWhere()->set	(ATTRIBUTE_WHERE_NRAYS, val);	}
 int		PolarScan::getA1Gate		()				{ return getWhere()->getInt	(ATTRIBUTE_WHERE_A1GATE);	}
-void		PolarScan::setA1Gate		(int val)			{	 getWhere()->set	(ATTRIBUTE_WHERE_A1GATE, val);	}
+void		PolarScan::setA1Gate		(int val)			{ invalidateRayTable();	 getWhere()->set	(ATTRIBUTE_WHERE_A1GATE, val);	}
 
 //--- HOW ROOT ---
 
@@ -1497,7 +1801,7 @@ double		PolarScan::getWaveLength	(double defaultValue)		{ return getHow()->getDo
 void		PolarScan::setWaveLength	(double val)			{        getHow()->set		(ATTRIBUTE_HOW_WAVELENGTH, val);		}
 double		PolarScan::getRPM		()				{ return getHow()->getDouble	(ATTRIBUTE_HOW_RPM, 0);				}
 double		PolarScan::getRPM		(double defaultValue)		{ return getHow()->getDouble	(ATTRIBUTE_HOW_RPM, defaultValue);		}
-void		PolarScan::setRPM		(double val)			{        getHow()->set		(ATTRIBUTE_HOW_RPM, val);			}
+void		PolarScan::setRPM		(double val)			{ invalidateRayTable();        getHow()->set		(ATTRIBUTE_HOW_RPM, val);			}
 double		PolarScan::getPulseWidth	()				{ return getHow()->getDouble	(ATTRIBUTE_HOW_PULSEWIDTH, 0);			}
 double		PolarScan::getPulseWidth	(double defaultValue)		{ return getHow()->getDouble	(ATTRIBUTE_HOW_PULSEWIDTH, defaultValue);	}
 void		PolarScan::setPulseWidth	(double val)			{        getHow()->set		(ATTRIBUTE_HOW_PULSEWIDTH, val);		}
@@ -1563,23 +1867,23 @@ std::string		PolarScan::getBinMethod		()					{ return getHow()->getStr	(ATTRIBUT
 void			PolarScan::setBinMethod		(const std::string& val)		{        getHow()->set		(ATTRIBUTE_HOW_BINMETHOD, val);	}
 std::vector<double>	PolarScan::getElevationAngles	() 	{return getHow()->getSimpleArrayDouble(ATTRIBUTE_HOW_ELANGLES);  }
 //void			PolarScan::setElevationAngles	( std::vector<double>& val)	{   getHow()->setSimpleArray(ATTRIBUTE_HOW_ELANGLES, val);	}
-void			PolarScan::setElevationAngles	(const std::vector<double>& val)	{   getHow()->setSimpleArray(ATTRIBUTE_HOW_ELANGLES, val);	}
+void			PolarScan::setElevationAngles	(const std::vector<double>& val)	{   invalidateRayTable(); getHow()->setSimpleArray(ATTRIBUTE_HOW_ELANGLES, val);	}
 std::vector<double>	PolarScan::getStartAzimuthAngles()	{return getHow()->getSimpleArrayDouble(ATTRIBUTE_HOW_STARTAZA);  }
-void			PolarScan::setStartAzimuthAngles	(const std::vector<double>& val) {} 
+void			PolarScan::setStartAzimuthAngles	(const std::vector<double>& val) {   invalidateRayTable(); getHow()->setSimpleArray(ATTRIBUTE_HOW_STARTAZA, val);	} 
 
 //std::vector<Arotation>	Horizontal_Product_2D::getArotation		()  { return getHow()->getArotation(ATTRIBUTE_HOW_AROTATION); }
 std::vector<AZAngles>	PolarScan::getAzimuthAngles () {return getHow()->getAZAngles("dummy");}
-void			PolarScan::setAzimuthAngles  (const std::vector<AZAngles>&val, int precision) {getHow()->set("dummy", val, 5);	}
+void			PolarScan::setAzimuthAngles  (const std::vector<AZAngles>&val, int precision) {invalidateRayTable(); getHow()->set("dummy", val, 5);	}
 
 std::vector<double>	PolarScan::getStopAzimuthAngles	()	{return getHow()->getSimpleArrayDouble(ATTRIBUTE_HOW_STOPAZA);  }		
-void			PolarScan::setStopAzimuthAngles		(const std::vector<double>& val) {}
+void			PolarScan::setStopAzimuthAngles		(const std::vector<double>& val) {   invalidateRayTable(); getHow()->setSimpleArray(ATTRIBUTE_HOW_STOPAZA, val);	}
 std::vector<double>	PolarScan::getStartAzimuthTimes	()	{return getHow()->getSimpleArrayDouble(ATTRIBUTE_HOW_STARTAZT);  } 
-void			PolarScan::setStartAzimuthTimes		(const std::vector<double>& val) {}
+void			PolarScan::setStartAzimuthTimes		(const std::vector<double>& val) {   invalidateRayTable(); getHow()->setSimpleArray(ATTRIBUTE_HOW_STARTAZT, val);	}
 std::vector<double>	PolarScan::getStopAzimuthTimes	()	{return getHow()->getSimpleArrayDouble(ATTRIBUTE_HOW_STOPAZT);  }
-void			PolarScan::setStopAzimuthTimes		(const std::vector<double>& val) {}
+void			PolarScan::setStopAzimuthTimes		(const std::vector<double>& val) {   invalidateRayTable(); getHow()->setSimpleArray(ATTRIBUTE_HOW_STOPAZT, val);	}
 
 std::vector<AZTimes>	PolarScan::getAzimuthTimes () {return getHow()->getAZTimes("dummy");}
-void			PolarScan::setAzimuthTimes  (const std::vector<AZTimes>&val) {getHow()->set("dummy", val);	}
+void			PolarScan::setAzimuthTimes  (const std::vector<AZTimes>&val) {invalidateRayTable(); getHow()->set("dummy", val);	}
 
 
 double		PolarScan::getPointAccEl	()				{ return getHow()->getDouble	(ATTRIBUTE_HOW_POINTACCEL, 0);		}
@@ -1688,6 +1992,7 @@ PolarScanData*	PolarScan::getQuantityData(const std::string& name)
 
 PolarScanData*	PolarScan::getQuantityData(const char* name) 
 {		
+	TraceScope trace("object", "getQuantityData", name);
 	int dataCount = getDataCount();
 	for (int i=0; i<dataCount; i++)
 	{
@@ -1711,12 +2016,16 @@ PolarScanData*	PolarScan::getQuantityData(const char* name)
 
 PolarScanData*	PolarScan::getQuantityData(int index) 
 {
+	TraceScope trace("object", "getQuantityData", index);
 	H5::Group* h5group = getDataGroup(index);
 	try
 	{
-		if (h5group)
-			return  new PolarScanData(this, h5group);
-		return NULL;
+		if (!h5group)
+			return NULL;
+		PolarScanData* data = new PolarScanData(this, h5group);
+		if (trace.isActive())
+			trace.setDetail(traceDetail(*data));
+		return data;
 	}
 	catch (...)
 	{
@@ -1796,6 +2105,95 @@ int PolarScan::getQuantityDataIndex(const std::string& name)
 	return getQuantityDataIndex(name.c_str());
 }
 
+void PolarScan::invalidateRayTable()
+{
+	delete rayTable;
+	rayTable = NULL;
+	delete azimuthIndex;
+	azimuthIndex = NULL;
+}
+
+const RayTable& PolarScan::getRayTable()
+{
+	if (rayTable)
+		return *rayTable;
+
+	RayTable* table = new RayTable();
+	try
+	{
+		int numrays	= getNumRays();
+		table->resize(numrays);
+		table->a1gate	= getA1Gate();
+
+		const char* names[]	= { ATTRIBUTE_HOW_STARTAZA, ATTRIBUTE_HOW_STOPAZA, ATTRIBUTE_HOW_ELANGLES, ATTRIBUTE_HOW_STARTAZT, ATTRIBUTE_HOW_STOPAZT };
+		double* buffers[]	= { table->startAzimuth(), table->stopAzimuth(), table->elevation(), table->startTime(), table->stopTime() };
+		int found = numrays ? getHow()->getSimpleArrays(5, names, buffers, numrays) : 0;
+
+		table->hasAzimuthAngles		= (found & 0x03) == 0x03;
+		table->hasElevationAngles	= (found & 0x04) != 0;
+		table->hasAzimuthTimes		= (found & 0x18) == 0x18;
+
+		double* startaz	= table->startAzimuth();
+		double* stopaz	= table->stopAzimuth();
+		double* centre	= table->centreAzimuth();
+		double* elev	= table->elevation();
+		double* startT	= table->startTime();
+		double* stopT	= table->stopTime();
+		int*	index	= table->originalIndex();
+
+		/* rays are stored clockwise starting from north */
+		if (!table->hasAzimuthAngles)
+			for (int i=0; i<numrays; i++)
+			{
+				startaz[i]	= 360. * i / numrays;
+				stopaz[i]	= 360. * (i + 1) / numrays;
+			}
+		if (!table->hasElevationAngles)
+		{
+			double elangle = getEAngle();
+			for (int i=0; i<numrays; i++)
+				elev[i] = elangle;
+		}
+		if (!table->hasAzimuthTimes)
+			for (int i=0; i<numrays; i++)
+				startT[i] = stopT[i] = DOUBLE_NAN;
+
+		/* same rules of getDirection(), using the times already loaded */
+		double rpm = getRPM(0);
+		int direction = 1;
+		if (rpm)
+			direction = rpm > 0 ? 1 : -1;
+		else if (table->hasAzimuthTimes)
+			for (int i=0; i<(numrays-1); i++)
+				if (startT[i] > startT[i+1]) {
+					direction = -1;
+					break;
+				}
+		table->direction = direction;
+
+		for (int i=0; i<numrays; i++)
+		{
+			centre[i]	= AZAngles(startaz[i], stopaz[i]).averagedAngle(direction);
+			index[i]	= originaRayIndex(i, direction, numrays, table->a1gate);
+		}
+
+		rayTable = table;
+		return *rayTable;
+	}
+	catch (...)
+	{
+		delete table;
+		throw;
+	}
+}
+
+const AzimuthIndex& PolarScan::getAzimuthIndex()
+{
+	if (!azimuthIndex)
+		azimuthIndex = new AzimuthIndex(getRayTable());
+	return *azimuthIndex;
+}
+
 /*===========================================================================*/
 /* POLAR SCAN DATA */
 /*===========================================================================*/
@@ -1857,7 +2255,10 @@ int PolarScanData::getNumBins()
 
 void PolarScanData::readTranslatedData(RayMatrix<float>& matrix)
 {
-	H5::DataType	type	= this->getDataType();
+	TraceScope trace("data", "readTranslatedData");
+	if (trace.isActive())
+		trace.setDetail(traceDetail(*this));
+	RawType		type	= getRawType();
 	int		rays	= this->getNumRays();
 	int		bins	= this->getNumBins();
 	double		offset	= this->getOffset();
@@ -1865,26 +2266,29 @@ void PolarScanData::readTranslatedData(RayMatrix<float>& matrix)
 
 	matrix.resize(rays, bins);
 
-	if (type == H5::PredType::NATIVE_UINT8)
+	if (type == RAW_UINT8)
 	{
 		RayMatrix<unsigned char> rawmatrix(rays, bins);
 		readData(const_cast<unsigned char*>(rawmatrix.get()));
+		HDF5StatsScope stats(HDF5_STATS_TRANSLATE, (uint64_t)rays * bins);
 		for (int r=0; r<rays; r++)
 			for (int b=0; b<bins; b++)
 				matrix.elem(r,b) = (float)(((double)rawmatrix.elem(r,b)) * gain + offset);
 	}
-	else if (type == H5::PredType::NATIVE_UINT16)
+	else if (type == RAW_UINT16)
 	{
 		RayMatrix<unsigned short> rawmatrix(rays, bins);
 		readData(const_cast<unsigned short*>(rawmatrix.get()));
+		HDF5StatsScope stats(HDF5_STATS_TRANSLATE, (uint64_t)rays * bins);
 		for (int r=0; r<rays; r++)
 			for (int b=0; b<bins; b++)
 				matrix.elem(r,b) = (float)(((double)rawmatrix.elem(r,b)) * gain + offset);
 	}
-	else if (type == H5::PredType::NATIVE_FLOAT)
+	else if (type == RAW_FLOAT)
 	{
 		RayMatrix<float> rawmatrix(rays, bins);
 		readData(const_cast<float*>(rawmatrix.get()));
+		HDF5StatsScope stats(HDF5_STATS_TRANSLATE, (uint64_t)rays * bins);
 		for (int r=0; r<rays; r++)
 			for (int b=0; b<bins; b++)
 				matrix.elem(r,b) = (float)(((double)rawmatrix.elem(r,b)) * gain + offset);
@@ -1893,7 +2297,10 @@ void PolarScanData::readTranslatedData(RayMatrix<float>& matrix)
 
 void PolarScanData::readTranslatedData(RayMatrix<double>& matrix)
 {
-	H5::DataType	type	= this->getDataType();
+	TraceScope trace("data", "readTranslatedData");
+	if (trace.isActive())
+		trace.setDetail(traceDetail(*this));
+	RawType		type	= getRawType();
 	int		rays	= this->getNumRays();
 	int		bins	= this->getNumBins();
 	double		offset	= this->getOffset();
@@ -1901,32 +2308,56 @@ void PolarScanData::readTranslatedData(RayMatrix<double>& matrix)
 
 	matrix.resize(rays, bins);
 
-	if (type == H5::PredType::NATIVE_UINT8)
+	if (type == RAW_UINT8)
 	{
 		RayMatrix<unsigned char> rawmatrix(rays, bins);
 		readData(const_cast<unsigned char*>(rawmatrix.get()));
+		HDF5StatsScope stats(HDF5_STATS_TRANSLATE, (uint64_t)rays * bins);
 		for (int r=0; r<rays; r++)
 			for (int b=0; b<bins; b++)
 				matrix.elem(r,b) = ((double)rawmatrix.elem(r,b)) * gain + offset;
 	}
-	else if (type == H5::PredType::NATIVE_UINT16)
+	else if (type == RAW_UINT16)
 	{
 		RayMatrix<unsigned short> rawmatrix(rays, bins);
 		readData(const_cast<unsigned short*>(rawmatrix.get()));
+		HDF5StatsScope stats(HDF5_STATS_TRANSLATE, (uint64_t)rays * bins);
 		for (int r=0; r<rays; r++)
 			for (int b=0; b<bins; b++)
 				matrix.elem(r,b) = ((double)rawmatrix.elem(r,b)) * gain + offset;
 	}
-	else if (type == H5::PredType::NATIVE_FLOAT)
+	else if (type == RAW_FLOAT)
 	{
 		RayMatrix<float> rawmatrix(rays, bins);
 		readData(const_cast<float*>(rawmatrix.get()));
+		HDF5StatsScope stats(HDF5_STATS_TRANSLATE, (uint64_t)rays * bins);
 		for (int r=0; r<rays; r++)
 			for (int b=0; b<bins; b++)
 				matrix.elem(r,b) = ((double)rawmatrix.elem(r,b)) * gain + offset;
 	}
 }
 
+void PolarScanData::readTranslatedData(float* buffer, float nodataValue, float undetectValue)
+{
+	TraceScope trace("data", "readTranslatedData");
+	if (trace.isActive())
+		trace.setDetail(traceDetail(*this));
+	size_t	count		= (size_t)this->getNumRays() * this->getNumBins();
+	float	offset		= (float)this->getOffset();
+	float	gain		= (float)this->getGain();
+	float	nodata		= (float)this->getNodata();
+	float	undetect	= (float)this->getUndetect();
+
+	/* HDF5 converts integer raw values to float exactly */
+	readData(buffer, H5::PredType::NATIVE_FLOAT);
+	HDF5StatsScope stats(HDF5_STATS_TRANSLATE, count);
+	for (size_t i=0; i<count; i++)
+	{
+		float raw = buffer[i];
+		buffer[i] = (raw == nodata) ? nodataValue : (raw == undetect) ? undetectValue : raw * gain + offset;
+	}
+}
+
 /*===========================================================================*/
 
 /* converte la matrice src nella matrice dst traducendo i valori in base a gain e offset */
@@ -1935,6 +2366,7 @@ static void translate(RayMatrix<SRCTYPE>& src, RayMatrix<DSTTYPE>& dst, SRCTYPE
 {
 	int rows = src.getRayCount();
 	int cols = src.getBinCount();
+	HDF5StatsScope stats(HDF5_STATS_TRANSLATE, (uint64_t)rows * cols);
 	dst.resize(rows,cols);
 	for (int i=0; i<rows; i++)
 		for (int j=0; j<cols; j++)
@@ -1943,25 +2375,29 @@ static void translate(RayMatrix<SRCTYPE>& src, RayMatrix<DSTTYPE>& dst, SRCTYPE
 
 void PolarScanData::writeAndTranslate(RayMatrix<float>& matrix, float offset, float gain, H5::DataType bintype)
 {
-	if (bintype == H5::PredType::NATIVE_INT8)
+	TraceScope trace("data", "writeAndTranslate");
+	if (trace.isActive())
+		trace.setDetail(traceDetail(*this));
+	RawType type = OdimH5v21::getRawType(bintype);
+	if (type == RAW_INT8)
 	{
 		RayMatrix<char> matrix2;
 		translate<float, char>(matrix, matrix2, offset, gain);	
 		writeData(matrix2);
 	}
-	else if (bintype == H5::PredType::NATIVE_UINT8)
+	else if (type == RAW_UINT8)
 	{
 		RayMatrix<unsigned char> matrix2;
 		translate<float, unsigned char>(matrix, matrix2, offset, gain);	
 		writeData(matrix2);
 	}
-	else if (bintype == H5::PredType::NATIVE_UINT16)
+	else if (type == RAW_UINT16)
 	{
 		RayMatrix<unsigned short> matrix2;
 		translate<float, unsigned short>(matrix, matrix2, offset, gain);	
 		writeData(matrix2);
 	}
-	else if (bintype == H5::PredType::NATIVE_FLOAT)
+	else if (type == RAW_FLOAT)
 	{
 		RayMatrix<float> matrix2;
 		translate<float, float>(matrix, matrix2, offset, gain);	
@@ -1975,25 +2411,29 @@ void PolarScanData::writeAndTranslate(RayMatrix<float>& matrix, float offset, fl
 
 void PolarScanData::writeAndTranslate(RayMatrix<double>& matrix, double offset, double gain, H5::DataType bintype)
 {
-	if (bintype == H5::PredType::NATIVE_INT8)
+	TraceScope trace("data", "writeAndTranslate");
+	if (trace.isActive())
+		trace.setDetail(traceDetail(*this));
+	RawType type = OdimH5v21::getRawType(bintype);
+	if (type == RAW_INT8)
 	{
 		RayMatrix<char> matrix2;
 		translate<double, char>(matrix, matrix2, offset, gain);	
 		writeData(matrix2);
 	}
-	if (bintype == H5::PredType::NATIVE_UINT8)
+	if (type == RAW_UINT8)
 	{
 		RayMatrix<unsigned char> matrix2;
 		translate<double, unsigned char>(matrix, matrix2, offset, gain);	
 		writeData(matrix2);
 	}
-	else if (bintype == H5::PredType::NATIVE_UINT16)
+	else if (type == RAW_UINT16)
 	{
 		RayMatrix<unsigned short> matrix2;
 		translate<double, unsigned short>(matrix, matrix2, offset, gain);	
 		writeData(matrix2);
 	}
-	else if (bintype == H5::PredType::NATIVE_FLOAT)
+	else if (type == RAW_FLOAT)
 	{
 		RayMatrix<float> matrix2;
 		translate<double, float>(matrix, matrix2, offset, gain);	
@@ -2375,6 +2815,7 @@ Product_HSP* Object_2D::createProductHSP()
 
 Product_2D* Object_2D::getProduct(int index) 
 {
+	TraceScope trace("object", "getProduct", index);
 	H5::Group* h5group1 = NULL;
 	H5::Group* h5group2 = NULL;
 	try
@@ -2653,6 +3094,47 @@ void	CompObject::checkMandatoryInformations()
 /*-----------------------------------------------------------
 ----------------------------*/
 
+/*===========================================================================*/
+/* CVOL Object*/
+/*===========================================================================*/
+
+CvolObject::CvolObject(H5::H5File* file)
+:HorizontalObject_2D(file)
+{		
+
+}	
+
+CvolObject::~CvolObject() {}
+
+void	CvolObject::setMandatoryInformations()
+{			
+	OdimObject::setMandatoryInformations();
+	setObject	(OdimH5v21::OBJECT_CVOL);
+	setVersion	(ModelVersion(2,1).toString());
+	setDateTime	(Radar::timeutils::getUTC());
+	setSource	(SourceInfo().setComment(""));
+}
+
+void	CvolObject::checkMandatoryInformations()
+{
+	OdimObject::checkMandatoryInformations();
+    checkVersion(this);
+
+	std::string object = this->getObject();
+	if (object != OdimH5v21::OBJECT_CVOL)
+		throw OdimH5FormatException(std::string("OdimH5 object is not ") + OdimH5v21::OBJECT_CVOL);	
+
+	time_t datetime = this->getDateTime();
+	if (datetime == (time_t)-1)
+		throw OdimH5FormatException("OdimH5 object date/time is not set");	
+	
+	SourceInfo source = this->getSource();
+	if (source.toString().empty())
+		throw OdimH5FormatException("OdimH5 object source is not set");	
+}
+/*-----------------------------------------------------------
+----------------------------*/
+
 /*===========================================================================*/
 /* XSEC Object*/
 /*===========================================================================*/
@@ -2818,15 +3300,15 @@ void			Product_2D::setBinMethod		(const std::string& val)		{        getHow()->se
 
 std::vector<double>	Product_2D::getElevationAngles	() 	{return getHow()->getSimpleArrayDouble(ATTRIBUTE_HOW_ELANGLES);  }
 //void			Product_2D::setElevationAngles	( std::vector<double>& val)	{   ;	}
-void			Product_2D::setElevationAngles	(const std::vector<double>& val)	{   ;	}
+void			Product_2D::setElevationAngles	(const std::vector<double>& val)	{   getHow()->setSimpleArray(ATTRIBUTE_HOW_ELANGLES, val);	}
 std::vector<double>	Product_2D::getStartAzimuthAngles()	{return getHow()->getSimpleArrayDouble(ATTRIBUTE_HOW_STARTAZA);  }
-void			Product_2D::setStartAzimuthAngles	(const std::vector<double>& val) {} 
+void			Product_2D::setStartAzimuthAngles	(const std::vector<double>& val) {   getHow()->setSimpleArray(ATTRIBUTE_HOW_STARTAZA, val);	} 
 std::vector<double>	Product_2D::getStopAzimuthAngles	()	{return getHow()->getSimpleArrayDouble(ATTRIBUTE_HOW_STOPAZA);  }				 
-void			Product_2D::setStopAzimuthAngles		(const std::vector<double>& val) {}
+void			Product_2D::setStopAzimuthAngles		(const std::vector<double>& val) {   getHow()->setSimpleArray(ATTRIBUTE_HOW_STOPAZA, val);	}
 std::vector<double>	Product_2D::getStartAzimuthTimes	()	{return getHow()->getSimpleArrayDouble(ATTRIBUTE_HOW_STARTAZT);  }				 
-void			Product_2D::setStartAzimuthTimes		(const std::vector<double>& val) {}
+void			Product_2D::setStartAzimuthTimes		(const std::vector<double>& val) {   getHow()->setSimpleArray(ATTRIBUTE_HOW_STARTAZT, val);	}
 std::vector<double>	Product_2D::getStopAzimuthTimes	()	{return getHow()->getSimpleArrayDouble(ATTRIBUTE_HOW_STOPAZT);  }				 
-void			Product_2D::setStopAzimuthTimes		(const std::vector<double>& val) {}
+void			Product_2D::setStopAzimuthTimes		(const std::vector<double>& val) {   getHow()->setSimpleArray(ATTRIBUTE_HOW_STOPAZT, val);	}
 
 double		Product_2D::getPointAccEl	()				{ return getHow()->getDouble	(ATTRIBUTE_HOW_POINTACCEL, 0);		}
 void		Product_2D::setPointAccEl	(double val)			{        getHow()->set		(ATTRIBUTE_HOW_POINTACCEL, val);	}
@@ -3045,12 +3527,16 @@ std::set<std::string> Product_2D::getStoredQuantities()
 
 Product_2D_Data*	Product_2D::getQuantityData(int index) 
 {
+	TraceScope trace("object", "getQuantityData", index);
 	H5::Group* h5group = getDataGroup(index);
 	try
 	{
-		if (h5group)
-			return  new Product_2D_Data(this, h5group);
-		return NULL;
+		if (!h5group)
+			return NULL;
+		Product_2D_Data* data = new Product_2D_Data(this, h5group);
+		if (trace.isActive())
+			trace.setDetail(traceDetail(*data));
+		return data;
 	}
 	catch (...)
 	{
@@ -3066,6 +3552,7 @@ Product_2D_Data*	Product_2D::getQuantityData(const std::string& name)
 
 Product_2D_Data*	Product_2D::getQuantityData(const char* name) 
 {		
+	TraceScope trace("object", "getQuantityData", name);
 	int dataCount = getDataCount();
 	for (int i=0; i<dataCount; i++)
 	{
@@ -3534,7 +4021,10 @@ int Product_2D_Data::getNumXElem()
 
 void Product_2D_Data::readTranslatedData(DataMatrix<float>& matrix)
 {
-	H5::DataType	type	= this->getDataType();
+	TraceScope trace("data", "readTranslatedData");
+	if (trace.isActive())
+		trace.setDetail(traceDetail(*this));
+	RawType		type	= getRawType();
 	int		ysize	= this->getNumYElem();
 	int		xsize	= this->getNumXElem();
 	double		offset	= this->getOffset();
@@ -3542,26 +4032,29 @@ void Product_2D_Data::readTranslatedData(DataMatrix<float>& matrix)
 
 	matrix.resize(ysize, xsize);
 
-	if (type == H5::PredType::NATIVE_UINT8)
+	if (type == RAW_UINT8)
 	{
 		DataMatrix<unsigned char> rawmatrix(ysize, xsize);
 		readData(const_cast<unsigned char*>(rawmatrix.get()));
+		HDF5StatsScope stats(HDF5_STATS_TRANSLATE, (uint64_t)ysize * xsize);
 		for (int r=0; r<ysize; r++)
 			for (int b=0; b<xsize; b++)
 				matrix.elem(r,b) = (float)(((double)rawmatrix.elem(r,b)) * gain + offset);
 	}
-	else if (type == H5::PredType::NATIVE_UINT16)
+	else if (type == RAW_UINT16)
 	{
 		DataMatrix<unsigned short> rawmatrix(ysize, xsize);
 		readData(const_cast<unsigned short*>(rawmatrix.get()));
+		HDF5StatsScope stats(HDF5_STATS_TRANSLATE, (uint64_t)ysize * xsize);
 		for (int r=0; r<ysize; r++)
 			for (int b=0; b<xsize; b++)
 				matrix.elem(r,b) = (float)(((double)rawmatrix.elem(r,b)) * gain + offset);
 	}
-	else if (type == H5::PredType::NATIVE_FLOAT)
+	else if (type == RAW_FLOAT)
 	{
 		DataMatrix<float> rawmatrix(ysize, xsize);
 		readData(const_cast<float*>(rawmatrix.get()));
+		HDF5StatsScope stats(HDF5_STATS_TRANSLATE, (uint64_t)ysize * xsize);
 		for (int r=0; r<ysize; r++)
 			for (int b=0; b<xsize; b++)
 				matrix.elem(r,b) = (float)(((double)rawmatrix.elem(r,b)) * gain + offset);
@@ -3570,7 +4063,10 @@ void Product_2D_Data::readTranslatedData(DataMatrix<float>& matrix)
 
 void Product_2D_Data::readTranslatedData(DataMatrix<double>& matrix)
 {
-	H5::DataType	type	= this->getDataType();
+	TraceScope trace("data", "readTranslatedData");
+	if (trace.isActive())
+		trace.setDetail(traceDetail(*this));
+	RawType		type	= getRawType();
 	int		ysize	= this->getNumYElem();
 	int		xsize	= this->getNumXElem();
 	double		offset	= this->getOffset();
@@ -3578,32 +4074,56 @@ void Product_2D_Data::readTranslatedData(DataMatrix<double>& matrix)
 
 	matrix.resize(ysize,xsize);
 
-	if (type == H5::PredType::NATIVE_UINT8)
+	if (type == RAW_UINT8)
 	{
 		DataMatrix<unsigned char> rawmatrix(ysize,xsize);
 		readData(const_cast<unsigned char*>(rawmatrix.get()));
+		HDF5StatsScope stats(HDF5_STATS_TRANSLATE, (uint64_t)ysize * xsize);
 		for (int r=0; r<ysize; r++)
 			for (int b=0; b<xsize; b++)
 				matrix.elem(r,b) = ((double)rawmatrix.elem(r,b)) * gain + offset;
 	}
-	else if (type == H5::PredType::NATIVE_UINT16)
+	else if (type == RAW_UINT16)
 	{
 		DataMatrix<unsigned short> rawmatrix(ysize, xsize);
 		readData(const_cast<unsigned short*>(rawmatrix.get()));
+		HDF5StatsScope stats(HDF5_STATS_TRANSLATE, (uint64_t)ysize * xsize);
 		for (int r=0; r<ysize; r++)
 			for (int b=0; b<xsize; b++)
 				matrix.elem(r,b) = ((double)rawmatrix.elem(r,b)) * gain + offset;
 	}
-	else if (type == H5::PredType::NATIVE_FLOAT)
+	else if (type == RAW_FLOAT)
 	{
 		DataMatrix<float> rawmatrix(ysize,xsize);
 		readData(const_cast<float*>(rawmatrix.get()));
+		HDF5StatsScope stats(HDF5_STATS_TRANSLATE, (uint64_t)ysize * xsize);
 		for (int r=0; r<ysize; r++)
 			for (int b=0; b<xsize; b++)
 				matrix.elem(r,b) = ((double)rawmatrix.elem(r,b)) * gain + offset;
 	}
 }
 
+void Product_2D_Data::readTranslatedData(float* buffer, float nodataValue, float undetectValue)
+{
+	TraceScope trace("data", "readTranslatedData");
+	if (trace.isActive())
+		trace.setDetail(traceDetail(*this));
+	size_t	count		= (size_t)this->getNumXElem() * this->getNumYElem();
+	float	offset		= (float)this->getOffset();
+	float	gain		= (float)this->getGain();
+	float	nodata		= (float)this->getNodata();
+	float	undetect	= (float)this->getUndetect();
+
+	/* HDF5 converts integer raw values to float exactly */
+	readData(buffer, H5::PredType::NATIVE_FLOAT);
+	HDF5StatsScope stats(HDF5_STATS_TRANSLATE, count);
+	for (size_t i=0; i<count; i++)
+	{
+		float raw = buffer[i];
+		buffer[i] = (raw == nodata) ? nodataValue : (raw == undetect) ? undetectValue : raw * gain + offset;
+	}
+}
+
 /*===========================================================================*/
 
 /* converte la matrice src nella matrice dst traducendo i valori in base a gain e offset */
@@ -3612,6 +4132,7 @@ static void translate(DataMatrix<SRCTYPE>& src, DataMatrix<DSTTYPE>& dst, SRCTYP
 {
 	int rows = src.getRowCount();
 	int cols = src.getColCount();
+	HDF5StatsScope stats(HDF5_STATS_TRANSLATE, (uint64_t)rows * cols);
 	dst.resize(rows,cols);
 	for (int i=0; i<rows; i++)
 		for (int j=0; j<cols; j++)
@@ -3620,25 +4141,29 @@ static void translate(DataMatrix<SRCTYPE>& src, DataMatrix<DSTTYPE>& dst, SRCTYP
 
 void Product_2D_Data::writeAndTranslate(DataMatrix<float>& matrix, float offset, float gain, H5::DataType bintype)
 {
-	if (bintype == H5::PredType::NATIVE_INT8)
+	TraceScope trace("data", "writeAndTranslate");
+	if (trace.isActive())
+		trace.setDetail(traceDetail(*this));
+	RawType type = OdimH5v21::getRawType(bintype);
+	if (type == RAW_INT8)
 	{
 		DataMatrix<char> matrix2;
 		translate<float, char>(matrix, matrix2, offset, gain);	
 		writeData(matrix2);
 	}
-	else if (bintype == H5::PredType::NATIVE_UINT8)
+	else if (type == RAW_UINT8)
 	{
 		DataMatrix<unsigned char> matrix2;
 		translate<float, unsigned char>(matrix, matrix2, offset, gain);	
 		writeData(matrix2);
 	}
-	else if (bintype == H5::PredType::NATIVE_UINT16)
+	else if (type == RAW_UINT16)
 	{
 		DataMatrix<unsigned short> matrix2;
 		translate<float, unsigned short>(matrix, matrix2, offset, gain);	
 		writeData(matrix2);
 	}
-	else if (bintype == H5::PredType::NATIVE_FLOAT)
+	else if (type == RAW_FLOAT)
 	{
 		DataMatrix<float> matrix2;
 		translate<float, float>(matrix, matrix2, offset, gain);	
@@ -3652,25 +4177,29 @@ void Product_2D_Data::writeAndTranslate(DataMatrix<float>& matrix, float offset,
 
 void Product_2D_Data::writeAndTranslate(DataMatrix<double>& matrix, double offset, double gain, H5::DataType bintype)
 {
-	if (bintype == H5::PredType::NATIVE_INT8)
+	TraceScope trace("data", "writeAndTranslate");
+	if (trace.isActive())
+		trace.setDetail(traceDetail(*this));
+	RawType type = OdimH5v21::getRawType(bintype);
+	if (type == RAW_INT8)
 	{
 		DataMatrix<char> matrix2;
 		translate<double, char>(matrix, matrix2, offset, gain);	
 		writeData(matrix2);
 	}
-	if (bintype == H5::PredType::NATIVE_UINT8)
+	if (type == RAW_UINT8)
 	{
 		DataMatrix<unsigned char> matrix2;
 		translate<double, unsigned char>(matrix, matrix2, offset, gain);	
 		writeData(matrix2);
 	}
-	else if (bintype == H5::PredType::NATIVE_UINT16)
+	else if (type == RAW_UINT16)
 	{
 		DataMatrix<unsigned short> matrix2;
 		translate<double, unsigned short>(matrix, matrix2, offset, gain);	
 		writeData(matrix2);
 	}
-	else if (bintype == H5::PredType::NATIVE_FLOAT)
+	else if (type == RAW_FLOAT)
 	{
 		DataMatrix<float> matrix2;
 		translate<double, float>(matrix, matrix2, offset, gain);	
@@ -56,6 +56,7 @@ class Object_2D;
 class HorizontalObject_2D; 
 class ImageObject; 
 class CompObject; 
+class CvolObject; 
 class XsecObject; 
 class Product_2D;
 class Horizontal_Product_2D;
@@ -480,6 +481,14 @@ public:
 	 * \throws OdimH5UnsupportedException	if the dataset type cannot be converted to an atomic type 
 	 */ 
 	virtual H5::AtomType	getDataType(); 
+	/*!  
+	 * \brief Get the raw type of the elements of the HDF5 dataset contained inside this 'data' group 
+	 * 
+	 * As getDataType(), without leaving HDF5 objects to the caller. \n 
+	 * RAW_OTHER is returned for the types not handled by the library and if the HDF5 dataset is not present. 
+	 * \throws OdimH5Exception		if an unexpected error occurs 
+	 */ 
+	virtual RawType		getRawType(); 
 	/*!  
 	 * \brief Get the width (cols num) of the matrix associated to this data group 
 	 * 
@@ -511,6 +520,30 @@ public:
 	 * \throws OdimH5Exception		if an unexpected error occurs 
 	 */ 
 	virtual void		writeData(const void* buff,		int width, int height, const H5::DataType& elemtype); 
+	/*!  
+	 * \brief Write data to the matrix associated to this 'data' group with the given compression 
+	 * 
+	 * As writeData(buff, width, height, elemtype), with the given deflate level instead of the default 6. \n 
+	 * \param compression			deflate level from 1 to 9, 0 to store the matrix uncompressed 
+	 * \throws OdimH5Exception		if an unexpected error occurs 
+	 */ 
+	virtual void		writeData(const void* buff,		int width, int height, const H5::DataType& elemtype, int compression); 
+	/*!  
+	 * \brief Write data to the matrix associated to this 'data' group from a buffer of the given raw type 
+	 * 
+	 * As writeData(buff, width, height, elemtype), converting the raw type with HDF5 locked. \n 
+	 * \throws OdimH5Exception		if an unexpected error occurs 
+	 * \throws OdimH5UnsupportedException	if the raw type is RAW_OTHER 
+	 */ 
+	virtual void		writeData(const void* buff,		int width, int height, RawType elemtype); 
+	/*!  
+	 * \brief Write data to the matrix associated to this 'data' group from a buffer of the given raw type with the given compression 
+	 * 
+	 * \param compression			deflate level from 1 to 9, 0 to store the matrix uncompressed 
+	 * \throws OdimH5Exception		if an unexpected error occurs 
+	 * \throws OdimH5UnsupportedException	if the raw type is RAW_OTHER 
+	 */ 
+	virtual void		writeData(const void* buff,		int width, int height, RawType elemtype, int compression); 
 	/*!  
 	 * \brief Write data to the matrix associated to this 'data' group 
 	 * 
@@ -598,6 +631,25 @@ public:
 	 * \throws OdimH5Exception		if an unexpected error occurs 
 	 */ 
 	virtual void		readData(void* buffer); 
+	/*!  
+	 * \brief Read data from the dataset of this 'data' group converting it to the given memory type 
+	 * 
+	 * Read data from the dataset of this 'data' group into the given buffer, letting HDF5 convert the values. \n 
+	 * The minimum size in byte of the buffer is (getDataWidth() x getDataHeight() x memtype.getSize()). \n 
+	 * \param buffer			the buffer to store the loaded data 
+	 * \param memtype			the type of the elements in the buffer 
+	 * \throws OdimH5Exception		if an unexpected error occurs 
+	 */ 
+	virtual void		readData(void* buffer, const H5::DataType& memtype); 
+	/*!  
+	 * \brief Read data from the dataset of this 'data' group converting it to the given raw type 
+	 * 
+	 * As readData(buffer, memtype), converting the raw type with HDF5 locked. \n 
+	 * The minimum size in byte of the buffer is (getDataWidth() x getDataHeight() x getRawSize(memtype)). \n 
+	 * \throws OdimH5Exception		if an unexpected error occurs 
+	 * \throws OdimH5UnsupportedException	if the raw type is RAW_OTHER 
+	 */ 
+	virtual void		readData(void* buffer, RawType memtype); 
 	/*!  
 	 * \brief Get the number of 'quality' groups inside this data group 
 	 * 
@@ -849,6 +901,16 @@ public:
 	 * \throws OdimH5Exception		if an unexpected error occurs 
 	 */ 
 	virtual void		readQuality(void* buffer); 
+	/*!  
+	 * \brief Read data from the dataset of this 'quality' group converting it to the given raw type 
+	 * 
+	 * The minimum size in byte of the buffer is (getQualityWidth() x getQualityHeight() x getRawSize(memtype)). \n 
+	 * \param buffer			the buffer to store the loaded data 
+	 * \param memtype			the type of the elements in the buffer 
+	 * \throws OdimH5Exception		if an unexpected error occurs 
+	 * \throws OdimH5UnsupportedException	if the raw type is RAW_OTHER 
+	 */ 
+	virtual void		readQuality(void* buffer, RawType memtype); 
  
 protected: 
 	H5::Group*	group;		 
@@ -998,6 +1060,21 @@ public:
 	 * \throws OdimH5Exception	Throwed if an error occurs 
 	 */ 
 	virtual std::set<std::string>	getStoredQuantities(); 
+	/*! 
+	 * \brief Read the physical values of a quantity from every scan in a single cube 
+	 *  
+	 * Scans containing the quantity are stored by increasing elevation, together with their shape and geometry. \n 
+	 * Raw data are read by the calling thread, then they are translated and copied in place by a pool of threads. \n 
+	 * When northAligned is true ray i of each scan is the one covering the centre of the i-th sector 
+	 * clockwise from north, as found by PolarScan::getAzimuthIndex(); sectors not covered by any ray are NaN. \n 
+	 * \param quantity		The quantity name 
+	 * \param cube			The destination cube, resized to fit the scans 
+	 * \param northAligned		Reorder rays by azimuth instead of keeping the stored order 
+	 * \param threads		Number of threads used to translate the values, 0 for one thread per core 
+	 * \throws OdimH5Exception	Throwed if no scan contains the quantity or an error occurs 
+	 * \see PolarCube 
+	 */ 
+	virtual void		readCube		(const std::string& quantity, PolarCube& cube, bool northAligned = false, int threads = 0); 
  
 protected: 
 	/* uses cannot directly create OdimH5 objects, only factories provide functions to do it */ 
@@ -1338,9 +1415,35 @@ public:
 			return ((numrays + a1gate) - index) % numrays; 
 		} 
 	} 
+	/*! 
+	 * \brief Get the per-ray geometry of the scan 
+	 *  
+	 * Load start/stop/centre azimuth, elevation, start/stop time and original ray index of every ray. \n 
+	 * The how/ arrays are read with a single traversal of the how group. \n 
+	 * The table is cached inside this object and reloaded only after a setter changes the values it depends on. \n 
+	 * Only the setters of this object invalidate the cache: values written through another PolarScan \n 
+	 * on the same group are not seen until the scan is obtained again from the volume. \n 
+	 * \returns			A reference to the cached table, valid until this object is deleted 
+	 * \throws OdimH5Exception	Throwed if an error occurs 
+	 * \see RayTable 
+	 */ 
+	const RayTable&		getRayTable		(); 
+	/*! 
+	 * \brief Get the azimuth to ray lookup index of the scan 
+	 *  
+	 * The index is built from getRayTable() and cached together with it. \n 
+	 * \returns			A reference to the cached index, valid until this object is deleted 
+	 * \throws OdimH5Exception	Throwed if an error occurs 
+	 * \see AzimuthIndex 
+	 */ 
+	const AzimuthIndex&	getAzimuthIndex		(); 
  
 private: 
 	PolarVolume*		volume; 
+	RayTable*		rayTable; 
+	AzimuthIndex*		azimuthIndex; 
+
+	void			invalidateRayTable	(); 
  
 	/* uses cannot directly create OdimH5 objects, only factories provide functions to do it */ 
 	friend class PolarVolume; 
@@ -1427,6 +1530,17 @@ public:
 	 * \throws OdimH5Exception	Throwed if an error occurs 
 	 */ 
 	virtual void		readTranslatedData(RayMatrix<double>& matrix); 
+	/*! 
+	 * \brief Read the matrix data translating the values  
+	 *  
+	 * Read the matrix data translating the values using 'gain' and 'offset' attributes. \n 
+	 * Elements equal to 'nodata' and 'undetect' are not translated, the given values are stored instead. \n 
+	 * \param buffer		buffer of getNumRays() x getNumBins() elements, stored ray by ray 
+	 * \param nodataValue	value stored for 'nodata' elements 
+	 * \param undetectValue	value stored for 'undetect' elements 
+	 * \throws OdimH5Exception	Throwed if an error occurs 
+	 */ 
+	virtual void		readTranslatedData(float* buffer, float nodataValue, float undetectValue); 
 	/*! 
 	 * \brief Write the given matrix of data into the quantity matrix 
 	 *  
@@ -1809,6 +1923,34 @@ protected:
 	CompObject(H5::H5File* file); 
 };
 
+/*===========================================================================*/
+/* CVOL OBJECT  */
+/*===========================================================================*/
+/*! 
+ * \brief OdimH5 v2.1 CvolObject
+ * 
+ * \n This class represents an OdimH5 CVOL Object, a 3D cartesian volume. \n
+ * \n CVOL Object is specification of Horizontal Object: every level is a CAPPI or PCAPPI dataset 
+ * on the grid described by the root where/ group, with the level height as product parameter. \n
+ * 
+ * \n Generic data manipulations can be done using methods provided by the OdimObject interface. \n
+ * 
+ * \see Product_2D
+ */
+class RADAR_API CvolObject : public HorizontalObject_2D
+{
+public:
+	virtual ~CvolObject() ;
+
+        virtual void	setMandatoryInformations();
+	virtual void  	checkMandatoryInformations();
+
+protected:
+	/* uses cannot directly create OdimH5 objects, only factories provide functions to do it */
+	friend class OdimFactory;
+	CvolObject(H5::H5File* file); 
+};
+
 /*===========================================================================*/
 /* XSEC OBJECT  */
 /*===========================================================================*/
@@ -2793,6 +2935,17 @@ public:
 	 * \throws OdimH5Exception	Throwed if an error occurs 
 	 */ 
 	virtual void		readTranslatedData(DataMatrix<double>& matrix); 
+	/*! 
+	 * \brief Read the matrix data translating the values  
+	 *  
+	 * Read the matrix data translating the values using 'gain' and 'offset' attributes. \n 
+	 * Elements equal to 'nodata' and 'undetect' are not translated, the given values are stored instead. \n 
+	 * \param buffer		buffer of getNumYElem() x getNumXElem() elements, stored row by row 
+	 * \param nodataValue	value stored for 'nodata' elements 
+	 * \param undetectValue	value stored for 'undetect' elements 
+	 * \throws OdimH5Exception	Throwed if an error occurs 
+	 */ 
+	virtual void		readTranslatedData(float* buffer, float nodataValue, float undetectValue); 
 	/*! 
 	 * \brief Write the given matrix of data into the quantity matrix 
 	 *  
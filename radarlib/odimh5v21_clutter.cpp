@@ -0,0 +1,368 @@
+/*
+ * odimh5v21_clutter - ground clutter frequency maps from volume archives
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <radarlib/odimh5v21_clutter.hpp>
+#include <radarlib/odimh5v21_const.hpp>
+#include <radarlib/odimh5v21_exceptions.hpp>
+#include <radarlib/odimh5v21_factory.hpp>
+#include <radarlib/parallel.hpp>
+
+#include <cmath>
+#include <memory>
+
+namespace OdimH5v21 {
+namespace products {
+
+namespace {
+
+template <class T> void countGates(const T* raw, size_t count, float threshold, float nodata, float undetect,
+				   unsigned int* hits, unsigned int* valid)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		float v = (float)raw[i];
+		unsigned int observed = v != nodata;
+		valid[i] += observed;
+		hits[i] += observed & (v != undetect) & (v > threshold);
+	}
+}
+
+}
+
+struct ClutterMapBuilder::CountTask
+{
+	ClutterMapBuilder&	builder;
+	size_t			slots;
+
+	/*
+	 * Each block is one volume of the batch. forBlocks gives block b to worker
+	 * b % n, where n is slots or, with fewer volumes than slots, the number of
+	 * volumes (and then b < n): either way begin % slots is the worker. Workers
+	 * that could not be started run one after the other in the calling thread,
+	 * so two threads never use the same accumulators at the same time.
+	 */
+	void operator()(size_t begin, size_t end) const
+	{
+		std::vector<unsigned int>& hits = builder.threadHits[begin % slots];
+		std::vector<unsigned int>& valid = builder.threadValid[begin % slots];
+		for (size_t v = begin; v < end; ++v)
+		{
+			const std::vector<RawScan>& volume = builder.batch[v];
+			for (size_t s = 0; s < volume.size(); ++s)
+			{
+				const RawScan& scan = volume[s];
+				size_t first = builder.offsets[scan.scan];
+				size_t count = builder.offsets[scan.scan + 1] - first;
+				if (scan.bytes == 1)
+					countGates((const unsigned char*)&scan.raw[0], count, scan.threshold, scan.nodata, scan.undetect,
+						   &hits[first], &valid[first]);
+				else if (scan.bytes == 2)
+					countGates((const unsigned short*)&scan.raw[0], count, scan.threshold, scan.nodata, scan.undetect,
+						   &hits[first], &valid[first]);
+				else
+					countGates((const float*)&scan.raw[0], count, scan.threshold, scan.nodata, scan.undetect,
+						   &hits[first], &valid[first]);
+			}
+		}
+	}
+};
+
+struct ClutterMapBuilder::MergeTask
+{
+	ClutterMapBuilder&	builder;
+
+	void operator()(size_t begin, size_t end) const
+	{
+		for (size_t t = 0; t < builder.threadHits.size(); ++t)
+		{
+			std::vector<unsigned int>& hits = builder.threadHits[t];
+			std::vector<unsigned int>& valid = builder.threadValid[t];
+			if (hits.empty())
+				continue;
+			for (size_t i = begin; i < end; ++i)
+			{
+				builder.hits[i] += hits[i];
+				builder.valid[i] += valid[i];
+				hits[i] = valid[i] = 0;
+			}
+		}
+	}
+};
+
+ClutterMapBuilder::ClutterMapBuilder(double threshold, const std::string& quantity, int threads)
+	: threshold(threshold), quantity(quantity), threads(threads), elevationTolerance(0.1),
+	  volumes(0), start(0), end(0), source(), lon(0), lat(0), alt(0), failed(), scans(), offsets(),
+	  hits(), valid(), threadHits(), threadValid(), batch(), pending(0)
+{
+}
+
+void ClutterMapBuilder::setThreads(int val)
+{
+	count();
+	threads = val;
+}
+
+void ClutterMapBuilder::clear()
+{
+	volumes = 0;
+	start = end = 0;
+	source = SourceInfo();
+	failed.clear();
+	scans.clear();
+	offsets.clear();
+	std::vector<unsigned int>().swap(hits);
+	std::vector<unsigned int>().swap(valid);
+	threadHits.clear();
+	threadValid.clear();
+	batch.clear();
+	pending = 0;
+}
+
+void ClutterMapBuilder::read(PolarVolume& volume)
+{
+	/* the first volume defines the geometry, kept only if every read succeeds */
+	std::vector<ClutterMapScan> geometry(scans);
+	std::vector<RawScan> raws;
+	std::vector<bool> matched(scans.size(), false);
+
+	int count = volume.getScanCount();
+	for (int i = 0; i < count; ++i)
+	{
+		std::unique_ptr<PolarScan> scan(volume.getScan(i));
+		if (!scan->hasQuantityData(quantity))
+			continue;
+		double elangle = scan->getEAngle();
+		int nrays = scan->getNumRays();
+		int nbins = scan->getNumBins();
+
+		int index = -1;
+		if (scans.empty())
+		{
+			ClutterMapScan s = { elangle, nrays, nbins, scan->getRangeStart(), scan->getRangeScale(), 0 };
+			index = (int)geometry.size();
+			geometry.push_back(s);
+		}
+		else
+		{
+			double best = elevationTolerance;
+			for (size_t s = 0; s < scans.size(); ++s)
+				if (!matched[s] && scans[s].nrays == nrays && scans[s].nbins == nbins
+				    && fabs(scans[s].elangle - elangle) <= best)
+				{
+					best = fabs(scans[s].elangle - elangle);
+					index = (int)s;
+				}
+			if (index < 0)
+				continue;
+			matched[index] = true;
+		}
+
+		std::unique_ptr<PolarScanData> data(scan->getQuantityData(quantity));
+		if (data->getDataWidth() != nbins || data->getDataHeight() != nrays)
+			throw OdimH5FormatException("Size of quantity " + quantity + " does not match the scan size");
+		double gain = data->getGain();
+		if (!(gain > 0))
+			throw OdimH5FormatException("Gain of quantity " + quantity + " must be positive");
+
+		RawScan raw;
+		raw.scan = index;
+		RawType type = data->getRawType();
+		if (type == RAW_UINT8)
+			raw.bytes = 1;
+		else if (type == RAW_UINT16)
+			raw.bytes = 2;
+		else
+			raw.bytes = 4;
+		raw.threshold = (float)((threshold - data->getOffset()) / gain);
+		raw.nodata = (float)data->getNodata();
+		raw.undetect = (float)data->getUndetect();
+		raw.raw.resize((size_t)nrays * nbins * raw.bytes + 1);
+		if (raw.bytes == 1)
+			data->readData(&raw.raw[0], RAW_UINT8);
+		else if (raw.bytes == 2)
+			data->readData(&raw.raw[0], RAW_UINT16);
+		else
+			data->readData(&raw.raw[0], RAW_FLOAT);
+		raws.push_back(raw);
+	}
+
+	if (geometry.empty())
+		throw OdimH5Exception("No scan contains quantity " + quantity);
+
+	time_t time = volume.getDateTime();
+	if (scans.empty())
+	{
+		scans.swap(geometry);
+		offsets.assign(1, 0);
+		for (size_t s = 0; s < scans.size(); ++s)
+			offsets.push_back(offsets.back() + (size_t)scans[s].nrays * scans[s].nbins);
+		hits.assign(offsets.back(), 0);
+		valid.assign(offsets.back(), 0);
+		source = volume.getSource();
+		lon = volume.getLongitude();
+		lat = volume.getLatitude();
+		alt = volume.getAltitude();
+		start = end = time;
+	}
+	if (time < start)
+		start = time;
+	if (time > end)
+		end = time;
+	for (size_t s = 0; s < raws.size(); ++s)
+		++scans[raws[s].scan].volumes;
+	++volumes;
+
+	size_t slots = (size_t)Radar::parallel::threadCount(threads);
+	if (batch.size() < slots)
+		batch.resize(slots);
+	batch[pending++].swap(raws);
+	if (pending >= slots)
+		this->count();
+}
+
+void ClutterMapBuilder::count()
+{
+	if (pending == 0)
+		return;
+	size_t slots = (size_t)Radar::parallel::threadCount(threads);
+	if (threadHits.size() < slots)
+	{
+		threadHits.resize(slots);
+		threadValid.resize(slots);
+	}
+	/* only the accumulators of the threads that take part are allocated */
+	for (size_t t = 0; t < pending && t < slots; ++t)
+		if (threadHits[t].empty())
+		{
+			threadHits[t].assign(offsets.back(), 0);
+			threadValid[t].assign(offsets.back(), 0);
+		}
+
+	CountTask task = { *this, slots };
+	Radar::parallel::forBlocks(pending, 1, threads, task);
+	for (size_t v = 0; v < pending; ++v)
+		batch[v].clear();
+	pending = 0;
+}
+
+void ClutterMapBuilder::merge()
+{
+	count();
+	if (hits.empty())
+		return;
+	MergeTask task = { *this };
+	Radar::parallel::forBlocks(hits.size(), 65536, threads, task);
+}
+
+void ClutterMapBuilder::addVolume(PolarVolume& volume)
+{
+	read(volume);
+}
+
+void ClutterMapBuilder::addFile(const std::string& path)
+{
+	OdimFactory factory;
+	std::unique_ptr<OdimObject> object(factory.open(path));
+	PolarVolume* volume = dynamic_cast<PolarVolume*>(object.get());
+	if (volume == NULL)
+		throw OdimH5Exception(path + " is not a polar volume");
+	read(*volume);
+}
+
+int ClutterMapBuilder::addFiles(const std::vector<std::string>& paths)
+{
+	int before = volumes;
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		try
+		{
+			addFile(paths[i]);
+		}
+		catch (std::exception&)
+		{
+			failed.push_back(paths[i]);
+		}
+		catch (H5::Exception&)
+		{
+			failed.push_back(paths[i]);
+		}
+	}
+	return volumes - before;
+}
+
+void ClutterMapBuilder::getFrequency(int index, RayMatrix<float>& out)
+{
+	const ClutterMapScan& scan = scans.at(index);
+	merge();
+	out.resize(scan.nrays, scan.nbins);
+	float* values = &out.elem(0, 0);
+	size_t first = offsets[index];
+	size_t count = offsets[index + 1] - first;
+	for (size_t i = 0; i < count; ++i)
+	{
+		unsigned int n = valid[first + i];
+		values[i] = n ? (float)hits[first + i] / n : NODATA;
+	}
+}
+
+void ClutterMapBuilder::write(PolarVolume& volume, const Encoding& encoding)
+{
+	if (volumes == 0)
+		throw OdimH5Exception("No volume in the clutter map");
+
+	volume.setDateTime(end);
+	if (!source.toString().empty())
+		volume.setSource(source);
+	volume.setLongitude(lon);
+	volume.setLatitude(lat);
+	volume.setAltitude(alt);
+
+	RayMatrix<float> frequency;
+	std::vector<char> raw;
+	for (int s = 0; s < getScanCount(); ++s)
+	{
+		const ClutterMapScan& geometry = scans[s];
+		getFrequency(s, frequency);
+
+		std::unique_ptr<PolarScan> scan(volume.createScan());
+		scan->setEAngle(geometry.elangle);
+		scan->setA1Gate(0);
+		scan->setNumBins(geometry.nbins);
+		scan->setNumRays(geometry.nrays);
+		scan->setRangeStart(geometry.rstart);
+		scan->setRangeScale(geometry.rscale);
+		scan->setStartDateTime(start);
+		scan->setEndDateTime(end);
+
+		size_t count = (size_t)geometry.nrays * geometry.nbins;
+		raw.resize(count * getRawSize(encoding.rawtype) + 1);
+		encoding.encode(&frequency.elem(0, 0), count, &raw[0]);
+		std::unique_ptr<PolarScanData> data(scan->createQuantityData(PRODUCT_QUANTITY_CMAP));
+		encoding.writeTo(*data);
+		data->writeData(&raw[0], geometry.nbins, geometry.nrays, encoding.rawtype);
+	}
+}
+
+Encoding ClutterMapBuilder::defaultEncoding()
+{
+	return Encoding(RAW_UINT8, 0.004, 0., 255., 254.);
+}
+
+}
+}
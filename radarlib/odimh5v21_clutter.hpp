@@ -0,0 +1,192 @@
+/*
+ * odimh5v21_clutter - ground clutter frequency maps from volume archives
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef __RADAR_ODIMH5V21_CLUTTER_HPP__
+#define __RADAR_ODIMH5V21_CLUTTER_HPP__
+/*!
+ * \file
+ * \brief Ground clutter frequency maps built from archives of polar volumes
+ */
+
+#include <radarlib/odimh5v21_cartesian.hpp>
+
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace OdimH5v21 {
+namespace products {
+
+/*!
+ * \brief Geometry of a scan of a clutter map
+ */
+struct RADAR_API ClutterMapScan {
+	double	elangle;	/*!< elevation angle (deg) */
+	int	nrays;
+	int	nbins;
+	double	rstart;		/*!< range of the start of the first bin (km) */
+	double	rscale;		/*!< length of a bin (m) */
+	int	volumes;	/*!< number of volumes that had this scan */
+};
+
+/*!
+ * \brief Frequency of echoes above a threshold, per gate and elevation
+ *
+ * The scans of the first volume with the quantity define the geometry of the
+ * map; the scans of the following volumes are matched by elevation, within
+ * getElevationTolerance() degrees, and must have the same number of rays and
+ * bins. Scans without a match are ignored. \n
+ * For every gate the builder counts the volumes where the gate is not nodata
+ * and those where it is above the threshold: the frequency is their ratio,
+ * NODATA for gates never observed. \n
+ * The threshold is converted to the raw encoding of each scan, so values are
+ * compared as stored in the file, without decoding them. Files are read in
+ * the calling thread in batches of one volume per thread, then each thread
+ * counts its volume in its own accumulator. Accumulators are merged when the
+ * map is requested.
+ */
+class RADAR_API ClutterMapBuilder {
+ public:
+	/*!
+	 * \brief Create a builder
+	 * \param threshold	gates strictly above this value are clutter, in the units of the quantity
+	 * \param quantity	quantity of the scans
+	 * \param threads	number of threads, 0 for one thread per core
+	 */
+	ClutterMapBuilder(double threshold, const std::string& quantity = PRODUCT_QUANTITY_DBZH, int threads = 0);
+
+	double getThreshold() const			{ return threshold; }
+	const std::string& getQuantity() const		{ return quantity; }
+	void setThreads(int val);
+	int getThreads() const				{ return threads; }
+	/*!
+	 * \brief Largest difference (deg) between the elevations of matching scans, default 0.1
+	 */
+	void setElevationTolerance(double val)		{ elevationTolerance = val; }
+	double getElevationTolerance() const		{ return elevationTolerance; }
+
+	/*!
+	 * \brief Remove every volume and the geometry of the map
+	 */
+	void clear();
+
+	/*!
+	 * \brief Count the gates of a volume
+	 * \throws OdimH5FormatException	if the data of a scan has a gain that is not positive
+	 */
+	void addVolume(PolarVolume& volume);
+	/*!
+	 * \brief Open a volume file and count its gates
+	 */
+	void addFile(const std::string& path);
+	/*!
+	 * \brief Count the gates of a list of volume files
+	 *
+	 * Files that cannot be read or are not volumes are skipped and listed in
+	 * getFailedFiles().
+	 * \returns		the number of volumes counted
+	 */
+	int addFiles(const std::vector<std::string>& paths);
+
+	/*!
+	 * \brief Number of volumes counted
+	 */
+	int getVolumeCount() const			{ return volumes; }
+	/*!
+	 * \brief Files skipped by addFiles()
+	 */
+	const std::vector<std::string>& getFailedFiles() const	{ return failed; }
+	/*!
+	 * \brief Date and time of the first volume counted
+	 */
+	time_t getStartDateTime() const			{ return start; }
+	/*!
+	 * \brief Date and time of the last volume counted
+	 */
+	time_t getEndDateTime() const			{ return end; }
+	/*!
+	 * \brief Number of scans of the map
+	 */
+	int getScanCount() const			{ return (int)scans.size(); }
+	/*!
+	 * \brief Geometry of a scan of the map
+	 */
+	const ClutterMapScan& getScan(int index) const	{ return scans.at(index); }
+
+	/*!
+	 * \brief Frequency of the gates of a scan above the threshold
+	 * \param out		resized to the rays and bins of the scan
+	 */
+	void getFrequency(int index, RayMatrix<float>& out);
+
+	/*!
+	 * \brief Store the map in a polar volume
+	 *
+	 * Root what/ and where/ of the volume are set from the first volume counted,
+	 * the date and time is the one of the last. Every scan of the map is
+	 * stored as a scan with the period in startdate/enddate and a CMAP quantity
+	 * with the frequency.
+	 */
+	void write(PolarVolume& volume, const Encoding& encoding = defaultEncoding());
+
+	/*!
+	 * \brief 8 bit unsigned, gain 0.004, offset 0, nodata 255, undetect 254 (never used)
+	 */
+	static Encoding defaultEncoding();
+
+ private:
+	/* raw values of a scan of the map, as stored in the file */
+	struct RawScan {
+		int			scan;		/* index in the map */
+		int			bytes;		/* 1 for uint8, 2 for uint16, 4 for float */
+		float			threshold;	/* raw threshold */
+		float			nodata;
+		float			undetect;
+		std::vector<char>	raw;
+	};
+	struct CountTask;
+	struct MergeTask;
+
+	double				threshold;
+	std::string			quantity;
+	int				threads;
+	double				elevationTolerance;
+	int				volumes;
+	time_t				start, end;
+	SourceInfo			source;
+	double				lon, lat, alt;
+	std::vector<std::string>	failed;
+	std::vector<ClutterMapScan>	scans;
+	std::vector<size_t>		offsets;	/* first gate of each scan, plus the total */
+	std::vector<unsigned int>	hits;		/* merged counts */
+	std::vector<unsigned int>	valid;
+	std::vector<std::vector<unsigned int> >	threadHits;	/* one accumulator per thread */
+	std::vector<std::vector<unsigned int> >	threadValid;
+	std::vector<std::vector<RawScan> >	batch;		/* volumes read and not yet counted */
+	size_t				pending;
+
+	void read(PolarVolume& volume);
+	void count();
+	void merge();
+};
+
+}
+}
+
+#endif
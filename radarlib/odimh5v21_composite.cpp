@@ -0,0 +1,460 @@
+/*
+ * odimh5v21_composite - multi radar composites
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <radarlib/odimh5v21_composite.hpp>
+#include <radarlib/odimh5v21_geometry.hpp>
+#include <radarlib/odimh5v21_const.hpp>
+#include <radarlib/odimh5v21_exceptions.hpp>
+#include <radarlib/parallel.hpp>
+
+#include <cmath>
+#include <memory>
+#include <sstream>
+
+namespace OdimH5v21 {
+namespace products {
+
+namespace {
+
+const double DEG2RAD = M_PI / 180.;
+
+/* radar node of a source, falling back to the other identifiers */
+std::string nodeName(const SourceInfo& source)
+{
+	if (!source.OperaRadarNode.empty())	return source.OperaRadarNode;
+	if (!source.OperaRadarSite.empty())	return source.OperaRadarSite;
+	if (!source.WMO.empty())		return source.WMO;
+	return source.Place;
+}
+
+/* unit vector of a point on the earth: nearer points have greater dot products */
+void unitVector(double lat, double lon, double* v)
+{
+	v[0] = cos(lat * DEG2RAD) * cos(lon * DEG2RAD);
+	v[1] = cos(lat * DEG2RAD) * sin(lon * DEG2RAD);
+	v[2] = sin(lat * DEG2RAD);
+}
+
+/* nearest pixel of a cartesian product on a window of the composite grid */
+struct ResampleTask
+{
+	const CartesianGrid&	grid;
+	const Projection&	proj;
+	const CartesianGrid&	src;
+	const Projection&	srcproj;
+	int			row0, col0, cols;
+	const float*		values;
+	const float*		quality;
+	float*			outValues;
+	float*			outQuality;
+
+	void operator()(size_t begin, size_t end) const
+	{
+		for (size_t row = begin; row < end; ++row)
+		{
+			double y = grid.pixelY(row0 + (int)row);
+			for (int col = 0; col < cols; ++col)
+			{
+				size_t i = row * cols + col;
+				double lat, lon, sx, sy;
+				proj.inverse(grid.pixelX(col0 + col), y, lat, lon);
+				srcproj.forward(lat, lon, sx, sy);
+				double c = floor((sx - src.ulx) / src.xscale);
+				double r = floor((src.uly - sy) / src.yscale);
+				if (c < 0 || r < 0 || c >= src.xsize || r >= src.ysize)
+				{
+					outValues[i] = NODATA;
+					if (outQuality) outQuality[i] = NODATA;
+					continue;
+				}
+				size_t s = (size_t)r * src.xsize + (size_t)c;
+				outValues[i] = values[s];
+				if (outQuality) outQuality[i] = quality[s];
+			}
+		}
+	}
+};
+
+}
+
+/*===========================================================================*/
+/* COMPOSITOR */
+/*===========================================================================*/
+
+Compositor::Compositor(const CartesianGrid& grid, CompositeRule rule, int threads)
+	: grid(grid), rule(rule), threads(threads), tileSize(64), defaultQuality(0.f),
+	  qualityEncoding(RAW_UINT8, 0.004, 0., 255., 254.), inputs()
+{
+	/* fail early on unsupported projections */
+	Projection check(grid.projdef);
+}
+
+std::vector<Nodes> Compositor::getNodes() const
+{
+	std::vector<Nodes> result;
+	for (size_t i = 0; i < inputs.size(); ++i)
+		if (!inputs[i].node.empty())
+			result.push_back(Nodes(inputs[i].node));
+	return result;
+}
+
+bool Compositor::setWindow(Input& input, const std::vector<double>& lats, const std::vector<double>& lons)
+{
+	Projection proj(grid.projdef);
+	double mincol = 0, maxcol = -1, minrow = 0, maxrow = -1;
+	for (size_t i = 0; i < lats.size(); ++i)
+	{
+		double x, y;
+		proj.forward(lats[i], lons[i], x, y);
+		double col = (x - grid.ulx) / grid.xscale;
+		double row = (grid.uly - y) / grid.yscale;
+		if (col != col || row != row)
+			continue;
+		if (maxcol < mincol)
+		{
+			mincol = maxcol = col;
+			minrow = maxrow = row;
+			continue;
+		}
+		if (col < mincol) mincol = col;
+		if (col > maxcol) maxcol = col;
+		if (row < minrow) minrow = row;
+		if (row > maxrow) maxrow = row;
+	}
+	if (maxcol < mincol)
+		return false;
+
+	/* one pixel of margin, the boundary is sampled */
+	double col0 = floor(mincol) - 1, col1 = ceil(maxcol) + 1;
+	double row0 = floor(minrow) - 1, row1 = ceil(maxrow) + 1;
+	if (col0 < 0) col0 = 0;
+	if (row0 < 0) row0 = 0;
+	if (col1 > grid.xsize) col1 = grid.xsize;
+	if (row1 > grid.ysize) row1 = grid.ysize;
+	if (col1 <= col0 || row1 <= row0)
+		return false;
+	input.col0	= (int)col0;
+	input.row0	= (int)row0;
+	input.cols	= (int)(col1 - col0);
+	input.rows	= (int)(row1 - row0);
+	return true;
+}
+
+bool Compositor::addImage(HorizontalObject_2D& image, int dataset, const std::string& quantity)
+{
+	CartesianGrid src = CartesianGrid::readFrom(image);
+	Projection srcproj(src.projdef);
+
+	std::unique_ptr<Product_2D> product(image.getProduct(dataset));
+	if (product.get() == NULL)
+		throw OdimH5Exception("Dataset not found in the image");
+
+	Input input;
+	input.source	= image.getSource();
+	input.node	= nodeName(input.source);
+	input.datetime	= image.getDateTime();
+	input.start	= product->getStartDateTime();
+	input.end	= product->getEndDateTime();
+
+	double lat, lon;
+	srcproj.inverse(src.ulx + src.xsize * src.xscale * 0.5, src.uly - src.ysize * src.yscale * 0.5, lat, lon);
+	unitVector(lat, lon, input.site);
+
+	/* sample the boundary of the image */
+	std::vector<double> lats, lons;
+	int xstep = src.xsize > 256 ? src.xsize / 256 : 1;
+	int ystep = src.ysize > 256 ? src.ysize / 256 : 1;
+	for (int i = 0; i <= src.xsize; i += xstep)
+		for (int side = 0; side < 2; ++side)
+		{
+			srcproj.inverse(src.ulx + i * src.xscale, src.uly - side * src.ysize * src.yscale, lat, lon);
+			lats.push_back(lat);
+			lons.push_back(lon);
+		}
+	for (int j = 0; j <= src.ysize; j += ystep)
+		for (int side = 0; side < 2; ++side)
+		{
+			srcproj.inverse(src.ulx + side * src.xsize * src.xscale, src.uly - j * src.yscale, lat, lon);
+			lats.push_back(lat);
+			lons.push_back(lon);
+		}
+	if (!setWindow(input, lats, lons))
+		return false;
+
+	/* HDF5 reads stay in this thread */
+	size_t size = (size_t)src.xsize * src.ysize;
+	std::vector<float> values(size + 1), quality;
+	std::unique_ptr<Product_2D_Data> data(product->getQuantityData(quantity));
+	if (data.get() == NULL)
+		throw OdimH5Exception("Quantity " + quantity + " not found in the image dataset");
+	if (data->getNumXElem() != src.xsize || data->getNumYElem() != src.ysize)
+		throw OdimH5FormatException("Size of quantity " + quantity + " does not match the image size");
+	data->readTranslatedData(&values[0], NODATA, UNDETECT);
+	if (product->hasQuantityData(PRODUCT_QUANTITY_QIND))
+	{
+		std::unique_ptr<Product_2D_Data> qind(product->getQuantityData(PRODUCT_QUANTITY_QIND));
+		quality.resize(size + 1);
+		qind->readTranslatedData(&quality[0], NODATA, 0.f);
+	}
+
+	size_t count = (size_t)input.rows * input.cols;
+	input.values.resize(count);
+	if (!quality.empty())
+		input.quality.resize(count);
+	Projection proj(grid.projdef);
+	ResampleTask task = {
+		grid, proj, src, srcproj,
+		input.row0, input.col0, input.cols,
+		&values[0], quality.empty() ? NULL : &quality[0],
+		&input.values[0], input.quality.empty() ? NULL : &input.quality[0]
+	};
+	Radar::parallel::forBlocks((size_t)input.rows, 16, threads, task);
+	inputs.push_back(input);
+	return true;
+}
+
+bool Compositor::addVolume(PolarVolume& volume, const std::string& product, double prodpar, const std::string& quantity)
+{
+	Input input;
+	input.source	= volume.getSource();
+	input.node	= nodeName(input.source);
+	input.datetime	= volume.getDateTime();
+	unitVector(volume.getLatitude(), volume.getLongitude(), input.site);
+
+	/* sample the circle of the maximum range of the scans */
+	double range = 0;
+	int count = volume.getScanCount();
+	for (int i = 0; i < count; ++i)
+	{
+		std::unique_ptr<PolarScan> scan(volume.getScan(i));
+		if (!scan->hasQuantityData(quantity))
+			continue;
+		double r = scan->getRangeStart() * 1000. + scan->getNumBins() * scan->getRangeScale();
+		if (r > range)
+			range = r;
+	}
+	std::vector<double> lats(361), lons(361);
+	for (int az = 0; az < 360; ++az)
+		geometry::PolarGeometry::computeRadial(volume.getLatitude(), volume.getLongitude(), az, &range, 1, &lats[az], &lons[az]);
+	lats[360] = volume.getLatitude();
+	lons[360] = volume.getLongitude();
+	if (!setWindow(input, lats, lons))
+		return false;
+
+	CartesianGrid window = grid;
+	window.xsize	= input.cols;
+	window.ysize	= input.rows;
+	window.ulx	= grid.ulx + input.col0 * grid.xscale;
+	window.uly	= grid.uly - input.row0 * grid.yscale;
+	CartesianGenerator generator(window, threads);
+
+	DataMatrix<float> values;
+	generator.compute(volume, product, prodpar, quantity, values);
+	input.values.assign(values.get(), values.get() + (size_t)input.rows * input.cols);
+
+	bool hasQuality = false;
+	for (int i = 0; i < count && !hasQuality; ++i)
+	{
+		std::unique_ptr<PolarScan> scan(volume.getScan(i));
+		hasQuality = scan->hasQuantityData(PRODUCT_QUANTITY_QIND);
+	}
+	if (hasQuality)
+	{
+		DataMatrix<float> quality;
+		generator.compute(volume, product, prodpar, PRODUCT_QUANTITY_QIND, quality);
+		input.quality.assign(quality.get(), quality.get() + (size_t)input.rows * input.cols);
+	}
+
+	/* start and end times of the scans used */
+	const std::vector<int>& scans = generator.getRemapTable(volume, product, prodpar, quantity)->getScans();
+	for (size_t k = 0; k < scans.size(); ++k)
+	{
+		std::unique_ptr<PolarScan> scan(volume.getScan(scans[k]));
+		time_t s = scan->getStartDateTime();
+		time_t e = scan->getEndDateTime();
+		if (k == 0 || s < input.start)	input.start = s;
+		if (k == 0 || e > input.end)	input.end = e;
+	}
+
+	inputs.push_back(input);
+	return true;
+}
+
+struct Compositor::Task
+{
+	const Compositor&	comp;
+	int			xtiles;
+	float*			out;
+	float*			quality;
+
+	void operator()(size_t begin, size_t end) const
+	{
+		const CartesianGrid& grid = comp.grid;
+		const int tileSize = comp.tileSize;
+		Projection proj(grid.projdef);
+		std::vector<const Input*> overlapping;
+
+		for (size_t tile = begin; tile < end; ++tile)
+		{
+			int row0 = (int)(tile / xtiles) * tileSize;
+			int col0 = (int)(tile % xtiles) * tileSize;
+			int row1 = row0 + tileSize < grid.ysize ? row0 + tileSize : grid.ysize;
+			int col1 = col0 + tileSize < grid.xsize ? col0 + tileSize : grid.xsize;
+
+			overlapping.clear();
+			for (size_t i = 0; i < comp.inputs.size(); ++i)
+			{
+				const Input& in = comp.inputs[i];
+				if (in.row0 < row1 && in.row0 + in.rows > row0 && in.col0 < col1 && in.col0 + in.cols > col0)
+					overlapping.push_back(&in);
+			}
+
+			for (int row = row0; row < row1; ++row)
+				for (int col = col0; col < col1; ++col)
+				{
+					double pixel[3] = { 0, 0, 0 };
+					if (comp.rule == COMPOSITE_NEAREST)
+					{
+						double lat, lon;
+						proj.inverse(grid.pixelX(col), grid.pixelY(row), lat, lon);
+						unitVector(lat, lon, pixel);
+					}
+
+					float value = NODATA, q = NODATA;
+					double best = 0;
+					for (size_t i = 0; i < overlapping.size(); ++i)
+					{
+						const Input& in = *overlapping[i];
+						int r = row - in.row0, c = col - in.col0;
+						if (r < 0 || c < 0 || r >= in.rows || c >= in.cols)
+							continue;
+						size_t k = (size_t)r * in.cols + c;
+						float v = in.values[k];
+						if (v != v)
+							continue;
+						float vq = in.quality.empty() ? comp.defaultQuality : in.quality[k];
+						double score;
+						switch (comp.rule)
+						{
+						case COMPOSITE_NEAREST:
+							score = in.site[0] * pixel[0] + in.site[1] * pixel[1] + in.site[2] * pixel[2];
+							break;
+						case COMPOSITE_QUALITY:
+							score = vq == vq ? vq : -1.;
+							break;
+						default:
+							score = v;
+							break;
+						}
+						if (value != value || score > best)
+						{
+							value	= v;
+							q	= vq;
+							best	= score;
+						}
+					}
+					size_t p = (size_t)row * grid.xsize + col;
+					out[p] = value;
+					if (quality)
+						quality[p] = q;
+				}
+		}
+	}
+};
+
+void Compositor::compute(DataMatrix<float>& out)
+{
+	run(out, NULL);
+}
+
+void Compositor::compute(DataMatrix<float>& out, DataMatrix<float>& quality)
+{
+	run(out, &quality);
+}
+
+void Compositor::run(DataMatrix<float>& out, DataMatrix<float>* quality)
+{
+	out.resize(grid.ysize, grid.xsize);
+	if (quality)
+		quality->resize(grid.ysize, grid.xsize);
+	if (grid.xsize <= 0 || grid.ysize <= 0)
+		return;
+
+	int xtiles = (grid.xsize + tileSize - 1) / tileSize;
+	int ytiles = (grid.ysize + tileSize - 1) / tileSize;
+	Task task = { *this, xtiles, &out.elem(0, 0), quality ? &quality->elem(0, 0) : NULL };
+	Radar::parallel::forBlocks((size_t)xtiles * ytiles, 1, threads, task);
+}
+
+Product_COMP* Compositor::generate(CompObject& comp, const std::string& quantity, const Encoding& encoding)
+{
+	if (inputs.empty())
+		throw OdimH5Exception("No input for the composite");
+
+	bool hasQuality = false;
+	time_t datetime = 0, start = 0, end = 0;
+	for (size_t i = 0; i < inputs.size(); ++i)
+	{
+		const Input& in = inputs[i];
+		if (i == 0 || in.datetime > datetime)	datetime = in.datetime;
+		if (i == 0 || in.start < start)		start = in.start;
+		if (i == 0 || in.end > end)		end = in.end;
+		hasQuality = hasQuality || !in.quality.empty();
+	}
+
+	DataMatrix<float> values, quality;
+	run(values, &quality);
+
+	/* ORG e CTY se comuni a tutti i radar, i nodi sono elencati in what/nodes */
+	SourceInfo source;
+	source.OriginatingCenter	= inputs[0].source.OriginatingCenter;
+	source.Country			= inputs[0].source.Country;
+	for (size_t i = 1; i < inputs.size(); ++i)
+	{
+		if (inputs[i].source.OriginatingCenter != source.OriginatingCenter)	source.OriginatingCenter = 0;
+		if (inputs[i].source.Country != source.Country)				source.Country = 0;
+	}
+	std::ostringstream comment;
+	comment << "composite of " << inputs.size() << " radars";
+	source.Comment = comment.str();
+
+	comp.setDateTime(datetime);
+	comp.setSource(source);
+	grid.writeTo(comp);
+
+	std::unique_ptr<Product_COMP> dataset(comp.createProductCOMP());
+	dataset->setStartDateTime(start);
+	dataset->setEndDateTime(end);
+	grid.writeTo(*dataset);
+	dataset->setNodes(getNodes());
+	dataset->setCCnum((int)inputs.size());
+	dataset->setCAMethod(rule == COMPOSITE_NEAREST ? "NEAREST" : rule == COMPOSITE_QUALITY ? "QMAXIMUM" : "MAXIMUM");
+
+	std::unique_ptr<Product_2D_Data> data(dataset->createQuantityData(quantity));
+	encoding.write(values, *data);
+	if (hasQuality)
+	{
+		std::unique_ptr<Product_2D_Data> qind(dataset->createQuantityData(PRODUCT_QUANTITY_QIND));
+		qualityEncoding.write(quality, *qind);
+	}
+	return dataset.release();
+}
+
+}
+}
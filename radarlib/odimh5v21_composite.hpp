@@ -0,0 +1,179 @@
+/*
+ * odimh5v21_composite - multi radar composites
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef __RADAR_ODIMH5V21_COMPOSITE_HPP__
+#define __RADAR_ODIMH5V21_COMPOSITE_HPP__
+/*!
+ * \file
+ * \brief Composites of products of several radars
+ */
+
+#include <radarlib/odimh5v21_cartesian.hpp>
+
+#include <string>
+#include <vector>
+
+namespace OdimH5v21 {
+namespace products {
+
+/*!
+ * \brief Rules used to choose among the radars that cover the same pixel
+ */
+enum CompositeRule {
+	COMPOSITE_MAXIMUM,	/*!< highest value (how/camethod MAXIMUM) */
+	COMPOSITE_NEAREST,	/*!< value of the nearest radar (how/camethod NEAREST) */
+	COMPOSITE_QUALITY	/*!< value with the highest quality index (how/camethod QMAXIMUM) */
+};
+
+/*!
+ * \brief Composite of cartesian products and polar volumes of several radars
+ *
+ * Inputs are decoded and resampled on the composite grid when they are added,
+ * keeping only the window of the grid they cover, so that HDF5 is used only by
+ * the calling thread. compute() splits the grid in square tiles processed in
+ * parallel, each tile looks only at the inputs whose window overlaps it. \n
+ * Pixels where no input has data are NODATA. UNDETECT values take part in
+ * every rule: they lose against any echo with COMPOSITE_MAXIMUM and win over
+ * missing data of nearer radars with COMPOSITE_NEAREST. \n
+ * The quality of an input is its QIND quantity (0-1), inputs without QIND
+ * have the default quality.
+ */
+class RADAR_API Compositor {
+ public:
+	/*!
+	 * \brief Create a compositor for the given grid
+	 * \param grid		grid of the composite
+	 * \param rule		rule used to choose among radars
+	 * \param threads	number of threads, 0 for one thread per core
+	 */
+	Compositor(const CartesianGrid& grid, CompositeRule rule = COMPOSITE_MAXIMUM, int threads = 0);
+
+	const CartesianGrid& getGrid() const	{ return grid; }
+	void setRule(CompositeRule val)		{ rule = val; }
+	CompositeRule getRule() const		{ return rule; }
+	void setThreads(int val)		{ threads = val; }
+	int getThreads() const			{ return threads; }
+	/*!
+	 * \brief Side (pixels) of the square tiles assigned to a thread at a time
+	 */
+	void setTileSize(int val)		{ tileSize = val > 0 ? val : 1; }
+	int getTileSize() const			{ return tileSize; }
+	/*!
+	 * \brief Quality of the inputs without QIND
+	 */
+	void setDefaultQuality(double val)	{ defaultQuality = (float)val; }
+	/*!
+	 * \brief Encoding of the QIND data written by generate(), default 8 bit with gain 0.004
+	 */
+	void setQualityEncoding(const Encoding& val)	{ qualityEncoding = val; }
+
+	/*!
+	 * \brief Add a cartesian product
+	 *
+	 * The product is resampled with the nearest pixel. The radar is assumed to be
+	 * at the centre of the image, as needed by COMPOSITE_NEAREST.
+	 * \param image		image or composite object, whose root where/ describes the grid
+	 * \param dataset	index of the product dataset
+	 * \param quantity	quantity to read from the dataset
+	 * \returns		false if the product does not overlap the composite grid
+	 */
+	bool addImage(HorizontalObject_2D& image, int dataset, const std::string& quantity);
+
+	/*!
+	 * \brief Add a polar volume
+	 *
+	 * The volume is converted with CartesianGenerator on the window of the
+	 * composite grid within its maximum range, so remap tables are cached
+	 * for each radar.
+	 * \param product	PRODUCT_PPI, PRODUCT_CAPPI or PRODUCT_PCAPPI
+	 * \param prodpar	product parameter, see CartesianGenerator
+	 * \returns		false if the volume does not overlap the composite grid
+	 */
+	bool addVolume(PolarVolume& volume, const std::string& product, double prodpar, const std::string& quantity);
+
+	/*!
+	 * \brief Number of inputs added so far
+	 */
+	int getInputCount() const	{ return (int)inputs.size(); }
+	/*!
+	 * \brief Radar nodes of the inputs with a known source, in the order they have been added
+	 */
+	std::vector<Nodes> getNodes() const;
+	/*!
+	 * \brief Remove every input
+	 */
+	void clear()			{ inputs.clear(); }
+
+	/*!
+	 * \brief Compute the composite
+	 * \param out		resized to the grid
+	 */
+	void compute(DataMatrix<float>& out);
+	/*!
+	 * \brief Compute the composite and the quality of the chosen values
+	 * \param out		resized to the grid
+	 * \param quality	resized to the grid, NODATA where out is NODATA
+	 */
+	void compute(DataMatrix<float>& out, DataMatrix<float>& quality);
+
+	/*!
+	 * \brief Compute the composite and store it in a composite object
+	 *
+	 * Root what/date, what/time and where/ are set from the inputs and the grid.
+	 * The new COMP dataset has the start/end times of the inputs and
+	 * how/nodes, how/ACCnum and how/camethod describing them. When some input
+	 * has a quality, the quality of the chosen values is stored as QIND.
+	 * \param comp		destination object
+	 * \param quantity	quantity of the stored data
+	 * \param encoding	encoding of the stored values
+	 * \returns		the new dataset
+	 * \remarks		User is responsible for deleting the returned object
+	 */
+	Product_COMP* generate(CompObject& comp, const std::string& quantity, const Encoding& encoding);
+
+ private:
+	/* input resampled on a window of the composite grid */
+	struct Input {
+		std::string		node;
+		SourceInfo		source;
+		double			site[3];	/* unit vector of the radar position */
+		int			row0, col0;
+		int			rows, cols;
+		std::vector<float>	values;
+		std::vector<float>	quality;	/* empty when the input has no quality */
+		time_t			datetime, start, end;
+	};
+	struct Task;
+
+	CartesianGrid		grid;
+	CompositeRule		rule;
+	int			threads;
+	int			tileSize;
+	float			defaultQuality;
+	Encoding		qualityEncoding;
+	std::vector<Input>	inputs;
+
+	bool setWindow(Input& input, const std::vector<double>& lats, const std::vector<double>& lons);
+	void run(DataMatrix<float>& out, DataMatrix<float>* quality);
+};
+
+}
+}
+
+#endif
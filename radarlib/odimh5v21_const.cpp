@@ -124,6 +124,7 @@ const char* PRODUCT_QUANTITY_VWND		= "VWND";
 const char* PRODUCT_QUANTITY_BRDR		= "BRDR"; 
 const char* PRODUCT_QUANTITY_QIND		= "QIND"; 
 const char* PRODUCT_QUANTITY_CLASS		= "CLASS";
+const char* PRODUCT_QUANTITY_CMAP		= "CMAP";
 
 const char* PRODUCT_QUANTITY_ff			= "ff";
 const char* PRODUCT_QUANTITY_dd			= "dd";
@@ -523,6 +524,7 @@ void Specification::getStandardQuantities(std::set<std::string>& names)
 	names.insert(PRODUCT_QUANTITY_BRDR		); //BRDR"; 
 	names.insert(PRODUCT_QUANTITY_QIND		); //QIND"; 
 	names.insert(PRODUCT_QUANTITY_CLASS		); //CLASS";
+	names.insert(PRODUCT_QUANTITY_CMAP		); //CMAP";
 
 	names.insert(PRODUCT_QUANTITY_ff			); //ff";
 	names.insert(PRODUCT_QUANTITY_dd			); //dd";
@@ -142,6 +142,7 @@ namespace OdimH5v21
 	extern RADAR_API const char* PRODUCT_QUANTITY_BRDR;	
 	extern RADAR_API const char* PRODUCT_QUANTITY_QIND;	
 	extern RADAR_API const char* PRODUCT_QUANTITY_CLASS;	
+	extern RADAR_API const char* PRODUCT_QUANTITY_CMAP;	
 
 	extern RADAR_API const char* PRODUCT_QUANTITY_ff;		
 	extern RADAR_API const char* PRODUCT_QUANTITY_dd;		
@@ -68,9 +68,10 @@ void OdimObjectDumper::dump(OdimObject* object, std::ostream* out)
 	
 	prefix(0) << "ROOT" << std::endl;
 
-	dumpMetadata(1, object->getWhat(), GROUP_WHAT);
-	dumpMetadata(1, object->getWhere(), GROUP_WHERE);
-	dumpMetadata(1, object->getHow(), GROUP_HOW);		
+	/* i gruppi mancanti non vengono creati: il file puo' essere aperto in sola lettura */
+	if (object->existWhat())		dumpMetadata(1, object->getWhat(), GROUP_WHAT);
+	if (object->existWhere())	dumpMetadata(1, object->getWhere(), GROUP_WHERE);
+	if (object->existHow())		dumpMetadata(1, object->getHow(), GROUP_HOW);		
 
 	int count = 0;
 	for (int i=0; count<object->getDatasetCount(); i++)
@@ -86,9 +87,9 @@ void OdimObjectDumper::dump(OdimObject* object, std::ostream* out)
 
 		std::unique_ptr<OdimDataset> dataset( datasetptr );
 
-		dumpMetadata(2, dataset->getWhat(),  GROUP_WHAT);
-		dumpMetadata(2, dataset->getWhere(), GROUP_WHERE);
-		dumpMetadata(2, dataset->getHow(),   GROUP_HOW);
+		if (dataset->existWhat())		dumpMetadata(2, dataset->getWhat(),  GROUP_WHAT);
+		if (dataset->existWhere())	dumpMetadata(2, dataset->getWhere(), GROUP_WHERE);
+		if (dataset->existHow())		dumpMetadata(2, dataset->getHow(),   GROUP_HOW);
 
 
 		int datacount = 0;
@@ -104,9 +105,9 @@ void OdimObjectDumper::dump(OdimObject* object, std::ostream* out)
 			prefix(2) << "+ DATA " << i << std::endl;
 
 			std::unique_ptr<OdimData> data(dataptr);
-			dumpMetadata(3, data->getWhat(),  GROUP_WHAT);
-			dumpMetadata(3, data->getWhere(), GROUP_WHERE);
-			dumpMetadata(3, data->getHow(),   GROUP_HOW);
+			if (data->existWhat())		dumpMetadata(3, data->getWhat(),  GROUP_WHAT);
+			if (data->existWhere())	dumpMetadata(3, data->getWhere(), GROUP_WHERE);
+			if (data->existHow())		dumpMetadata(3, data->getHow(),   GROUP_HOW);
 
 			dumpDataset(3, data.get());
 		}
@@ -118,6 +119,7 @@ void OdimObjectDumper::dump(OdimObject* object, std::ostream* out)
 
 void OdimObjectDumper::dumpMetadata(int level, MetadataGroup* metadata, const std::string& name)
 {
+	HDF5Lock		lock;
 	H5::H5Object*		obj		= metadata->getH5Object();
 	int			count		= obj->getNumAttrs();
 	H5::Attribute*		h5attr		= NULL;
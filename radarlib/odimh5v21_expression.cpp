@@ -0,0 +1,503 @@
+/*
+ * odimh5v21_expression - gate filters and derived quantities from expressions
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <radarlib/odimh5v21_expression.hpp>
+#include <radarlib/odimh5v21_exceptions.hpp>
+#include <radarlib/parallel.hpp>
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace OdimH5v21 {
+namespace products {
+
+/*===========================================================================*/
+/* PARSER */
+/*===========================================================================*/
+
+class Expression::Parser
+{
+ public:
+	/* deepest nesting of parentheses, unary operators and conditions */
+	static const int MAX_DEPTH = 256;
+
+	Parser(Expression& expr)
+		: expr(expr), text(expr.text), pos(0), depth(0)
+	{
+	}
+
+	void parse()
+	{
+		ternary();
+		skipSpaces();
+		if (pos < text.size())
+			error("unexpected character");
+	}
+
+ private:
+	Expression&		expr;
+	const std::string&	text;
+	size_t			pos;
+	int			depth;
+
+	/* ogni livello di annidamento usa lo stack: oltre MAX_DEPTH l'espressione non e' valida */
+	struct Nesting
+	{
+		Parser& parser;
+
+		Nesting(Parser& parser) : parser(parser)
+		{
+			if (++parser.depth > MAX_DEPTH)
+				parser.error("expression nested too deeply");
+		}
+		~Nesting() { --parser.depth; }
+	};
+
+	void error(const std::string& message) const
+	{
+		std::ostringstream ss;
+		ss << "Invalid expression '" << text << "' at position " << pos << ": " << message;
+		throw std::invalid_argument(ss.str());
+	}
+
+	void skipSpaces()
+	{
+		while (pos < text.size() && isspace((unsigned char)text[pos]))
+			++pos;
+	}
+
+	bool accept(const char* token)
+	{
+		skipSpaces();
+		size_t len = strlen(token);
+		if (text.compare(pos, len, token) != 0)
+			return false;
+		/* '<' must not match the start of '<=', '!' the start of '!=' */
+		if (len == 1 && pos + 1 < text.size() && text[pos + 1] == '=' && (token[0] == '<' || token[0] == '>' || token[0] == '!'))
+			return false;
+		pos += len;
+		return true;
+	}
+
+	void expect(const char* token)
+	{
+		if (!accept(token))
+			error(std::string("expected '") + token + "'");
+	}
+
+	int add(Op op, int a = -1, int b = -1, int c = -1, float value = 0.f)
+	{
+		Node node = { op, a, b, c, value };
+		expr.nodes.push_back(node);
+		return (int)expr.nodes.size() - 1;
+	}
+
+	int ternary()
+	{
+		Nesting nesting(*this);
+		int cond = logicalOr();
+		if (!accept("?"))
+			return cond;
+		int a = ternary();
+		expect(":");
+		int b = ternary();
+		return add(OP_COND, cond, a, b);
+	}
+
+	int logicalOr()
+	{
+		int a = logicalAnd();
+		while (accept("||"))
+			a = add(OP_OR, a, logicalAnd());
+		return a;
+	}
+
+	int logicalAnd()
+	{
+		int a = comparison();
+		while (accept("&&"))
+			a = add(OP_AND, a, comparison());
+		return a;
+	}
+
+	int comparison()
+	{
+		int a = additive();
+		static const char* tokens[] = { "<=", ">=", "==", "!=", "<", ">" };
+		static const Op ops[] = { OP_LE, OP_GE, OP_EQ, OP_NE, OP_LT, OP_GT };
+		for (int i = 0; i < 6; ++i)
+			if (accept(tokens[i]))
+				return add(ops[i], a, additive());
+		return a;
+	}
+
+	int additive()
+	{
+		int a = multiplicative();
+		for (;;)
+		{
+			if (accept("+"))
+				a = add(OP_ADD, a, multiplicative());
+			else if (accept("-"))
+				a = add(OP_SUB, a, multiplicative());
+			else
+				return a;
+		}
+	}
+
+	int multiplicative()
+	{
+		int a = unary();
+		for (;;)
+		{
+			if (accept("*"))
+				a = add(OP_MUL, a, unary());
+			else if (accept("/"))
+				a = add(OP_DIV, a, unary());
+			else
+				return a;
+		}
+	}
+
+	int unary()
+	{
+		Nesting nesting(*this);
+		if (accept("-"))
+			return add(OP_NEG, unary());
+		if (accept("!"))
+			return add(OP_NOT, unary());
+		return primary();
+	}
+
+	int primary()
+	{
+		skipSpaces();
+		if (pos >= text.size())
+			error("unexpected end");
+		char c = text[pos];
+		if (accept("("))
+		{
+			int a = ternary();
+			expect(")");
+			return a;
+		}
+		if (isdigit((unsigned char)c) || c == '.')
+		{
+			const char* start = text.c_str() + pos;
+			char* end;
+			double value = strtod(start, &end);
+			if (end == start)
+				error("invalid number");
+			pos += end - start;
+			return add(OP_CONST, -1, -1, -1, (float)value);
+		}
+		if (isalpha((unsigned char)c) || c == '_')
+		{
+			size_t start = pos;
+			while (pos < text.size() && (isalnum((unsigned char)text[pos]) || text[pos] == '_'))
+				++pos;
+			std::string name = text.substr(start, pos - start);
+			skipSpaces();
+			if (pos < text.size() && text[pos] == '(')
+				return function(name);
+			return input(name);
+		}
+		error("unexpected character");
+		return -1;
+	}
+
+	int function(const std::string& name)
+	{
+		static const char* unaryNames[] = { "abs", "sqrt", "exp", "log", "log10", "valid", "nodata", "undetect" };
+		static const Op unaryOps[] = { OP_ABS, OP_SQRT, OP_EXP, OP_LOG, OP_LOG10, OP_VALID, OP_NODATA, OP_UNDETECT };
+		static const char* binaryNames[] = { "pow", "min", "max" };
+		static const Op binaryOps[] = { OP_POW, OP_MIN, OP_MAX };
+
+		expect("(");
+		for (int i = 0; i < 8; ++i)
+			if (name == unaryNames[i])
+			{
+				int a = ternary();
+				expect(")");
+				return add(unaryOps[i], a);
+			}
+		for (int i = 0; i < 3; ++i)
+			if (name == binaryNames[i])
+			{
+				int a = ternary();
+				expect(",");
+				int b = ternary();
+				expect(")");
+				return add(binaryOps[i], a, b);
+			}
+		error("unknown function " + name);
+		return -1;
+	}
+
+	int input(const std::string& name)
+	{
+		size_t i = 0;
+		while (i < expr.quantities.size() && expr.quantities[i] != name)
+			++i;
+		if (i == expr.quantities.size())
+			expr.quantities.push_back(name);
+		return add(OP_INPUT, (int)i);
+	}
+};
+
+/*===========================================================================*/
+/* EVALUATION */
+/*===========================================================================*/
+
+namespace {
+
+/* number of gates evaluated by each node at a time */
+const size_t LANES = 256;
+
+inline bool truth(float v)
+{
+	return v > 0 || v < 0;
+}
+
+inline float arith(float a, float r)
+{
+	return a != a ? NODATA : a == UNDETECT ? UNDETECT : r;
+}
+
+inline float arith(float a, float b, float r)
+{
+	return a != a || b != b ? NODATA : a == UNDETECT || b == UNDETECT ? UNDETECT : r;
+}
+
+inline float compare(float a, float b, bool r)
+{
+	return a == a && b == b && r ? 1.f : 0.f;
+}
+
+}
+
+struct Expression::EvaluateTask
+{
+	const std::vector<Node>&	nodes;
+	const std::vector<Input>&	inputs;
+	float*				out;
+	unsigned char*			mask;
+
+	void operator()(size_t begin, size_t end) const
+	{
+		/* one short vector per node */
+		std::vector<float> registers(nodes.size() * LANES);
+		for (size_t first = begin; first < end; first += LANES)
+		{
+			size_t n = end - first < LANES ? end - first : LANES;
+			for (size_t k = 0; k < nodes.size(); ++k)
+				evaluate(k, first, n, &registers[0]);
+
+			const float* result = &registers[(nodes.size() - 1) * LANES];
+			if (mask)
+				for (size_t i = 0; i < n; ++i)
+					mask[first + i] = truth(result[i]) ? 1 : 0;
+			else
+				for (size_t i = 0; i < n; ++i)
+					out[first + i] = result[i];
+		}
+	}
+
+	void evaluate(size_t k, size_t first, size_t n, float* registers) const
+	{
+		const Node& node = nodes[k];
+		float* r = registers + k * LANES;
+		const float* a = node.a >= 0 && node.op != OP_INPUT ? registers + node.a * LANES : NULL;
+		const float* b = node.b >= 0 ? registers + node.b * LANES : NULL;
+		const float* c = node.c >= 0 ? registers + node.c * LANES : NULL;
+
+		switch (node.op)
+		{
+			case OP_CONST:
+				for (size_t i = 0; i < n; ++i) r[i] = node.value;
+				break;
+			case OP_INPUT:
+			{
+				const Input& input = inputs[node.a];
+				const float* v = input.values + first;
+				if (input.decoded)
+					for (size_t i = 0; i < n; ++i) r[i] = v[i];
+				else
+					for (size_t i = 0; i < n; ++i)
+						r[i] = v[i] == input.nodata ? NODATA : v[i] == input.undetect ? UNDETECT : v[i] * input.gain + input.offset;
+				break;
+			}
+			case OP_NEG:	for (size_t i = 0; i < n; ++i) r[i] = arith(a[i], -a[i]); break;
+			case OP_NOT:	for (size_t i = 0; i < n; ++i) r[i] = a[i] != a[i] ? NODATA : truth(a[i]) ? 0.f : 1.f; break;
+			case OP_ABS:	for (size_t i = 0; i < n; ++i) r[i] = arith(a[i], fabsf(a[i])); break;
+			case OP_SQRT:	for (size_t i = 0; i < n; ++i) r[i] = arith(a[i], sqrtf(a[i])); break;
+			case OP_EXP:	for (size_t i = 0; i < n; ++i) r[i] = arith(a[i], expf(a[i])); break;
+			case OP_LOG:	for (size_t i = 0; i < n; ++i) r[i] = arith(a[i], logf(a[i])); break;
+			case OP_LOG10:	for (size_t i = 0; i < n; ++i) r[i] = arith(a[i], log10f(a[i])); break;
+			case OP_VALID:	for (size_t i = 0; i < n; ++i) r[i] = a[i] == a[i] && a[i] != UNDETECT ? 1.f : 0.f; break;
+			case OP_NODATA:	for (size_t i = 0; i < n; ++i) r[i] = a[i] != a[i] ? 1.f : 0.f; break;
+			case OP_UNDETECT: for (size_t i = 0; i < n; ++i) r[i] = a[i] == UNDETECT ? 1.f : 0.f; break;
+			case OP_ADD:	for (size_t i = 0; i < n; ++i) r[i] = arith(a[i], b[i], a[i] + b[i]); break;
+			case OP_SUB:	for (size_t i = 0; i < n; ++i) r[i] = arith(a[i], b[i], a[i] - b[i]); break;
+			case OP_MUL:	for (size_t i = 0; i < n; ++i) r[i] = arith(a[i], b[i], a[i] * b[i]); break;
+			case OP_DIV:	for (size_t i = 0; i < n; ++i) r[i] = arith(a[i], b[i], a[i] / b[i]); break;
+			case OP_POW:	for (size_t i = 0; i < n; ++i) r[i] = arith(a[i], b[i], powf(a[i], b[i])); break;
+			case OP_MIN:	for (size_t i = 0; i < n; ++i) r[i] = arith(a[i], b[i], a[i] < b[i] ? a[i] : b[i]); break;
+			case OP_MAX:	for (size_t i = 0; i < n; ++i) r[i] = arith(a[i], b[i], a[i] > b[i] ? a[i] : b[i]); break;
+			case OP_LT:	for (size_t i = 0; i < n; ++i) r[i] = compare(a[i], b[i], a[i] < b[i]); break;
+			case OP_LE:	for (size_t i = 0; i < n; ++i) r[i] = compare(a[i], b[i], a[i] <= b[i]); break;
+			case OP_GT:	for (size_t i = 0; i < n; ++i) r[i] = compare(a[i], b[i], a[i] > b[i]); break;
+			case OP_GE:	for (size_t i = 0; i < n; ++i) r[i] = compare(a[i], b[i], a[i] >= b[i]); break;
+			case OP_EQ:	for (size_t i = 0; i < n; ++i) r[i] = compare(a[i], b[i], a[i] == b[i]); break;
+			case OP_NE:	for (size_t i = 0; i < n; ++i) r[i] = compare(a[i], b[i], a[i] != b[i]); break;
+			case OP_AND:	for (size_t i = 0; i < n; ++i) r[i] = truth(a[i]) && truth(b[i]) ? 1.f : 0.f; break;
+			case OP_OR:	for (size_t i = 0; i < n; ++i) r[i] = truth(a[i]) || truth(b[i]) ? 1.f : 0.f; break;
+			case OP_COND:	for (size_t i = 0; i < n; ++i) r[i] = truth(a[i]) ? b[i] : c[i]; break;
+		}
+	}
+};
+
+/*===========================================================================*/
+/* EXPRESSION */
+/*===========================================================================*/
+
+Expression::Expression(const std::string& text, int threads)
+	: text(text), quantities(), nodes(), threads(threads), blockSize(16384)
+{
+	Parser(*this).parse();
+}
+
+void Expression::run(const std::vector<Input>& inputs, size_t count, float* out, unsigned char* mask) const
+{
+	EvaluateTask task = { nodes, inputs, out, mask };
+	Radar::parallel::forBlocks(count, blockSize, threads, task);
+}
+
+void Expression::evaluate(const std::vector<const float*>& values, size_t count, float* out) const
+{
+	if (values.size() != quantities.size())
+		throw std::invalid_argument("Expression '" + text + "' needs one array for each quantity");
+	std::vector<Input> inputs(values.size());
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		inputs[i].values = values[i];
+		inputs[i].decoded = true;
+	}
+	run(inputs, count, out, NULL);
+}
+
+template <class DATASET> void Expression::readInputs(DATASET& dataset, std::vector<Input>& inputs, int& width, int& height) const
+{
+	if (quantities.empty())
+		throw std::invalid_argument("Expression '" + text + "' does not use any quantity");
+	inputs.resize(quantities.size());
+	for (size_t i = 0; i < quantities.size(); ++i)
+	{
+		if (!dataset.hasQuantityData(quantities[i]))
+			throw OdimH5Exception("Quantity " + quantities[i] + " of expression '" + text + "' not found");
+		std::unique_ptr<typename std::remove_pointer<decltype(dataset.getQuantityData(quantities[i]))>::type>
+			data(dataset.getQuantityData(quantities[i]));
+		if (i == 0)
+		{
+			width = data->getDataWidth();
+			height = data->getDataHeight();
+		}
+		else if (data->getDataWidth() != width || data->getDataHeight() != height)
+			throw OdimH5FormatException("Quantities of expression '" + text + "' have different sizes");
+
+		/* raw values converted to float by HDF5, decoded while evaluating */
+		Input& input = inputs[i];
+		input.buffer.resize((size_t)width * height + 1);
+		data->readData(&input.buffer[0], RAW_FLOAT);
+		input.values = &input.buffer[0];
+		input.gain = (float)data->getGain();
+		input.offset = (float)data->getOffset();
+		input.nodata = (float)data->getNodata();
+		input.undetect = (float)data->getUndetect();
+		input.decoded = false;
+	}
+}
+
+void Expression::evaluate(PolarScan& scan, RayMatrix<float>& out) const
+{
+	std::vector<Input> inputs;
+	int width, height;
+	readInputs(scan, inputs, width, height);
+	out.resize(height, width);
+	run(inputs, (size_t)width * height, &out.elem(0, 0), NULL);
+}
+
+void Expression::evaluate(Product_2D& dataset, DataMatrix<float>& out) const
+{
+	std::vector<Input> inputs;
+	int width, height;
+	readInputs(dataset, inputs, width, height);
+	out.resize(height, width);
+	run(inputs, (size_t)width * height, &out.elem(0, 0), NULL);
+}
+
+void Expression::mask(PolarScan& scan, RayMatrix<unsigned char>& out) const
+{
+	std::vector<Input> inputs;
+	int width, height;
+	readInputs(scan, inputs, width, height);
+	out.resize(height, width);
+	run(inputs, (size_t)width * height, NULL, &out.elem(0, 0));
+}
+
+void Expression::mask(Product_2D& dataset, DataMatrix<unsigned char>& out) const
+{
+	std::vector<Input> inputs;
+	int width, height;
+	readInputs(dataset, inputs, width, height);
+	out.resize(height, width);
+	run(inputs, (size_t)width * height, NULL, &out.elem(0, 0));
+}
+
+PolarScanData* Expression::derive(PolarScan& scan, const std::string& quantity, const Encoding& encoding) const
+{
+	RayMatrix<float> values;
+	evaluate(scan, values);
+	size_t count = (size_t)values.getRowCount() * values.getColCount();
+	std::vector<char> raw(count * getRawSize(encoding.rawtype) + 1);
+	encoding.encode(&values.elem(0, 0), count, &raw[0]);
+
+	std::unique_ptr<PolarScanData> data(scan.createQuantityData(quantity));
+	encoding.writeTo(*data);
+	data->writeData(&raw[0], values.getColCount(), values.getRowCount(), encoding.rawtype);
+	return data.release();
+}
+
+Product_2D_Data* Expression::derive(Product_2D& dataset, const std::string& quantity, const Encoding& encoding) const
+{
+	DataMatrix<float> values;
+	evaluate(dataset, values);
+	std::unique_ptr<Product_2D_Data> data(dataset.createQuantityData(quantity));
+	encoding.write(values, *data);
+	return data.release();
+}
+
+}
+}
@@ -0,0 +1,163 @@
+/*
+ * odimh5v21_expression - gate filters and derived quantities from expressions
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef __RADAR_ODIMH5V21_EXPRESSION_HPP__
+#define __RADAR_ODIMH5V21_EXPRESSION_HPP__
+/*!
+ * \file
+ * \brief Expressions over the quantities of a scan or of a product dataset
+ */
+
+#include <radarlib/odimh5v21_cartesian.hpp>
+
+#include <string>
+#include <vector>
+
+namespace OdimH5v21 {
+namespace products {
+
+/*!
+ * \brief Expression evaluated gate by gate over the quantities of a dataset
+ *
+ * The language has numbers, quantity names, parentheses and, by increasing
+ * precedence:
+ * - c ? a : b
+ * - ||
+ * - &&
+ * - < <= > >= == !=
+ * - + -
+ * - * /
+ * - unary - and !
+ *
+ * Functions are abs, sqrt, exp, log, log10, pow(x, y), min(a, b), max(a, b),
+ * valid(x) (neither NODATA nor UNDETECT), nodata(x) and undetect(x); every
+ * other name is a quantity, as in "DBZH > 5 && RHOHV > 0.85 && abs(VRAD) > 1"
+ * or "DBZH - DBZV". \n
+ * Arithmetic and functions give NODATA if an operand is NODATA, otherwise
+ * UNDETECT if an operand is UNDETECT. Comparisons are false when an operand is
+ * NODATA and compare UNDETECT as lower than every value. Conditions are true
+ * when their value is neither 0 nor NODATA, and give 1 or 0; !x gives NODATA
+ * when x is NODATA. Parentheses, unary operators and conditions can be nested
+ * up to 256 levels. \n
+ * Only the referenced quantities are read, as raw values; gates are decoded and
+ * evaluated in short vectors, so that the only full size arrays are the raw
+ * inputs and the output. Blocks of gates are evaluated in parallel, HDF5 reads
+ * and writes stay in the calling thread.
+ */
+class RADAR_API Expression {
+ public:
+	/*!
+	 * \brief Parse an expression
+	 * \param threads	number of threads, 0 for one thread per core
+	 * \throws std::invalid_argument if the expression is not valid
+	 */
+	Expression(const std::string& text, int threads = 0);
+
+	const std::string& getText() const			{ return text; }
+	/*!
+	 * \brief Quantities referenced by the expression, in order of appearance
+	 */
+	const std::vector<std::string>& getQuantities() const	{ return quantities; }
+
+	void setThreads(int val)				{ threads = val; }
+	int getThreads() const					{ return threads; }
+	/*!
+	 * \brief Number of gates assigned to a thread at a time
+	 */
+	void setBlockSize(size_t val)				{ blockSize = val > 0 ? val : 1; }
+
+	/*!
+	 * \brief Evaluate the expression over decoded values
+	 * \param values	one array of count values for each of getQuantities()
+	 * \param out		output array of count values
+	 */
+	void evaluate(const std::vector<const float*>& values, size_t count, float* out) const;
+
+	/*!
+	 * \brief Evaluate the expression over the quantities of a scan
+	 * \param out		resized to the rays and bins of the scan
+	 * \throws OdimH5Exception	if a quantity is missing
+	 */
+	void evaluate(PolarScan& scan, RayMatrix<float>& out) const;
+	/*!
+	 * \brief Evaluate the expression over the quantities of a product dataset
+	 */
+	void evaluate(Product_2D& dataset, DataMatrix<float>& out) const;
+
+	/*!
+	 * \brief Gates of a scan where the expression is true
+	 * \param out		resized to the rays and bins of the scan, 1 where true and 0 elsewhere
+	 */
+	void mask(PolarScan& scan, RayMatrix<unsigned char>& out) const;
+	/*!
+	 * \brief Pixels of a product dataset where the expression is true
+	 */
+	void mask(Product_2D& dataset, DataMatrix<unsigned char>& out) const;
+
+	/*!
+	 * \brief Store the expression as a new quantity of a scan
+	 * \returns		the new data
+	 * \remarks		User is responsible for deleting the returned object
+	 */
+	PolarScanData* derive(PolarScan& scan, const std::string& quantity, const Encoding& encoding) const;
+	/*!
+	 * \brief Store the expression as a new quantity of a product dataset
+	 * \returns		the new data
+	 * \remarks		User is responsible for deleting the returned object
+	 */
+	Product_2D_Data* derive(Product_2D& dataset, const std::string& quantity, const Encoding& encoding) const;
+
+ private:
+	enum Op {
+		OP_CONST, OP_INPUT,
+		OP_NEG, OP_NOT, OP_ABS, OP_SQRT, OP_EXP, OP_LOG, OP_LOG10, OP_VALID, OP_NODATA, OP_UNDETECT,
+		OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_POW, OP_MIN, OP_MAX,
+		OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ, OP_NE, OP_AND, OP_OR,
+		OP_COND
+	};
+	/* nodes are stored after their operands, so they can be evaluated in order */
+	struct Node {
+		Op	op;
+		int	a, b, c;	/* operands */
+		float	value;		/* constant */
+	};
+	/* a quantity as stored in the file, or already decoded */
+	struct Input {
+		std::vector<float>	buffer;
+		const float*		values;
+		float			gain, offset, nodata, undetect;
+		bool			decoded;
+	};
+	class Parser;
+	struct EvaluateTask;
+
+	std::string			text;
+	std::vector<std::string>	quantities;
+	std::vector<Node>		nodes;
+	int				threads;
+	size_t				blockSize;
+
+	template <class DATASET> void readInputs(DATASET& dataset, std::vector<Input>& inputs, int& width, int& height) const;
+	void run(const std::vector<Input>& inputs, size_t count, float* out, unsigned char* mask) const;
+};
+
+}
+}
+
+#endif
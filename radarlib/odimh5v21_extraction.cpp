@@ -0,0 +1,490 @@
+/*
+ * odimh5v21_extraction - values of points and polygons from polar and cartesian data
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <radarlib/odimh5v21_extraction.hpp>
+#include <radarlib/odimh5v21_geometry.hpp>
+#include <radarlib/odimh5v21_const.hpp>
+#include <radarlib/odimh5v21_exceptions.hpp>
+#include <radarlib/odimh5v21_factory.hpp>
+#include <radarlib/parallel.hpp>
+#include <radarlib/time.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace OdimH5v21 {
+namespace products {
+
+namespace {
+
+const double DEG2RAD = M_PI / 180.;
+
+typedef std::vector<std::pair<size_t, double> > Entries;
+
+/* even-odd rule */
+bool inside(const std::vector<double>& xs, const std::vector<double>& ys, double x, double y)
+{
+	bool in = false;
+	for (size_t i = 0, j = xs.size() - 1; i < xs.size(); j = i++)
+		if ((ys[i] > y) != (ys[j] > y) && x < (xs[j] - xs[i]) * (y - ys[i]) / (ys[j] - ys[i]) + xs[i])
+			in = !in;
+	return in;
+}
+
+struct Box
+{
+	double xmin, xmax, ymin, ymax;
+
+	Box(const std::vector<double>& xs, const std::vector<double>& ys)
+		: xmin(*std::min_element(xs.begin(), xs.end())), xmax(*std::max_element(xs.begin(), xs.end())),
+		  ymin(*std::min_element(ys.begin(), ys.end())), ymax(*std::max_element(ys.begin(), ys.end()))
+	{
+	}
+
+	bool contains(double x, double y) const { return x >= xmin && x <= xmax && y >= ymin && y <= ymax; }
+};
+
+double mean(const std::vector<double>& values)
+{
+	double sum = 0;
+	for (size_t i = 0; i < values.size(); ++i)
+		sum += values[i];
+	return sum / values.size();
+}
+
+}
+
+/*===========================================================================*/
+/* EXTRACTION INDEX */
+/*===========================================================================*/
+
+ExtractionIndex::ExtractionIndex()
+	: first(), cells(), weights()
+{
+}
+
+size_t ExtractionIndex::memorySize() const
+{
+	return sizeof(*this) + (first.capacity() + cells.capacity()) * sizeof(size_t) + weights.capacity() * sizeof(float);
+}
+
+/*===========================================================================*/
+/* EXTRACTION TABLE */
+/*===========================================================================*/
+
+void ExtractionTable::clear()
+{
+	targets.clear();
+	files.clear();
+	rows.clear();
+}
+
+void ExtractionTable::writeCSV(std::ostream& out) const
+{
+	out << "file,time,target,dataset,elangle,value,coverage\n";
+	for (size_t i = 0; i < rows.size(); ++i)
+	{
+		const ExtractionRow& row = rows[i];
+		if (row.file >= 0 && row.file < (int)files.size())
+			out << files[row.file];
+		out << ',' << Radar::timeutils::absoluteToString(row.time) << ',';
+		if (row.target >= 0 && row.target < (int)targets.size())
+			out << targets[row.target];
+		else
+			out << row.target;
+		out << ',' << row.dataset << ',';
+		if (row.elangle == row.elangle)
+			out << row.elangle;
+		out << ',';
+		if (row.value == row.value)
+			out << row.value;
+		out << ',' << row.coverage << '\n';
+	}
+}
+
+/*===========================================================================*/
+/* EXTRACTOR */
+/*===========================================================================*/
+
+/* targets on the plane of the azimuthal equidistant projection centred on the radar */
+struct Extractor::PolarBuildTask
+{
+	const std::vector<Target>&	targets;
+	const geometry::PolarGeometryKey& key;
+	const AzimuthIndex&		rays;		/* ray covering each azimuth */
+	const std::vector<double>&	ground;		/* distance of the centre of each bin */
+	const std::vector<double>&	edges;		/* distance of the start of each bin, plus the end of the last */
+	std::vector<Entries>&		out;
+
+	void toPlane(double lat, double lon, double& x, double& y) const
+	{
+		double distance, azimuth;
+		geometry::distanceAzimuth(key.lat, key.lon, lat, lon, distance, azimuth);
+		x = distance * sin(azimuth * DEG2RAD);
+		y = distance * cos(azimuth * DEG2RAD);
+	}
+
+	long locate(double x, double y) const
+	{
+		double distance = sqrt(x * x + y * y);
+		if (key.nbins == 0 || key.nrays == 0 || distance < edges.front() || distance >= edges.back())
+			return -1;
+		long bin = (long)(std::upper_bound(edges.begin(), edges.end(), distance) - edges.begin()) - 1;
+		long ray = rays.findRay(atan2(x, y) / DEG2RAD);
+		if (ray < 0)
+			return -1;
+		return ray * key.nbins + bin;
+	}
+
+	void operator()(size_t begin, size_t end) const
+	{
+		for (size_t t = begin; t < end; ++t)
+		{
+			const Target& target = targets[t];
+			std::vector<double> xs(target.lats.size()), ys(target.lats.size());
+			for (size_t v = 0; v < xs.size(); ++v)
+				toPlane(target.lats[v], target.lons[v], xs[v], ys[v]);
+
+			Entries& entries = out[t];
+			if (xs.size() > 1)
+			{
+				/* only the bins in the range of distances of the bounding box */
+				Box box(xs, ys);
+				double dx = box.xmin > 0 ? box.xmin : box.xmax < 0 ? -box.xmax : 0;
+				double dy = box.ymin > 0 ? box.ymin : box.ymax < 0 ? -box.ymax : 0;
+				double dmax = 0;
+				for (int c = 0; c < 4; ++c)
+				{
+					double cx = c & 1 ? box.xmax : box.xmin;
+					double cy = c & 2 ? box.ymax : box.ymin;
+					dmax = std::max(dmax, sqrt(cx * cx + cy * cy));
+				}
+				size_t b0 = std::lower_bound(ground.begin(), ground.end(), sqrt(dx * dx + dy * dy)) - ground.begin();
+				size_t b1 = std::upper_bound(ground.begin(), ground.end(), dmax) - ground.begin();
+				for (int r = 0; r < key.nrays && b0 < b1; ++r)
+				{
+					double azimuth = key.azimuths.centre(r, key.nrays) * DEG2RAD;
+					double s = sin(azimuth), c = cos(azimuth);
+					for (size_t b = b0; b < b1; ++b)
+					{
+						double x = ground[b] * s, y = ground[b] * c;
+						if (box.contains(x, y) && inside(xs, ys, x, y))
+							entries.push_back(std::make_pair((size_t)r * key.nbins + b, ground[b]));
+					}
+				}
+				if (!entries.empty())
+					continue;
+			}
+			long cell = locate(mean(xs), mean(ys));
+			if (cell >= 0)
+				entries.push_back(std::make_pair((size_t)cell, 1.));
+		}
+	}
+};
+
+struct Extractor::GridBuildTask
+{
+	const std::vector<Target>&	targets;
+	const CartesianGrid&		grid;
+	const Projection&		projection;
+	std::vector<Entries>&		out;
+
+	long locate(double x, double y) const
+	{
+		double col = floor((x - grid.ulx) / grid.xscale);
+		double row = floor((grid.uly - y) / grid.yscale);
+		if (col < 0 || col >= grid.xsize || row < 0 || row >= grid.ysize)
+			return -1;
+		return (long)row * grid.xsize + (long)col;
+	}
+
+	void operator()(size_t begin, size_t end) const
+	{
+		for (size_t t = begin; t < end; ++t)
+		{
+			const Target& target = targets[t];
+			std::vector<double> xs(target.lats.size()), ys(target.lats.size());
+			for (size_t v = 0; v < xs.size(); ++v)
+				projection.forward(target.lats[v], target.lons[v], xs[v], ys[v]);
+
+			Entries& entries = out[t];
+			if (xs.size() > 1)
+			{
+				/* only the pixels whose centre is in the bounding box */
+				Box box(xs, ys);
+				int c0 = std::max(0., ceil((box.xmin - grid.ulx) / grid.xscale - 0.5));
+				int c1 = std::min(grid.xsize - 1., floor((box.xmax - grid.ulx) / grid.xscale - 0.5));
+				int r0 = std::max(0., ceil((grid.uly - box.ymax) / grid.yscale - 0.5));
+				int r1 = std::min(grid.ysize - 1., floor((grid.uly - box.ymin) / grid.yscale - 0.5));
+				for (int r = r0; r <= r1; ++r)
+					for (int c = c0; c <= c1; ++c)
+						if (inside(xs, ys, grid.pixelX(c), grid.pixelY(r)))
+							entries.push_back(std::make_pair((size_t)r * grid.xsize + c, 1.));
+				if (!entries.empty())
+					continue;
+			}
+			long cell = locate(mean(xs), mean(ys));
+			if (cell >= 0)
+				entries.push_back(std::make_pair((size_t)cell, 1.));
+		}
+	}
+};
+
+struct Extractor::GatherTask
+{
+	const ExtractionIndex&	index;
+	const float*		raw;
+	float			gain;
+	float			offset;
+	float			nodata;
+	float			undetect;
+	float			undetectValue;
+	ExtractionRow*		rows;
+
+	void operator()(size_t begin, size_t end) const
+	{
+		const size_t* first = &index.getFirst()[0];
+		const size_t* cells = index.getCells().empty() ? NULL : &index.getCells()[0];
+		const float* weights = index.getWeights().empty() ? NULL : &index.getWeights()[0];
+		for (size_t t = begin; t < end; ++t)
+		{
+			double sum = 0, observed = 0;
+			for (size_t e = first[t]; e < first[t + 1]; ++e)
+			{
+				float v = raw[cells[e]];
+				if (v == nodata)
+					continue;
+				float value = v == undetect ? undetectValue : v * gain + offset;
+				sum += weights[e] * value;
+				observed += weights[e];
+			}
+			rows[t].value = observed > 0 ? (float)(sum / observed) : NODATA;
+			rows[t].coverage = (float)observed;
+		}
+	}
+};
+
+namespace {
+
+/* flatten the entries of the targets, normalizing the weights */
+void storeEntries(const std::vector<Entries>& entries, std::vector<size_t>& first,
+		  std::vector<size_t>& cells, std::vector<float>& weights)
+{
+	first.assign(1, 0);
+	for (size_t t = 0; t < entries.size(); ++t)
+	{
+		double total = 0;
+		for (size_t e = 0; e < entries[t].size(); ++e)
+			total += entries[t][e].second;
+		for (size_t e = 0; e < entries[t].size(); ++e)
+		{
+			cells.push_back(entries[t][e].first);
+			weights.push_back((float)(entries[t][e].second / total));
+		}
+		first.push_back(cells.size());
+	}
+}
+
+}
+
+Extractor::Extractor(const std::vector<ExtractionPoint>& points, const std::vector<ExtractionPolygon>& polygons, int threads)
+	: names(), targets(), threads(threads), targetsPerBlock(64), undetectValue(0.f), failed(), indexes(16), raw()
+{
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		Target target;
+		target.lats.assign(1, points[i].lat);
+		target.lons.assign(1, points[i].lon);
+		targets.push_back(target);
+		names.push_back(points[i].name);
+	}
+	for (size_t i = 0; i < polygons.size(); ++i)
+	{
+		if (polygons[i].lats.size() < 3 || polygons[i].lats.size() != polygons[i].lons.size())
+			throw std::invalid_argument("Polygon " + polygons[i].name + " needs at least 3 vertices");
+		Target target;
+		target.lats = polygons[i].lats;
+		target.lons = polygons[i].lons;
+		targets.push_back(target);
+		names.push_back(polygons[i].name);
+	}
+}
+
+Extractor::IndexPtr Extractor::getIndex(PolarVolume& volume, PolarScan& scan)
+{
+	geometry::PolarGeometryKey key(volume, scan);
+	std::ostringstream ss;
+	ss.precision(12);
+	ss << "POLAR|" << key.lat << '|' << key.lon << '|' << key.elangle << '|' << key.nbins << '|'
+	   << key.rscale << '|' << key.rstart << '|' << key.nrays << '|' << key.azimuths.key();
+
+	return indexes.get(ss.str(), [&](const std::string&) {
+		std::vector<double> ground(key.nbins), edges(key.nbins + 1);
+		geometry::PolarGeometry::computeBins(key.elangle, key.rstart, key.rscale, key.nbins, NULL, ground.empty() ? NULL : &ground[0], NULL);
+		geometry::PolarGeometry::computeBins(key.elangle, key.rstart - key.rscale / 2000., key.rscale, key.nbins + 1, NULL, &edges[0], NULL);
+		std::vector<Entries> entries(targets.size());
+		AzimuthIndex rays = key.azimuths.index(key.nrays);
+		PolarBuildTask task = { targets, key, rays, ground, edges, entries };
+		Radar::parallel::forBlocks(targets.size(), 1, threads, task);
+
+		std::unique_ptr<ExtractionIndex> index(new ExtractionIndex());
+		storeEntries(entries, index->first, index->cells, index->weights);
+		return index.release();
+	});
+}
+
+Extractor::IndexPtr Extractor::getIndex(const CartesianGrid& grid)
+{
+	return indexes.get("GRID|" + grid.key(), [&](const std::string&) {
+		Projection projection(grid.projdef);
+		std::vector<Entries> entries(targets.size());
+		GridBuildTask task = { targets, grid, projection, entries };
+		Radar::parallel::forBlocks(targets.size(), 1, threads, task);
+
+		std::unique_ptr<ExtractionIndex> index(new ExtractionIndex());
+		storeEntries(entries, index->first, index->cells, index->weights);
+		return index.release();
+	});
+}
+
+void Extractor::prepareTable(ExtractionTable& table) const
+{
+	if (table.targets.empty())
+		table.targets = names;
+}
+
+void Extractor::gather(OdimData& data, WHATDatasetMetadata& what, const ExtractionIndex& index, const ExtractionRow& row,
+		       ExtractionTable& table)
+{
+	/* raw values converted to float by HDF5, only the cells of the targets are decoded */
+	raw.resize((size_t)data.getDataWidth() * data.getDataHeight() + 1);
+	data.readData(&raw[0], RAW_FLOAT);
+
+	size_t base = table.rows.size();
+	table.rows.resize(base + targets.size(), row);
+	for (size_t t = 0; t < targets.size(); ++t)
+		table.rows[base + t].target = (int)t;
+	if (targets.empty())
+		return;
+
+	GatherTask task = { index, &raw[0], (float)what.getGain(), (float)what.getOffset(), (float)what.getNodata(),
+			    (float)what.getUndetect(), undetectValue, &table.rows[base] };
+	Radar::parallel::forBlocks(targets.size(), targetsPerBlock, threads, task);
+}
+
+int Extractor::extractVolume(PolarVolume& volume, const std::string& quantity, ExtractionTable& table, int file)
+{
+	int extracted = 0;
+	int count = volume.getScanCount();
+	for (int i = 0; i < count; ++i)
+	{
+		std::unique_ptr<PolarScan> scan(volume.getScan(i));
+		if (!scan->hasQuantityData(quantity))
+			continue;
+		IndexPtr index = getIndex(volume, *scan);
+		std::unique_ptr<PolarScanData> data(scan->getQuantityData(quantity));
+		if (data->getDataWidth() != scan->getNumBins() || data->getDataHeight() != scan->getNumRays())
+			throw OdimH5FormatException("Size of quantity " + quantity + " does not match the scan size");
+
+		ExtractionRow row = { file, volume.getDateTime(), 0, i, scan->getEAngle(), NODATA, 0.f };
+		gather(*data, *data, *index, row, table);
+		++extracted;
+	}
+	return extracted;
+}
+
+int Extractor::extractObject(HorizontalObject_2D& object, const std::string& quantity, ExtractionTable& table, int file)
+{
+	CartesianGrid grid = CartesianGrid::readFrom(object);
+	IndexPtr index;
+	int extracted = 0;
+	int count = object.getProductCount();
+	for (int i = 0; i < count; ++i)
+	{
+		std::unique_ptr<Product_2D> product(object.getProduct(i));
+		if (!product->hasQuantityData(quantity))
+			continue;
+		std::unique_ptr<Product_2D_Data> data(product->getQuantityData(quantity));
+		if (data->getNumXElem() != grid.xsize || data->getNumYElem() != grid.ysize)
+			throw OdimH5FormatException("Size of quantity " + quantity + " does not match the image size");
+		if (!index)
+			index = getIndex(grid);
+
+		ExtractionRow row = { file, object.getDateTime(), 0, i, NAN, NODATA, 0.f };
+		gather(*data, *data, *index, row, table);
+		++extracted;
+	}
+	return extracted;
+}
+
+int Extractor::extract(PolarVolume& volume, const std::string& quantity, ExtractionTable& table)
+{
+	prepareTable(table);
+	return extractVolume(volume, quantity, table, -1);
+}
+
+int Extractor::extract(HorizontalObject_2D& object, const std::string& quantity, ExtractionTable& table)
+{
+	prepareTable(table);
+	return extractObject(object, quantity, table, -1);
+}
+
+int Extractor::extractFiles(const std::vector<std::string>& paths, const std::string& quantity, ExtractionTable& table)
+{
+	prepareTable(table);
+	failed.clear();
+	int extracted = 0;
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		size_t rows = table.rows.size();
+		int file = (int)table.files.size();
+		table.files.push_back(paths[i]);
+		try
+		{
+			OdimFactory factory;
+			std::unique_ptr<OdimObject> object(factory.open(paths[i]));
+			if (PolarVolume* volume = dynamic_cast<PolarVolume*>(object.get()))
+				extractVolume(*volume, quantity, table, file);
+			else if (HorizontalObject_2D* image = dynamic_cast<HorizontalObject_2D*>(object.get()))
+				extractObject(*image, quantity, table, file);
+			else
+				throw OdimH5Exception(paths[i] + " is not a volume, an image or a composite");
+			++extracted;
+			continue;
+		}
+		catch (std::exception&)
+		{
+		}
+		catch (H5::Exception&)
+		{
+		}
+		/* rows of a file are all or nothing */
+		table.rows.resize(rows);
+		table.files.pop_back();
+		failed.push_back(paths[i]);
+	}
+	return extracted;
+}
+
+}
+}
@@ -0,0 +1,256 @@
+/*
+ * odimh5v21_extraction - values of points and polygons from polar and cartesian data
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef __RADAR_ODIMH5V21_EXTRACTION_HPP__
+#define __RADAR_ODIMH5V21_EXTRACTION_HPP__
+/*!
+ * \file
+ * \brief Extraction of the values of points and polygons from volumes and images
+ */
+
+#include <radarlib/odimh5v21_cartesian.hpp>
+
+#include <ctime>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace OdimH5v21 {
+namespace products {
+
+/*===========================================================================*/
+/* TARGETS */
+/*===========================================================================*/
+
+/*!
+ * \brief Point whose value is extracted, as a rain gauge
+ */
+struct RADAR_API ExtractionPoint {
+	std::string	name;
+	double		lat;	/*!< latitude (degrees) */
+	double		lon;	/*!< longitude (degrees) */
+};
+
+/*!
+ * \brief Polygon whose mean value is extracted, as a basin
+ */
+struct RADAR_API ExtractionPolygon {
+	std::string		name;
+	std::vector<double>	lats;	/*!< latitudes (degrees) of the vertices */
+	std::vector<double>	lons;	/*!< longitudes (degrees) of the vertices */
+};
+
+/*===========================================================================*/
+/* EXTRACTION INDEX */
+/*===========================================================================*/
+
+/*!
+ * \brief Precomputed cells of every point and polygon in a scan or grid
+ *
+ * Cells are numbered ray * nbins + bin in polar scans and row * xsize + col
+ * in cartesian grids. The entries of target t are the ones from getFirst()[t]
+ * to getFirst()[t + 1]: a point has the cell that contains it, a polygon the
+ * cells whose centre is inside it, or the cell of the mean of its vertices
+ * when it is smaller than a cell. Targets outside the data have no entries.
+ */
+class RADAR_API ExtractionIndex {
+ public:
+	ExtractionIndex();
+
+	/*!
+	 * \brief Number of points and polygons
+	 */
+	int getTargetCount() const			{ return first.empty() ? 0 : (int)first.size() - 1; }
+	/*!
+	 * \brief First entry of each target, plus the total number of entries
+	 */
+	const std::vector<size_t>& getFirst() const	{ return first; }
+	/*!
+	 * \brief Cell of each entry
+	 */
+	const std::vector<size_t>& getCells() const	{ return cells; }
+	/*!
+	 * \brief Weight of each entry, proportional to the area of the cell; the weights of a target sum to 1
+	 */
+	const std::vector<float>& getWeights() const	{ return weights; }
+
+	/*!
+	 * \brief Memory used by the index, in bytes
+	 */
+	size_t memorySize() const;
+
+ private:
+	friend class Extractor;
+	std::vector<size_t>	first;
+	std::vector<size_t>	cells;
+	std::vector<float>	weights;
+};
+
+/*===========================================================================*/
+/* EXTRACTION TABLE */
+/*===========================================================================*/
+
+/*!
+ * \brief Value of a target in a scan or in a dataset
+ */
+struct RADAR_API ExtractionRow {
+	int	file;		/*!< index in ExtractionTable::files, -1 when not read from a file */
+	time_t	time;		/*!< date and time of the volume or image */
+	int	target;		/*!< index of the target, points first then polygons */
+	int	dataset;	/*!< index of the scan in the volume or of the dataset in the image */
+	double	elangle;	/*!< elevation angle (degrees) of the scan, NaN for images */
+	float	value;		/*!< value of the point or weighted mean of the polygon, NODATA if not observed */
+	float	coverage;	/*!< fraction of the target with valid values */
+};
+
+/*!
+ * \brief Rows extracted from volumes and images
+ */
+struct RADAR_API ExtractionTable {
+	std::vector<std::string>	targets;	/*!< names of the targets */
+	std::vector<std::string>	files;		/*!< files the rows were read from */
+	std::vector<ExtractionRow>	rows;
+
+	void clear();
+	/*!
+	 * \brief Write the rows as comma separated values
+	 *
+	 * Columns are file, time, target, dataset, elangle, value and coverage;
+	 * NODATA values and missing files or elevations are empty.
+	 */
+	void writeCSV(std::ostream& out) const;
+};
+
+/*===========================================================================*/
+/* EXTRACTOR */
+/*===========================================================================*/
+
+/*!
+ * \brief Extraction of the values of a set of points and polygons
+ *
+ * Indexes are computed once per scan geometry or grid and cached, so every
+ * following volume or image costs one raw read and one gather pass over the
+ * cells of the targets: only those cells are decoded. UNDETECT cells take
+ * getUndetectValue(), NODATA cells are left out of polygon means and reduce
+ * the coverage. \n
+ * Targets are gathered in parallel blocks, HDF5 reads stay in the calling
+ * thread.
+ */
+class RADAR_API Extractor {
+ public:
+	typedef std::shared_ptr<const ExtractionIndex> IndexPtr;
+
+	/*!
+	 * \brief Create an extractor
+	 * \param threads	number of threads, 0 for one thread per core
+	 * \throws std::invalid_argument if a polygon has less than 3 vertices
+	 */
+	Extractor(const std::vector<ExtractionPoint>& points,
+		  const std::vector<ExtractionPolygon>& polygons = std::vector<ExtractionPolygon>(), int threads = 0);
+
+	/*!
+	 * \brief Number of points and polygons
+	 */
+	int getTargetCount() const			{ return (int)names.size(); }
+	const std::string& getTargetName(int index) const	{ return names.at(index); }
+
+	void setThreads(int val)			{ threads = val; }
+	int getThreads() const				{ return threads; }
+	/*!
+	 * \brief Number of targets assigned to a thread at a time
+	 */
+	void setTargetsPerBlock(int val)		{ targetsPerBlock = val > 0 ? val : 1; }
+	/*!
+	 * \brief Value of UNDETECT cells, default 0 (no rain)
+	 */
+	void setUndetectValue(float val)		{ undetectValue = val; }
+	float getUndetectValue() const			{ return undetectValue; }
+
+	/*!
+	 * \brief Get the index of a scan, computing it if it is not cached
+	 */
+	IndexPtr getIndex(PolarVolume& volume, PolarScan& scan);
+	/*!
+	 * \brief Get the index of a grid, computing it if it is not cached
+	 */
+	IndexPtr getIndex(const CartesianGrid& grid);
+
+	/*!
+	 * \brief Extract the targets from every scan of a volume with the quantity
+	 * \returns		the number of scans
+	 */
+	int extract(PolarVolume& volume, const std::string& quantity, ExtractionTable& table);
+	/*!
+	 * \brief Extract the targets from every dataset of an image or composite with the quantity
+	 *
+	 * Every dataset uses the grid of the object.
+	 * \returns		the number of datasets
+	 */
+	int extract(HorizontalObject_2D& object, const std::string& quantity, ExtractionTable& table);
+	/*!
+	 * \brief Extract the targets from a list of volume, image or composite files
+	 *
+	 * Files that cannot be read are skipped and listed in getFailedFiles().
+	 * \returns		the number of files extracted
+	 */
+	int extractFiles(const std::vector<std::string>& paths, const std::string& quantity, ExtractionTable& table);
+	/*!
+	 * \brief Files skipped by the last extractFiles()
+	 */
+	const std::vector<std::string>& getFailedFiles() const	{ return failed; }
+
+	/*!
+	 * \brief Number of getIndex() calls satisfied by the cache
+	 */
+	size_t getIndexHits() const			{ return indexes.getHits(); }
+	/*!
+	 * \brief Number of getIndex() calls that computed an index
+	 */
+	size_t getIndexMisses() const			{ return indexes.getMisses(); }
+
+ private:
+	/* vertices of a target, a point has only one */
+	struct Target {
+		std::vector<double>	lats;
+		std::vector<double>	lons;
+	};
+	struct PolarBuildTask;
+	struct GridBuildTask;
+	struct GatherTask;
+
+	std::vector<std::string>	names;
+	std::vector<Target>		targets;
+	int				threads;
+	int				targetsPerBlock;
+	float				undetectValue;
+	std::vector<std::string>	failed;
+	Radar::LRUCache<std::string, const ExtractionIndex>	indexes;
+	std::vector<float>		raw;		/* buffer of the data being extracted */
+
+	int extractVolume(PolarVolume& volume, const std::string& quantity, ExtractionTable& table, int file);
+	int extractObject(HorizontalObject_2D& object, const std::string& quantity, ExtractionTable& table, int file);
+	void gather(OdimData& data, WHATDatasetMetadata& what, const ExtractionIndex& index, const ExtractionRow& row,
+		    ExtractionTable& table);
+	void prepareTable(ExtractionTable& table) const;
+};
+
+}
+}
+
+#endif
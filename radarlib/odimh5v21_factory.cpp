@@ -26,6 +26,7 @@
 #include <cstring>
 
 #include <radarlib/debug.hpp>
+#include <radarlib/odimh5v21_trace.hpp>
 
 namespace OdimH5v21 {
 
@@ -33,15 +34,16 @@ namespace OdimH5v21 {
 
 OdimFactory::OdimFactory()
 {
+	HDF5Library::instance();
 }
 
 OdimFactory::~OdimFactory()
 {
 	try
 	{
-		/* quando si chiude una factory si pulisce la memoria */
-		/* per obbligare HDF5 a chiudere quello che va chiuso */
-		H5::H5Library::garbageCollect();
+		/* quando si chiude una factory si pulisce la memoria di HDF5 */
+		/* secondo la politica scelta in HDF5Library */
+		HDF5Library::instance().factoryReleased();
 	}
 	catch (...)
 	{
@@ -50,6 +52,8 @@ OdimFactory::~OdimFactory()
 
 OdimObject* OdimFactory::create(const std::string& path)
 {
+	TraceScope trace("file", "create", path);
+	HDF5Lock lock;
 	H5::H5File*	file	= NULL;
 	OdimObject*	object	= NULL;
 	try
@@ -70,6 +74,8 @@ OdimObject* OdimFactory::create(const std::string& path)
 
 H5::H5File* OdimFactory::openOdimFile(const std::string& path, int h5flags, std::string& objtype)
 {
+	/* anche le letture dei metadati e le delete sono chiamate a HDF5 */
+	HDF5Lock		lock;
 	H5::H5File*		file		= NULL;
 	H5::Group*		root		= NULL;
 	H5::Group*		what		= NULL;		
@@ -122,14 +128,20 @@ OdimObject* OdimFactory::open(const std::string& path)
 
 OdimObject* OdimFactory::open(const std::string& path, int h5flags) 
 {
-	H5::H5File*	file		= NULL;
-	OdimObject*	object		= NULL;
+	TraceScope trace("file", "open", path);
+	HDF5Lock lock;
 	std::string	objecttype;
+	H5::H5File*	file		= openOdimFile(path, h5flags, objecttype);
+	return createObject(file, objecttype);
+}
+
+OdimObject* OdimFactory::createObject(H5::H5File* file, const std::string& objecttype)
+{
+	HDF5Lock lock;
+	OdimObject*	object		= NULL;
 
 	try
 	{
-		file = openOdimFile(path, h5flags, objecttype);
-		
 		if (objecttype == OBJECT_PVOL)
 		{			
 			object = createPolarVolume(file);
@@ -142,6 +154,10 @@ OdimObject* OdimFactory::open(const std::string& path, int h5flags)
 		{			
 			object = createCompObject(file);
 		}
+		else if (objecttype == OBJECT_CVOL)
+		{			
+			object = createCvolObject(file);
+		}
 		else if (objecttype == OBJECT_XSEC)
 		{			
 			object = createXsecObject(file);
@@ -170,6 +186,8 @@ PolarVolume* OdimFactory::createPolarVolume(H5::H5File* file)
 
 PolarVolume* OdimFactory::createPolarVolume(const std::string& path) 
 {
+	TraceScope trace("file", "createPolarVolume", path);
+	HDF5Lock lock;
 	H5::H5File*	file	= NULL;
 	PolarVolume*	volume	= NULL;
 	try
@@ -195,6 +213,8 @@ ImageObject * OdimFactory::createImageObject(H5::H5File* file)
 
 ImageObject* OdimFactory::createImageObject(const std::string& path)
 {
+	TraceScope trace("file", "createImageObject", path);
+	HDF5Lock lock;
 	H5::H5File*	file	= NULL;
 	ImageObject*	image	= NULL;
 	try
@@ -220,6 +240,8 @@ CompObject * OdimFactory::createCompObject(H5::H5File* file)
 
 CompObject* OdimFactory::createCompObject(const std::string& path)
 {
+	TraceScope trace("file", "createCompObject", path);
+	HDF5Lock lock;
 	H5::H5File*	file	= NULL;
 	CompObject*	comp	= NULL;
 	try
@@ -238,6 +260,33 @@ CompObject* OdimFactory::createCompObject(const std::string& path)
 	}	
 }
 
+CvolObject * OdimFactory::createCvolObject(H5::H5File* file)
+{
+	return new CvolObject(file);
+}
+
+CvolObject* OdimFactory::createCvolObject(const std::string& path)
+{
+	TraceScope trace("file", "createCvolObject", path);
+	HDF5Lock lock;
+	H5::H5File*	file	= NULL;
+	CvolObject*	cvol	= NULL;
+	try
+	{
+		file	= HDF5File::open(path, H5F_ACC_TRUNC);	
+		cvol	= createCvolObject(file);
+		file	= NULL;
+		cvol->setMandatoryInformations();
+		return cvol;
+	}
+	catch (...)
+	{
+		delete cvol;
+		delete file;
+		throw;
+	}	
+}
+
 XsecObject * OdimFactory::createXsecObject(H5::H5File* file)
 {
 	return new XsecObject(file);
@@ -245,6 +294,8 @@ XsecObject * OdimFactory::createXsecObject(H5::H5File* file)
 
 XsecObject* OdimFactory::createXsecObject(const std::string& path)
 {
+	TraceScope trace("file", "createXsecObject", path);
+	HDF5Lock lock;
 	H5::H5File*	file	= NULL;
 	XsecObject*	xsec	= NULL;
 	try
@@ -270,6 +321,8 @@ PolarVolume* OdimFactory::openPolarVolume(const std::string& path)
 
 PolarVolume* OdimFactory::openPolarVolume(const std::string& path, int h5flags)
 {
+	TraceScope trace("file", "openPolarVolume", path);
+	HDF5Lock lock;
 	H5::H5File*	file	= NULL;
 	PolarVolume*	volume	= NULL;
 	try
@@ -295,6 +348,8 @@ ImageObject* OdimFactory::openImageObject(const std::string& path)
 
 ImageObject* OdimFactory::openImageObject(const std::string& path, int h5flags)
 {
+	TraceScope trace("file", "openImageObject", path);
+	HDF5Lock lock;
 	H5::H5File*	file	= NULL;
 	ImageObject*	image	= NULL;
 	try
@@ -320,6 +375,8 @@ CompObject* OdimFactory::openCompObject(const std::string& path)
 
 CompObject* OdimFactory::openCompObject(const std::string& path, int h5flags)
 {
+	TraceScope trace("file", "openCompObject", path);
+	HDF5Lock lock;
 	H5::H5File*	file	= NULL;
 	CompObject*	comp	= NULL;
 	try
@@ -338,6 +395,33 @@ CompObject* OdimFactory::openCompObject(const std::string& path, int h5flags)
 	}
 }
 
+CvolObject* OdimFactory::openCvolObject(const std::string& path) 
+{
+	return openCvolObject(path, H5F_ACC_RDWR);
+}
+
+CvolObject* OdimFactory::openCvolObject(const std::string& path, int h5flags)
+{
+	TraceScope trace("file", "openCvolObject", path);
+	HDF5Lock lock;
+	H5::H5File*	file	= NULL;
+	CvolObject*	cvol	= NULL;
+	try
+	{		
+		file	= HDF5File::open(path, h5flags);	
+		cvol	= createCvolObject(file);
+		file	= NULL;
+		cvol->checkMandatoryInformations();
+		return cvol;
+	}
+	catch (...)
+	{	
+		delete cvol;
+		delete file;
+		throw;
+	}
+}
+
 XsecObject* OdimFactory::openXsecObject(const std::string& path) 
 {
 	return openXsecObject(path, H5F_ACC_RDWR);
@@ -345,6 +429,8 @@ XsecObject* OdimFactory::openXsecObject(const std::string& path)
 
 XsecObject* OdimFactory::openXsecObject(const std::string& path, int h5flags)
 {
+	TraceScope trace("file", "openXsecObject", path);
+	HDF5Lock lock;
 	H5::H5File*	file	= NULL;
 	XsecObject*	xsec	= NULL;
 	try
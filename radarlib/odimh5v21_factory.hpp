@@ -173,6 +173,25 @@ namespace OdimH5v21 {
 					 */
 					virtual CompObject*		createCompObject(const std::string& path);
 					
+					/*!
+					 * \brief
+					 * Create a new OdimH5 CVOL object and the associated file
+					 * 
+					 * \param path			the file path where the object will be stored
+					 * 
+					 * \returns
+					 * Returns the created CvolObject object
+					 * 
+					 * \throws OdimH5HDF5LibException	Throwed when a HDF5 exception occurs	 
+					 * 
+					 * \n Create a OdimH5 CVOL object and the associated file. 
+					 * \n If the file already exists, it will be recreated. 
+					 * \n The file will be opened for input and output operations.
+					 * 
+					 * \see CvolObject | openCvolObject
+					 */
+					virtual CvolObject*		createCvolObject(const std::string& path);
+					
 					/*!
 					 * \brief
 					 * Create a new OdimH5 XSEC object and the associated file
@@ -315,6 +334,47 @@ namespace OdimH5v21 {
 					 */
 					virtual CompObject*		openCompObject(const std::string& path, int h5flags);
 					
+					/*!
+					 * \brief
+					 * Get a OdimH5 CVOL object from an existing file
+					 * 
+					 * \param path				the file path where the object is stored
+					 * 
+					 * \returns
+					 * Returns the CvolObject that represents the OdimH5 CVOL
+					 * 
+					 * \throws OdimH5FormatException	Throwed when the HDF5 file is not a OdimH5 file 
+					 * \throws OdimH5HDF5LibException	Throwed when a HDF5 exception occurs
+					 *
+					 * \n Get a OdimH5 CvolObject object stored in an existing file
+					 * \n If the file does not contains a OdimH5 CVOL object an exception will occur
+					 * \n The file will be opened  input and output operations
+					 * 
+					 * \see openCvolObject
+					 */
+					virtual CvolObject*		openCvolObject(const std::string& path);
+					
+					/*!
+					 * \brief
+					 * Get a OdimH5 CVOL object from an existing file
+					 * 
+					 * \param path				the file path where the object is stored
+					 * \param h5flags			the HDF5 I/O flags used to open the file
+					 * 
+					 * \returns
+					 * Returns the CvolObject that represents the OdimH5 CVOL 
+					 * 
+					 * \throws OdimH5FormatException	Throwed when the HDF5 file is not a OdimH5 file 
+					 * \throws OdimH5HDF5LibException	Throwed when a HDF5 exception occurs
+					 *
+					 * \n Get a OdimH5 CvolObject object stored in an existing file
+					 * \n If the file does not contains a OdimH5 CVOL object an exception will occur
+					 * \n The file will be opened with the I/O options indicated
+					 * 
+					 * \see openCvolObject
+					 */
+					virtual CvolObject*		openCvolObject(const std::string& path, int h5flags);
+					
 					/*!
 					 * \brief
 					 * Get a OdimH5 XSEC object from an existing file
@@ -371,9 +431,17 @@ namespace OdimH5v21 {
 					
 			protected:
 				  virtual H5::H5File* openOdimFile(const std::string& path, int h5flags, std::string& objtype);	
+					  /*!
+					   * \brief Create the object of the given type stored in an open file
+					   *
+					   * The object takes the ownership of the file, that is deleted also
+					   * if the object cannot be created.
+					   */
+					  OdimObject* createObject(H5::H5File* file, const std::string& objtype);
 					  virtual PolarVolume* createPolarVolume(H5::H5File* file);
 					  virtual ImageObject* createImageObject(H5::H5File* file);
 					  virtual CompObject*  createCompObject (H5::H5File* file);
+					  virtual CvolObject*  createCvolObject (H5::H5File* file);
 					  virtual XsecObject*  createXsecObject (H5::H5File* file);
 					  
 		};
@@ -0,0 +1,211 @@
+/*
+ * odimh5v21_filecache - cache of open read-only ODIM files
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <radarlib/odimh5v21_filecache.hpp>
+#include <radarlib/odimh5v21_exceptions.hpp>
+#include <radarlib/odimh5v21_hdf5.hpp>
+#include <radarlib/odimh5v21_trace.hpp>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace OdimH5v21 {
+
+/*===========================================================================*/
+/* FILE STATUS */
+/*===========================================================================*/
+
+namespace {
+
+/* modification time in nanoseconds and size, false if the file is missing */
+bool fileStatus(const std::string& path, int64_t& mtime, uint64_t& size)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		return false;
+#if defined(__linux__) || defined(linux)
+	/* a file rewritten within the same second must not look unchanged */
+	mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#else
+	mtime = (int64_t)st.st_mtime * 1000000000;
+#endif
+	size = (uint64_t)st.st_size;
+	return true;
+}
+
+}
+
+/*===========================================================================*/
+/* FILE CACHE */
+/*===========================================================================*/
+
+/* gives access to the factory methods working on open files */
+class OdimFileCache::Factory : public OdimFactory {
+ public:
+	H5::H5File* openFile(const std::string& path, std::string& objtype)
+	{
+		return openOdimFile(path, H5F_ACC_RDONLY, objtype);
+	}
+	OdimObject* createObject(H5::H5File* file, const std::string& objtype)
+	{
+		return OdimFactory::createObject(file, objtype);
+	}
+};
+
+OdimFileCache::Entry::Entry()
+:file(NULL)
+,object()
+,mtime(0)
+,size(0)
+{
+}
+
+OdimFileCache::Entry::~Entry()
+{
+	try
+	{
+		HDF5Lock lock;
+		delete file;
+		HDF5Library::instance().fileClosed();
+	}
+	catch (...)
+	{
+	}
+}
+
+OdimFileCache::OdimFileCache(size_t maxFiles, uint64_t maxBytes)
+:factory(new Factory())
+,entries(maxFiles)
+,hits(0)
+,misses(0)
+,invalidations(0)
+{
+	entries.setMaxWeight((size_t)maxBytes);
+}
+
+OdimFileCache::~OdimFileCache()
+{
+	/* the entries close their files before the factory goes away */
+	entries.clear();
+}
+
+std::shared_ptr<OdimObject> OdimFileCache::open(const std::string& path)
+{
+	int64_t		mtime	= 0;
+	uint64_t	size	= 0;
+	if (!fileStatus(path, mtime, size))
+	{
+		/* the factory reports the error as it would without the cache */
+		entries.erase(path);
+		return std::shared_ptr<OdimObject>(factory->open(path, H5F_ACC_RDONLY));
+	}
+
+	std::shared_ptr<Entry> entry = entries.find(path);
+	if (entry && (entry->mtime != mtime || entry->size != size))
+	{
+		/* objects already given out keep the old file open */
+		entries.erase(path);
+		entry.reset();
+		++invalidations;
+	}
+	if (entry)
+		++hits;
+	else
+	{
+		++misses;
+		TraceScope trace("file", "open", path);
+		std::shared_ptr<Entry> opened(new Entry);
+		opened->file	= factory->openFile(path, opened->object);
+		opened->mtime	= mtime;
+		opened->size	= size;
+		/* another thread may have opened the same file in the meantime */
+		entry = entries.insert(path, opened, (size_t)size);
+	}
+
+	HDF5Lock lock;
+	return std::shared_ptr<OdimObject>(factory->createObject(new H5::H5File(*entry->file), entry->object));
+}
+
+template <class T> std::shared_ptr<T> OdimFileCache::openAs(const std::string& path, const char* object)
+{
+	std::shared_ptr<T> result = std::dynamic_pointer_cast<T>(open(path));
+	if (!result)
+		throw OdimH5FormatException("File " + path + " does not contain a " + object);
+	return result;
+}
+
+std::shared_ptr<PolarVolume> OdimFileCache::openPolarVolume(const std::string& path)
+{
+	return openAs<PolarVolume>(path, "polar volume");
+}
+
+std::shared_ptr<ImageObject> OdimFileCache::openImageObject(const std::string& path)
+{
+	return openAs<ImageObject>(path, "image");
+}
+
+std::shared_ptr<CompObject> OdimFileCache::openCompObject(const std::string& path)
+{
+	return openAs<CompObject>(path, "composite");
+}
+
+void OdimFileCache::invalidate(const std::string& path)
+{
+	entries.erase(path);
+}
+
+void OdimFileCache::clear()
+{
+	entries.clear();
+}
+
+void OdimFileCache::setMaxFiles(size_t val)
+{
+	entries.setCapacity(val);
+}
+
+size_t OdimFileCache::getMaxFiles() const
+{
+	return entries.getCapacity();
+}
+
+void OdimFileCache::setMaxBytes(uint64_t val)
+{
+	entries.setMaxWeight((size_t)val);
+}
+
+uint64_t OdimFileCache::getMaxBytes() const
+{
+	return entries.getMaxWeight();
+}
+
+size_t OdimFileCache::size() const
+{
+	return entries.size();
+}
+
+uint64_t OdimFileCache::getBytes() const
+{
+	return entries.getWeight();
+}
+
+/*===========================================================================*/
+
+}
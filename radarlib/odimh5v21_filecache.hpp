@@ -0,0 +1,145 @@
+/*
+ * odimh5v21_filecache - cache of open read-only ODIM files
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef __RADAR_ODIMH5V21_FILECACHE_HPP__
+#define __RADAR_ODIMH5V21_FILECACHE_HPP__
+/*!
+ * \file
+ * \brief Cache of open read-only ODIM files for long running services
+ */
+
+#include <radarlib/cache.hpp>
+#include <radarlib/odimh5v21_factory.hpp>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <stdint.h>
+
+namespace OdimH5v21 {
+
+/*!
+ * \brief LRU cache of ODIM objects opened read-only
+ *
+ * Objects are keyed by path and validated against the modification time and
+ * size of the file at every request: a file that has been rewritten or
+ * replaced is opened again. The cache keeps at most the given number of open
+ * files and, optionally, of bytes of the files, evicting the least recently
+ * used ones. \n
+ * The cache keeps the files open: every request gets an object of its own
+ * on the cached file, so that threads do not share the metadata that objects
+ * load on demand. Objects are handed out as shared pointers: the file of an
+ * evicted or invalidated entry stays open until its last object is released. \n
+ * The cache is thread safe. An object is not: one shared by several threads
+ * must be used by one thread at a time. \n
+ * Releasing an object or an entry counts as closing a file for
+ * HDF5Library: with HDF5_GC_EVERY_FACTORY, the default, each release garbage
+ * collects the HDF5 free lists, as closing an object opened without the cache
+ * does. Servers answering many requests should set HDF5_GC_EVERY_N_FILES or
+ * HDF5_GC_MEMORY_THRESHOLD, which count only the files really opened.
+ */
+class RADAR_API OdimFileCache {
+ public:
+	/*!
+	 * \param maxFiles	maximum number of open files
+	 * \param maxBytes	maximum total size of the open files, 0 for no limit
+	 */
+	OdimFileCache(size_t maxFiles = 64, uint64_t maxBytes = 0);
+	~OdimFileCache();
+
+	/*!
+	 * \brief Get a new object on the file, opening the file only if it is not cached
+	 * \throws OdimH5Exception	if the file cannot be opened
+	 */
+	std::shared_ptr<OdimObject> open(const std::string& path);
+	/*!
+	 * \brief Get the polar volume stored in a file
+	 * \throws OdimH5FormatException	if the file does not contain a polar volume
+	 */
+	std::shared_ptr<PolarVolume> openPolarVolume(const std::string& path);
+	/*!
+	 * \throws OdimH5FormatException	if the file does not contain an image
+	 */
+	std::shared_ptr<ImageObject> openImageObject(const std::string& path);
+	/*!
+	 * \throws OdimH5FormatException	if the file does not contain a composite
+	 */
+	std::shared_ptr<CompObject> openCompObject(const std::string& path);
+
+	/*!
+	 * \brief Forget a file, e.g. before deleting it
+	 */
+	void invalidate(const std::string& path);
+	/*!
+	 * \brief Forget every file
+	 */
+	void clear();
+
+	void setMaxFiles(size_t val);
+	size_t getMaxFiles() const;
+	void setMaxBytes(uint64_t val);
+	uint64_t getMaxBytes() const;
+
+	/*!
+	 * \brief Number of open files in the cache
+	 */
+	size_t size() const;
+	/*!
+	 * \brief Total size of the open files in the cache
+	 */
+	uint64_t getBytes() const;
+	/*!
+	 * \brief Requests served by the cache
+	 */
+	uint64_t getHits() const		{ return hits.load(); }
+	/*!
+	 * \brief Requests that opened the file
+	 */
+	uint64_t getMisses() const		{ return misses.load(); }
+	/*!
+	 * \brief Cached files found changed on disk and opened again
+	 */
+	uint64_t getInvalidations() const	{ return invalidations.load(); }
+
+ private:
+	class Factory;
+
+	struct Entry {
+		H5::H5File*	file;		/* copied by every object handed out */
+		std::string	object;		/* what/object of the file */
+		int64_t		mtime;		/* nanoseconds */
+		uint64_t	size;
+
+		Entry();
+		~Entry();
+	};
+
+	std::unique_ptr<Factory>		factory;
+	Radar::LRUCache<std::string, Entry>	entries;
+	std::atomic<uint64_t>			hits, misses, invalidations;
+
+	template <class T> std::shared_ptr<T> openAs(const std::string& path, const char* object);
+
+	OdimFileCache(const OdimFileCache&);
+	OdimFileCache& operator=(const OdimFileCache&);
+};
+
+}
+
+#endif
@@ -0,0 +1,323 @@
+/*
+ * odimh5v21_geometry - polar gates geolocation
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <radarlib/odimh5v21_geometry.hpp>
+#include <radarlib/odimh5v21_classes.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+namespace OdimH5v21 {
+namespace geometry {
+
+namespace {
+
+const double DEG2RAD = M_PI / 180.;
+const double RAD2DEG = 180. / M_PI;
+
+/* punto a distanza angolare d (seno e coseno) lungo il radiale di azimuth az (seno e coseno) */
+inline void radialPoint(double sinlat, double coslat, double lon, double sinaz, double cosaz,
+			double sind, double cosd, double& outlat, double& outlon)
+{
+	double sinlat2	= sinlat * cosd + coslat * sind * cosaz;
+	outlat		= asin(sinlat2) * RAD2DEG;
+	outlon		= lon + atan2(sinaz * sind * coslat, cosd - sinlat * sinlat2) * RAD2DEG;
+}
+
+}
+
+/*===========================================================================*/
+/* GREAT CIRCLES */
+/*===========================================================================*/
+
+void distanceAzimuth(double lat1, double lon1, double lat2, double lon2, double& distance, double& azimuth)
+{
+	double phi1	= lat1 * DEG2RAD;
+	double phi2	= lat2 * DEG2RAD;
+	double dlon	= (lon2 - lon1) * DEG2RAD;
+	double sindlat2	= sin((phi2 - phi1) * 0.5);
+	double sindlon2	= sin(dlon * 0.5);
+	double a	= sindlat2 * sindlat2 + cos(phi1) * cos(phi2) * sindlon2 * sindlon2;
+	distance	= 2. * EARTH_RADIUS * asin(sqrt(a < 1. ? a : 1.));
+	azimuth		= atan2(sin(dlon) * cos(phi2), cos(phi1) * sin(phi2) - sin(phi1) * cos(phi2) * cos(dlon)) * RAD2DEG;
+	if (azimuth < 0)
+		azimuth += 360.;
+}
+
+void greatCirclePoint(double lat1, double lon1, double lat2, double lon2, double fraction, double& lat, double& lon)
+{
+	double distance, azimuth;
+	distanceAzimuth(lat1, lon1, lat2, lon2, distance, azimuth);
+	double ground = distance * fraction;
+	PolarGeometry::computeRadial(lat1, lon1, azimuth, &ground, 1, &lat, &lon);
+}
+
+/*===========================================================================*/
+/* RAY AZIMUTHS */
+/*===========================================================================*/
+
+RayAzimuths::RayAzimuths()
+	: start(), stop(), direction(1)
+{
+}
+
+RayAzimuths::RayAzimuths(PolarScan& scan)
+	: start(), stop(), direction(1)
+{
+	const RayTable& table = scan.getRayTable();
+	if (!table.hasAzimuthAngles)
+		return;
+	start.assign(table.startAzimuth(), table.startAzimuth() + table.size());
+	stop.assign(table.stopAzimuth(), table.stopAzimuth() + table.size());
+	direction = table.direction;
+}
+
+double RayAzimuths::centre(int ray, int nrays) const
+{
+	if (isUniform(nrays))
+		return (ray + 0.5) * 360. / nrays;
+	return AZAngles(start[ray], stop[ray]).averagedAngle(direction);
+}
+
+AzimuthIndex RayAzimuths::index(int nrays) const
+{
+	AzimuthIndex index;
+	if (!isUniform(nrays))
+	{
+		index.build(&start[0], &stop[0], nrays, direction);
+		return index;
+	}
+	std::vector<double> first(nrays), last(nrays);
+	for (int i = 0; i < nrays; ++i)
+	{
+		first[i]	= 360. * i / nrays;
+		last[i]		= 360. * (i + 1) / nrays;
+	}
+	index.build(nrays ? &first[0] : NULL, nrays ? &last[0] : NULL, nrays, 1);
+	return index;
+}
+
+std::string RayAzimuths::key() const
+{
+	if (start.empty())
+		return std::string();
+	std::string key = direction < 0 ? "ccw" : "cw";
+	char buff[64];
+	for (size_t i = 0; i < start.size() && i < stop.size(); ++i)
+	{
+		snprintf(buff, sizeof(buff), ";%.17g,%.17g", start[i], stop[i]);
+		key += buff;
+	}
+	return key;
+}
+
+bool RayAzimuths::operator<(const RayAzimuths& o) const
+{
+	if (direction != o.direction)	return direction < o.direction;
+	if (start != o.start)		return start < o.start;
+	return stop < o.stop;
+}
+
+bool RayAzimuths::operator==(const RayAzimuths& o) const
+{
+	return direction == o.direction && start == o.start && stop == o.stop;
+}
+
+/*===========================================================================*/
+/* POLAR GEOMETRY KEY */
+/*===========================================================================*/
+
+PolarGeometryKey::PolarGeometryKey()
+	: lon(0), lat(0), height(0), elangle(0), nbins(0), rscale(0), rstart(0), nrays(0), azimuths()
+{
+}
+
+PolarGeometryKey::PolarGeometryKey(PolarVolume& volume, PolarScan& scan)
+	: lon(volume.getLongitude()),
+	  lat(volume.getLatitude()),
+	  height(volume.getAltitude()),
+	  elangle(scan.getEAngle()),
+	  nbins(scan.getNumBins()),
+	  rscale(scan.getRangeScale()),
+	  rstart(scan.getRangeStart()),
+	  nrays(scan.getNumRays()),
+	  azimuths(scan)
+{
+}
+
+bool PolarGeometryKey::operator<(const PolarGeometryKey& o) const
+{
+	if (lon != o.lon)		return lon < o.lon;
+	if (lat != o.lat)		return lat < o.lat;
+	if (height != o.height)		return height < o.height;
+	if (elangle != o.elangle)	return elangle < o.elangle;
+	if (nbins != o.nbins)		return nbins < o.nbins;
+	if (rscale != o.rscale)		return rscale < o.rscale;
+	if (rstart != o.rstart)		return rstart < o.rstart;
+	if (nrays != o.nrays)		return nrays < o.nrays;
+	return azimuths < o.azimuths;
+}
+
+bool PolarGeometryKey::operator==(const PolarGeometryKey& o) const
+{
+	return !(*this < o) && !(o < *this);
+}
+
+/*===========================================================================*/
+/* POLAR GEOMETRY */
+/*===========================================================================*/
+
+PolarGeometry::PolarGeometry(const PolarGeometryKey& key)
+	: key(key), perbin(), lats(), lons()
+{
+	if (key.nbins < 0 || key.nrays < 0)
+		throw std::invalid_argument("Number of bins and rays cannot be negative");
+
+	size_t nbins = key.nbins;
+	perbin.resize(3 * nbins);
+	double* range	= nbins ? &perbin[0] : NULL;
+	double* ground	= range + nbins;
+	double* height	= ground + nbins;
+	computeBins(key.elangle, key.rstart, key.rscale, key.nbins, range, ground, height);
+	for (size_t i = 0; i < nbins; ++i)
+		height[i] += key.height;
+
+	/* seno e coseno della distanza angolare dei bin sono gli stessi per ogni raggio */
+	std::vector<double> sind(nbins), cosd(nbins);
+	for (size_t i = 0; i < nbins; ++i)
+	{
+		sind[i] = sin(ground[i] / EARTH_RADIUS);
+		cosd[i] = cos(ground[i] / EARTH_RADIUS);
+	}
+
+	const double sinlat	= sin(key.lat * DEG2RAD);
+	const double coslat	= cos(key.lat * DEG2RAD);
+	size_t gates = nbins * key.nrays;
+	lats.resize(gates);
+	lons.resize(gates);
+	for (int r = 0; r < key.nrays; ++r)
+	{
+		double azimuth	= key.azimuths.centre(r, key.nrays) * DEG2RAD;
+		double sinaz	= sin(azimuth);
+		double cosaz	= cos(azimuth);
+		double* outlat	= &lats[r * nbins];
+		double* outlon	= &lons[r * nbins];
+		for (size_t i = 0; i < nbins; ++i)
+			radialPoint(sinlat, coslat, key.lon, sinaz, cosaz, sind[i], cosd[i], outlat[i], outlon[i]);
+	}
+}
+
+size_t PolarGeometry::memorySize() const
+{
+	return sizeof(*this) + (key.azimuths.start.capacity() + key.azimuths.stop.capacity()
+		+ perbin.capacity() + lats.capacity() + lons.capacity()) * sizeof(double);
+}
+
+void PolarGeometry::computeBins(double elangle, double rstart, double rscale, int nbins,
+				double* range, double* ground, double* height)
+{
+	const double re		= EFFECTIVE_EARTH_RADIUS;
+	const double sinel	= sin(elangle * DEG2RAD);
+	const double cosel	= cos(elangle * DEG2RAD);
+	const double first	= rstart * 1000. + rscale * 0.5;
+
+	/* un ciclo per ogni uscita richiesta, senza test sugli elementi */
+	if (range)
+		for (int i = 0; i < nbins; ++i)
+			range[i] = first + rscale * i;
+	if (height)
+		for (int i = 0; i < nbins; ++i)
+		{
+			double r = first + rscale * i;
+			height[i] = sqrt(r * r + re * re + 2. * r * re * sinel) - re;
+		}
+	if (ground && height)
+		for (int i = 0; i < nbins; ++i)
+		{
+			double r = first + rscale * i;
+			ground[i] = re * asin(r * cosel / (re + height[i]));
+		}
+	else if (ground)
+		for (int i = 0; i < nbins; ++i)
+		{
+			double r = first + rscale * i;
+			double h = sqrt(r * r + re * re + 2. * r * re * sinel) - re;
+			ground[i] = re * asin(r * cosel / (re + h));
+		}
+}
+
+void PolarGeometry::computeRadial(double lat, double lon, double azimuth, const double* ground, int count,
+				  double* outlat, double* outlon)
+{
+	const double sinlat	= sin(lat * DEG2RAD);
+	const double coslat	= cos(lat * DEG2RAD);
+	const double sinaz	= sin(azimuth * DEG2RAD);
+	const double cosaz	= cos(azimuth * DEG2RAD);
+
+	for (int i = 0; i < count; ++i)
+	{
+		double d = ground[i] / EARTH_RADIUS;
+		radialPoint(sinlat, coslat, lon, sinaz, cosaz, sin(d), cos(d), outlat[i], outlon[i]);
+	}
+}
+
+/*===========================================================================*/
+/* POLAR GEOMETRY CACHE */
+/*===========================================================================*/
+
+namespace {
+
+PolarGeometry* createGeometry(const PolarGeometryKey& key)
+{
+	return new PolarGeometry(key);
+}
+
+}
+
+PolarGeometryCache::PolarGeometryCache(size_t capacity)
+	: cache(capacity)
+{
+}
+
+PolarGeometryCache::GeometryPtr PolarGeometryCache::get(const PolarGeometryKey& key)
+{
+	return cache.get(key, createGeometry);
+}
+
+PolarGeometryCache::GeometryPtr PolarGeometryCache::get(PolarVolume& volume, PolarScan& scan)
+{
+	return get(PolarGeometryKey(volume, scan));
+}
+
+void PolarGeometryCache::setCapacity(size_t capacity)	{ cache.setCapacity(capacity); }
+size_t PolarGeometryCache::getCapacity() const		{ return cache.getCapacity(); }
+size_t PolarGeometryCache::size() const			{ return cache.size(); }
+void PolarGeometryCache::clear()			{ cache.clear(); }
+size_t PolarGeometryCache::getHits() const		{ return cache.getHits(); }
+size_t PolarGeometryCache::getMisses() const		{ return cache.getMisses(); }
+
+PolarGeometryCache& PolarGeometryCache::global()
+{
+	static PolarGeometryCache cache;
+	return cache;
+}
+
+}
+}
@@ -0,0 +1,284 @@
+/*
+ * odimh5v21_geometry - polar gates geolocation
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef __RADAR_ODIMH5V21_GEOMETRY_HPP__
+#define __RADAR_ODIMH5V21_GEOMETRY_HPP__
+/*!
+ * \file
+ * \brief Geolocation of polar gates
+ */
+
+#include <radarlib/defs.h>
+#include <radarlib/cache.hpp>
+#include <radarlib/odimh5v21_support.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace OdimH5v21 {
+
+class PolarVolume;
+class PolarScan;
+
+namespace geometry {
+
+/*!
+ * \brief Mean earth radius (m)
+ */
+const double EARTH_RADIUS = 6371000.;
+/*!
+ * \brief Effective earth radius (m) of the standard 4/3 earth refraction model
+ */
+const double EFFECTIVE_EARTH_RADIUS = EARTH_RADIUS * 4. / 3.;
+
+/*!
+ * \brief Great circle distance and azimuth between two points
+ * \param distance	distance (m) on a sphere of radius EARTH_RADIUS
+ * \param azimuth	azimuth (degrees, 0 to 360) of the second point seen from the first
+ */
+RADAR_API void distanceAzimuth(double lat1, double lon1, double lat2, double lon2, double& distance, double& azimuth);
+/*!
+ * \brief Point at the given fraction of the great circle arc between two points
+ */
+RADAR_API void greatCirclePoint(double lat1, double lon1, double lat2, double lon2, double fraction, double& lat, double& lon);
+
+/*!
+ * \brief Azimuths of the rays of a polar scan
+ *
+ * Start and stop azimuths are the ones of how/startazA and how/stopazA. When a
+ * scan has none both arrays are empty and the rays are assumed to have the same
+ * width and to start from north, so ray i covers the sector from i * 360 / nrays
+ * to (i + 1) * 360 / nrays. Arrays whose size is not the number of rays of the
+ * scan are handled the same way.
+ */
+struct RADAR_API RayAzimuths {
+	std::vector<double>	start;		/*!< start azimuth (degrees) of each ray, empty for uniform rays */
+	std::vector<double>	stop;		/*!< stop azimuth (degrees) of each ray, empty for uniform rays */
+	int			direction;	/*!< 1 for clockwise scans, -1 for counter-clockwise scans */
+
+	/*!
+	 * \brief Uniform rays starting from north
+	 */
+	RayAzimuths();
+	/*!
+	 * \brief Read the azimuths from the ray table of a scan
+	 */
+	explicit RayAzimuths(PolarScan& scan);
+
+	/*!
+	 * \brief True if the rays of a scan with nrays rays are uniform
+	 */
+	bool isUniform(int nrays) const { return start.size() != (size_t)nrays || stop.size() != (size_t)nrays; }
+	/*!
+	 * \brief Centre azimuth (degrees) of a ray of a scan with nrays rays
+	 */
+	double centre(int ray, int nrays) const;
+	/*!
+	 * \brief Lookup index from azimuth to ray of a scan with nrays rays
+	 */
+	AzimuthIndex index(int nrays) const;
+	/*!
+	 * \brief String that identifies the azimuths in caches, empty for uniform rays
+	 */
+	std::string key() const;
+
+	bool operator<(const RayAzimuths& other) const;
+	bool operator==(const RayAzimuths& other) const;
+};
+
+/*!
+ * \brief Values that identify the geometry of a polar scan
+ *
+ * Units are the ones of the ODIM where/ attributes: degrees for angles and
+ * site coordinates, meters for the site altitude and rscale, km for rstart.
+ */
+struct RADAR_API PolarGeometryKey {
+	double		lon;
+	double		lat;
+	double		height;
+	double		elangle;
+	int		nbins;
+	double		rscale;
+	double		rstart;
+	int		nrays;
+	RayAzimuths	azimuths;
+
+	PolarGeometryKey();
+	/*!
+	 * \brief Read the key from a scan of a volume
+	 *
+	 * The site coordinates are read from the volume, everything else from the scan.
+	 */
+	PolarGeometryKey(PolarVolume& volume, PolarScan& scan);
+
+	bool operator<(const PolarGeometryKey& other) const;
+	bool operator==(const PolarGeometryKey& other) const;
+};
+
+/*!
+ * \brief Precomputed location of every gate of a polar scan
+ *
+ * Per bin arrays refer to the centre of the bin and are the same for every ray.
+ * Per gate arrays are stored ray by ray (index ray * nbins + bin) and refer to
+ * the centre azimuth of each ray, see RayAzimuths::centre().
+ *
+ * Heights and ground distances follow the 4/3 effective earth radius model,
+ * latitudes and longitudes are computed on a spherical earth.
+ */
+class RADAR_API PolarGeometry {
+ public:
+	/*!
+	 * \brief Compute the geometry
+	 * \throws std::invalid_argument if nbins or nrays are negative
+	 */
+	PolarGeometry(const PolarGeometryKey& key);
+
+	/*!
+	 * \brief Values used to compute the geometry
+	 */
+	const PolarGeometryKey& getKey() const { return key; }
+	int getNumBins() const { return key.nbins; }
+	int getNumRays() const { return key.nrays; }
+
+	/*!
+	 * \brief Slant range (m) of each bin
+	 */
+	const double* range() const { return bins(0); }
+	/*!
+	 * \brief Distance (m) along the earth surface from the site of each bin
+	 */
+	const double* groundDistance() const { return bins(1); }
+	/*!
+	 * \brief Height (m) above sea level of each bin
+	 */
+	const double* height() const { return bins(2); }
+	/*!
+	 * \brief Latitude (degrees) of each gate
+	 */
+	const double* latitude() const { return key.nrays && key.nbins ? &lats[0] : NULL; }
+	/*!
+	 * \brief Longitude (degrees) of each gate
+	 */
+	const double* longitude() const { return key.nrays && key.nbins ? &lons[0] : NULL; }
+
+	/*!
+	 * \brief Memory used by the arrays, in bytes
+	 */
+	size_t memorySize() const;
+
+	/*!
+	 * \brief Compute slant range, ground distance and height of bins
+	 *
+	 * \param elangle	elevation angle (degrees)
+	 * \param rstart	range of the start of the first bin (km)
+	 * \param rscale	length of bins (m)
+	 * \param nbins		number of bins and size of the output arrays
+	 * \param range		output slant range (m), can be NULL
+	 * \param ground	output ground distance (m), can be NULL
+	 * \param height	output height (m) above the antenna, can be NULL
+	 */
+	static void computeBins(double elangle, double rstart, double rscale, int nbins,
+				double* range, double* ground, double* height);
+	/*!
+	 * \brief Compute latitude and longitude of points along a radial
+	 *
+	 * \param lat		site latitude (degrees)
+	 * \param lon		site longitude (degrees)
+	 * \param azimuth	azimuth of the radial (degrees)
+	 * \param ground	ground distances (m) from the site
+	 * \param count		number of points
+	 * \param outlat	output latitudes (degrees)
+	 * \param outlon	output longitudes (degrees)
+	 */
+	static void computeRadial(double lat, double lon, double azimuth, const double* ground, int count,
+				  double* outlat, double* outlon);
+
+ private:
+	PolarGeometryKey	key;
+	std::vector<double>	perbin;
+	std::vector<double>	lats;
+	std::vector<double>	lons;
+
+	const double* bins(int col) const { return key.nbins ? &perbin[(size_t)col * key.nbins] : NULL; }
+};
+
+/*!
+ * \brief Bounded LRU cache of polar geometries
+ *
+ * Geometries are shared: a geometry evicted from the cache stays valid for
+ * the users still holding it. All methods are thread safe.
+ * \see Radar::LRUCache
+ */
+class RADAR_API PolarGeometryCache {
+ public:
+	typedef std::shared_ptr<const PolarGeometry> GeometryPtr;
+
+	/*!
+	 * \brief Create a cache
+	 * \param capacity	maximum number of geometries kept in the cache
+	 */
+	PolarGeometryCache(size_t capacity = 32);
+
+	/*!
+	 * \brief Get the geometry for the given key, computing it if it is not cached
+	 */
+	GeometryPtr get(const PolarGeometryKey& key);
+	/*!
+	 * \brief Get the geometry of a scan of a volume
+	 */
+	GeometryPtr get(PolarVolume& volume, PolarScan& scan);
+
+	/*!
+	 * \brief Change the capacity, evicting the least recently used geometries if needed
+	 */
+	void setCapacity(size_t capacity);
+	size_t getCapacity() const;
+	/*!
+	 * \brief Number of cached geometries
+	 */
+	size_t size() const;
+	/*!
+	 * \brief Remove every geometry from the cache
+	 */
+	void clear();
+
+	/*!
+	 * \brief Number of get() calls satisfied by the cache
+	 */
+	size_t getHits() const;
+	/*!
+	 * \brief Number of get() calls that computed a geometry
+	 */
+	size_t getMisses() const;
+
+	/*!
+	 * \brief Cache shared by the whole process
+	 */
+	static PolarGeometryCache& global();
+
+ private:
+	Radar::LRUCache<PolarGeometryKey, const PolarGeometry>	cache;
+};
+
+}
+}
+
+#endif
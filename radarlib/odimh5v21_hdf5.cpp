@@ -29,11 +29,14 @@
 #include <sstream>
 #include <assert.h>
 #include <memory>
+#include <stdexcept>
+#include <chrono>
 
 #include <radarlib/debug.hpp>
 #include <radarlib/string.hpp>
 #include <radarlib/odimh5v21_const.hpp>
 #include <radarlib/odimh5v21_exceptions.hpp>
+#include <radarlib/odimh5v21_stats.hpp>
 
 namespace OdimH5v21 {
 
@@ -59,30 +62,245 @@ namespace OdimH5v21 {
 //atic const H5::FloatType	FLOATTYPE	(H5::PredType::NATIVE_FLOAT);
 
 /*===========================================================================*/
-/* HDF5 FILE */
+/* HDF5 LIBRARY */
 /*===========================================================================*/
 
-static int odimh5_init = 0;
+HDF5Library::HDF5Library()
+:printErrors(true)
+,policy(HDF5_GC_EVERY_FACTORY)
+,parameter(0)
+,files(0)
+,filesSinceGC(0)
+,collections(0)
+,callMutex()
+,lockPolicy(HDF5_LOCK_AUTO)
+,locking(false)
+,lockCount(0)
+,lockWaits(0)
+,lockWaitTime(0)
+{
+	if (H5open() < 0)
+		throw OdimH5HDF5LibException("H5open() failed");
+	locking = !isThreadSafe();
+}
+
+HDF5Library& HDF5Library::instance()
+{
+	/* mai distrutta: i file possono essere chiusi da distruttori statici */
+	static HDF5Library* library = new HDF5Library();
+	return *library;
+}
+
+void HDF5Library::setPrintErrors(bool value)
+{
+	HDF5Lock h5lock;
+	std::lock_guard<std::mutex> lock(mutex);
+	herr_t result = value ? H5Eset_auto2(H5E_DEFAULT, (H5E_auto2_t)H5Eprint2, stderr) : H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+	if (result < 0)
+		throw OdimH5HDF5LibException("Cannot change the printing of HDF5 errors");
+	printErrors = value;
+}
+
+bool HDF5Library::getPrintErrors() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return printErrors;
+}
+
+void HDF5Library::setGCPolicy(HDF5GCPolicy value, uint64_t param)
+{
+	if ((value == HDF5_GC_EVERY_N_FILES || value == HDF5_GC_MEMORY_THRESHOLD) && param == 0)
+		throw std::invalid_argument("HDF5 garbage collection policy needs a parameter greater than 0");
+#if !H5_VERSION_GE(1,10,7)
+	if (value == HDF5_GC_MEMORY_THRESHOLD)
+		throw std::invalid_argument("This HDF5 version cannot report the size of its free lists");
+#endif
+	std::lock_guard<std::mutex> lock(mutex);
+	policy		= value;
+	parameter	= param;
+	filesSinceGC	= 0;
+}
+
+HDF5GCPolicy HDF5Library::getGCPolicy() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return policy;
+}
+
+uint64_t HDF5Library::getGCParameter() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return parameter;
+}
+
+uint64_t HDF5Library::getFileCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return files;
+}
+
+uint64_t HDF5Library::getGCCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return collections;
+}
+
+void HDF5Library::garbageCollect()
+{
+	HDF5Lock h5lock;
+	std::lock_guard<std::mutex> lock(mutex);
+	collect();
+}
+
+uint64_t HDF5Library::getFreeListSize()
+{
+#if H5_VERSION_GE(1,10,7)
+	HDF5Lock h5lock;
+	size_t reg = 0, arr = 0, blk = 0, fac = 0;
+	if (H5get_free_list_sizes(&reg, &arr, &blk, &fac) < 0)
+		return 0;
+	return (uint64_t)reg + arr + blk + fac;
+#else
+	return 0;
+#endif
+}
+
+void HDF5Library::fileOpening()
+{
+	HDF5Lock h5lock;
+	std::lock_guard<std::mutex> lock(mutex);
+	if (policy == HDF5_GC_EVERY_N_FILES && filesSinceGC >= parameter)
+		collect();
+	else if (policy == HDF5_GC_MEMORY_THRESHOLD && getFreeListSize() > parameter)
+		collect();
+	files++;
+	filesSinceGC++;
+}
+
+void HDF5Library::fileClosed()
+{
+	/* le altre politiche sono verificate all'apertura dei file */
+	HDF5Lock h5lock;
+	std::lock_guard<std::mutex> lock(mutex);
+	if (policy == HDF5_GC_EVERY_FACTORY)
+		collect();
+}
 
-static void initLibrary()
+void HDF5Library::factoryReleased()
 {
-	if (odimh5_init)
+	HDF5Lock h5lock;
+	std::lock_guard<std::mutex> lock(mutex);
+	if (policy == HDF5_GC_EVERY_FACTORY)
+		collect();
+	else if (policy == HDF5_GC_EVERY_N_FILES && filesSinceGC >= parameter)
+		collect();
+	else if (policy == HDF5_GC_MEMORY_THRESHOLD && getFreeListSize() > parameter)
+		collect();
+}
+
+void HDF5Library::collect()
+{
+	/* chiamata con HDF5Lock e il mutex acquisiti, in quest'ordine */
+	H5garbage_collect();
+	filesSinceGC = 0;
+	collections++;
+}
+
+bool HDF5Library::isThreadSafe()
+{
+#if H5_VERSION_GE(1,8,16)
+	hbool_t result = 0;
+	if (H5is_library_threadsafe(&result) < 0)
+		return false;
+	return result != 0;
+#elif defined(H5_HAVE_THREADSAFE)
+	return true;
+#else
+	return false;
+#endif
+}
+
+void HDF5Library::setLockPolicy(HDF5LockPolicy value)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	lockPolicy = value;
+	locking = value == HDF5_LOCK_ALWAYS || (value == HDF5_LOCK_AUTO && !isThreadSafe());
+}
+
+/*===========================================================================*/
+/* HDF5 LOCK */
+/*===========================================================================*/
+
+HDF5Lock::HDF5Lock()
+:locked(false)
+{
+	HDF5Library& library = HDF5Library::instance();
+	if (!library.isLocking())
 		return;
-	try
+	if (!library.callMutex.try_lock())
 	{
-		//H5::Exception::dontPrint();
-		odimh5_init++;
+		/* si misura solo l'attesa, il caso senza contesa costa un try_lock */
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		library.callMutex.lock();
+		library.lockWaits.fetch_add(1, std::memory_order_relaxed);
+		library.lockWaitTime.fetch_add((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
 	}
-	catch (H5::Exception& h5e)
+	library.lockCount.fetch_add(1, std::memory_order_relaxed);
+	locked = true;
+}
+
+HDF5Lock::~HDF5Lock()
+{
+	if (locked)
+		HDF5Library::instance().callMutex.unlock();
+}
+
+RawType getRawType(const H5::DataType& type)
+{
+	HDF5Lock lock;
+	if (type == H5::PredType::NATIVE_INT8)		return RAW_INT8;
+	if (type == H5::PredType::NATIVE_UINT8)		return RAW_UINT8;
+	if (type == H5::PredType::NATIVE_INT16)		return RAW_INT16;
+	if (type == H5::PredType::NATIVE_UINT16)	return RAW_UINT16;
+	if (type == H5::PredType::NATIVE_FLOAT)		return RAW_FLOAT;
+	return RAW_OTHER;
+}
+
+const H5::PredType& getH5Type(RawType type)
+{
+	switch (type)
+	{
+		case RAW_INT8:		return H5::PredType::NATIVE_INT8;
+		case RAW_UINT8:		return H5::PredType::NATIVE_UINT8;
+		case RAW_INT16:		return H5::PredType::NATIVE_INT16;
+		case RAW_UINT16:	return H5::PredType::NATIVE_UINT16;
+		case RAW_FLOAT:		return H5::PredType::NATIVE_FLOAT;
+		default:		throw OdimH5UnsupportedException("Raw type without an HDF5 type");
+	}
+}
+
+size_t getRawSize(RawType type)
+{
+	switch (type)
 	{
-		throw OdimH5HDF5LibException("H5::Exception::dontPrint() failed: ", h5e);
+		case RAW_INT8:
+		case RAW_UINT8:		return 1;
+		case RAW_INT16:
+		case RAW_UINT16:	return 2;
+		case RAW_FLOAT:		return sizeof(float);
+		default:		return 0;
 	}
 }
 
+/*===========================================================================*/
+/* HDF5 FILE */
+/*===========================================================================*/
 
 H5::H5File* HDF5File::open(const std::string& path, int h5flags) 
 {
-	initLibrary();
+	HDF5Lock lock;
+	HDF5Library::instance().fileOpening();
+	HDF5StatsScope stats(HDF5_STATS_FILE_OPEN);
 	try
 	{	
 		return new H5::H5File(path.c_str(), h5flags);
@@ -96,7 +314,9 @@ H5::H5File* HDF5File::open(const std::string& path, int h5flags)
 
 H5::Group* HDF5File::getRoot(H5::H5File* file) 
 {
+	HDF5Lock lock;
 	if (file==NULL) throw std::invalid_argument("H5 FILE is NULL");		
+	HDF5StatsScope stats(HDF5_STATS_GROUP_OPEN);
 	try
 	{
 		return new H5::Group( file->openGroup("/") );
@@ -116,6 +336,7 @@ static inline bool attrExists(H5::H5Object* object, const char* name)
 	if (object == NULL) throw std::invalid_argument("H5Object is NULL");	
 	if (name   == NULL) throw std::invalid_argument("name is NULL");	
 	
+	HDF5StatsScope stats(HDF5_STATS_ATTRIBUTE_EXISTS);
 	hid_t  id     = object->getId();
 	htri_t result = H5Aexists(id, name);
 	if (result < 0) {
@@ -127,8 +348,12 @@ static inline bool attrExists(H5::H5Object* object, const char* name)
 
 H5::Attribute* HDF5Attribute::get(H5::H5Object* obj, const char* name, bool mandatory)
 {
+	HDF5Lock lock;
 	if (attrExists(obj, name))
-		return new H5::Attribute(obj->openAttribute(name));		
+	{
+		HDF5StatsScope stats(HDF5_STATS_ATTRIBUTE_READ);
+		return new H5::Attribute(obj->openAttribute(name));
+	}		
 	if (mandatory)
 		throw OdimH5MissingAttributeException("Mandatory attribute " + std::string(name) + " not found");
 	return NULL;
@@ -136,12 +361,14 @@ H5::Attribute* HDF5Attribute::get(H5::H5Object* obj, const char* name, bool mand
 
 bool HDF5Attribute::exists(H5::H5Object* object, const char* name) 	//throw (H5::Exception)
 {
+	HDF5Lock lock;
 	return attrExists(object, name);
 }
 
 static void attrRemove(H5::H5Object* obj, const char* name) 
 {
 	if (obj==NULL) throw std::invalid_argument("obj is NULL");		
+	HDF5StatsScope stats(HDF5_STATS_ATTRIBUTE_REMOVE);
 	try
 	{
 		obj->removeAttr(name);
@@ -154,12 +381,14 @@ static void attrRemove(H5::H5Object* obj, const char* name)
 
 void HDF5Attribute::remove(H5::H5Object* obj, const char* name)	// throw (H5::Exception)
 {
+	HDF5Lock lock;
 	if (attrExists(obj, name))
 		attrRemove(obj, name);
 }
 
 std::string HDF5Attribute::getName(H5::Attribute* attr)
 {
+	HDF5Lock lock;
 	/* NOTA: la funzione H5::Attribute->getName() sembra non funzionare, quindi uso questo wrapper */
 	char buff[200+1];	
 	size_t len = H5Aget_name(attr->getId(), 200, buff);
@@ -169,9 +398,11 @@ std::string HDF5Attribute::getName(H5::Attribute* attr)
 
 void HDF5Attribute::set(H5::H5Object* obj, const char* name, int64_t value)	// throw (H5::Exception)
 {
+	HDF5Lock lock;
 	if (attrExists(obj, name))
 		attrRemove(obj, name);
 
+	HDF5StatsScope stats(HDF5_STATS_ATTRIBUTE_WRITE, sizeof(value));
 	H5::Attribute* attr = NULL;
 	try 
 	{
@@ -195,9 +426,11 @@ void HDF5Attribute::set(H5::H5Object* obj, const char* name, int64_t value)	// t
 
 void HDF5Attribute::set(H5::H5Object* obj, const char* name, double value) 
 {
+	HDF5Lock lock;
 	if (attrExists(obj, name))
 		attrRemove(obj, name);
 
+	HDF5StatsScope stats(HDF5_STATS_ATTRIBUTE_WRITE, sizeof(value));
 	H5::Attribute* attr = NULL;
 	try 
 	{
@@ -221,9 +454,11 @@ void HDF5Attribute::set(H5::H5Object* obj, const char* name, double value)
 
 void HDF5Attribute::set(H5::H5Object* obj, const char* name, const std::string& value)	// throw (H5::Exception)
 {
+	HDF5Lock lock;
 	if (attrExists(obj, name))
 		attrRemove(obj, name);
 
+	HDF5StatsScope stats(HDF5_STATS_ATTRIBUTE_WRITE, value.length() + 1);
 	H5::Attribute* attr = NULL;
 	try
 	{
@@ -260,6 +495,7 @@ void HDF5Attribute::set(H5::H5Object* obj, const char* name, const char* value)
 
 static int64_t attrGetLong(H5::H5Object* obj, const char* name) 
 {
+	HDF5StatsScope stats(HDF5_STATS_ATTRIBUTE_READ, sizeof(int64_t));
 	H5::Attribute* attr = NULL;
 	try {
 		int64_t result = 0;
@@ -284,6 +520,7 @@ static int64_t attrGetLong(H5::H5Object* obj, const char* name)
 
 int64_t HDF5Attribute::getLong(H5::H5Object* obj, const char* name) 
 {
+	HDF5Lock lock;
 	if (!attrExists(obj, name))
 		throw OdimH5MissingAttributeException("Cannot open/read mandatory attribute " + std::string(name));
 	return attrGetLong(obj, name);
@@ -291,6 +528,7 @@ int64_t HDF5Attribute::getLong(H5::H5Object* obj, const char* name)
 
 int64_t HDF5Attribute::getLong(H5::H5Object* obj, const char* name, int64_t defaultValue) 
 {
+	HDF5Lock lock;
 	if (!attrExists(obj, name))
 		return defaultValue;
 	return attrGetLong(obj, name);
@@ -298,6 +536,7 @@ int64_t HDF5Attribute::getLong(H5::H5Object* obj, const char* name, int64_t defa
 
 static double attrGetDouble(H5::H5Object* obj, const char* name)
 {
+	HDF5StatsScope stats(HDF5_STATS_ATTRIBUTE_READ, sizeof(double));
 	H5::Attribute* attr = NULL;
 	try 
 	{
@@ -323,6 +562,7 @@ static double attrGetDouble(H5::H5Object* obj, const char* name)
 
 double HDF5Attribute::getDouble(H5::H5Object* obj, const char* name)
 {
+	HDF5Lock lock;
 	if (!attrExists(obj, name)) {
 		std::ostringstream ss; ss << "Cannot open/read mandatory attribute " << name;
 		throw OdimH5MissingAttributeException(ss.str());
@@ -332,6 +572,7 @@ double HDF5Attribute::getDouble(H5::H5Object* obj, const char* name)
 
 double HDF5Attribute::getDouble(H5::H5Object* obj, const char* name, double defaultValue)
 {
+	HDF5Lock lock;
 	if (!attrExists(obj, name))
 		return defaultValue;
 	return attrGetDouble(obj, name);
@@ -339,6 +580,7 @@ double HDF5Attribute::getDouble(H5::H5Object* obj, const char* name, double defa
 
 std::string attrGetStr(H5::H5Object* obj, const char* name)
 {
+	HDF5StatsScope stats(HDF5_STATS_ATTRIBUTE_READ);
 	H5::Attribute* attr = NULL;
 	char* buf[1] = { NULL };	//NOTA: non si capisce bene perche' l'implementazione interna vuole cosi' altrimenti crasha tutto
 	try
@@ -356,6 +598,7 @@ std::string attrGetStr(H5::H5Object* obj, const char* name)
 		attr = new H5::Attribute(obj->openAttribute(name));		
 		H5::StrType STRTYPE = attr->getStrType();
 		size_t len = (size_t)attr->getStorageSize();
+		stats.setBytes(len);
 		buf[0] = new char[len];
 		attr->read(STRTYPE, buf[0]);		//attr->read(StrType(PredType::C_S1, H5T_VARIABLE), buf);
 		result = buf[0];
@@ -382,6 +625,7 @@ std::string attrGetStr(H5::H5Object* obj, const char* name)
 
 std::string HDF5Attribute::getStr(H5::H5Object* obj, const char* name)
 {
+	HDF5Lock lock;
 	if (!attrExists(obj, name))
 		THROW_EXCEPTION(OdimH5MissingAttributeException, "Cannot open/read mandatory attribute " << name);
 	return attrGetStr(obj, name);
@@ -389,6 +633,7 @@ std::string HDF5Attribute::getStr(H5::H5Object* obj, const char* name)
 
 std::string HDF5Attribute::getStr(H5::H5Object* obj, const char* name, const std::string& defaultValue)
 {
+	HDF5Lock lock;
 	if (!attrExists(obj, name))
 		return defaultValue;
 	return attrGetStr(obj, name);
@@ -398,6 +643,12 @@ std::string HDF5Attribute::getStr(H5::H5Object* obj, const char* name, const std
 /* HDF5GROUP */
 /*===========================================================================*/
 
+static inline herr_t iterateLinks(H5::Group* parent, H5L_iterate_t op, void* data)
+{
+	HDF5StatsScope stats(HDF5_STATS_GROUP_ITERATE);
+	return H5Literate(parent->getId(), H5_INDEX_NAME, H5_ITER_INC, NULL, op, data);
+}
+
 struct iterate_group_data
 {
 	const char*	searchName;	
@@ -425,18 +676,20 @@ static herr_t find_group(hid_t loc_id, const char *name, const H5L_info_t *linfo
 
 H5::Group* HDF5Group::getChild(H5::Group* parent, const char* name)	// throw (H5::Exception)
 {
+	HDF5Lock lock;
 	if (parent==NULL)	THROW_EXCEPTION(std::invalid_argument, "parent is NULL");		
 	if (name==NULL)		THROW_EXCEPTION(std::invalid_argument, "name is NULL");		
 
 	iterate_group_data data(name);
-	herr_t result = H5Literate(parent->getId(), H5_INDEX_NAME, H5_ITER_INC, NULL, find_group, &data);
+	herr_t result = iterateLinks(parent, find_group, &data);
 	if (result < 0)
 		THROW_EXCEPTION(OdimH5HDF5LibException, "H5Literate("<<parent->getId()<<",...,"<<name<<") failed: " << result);
 	try
 	{
-		if (data.found)
-			return new H5::Group(parent->openGroup(name) );	
-		return NULL;
+		if (!data.found)
+			return NULL;
+		HDF5StatsScope stats(HDF5_STATS_GROUP_OPEN);
+		return new H5::Group(parent->openGroup(name) );
 	}
 	catch (H5::Exception& h5e)
 	{		
@@ -447,12 +700,13 @@ H5::Group* HDF5Group::getChild(H5::Group* parent, const char* name)	// throw (H5
 
 void HDF5Group::ensureChild(H5::Group* parent, const char* name)	// throw (H5::Exception)
 {
+	HDF5Lock lock;
 	if (parent==NULL)	throw std::invalid_argument("HDF5 parent group is NULL");		
 	if (name==NULL)		throw std::invalid_argument("name is NULL");		
 
 	iterate_group_data data(name);
 
-	herr_t result = H5Literate(parent->getId(), H5_INDEX_NAME, H5_ITER_INC, NULL, find_group, &data);
+	herr_t result = iterateLinks(parent, find_group, &data);
 
 	if (result < 0) 
 	{
@@ -462,6 +716,7 @@ void HDF5Group::ensureChild(H5::Group* parent, const char* name)	// throw (H5::E
 
 	if (!data.found)
 	{
+		HDF5StatsScope stats(HDF5_STATS_GROUP_CREATE);
 		try
 		{
 			delete new H5::Group(parent->createGroup(name) );	
@@ -476,13 +731,14 @@ void HDF5Group::ensureChild(H5::Group* parent, const char* name)	// throw (H5::E
 
 H5::Group* HDF5Group::ensureGetChild(H5::Group* parent, const char* name)	// throw (H5::Exception)
 {
+	HDF5Lock lock;
 	if (parent==NULL)	throw std::invalid_argument("HDF5 parent group is NULL");		
 	if (name==NULL)		throw std::invalid_argument("name is NULL");		
 
 
 	iterate_group_data data(name);
 
-	herr_t result = H5Literate(parent->getId(), H5_INDEX_NAME, H5_ITER_INC, NULL, find_group, &data);
+	herr_t result = iterateLinks(parent, find_group, &data);
 
 	if (result < 0)
 	{
@@ -492,6 +748,7 @@ H5::Group* HDF5Group::ensureGetChild(H5::Group* parent, const char* name)	// thr
 
 	if (data.found)
 	{
+		HDF5StatsScope stats(HDF5_STATS_GROUP_OPEN);
 		try
 		{
 			return new H5::Group(parent->openGroup(name) );	
@@ -504,6 +761,7 @@ H5::Group* HDF5Group::ensureGetChild(H5::Group* parent, const char* name)	// thr
 	}		
 	else
 	{
+		HDF5StatsScope stats(HDF5_STATS_GROUP_CREATE);
 		try
 		{
 			return new H5::Group(parent->createGroup(name) );	
@@ -529,12 +787,13 @@ static herr_t count_group(hid_t loc_id, const char *name, const H5L_info_t *linf
 
 int HDF5Group::getChildCount(H5::Group* parent, const char* prefix) //throw (H5::Exception)
 {
+	HDF5Lock lock;
 	if (parent==NULL)	throw std::invalid_argument("HDF5 parent group is NULL");		
 	if (prefix==NULL)	throw std::invalid_argument("prefix is NULL");		
 
 	iterate_group_data data(prefix);
 
-	herr_t result = H5Literate(parent->getId(), H5_INDEX_NAME, H5_ITER_INC, NULL, count_group, &data);
+	herr_t result = iterateLinks(parent, count_group, &data);
 
 	if (result < 0)
 	{
@@ -549,12 +808,13 @@ int HDF5Group::getChildCount(H5::Group* parent, const char* prefix) //throw (H5:
 
 void HDF5Group::removeChild(H5::Group* parent, const char* name)	//	throw (H5::Exception)
 {
+	HDF5Lock lock;
 	if (parent==NULL)	throw std::invalid_argument("HDF5 parent group is NULL");		
 	if (name==NULL)		throw std::invalid_argument("name is NULL");		
 
 	iterate_group_data data(name);
 
-	herr_t result = H5Literate(parent->getId(), H5_INDEX_NAME, H5_ITER_INC, NULL, find_group, &data);
+	herr_t result = iterateLinks(parent, find_group, &data);
 
 	if (result < 0)
 	{
@@ -564,6 +824,7 @@ void HDF5Group::removeChild(H5::Group* parent, const char* name)	//	throw (H5::E
 
 	if (data.found)
 	{
+		HDF5StatsScope stats(HDF5_STATS_GROUP_UNLINK);
 		try
 		{			
 			parent->unlink(name);
@@ -605,12 +866,13 @@ static  herr_t find_dataset(hid_t loc_id, const char *name, const H5L_info_t *li
 
 bool HDF5Group::exists(H5::Group* parent, const char* name)
 {
+	HDF5Lock lock;
 	if (parent==NULL)	throw std::invalid_argument("HDF5 parent group is NULL");		
 	if (name==NULL)		throw std::invalid_argument("name is NULL");		
 
 	iterate_dataset_data data(name);
 
-	herr_t result = H5Literate(parent->getId(), H5_INDEX_NAME, H5_ITER_INC, NULL, find_dataset, &data);
+	herr_t result = iterateLinks(parent, find_dataset, &data);
 
 	if (result < 0)
 	{
@@ -623,12 +885,13 @@ bool HDF5Group::exists(H5::Group* parent, const char* name)
 
 H5::DataSet* HDF5Group::getDataset(H5::Group* parent, const char* name) 
 {
+	HDF5Lock lock;
 	if (parent==NULL)	throw std::invalid_argument("HDF5 parent group is NULL");	
 	if (name==NULL)		throw std::invalid_argument("name is NULL");		
 
 	iterate_dataset_data data(name);
 
-	herr_t result = H5Literate(parent->getId(), H5_INDEX_NAME, H5_ITER_INC, NULL, find_dataset, &data);
+	herr_t result = iterateLinks(parent, find_dataset, &data);
 
 	if (result < 0)
 	{
@@ -638,6 +901,7 @@ H5::DataSet* HDF5Group::getDataset(H5::Group* parent, const char* name)
 
 	if (data.found)
 	{
+		HDF5StatsScope stats(HDF5_STATS_DATASET_OPEN);
 		try
 		{
 			return new H5::DataSet(parent->openDataSet(name) );	
@@ -662,8 +926,11 @@ void HDF5Group::copyAttributes(H5::Group* src, H5::Group* dst)
 
 void HDF5Group::copyAttributes(H5::Group* src, H5::Group* dst, const std::set<std::string>& names)
 {	
+	HDF5Lock	lock;
 	H5::Attribute*	srcAttr	= NULL;
 	H5::Attribute*	dstAttr	= NULL;
+	HDF5StatsScope	stats(HDF5_STATS_ATTRIBUTE_COPY);
+	uint64_t	copied	= 0;
 
 	try
 	{
@@ -697,6 +964,8 @@ void HDF5Group::copyAttributes(H5::Group* src, H5::Group* dst, const std::set<st
 			dstAttr	= new H5::Attribute(dst->createAttribute(name.c_str(), srcAttr->getDataType(), srcAttr->getSpace()));
 
 			dstAttr->write(dstAttr->getDataType(), &(buff[0]));
+			copied += storagesize;
+			stats.setBytes(copied);
 
 			delete srcAttr; srcAttr	= NULL;
 			delete dstAttr; dstAttr = NULL;
@@ -805,6 +1074,7 @@ std::cerr << name << std::endl;
 
 H5::AtomType HDF5AtomType::fromDataType(const H5::DataType& type)
 {
+	HDF5Lock lock;
 	#define CASE(spectype)	if (type == H5::PredType::spectype) return H5::PredType::spectype;
 
 	CASE(STD_I8BE)
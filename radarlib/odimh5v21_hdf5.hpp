@@ -47,9 +47,193 @@
 //#endif
 
 #include <set>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
 
 namespace OdimH5v21 {
 
+/*===========================================================================*/
+/* HDF5 LIBRARY */
+/*===========================================================================*/
+
+/*!
+ * \brief When the HDF5 free lists are garbage collected
+ */
+enum HDF5GCPolicy {
+	HDF5_GC_EVERY_FACTORY,		/*!< each time an object is closed or an OdimFactory is destroyed (default) */
+	HDF5_GC_NEVER,			/*!< only when HDF5Library::garbageCollect() is called */
+	HDF5_GC_EVERY_N_FILES,		/*!< after the given number of files has been opened */
+	HDF5_GC_MEMORY_THRESHOLD	/*!< when the free lists hold more than the given bytes */
+};
+
+/*!
+ * \brief When calls to HDF5 are serialized by the library
+ */
+enum HDF5LockPolicy {
+	HDF5_LOCK_AUTO,			/*!< unless HDF5 was built thread safe (default) */
+	HDF5_LOCK_ALWAYS,		/*!< always, e.g. to measure the contention */
+	HDF5_LOCK_NEVER			/*!< never, for single threaded programs */
+};
+
+/*!
+ * \brief Process-wide state of the HDF5 library shared by all the factories
+ *
+ * Owns the initialisation of HDF5, the printing of HDF5 error stacks and the
+ * policy used to garbage collect the HDF5 free lists. The policy is checked
+ * when a file is opened or closed and when a factory is destroyed, also for
+ * the objects and factories of OdimH5v20. \n
+ * HDF5_GC_EVERY_FACTORY keeps the historical behaviour; programs that open
+ * many files with short lived factories should prefer HDF5_GC_EVERY_N_FILES
+ * or HDF5_GC_MEMORY_THRESHOLD. \n
+ * It also owns the lock taken by HDF5Lock around every call to HDF5, so that
+ * objects of different files can be used by different threads even when HDF5
+ * was not built thread safe. Translations, geometry and the other
+ * computations run outside the lock.
+ */
+class RADAR_API HDF5Library
+{
+public:
+	/*!
+	 * \brief The library context of the process
+	 */
+	static HDF5Library&	instance	();
+
+	/*!
+	 * \brief Enable or disable the printing of HDF5 error stacks on stderr
+	 * Errors are always reported with exceptions, printing is enabled by default
+	 */
+	void			setPrintErrors	(bool value);
+	bool			getPrintErrors	() const;
+
+	/*!
+	 * \brief Set the garbage collection policy
+	 * \param policy			the policy
+	 * \param parameter			number of files for HDF5_GC_EVERY_N_FILES, bytes for HDF5_GC_MEMORY_THRESHOLD
+	 * \throws std::invalid_argument	if the parameter is 0 for a policy that needs it,
+	 *					or the HDF5 library cannot report the size of its free lists
+	 */
+	void			setGCPolicy	(HDF5GCPolicy policy, uint64_t parameter = 0);
+	HDF5GCPolicy		getGCPolicy	() const;
+	uint64_t		getGCParameter	() const;
+
+	/*!
+	 * \brief Garbage collect the HDF5 free lists now
+	 */
+	void			garbageCollect	();
+	/*!
+	 * \brief Bytes held by the HDF5 free lists, 0 if the library cannot report them
+	 */
+	static uint64_t		getFreeListSize	();
+
+	/*! \brief Files opened through HDF5File::open */
+	uint64_t		getFileCount	() const;
+	/*! \brief Garbage collections done */
+	uint64_t		getGCCount	() const;
+
+	/*!
+	 * \brief True if HDF5 was built thread safe
+	 */
+	static bool		isThreadSafe	();
+	/*!
+	 * \brief Set when calls to HDF5 are serialized
+	 * Change it only while no other thread uses the library
+	 */
+	void			setLockPolicy	(HDF5LockPolicy policy);
+	HDF5LockPolicy		getLockPolicy	() const	{ return lockPolicy; }
+	/*! \brief True if calls to HDF5 are serialized */
+	bool			isLocking	() const	{ return locking.load(std::memory_order_relaxed); }
+
+	/*! \brief Times the HDF5 lock has been taken */
+	uint64_t		getLockCount	() const	{ return lockCount.load(); }
+	/*! \brief Times a thread had to wait for the HDF5 lock */
+	uint64_t		getLockWaits	() const	{ return lockWaits.load(); }
+	/*! \brief Nanoseconds spent by threads waiting for the HDF5 lock */
+	uint64_t		getLockWaitTime	() const	{ return lockWaitTime.load(); }
+
+	/*! \brief Called by HDF5File::open before a file is opened */
+	void			fileOpening	();
+	/*! \brief Called by OdimObject when it closes its file */
+	void			fileClosed	();
+	/*! \brief Called by OdimFactory when it is destroyed */
+	void			factoryReleased	();
+
+private:
+	mutable std::mutex	mutex;		/* guards the fields up to collections */
+	bool			printErrors;
+	HDF5GCPolicy		policy;
+	uint64_t		parameter;
+	uint64_t		files;
+	uint64_t		filesSinceGC;
+	uint64_t		collections;
+
+	std::recursive_mutex	callMutex;	/* taken by HDF5Lock */
+	HDF5LockPolicy		lockPolicy;
+	std::atomic<bool>	locking;
+	std::atomic<uint64_t>	lockCount;
+	std::atomic<uint64_t>	lockWaits;
+	std::atomic<uint64_t>	lockWaitTime;
+
+	friend class HDF5Lock;
+
+	HDF5Library();
+	HDF5Library(const HDF5Library&);
+	HDF5Library& operator=(const HDF5Library&);
+
+	void			collect		();
+};
+
+/*!
+ * \brief Serializes the calls to HDF5 done while it exists
+ *
+ * Taken by the HDF5 wrappers and by the classes around their own use of
+ * HDF5, it can be nested. Code using the HDF5 objects returned by the
+ * library, e.g. the datasets returned by getData(), must take it as well. \n
+ * It does nothing unless HDF5Library::isLocking() is true.
+ */
+class RADAR_API HDF5Lock
+{
+public:
+	HDF5Lock();
+	~HDF5Lock();
+
+private:
+	bool			locked;
+
+	HDF5Lock(const HDF5Lock&);
+	HDF5Lock& operator=(const HDF5Lock&);
+};
+
+/*!
+ * \brief Element types of raw data handled by the library
+ *
+ * Copies and comparisons of H5::DataType are calls to HDF5: code running
+ * without HDF5Lock, e.g. the worker threads of the product generators, keeps
+ * one of these and converts it with getH5Type() only inside locked calls.
+ */
+enum RawType {
+	RAW_INT8,
+	RAW_UINT8,
+	RAW_INT16,
+	RAW_UINT16,
+	RAW_FLOAT,
+	RAW_OTHER			/*!< any other type, not handled by the library */
+};
+
+/*!
+ * \brief Raw type of an HDF5 type, taking HDF5Lock
+ */
+RADAR_API RawType getRawType(const H5::DataType& type);
+/*!
+ * \brief Native HDF5 type of a raw type, to be used with HDF5Lock taken
+ * \throws OdimH5UnsupportedException	for RAW_OTHER
+ */
+RADAR_API const H5::PredType& getH5Type(RawType type);
+/*!
+ * \brief Size in bytes of an element of the given type, 0 for RAW_OTHER
+ */
+RADAR_API size_t getRawSize(RawType type);
+
 /*===========================================================================*/
 /* HDF5 FILE */
 /*===========================================================================*/
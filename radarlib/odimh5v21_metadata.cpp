@@ -27,6 +27,10 @@
 #include <sstream>
 #include <ctime>
 #include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
 
 #include <radarlib/time.hpp>
@@ -104,16 +108,126 @@ namespace {
     }
 }
 
-template<class T> static std::vector<T> getSimpleArray(H5::Group* group, const char* name, bool mandatory, std::vector<T>& result)
+/* 
+ * Read a 1D dataset into a caller supplied buffer of 'count' elements placed 'stride' elements apart.
+ * Using a strided memory hyperslab lets arrays of pairs (AZAngles, AZTimes) be filled in place
+ * without passing through temporary vectors.
+ */
+template<class T> static void readSimpleArray(H5::DataSet* dataset, T* buff, size_t count, size_t stride)
+{
+	if (count == 0)
+		return;
+	hsize_t mdim[]   = { (hsize_t)(count * stride) };
+	hsize_t start[]  = { 0 };
+	hsize_t mstride[]= { (hsize_t)stride };
+	hsize_t mcount[] = { (hsize_t)count };
+	H5::DataSpace memspace(1, mdim);
+	if (stride > 1)
+		memspace.selectHyperslab(H5S_SELECT_SET, mcount, start, mstride);
+	dataset->read(buff, infer_data_type<T>(), memspace, dataset->getSpace());
+}
+
+static H5::DataSet* openSimpleArray(H5::Group* group, const char* name, bool mandatory)
 {
 	H5::DataSet* dataset = HDF5Group::getDataset(group, name);
-	// TODO: mandatory
+	if (dataset == NULL && mandatory)
+		throw OdimH5MissingAttributeException("Mandatory simple array " + std::string(name) + " not found");
+	return dataset;
+}
+
+static size_t getSimpleArraySize(H5::DataSet* dataset)
+{
 	// TODO: dataset->getSpace().getSimpleExtentDims(sizes) == 1
-	hssize_t size = dataset->getSpace().getSimpleExtentNpoints();
-	result.resize(size);
-	dataset->read(&(result[0]), infer_data_type<T>(), dataset->getSpace());
+	return (size_t)dataset->getSpace().getSimpleExtentNpoints();
+}
+
+template<class T> static std::vector<T>& getSimpleArray_(H5::Group* group, const char* name, bool mandatory, std::vector<T>& result)
+{
+	HDF5Lock lock;
+	H5::DataSet* dataset = NULL;
+	try
+	{
+		dataset = openSimpleArray(group, name, mandatory);
+		if (dataset == NULL)
+		{
+			result.clear();
+			return result;
+		}
+		result.resize(getSimpleArraySize(dataset));
+		if (result.size())
+			readSimpleArray<T>(dataset, &(result[0]), result.size(), 1);
+		delete dataset;
+		return result;
+	}
+	catch (H5::Exception& h5e)
+	{
+		delete dataset;
+		throw OdimH5HDF5LibException("Unable to read simple array " + std::string(name), h5e);
+	}
+	catch (...)
+	{
+		delete dataset;
+		throw;
+	}
+}
 
-	return result;;
+/* 
+ * Write 'count' elements taken 'stride' elements apart from the given buffer into a 1D dataset.
+ * No intermediate copy of the values is made, the selection is resolved by HDF5 while writing.
+ */
+template<class T> static void setSimpleArray_(H5::Group* group, const char* name, const T* buff, size_t count, size_t stride, const H5::PredType& filetype)
+{
+	HDF5Lock lock;
+	H5::DataSet* dataset = NULL;
+	try
+	{		
+		const int RANK = 1;
+		hsize_t fdim[] = { (hsize_t)count }; // dim sizes of ds (on disk)
+		H5::DataSpace space(RANK, fdim);
+
+		/* an existing array with the same size and type is overwritten in place, avoiding unlink and new allocations in the file */
+		dataset = HDF5Group::getDataset(group, name);
+		if (dataset && !(count && getSimpleArraySize(dataset) == count && dataset->getDataType() == filetype))
+		{
+			delete dataset;
+			dataset = NULL;
+			HDF5Group::removeChild(group, name);
+		}
+
+		if (dataset == NULL)
+		{
+			H5::DSetCreatPropList ds_creatplist;  // create dataset creation prop list
+			if (count)
+			{
+				ds_creatplist.setChunk( 1, fdim );  // then modify it for compression
+				ds_creatplist.setDeflate( 6 );
+			}
+			dataset = new H5::DataSet(group->createDataSet(name, filetype, space, ds_creatplist));			
+		}
+		if (count)
+		{
+			hsize_t mdim[]   = { (hsize_t)(count * stride) };
+			hsize_t start[]  = { 0 };
+			hsize_t mstride[]= { (hsize_t)stride };
+			hsize_t mcount[] = { (hsize_t)count };
+			H5::DataSpace memspace(RANK, mdim);
+			if (stride > 1)
+				memspace.selectHyperslab(H5S_SELECT_SET, mcount, start, mstride);
+			dataset->write(buff, infer_data_type<T>(), memspace, space);
+		}
+
+		delete dataset;
+	}
+	catch (H5::Exception& h5e)
+	{
+		delete dataset;		
+		throw OdimH5HDF5LibException("Unable to write odim data into HDF5 dataset", h5e);
+	}
+	catch (...)
+	{
+		delete dataset;
+		throw;
+	}
 }
 
 /*===========================================================================*/
@@ -127,10 +241,11 @@ MetadataGroup::MetadataGroup(H5::Group* group)
 
 MetadataGroup::~MetadataGroup() 
 { 
+	HDF5Lock lock;
 	delete group;
 }
 
-int		MetadataGroup::getCount		()					{ return group->getNumAttrs(); }
+int		MetadataGroup::getCount		()					{ HDF5Lock lock; return group->getNumAttrs(); }
 
 H5::Attribute*	MetadataGroup::getH5Attribute	(const char* name, bool mandatory)	{ return HDF5Attribute::get(group, name, mandatory);	}
 
@@ -273,79 +388,98 @@ std::vector<std::string>	MetadataGroup::getStrings	(const char* name, bool manda
 
 std::vector<int64_t>	MetadataGroup::getSimpleArrayLong	(const char* name, bool mandatory) {
 	std::vector<int64_t>	result;
-	return getSimpleArray<int64_t>(group, name, mandatory, result);
+	getSimpleArray_<int64_t>(group, name, mandatory, result);
+	return result;
 }
 std::vector<double>	MetadataGroup::getSimpleArrayDouble	(const char* name, bool mandatory) {
 	std::vector<double>	result;
-	return getSimpleArray<double>(group, name, mandatory, result);
+	getSimpleArray_<double>(group, name, mandatory, result);
+	return result;
 }
-/*===========================================================================*/
-/* set simple array */
-/*===========================================================================*/
-void	MetadataGroup::setSimpleArray	(const char* name, const std::vector<int64_t>&	value)  
-{  
-	H5::DataSet* dataset = NULL;
-	try
-	{		
-		if (HDF5Group::exists(group,name)) HDF5Group::removeChild(group, name);
-
-		const int RANK = 1;
-		hsize_t fdim[] = {value.size()}; // dim sizes of ds (on disk)
-		H5::DataSpace space(RANK, fdim);
-
-		H5::DSetCreatPropList ds_creatplist;  // create dataset creation prop list
-		ds_creatplist.setChunk( 1, fdim );  // then modify it for compression
-		ds_creatplist.setDeflate( 6 );
+std::vector<int64_t>&	MetadataGroup::getSimpleArray		(const char* name, std::vector<int64_t>& result, bool mandatory) {
+	return getSimpleArray_<int64_t>(group, name, mandatory, result);
+}
+std::vector<double>&	MetadataGroup::getSimpleArray		(const char* name, std::vector<double>& result, bool mandatory) {
+	return getSimpleArray_<double>(group, name, mandatory, result);
+}
+struct find_simple_arrays_data
+{
+	int			count;
+	const char* const*	names;
+	int			found;
+};
 
-		//dataset = new H5::DataSet(group->createDataSet(name, elemtype, space, ds_creatplist));			
-		dataset = new H5::DataSet(group->createDataSet(name, H5::PredType::NATIVE_LONG, space, ds_creatplist));			
-		dataset->write(&(value[0]), H5::PredType::NATIVE_LONG);	// mspace1, fspace );
+static herr_t find_simple_arrays(hid_t /*loc_id*/, const char *name, const H5L_info_t* /*info*/, void *opdata)
+{
+	find_simple_arrays_data* data = (find_simple_arrays_data*)opdata;
+	for (int i=0; i<data->count; i++)
+		if (strcmp(name, data->names[i]) == 0)
+			data->found |= (1 << i);
+	return 0;
+}
 
-		delete dataset;
-	}
-	catch (H5::Exception& h5e)
+int MetadataGroup::getSimpleArrays(int count, const char* const names[], double* const buffers[], size_t size)
+{
+	if (count > (int)(sizeof(int) * 8 - 1))
+		throw std::invalid_argument("Too many simple arrays requested");
+
+	HDF5Lock lock;
+
+	/* a single pass over the group links tells which arrays are present */
+	find_simple_arrays_data data;
+	data.count	= count;
+	data.names	= names;
+	data.found	= 0;
+	herr_t res = H5Literate(group->getId(), H5_INDEX_NAME, H5_ITER_NATIVE, NULL, find_simple_arrays, &data);
+	if (res < 0)
 	{
-		delete dataset;		
-		throw OdimH5HDF5LibException("Unable to write odim data into HDF5 dataset", h5e);
+		std::ostringstream ss; ss << "H5Literate("<<group->getId()<<",...) failed: " << res;
+		throw OdimH5HDF5LibException(ss.str());
 	}
-	catch (...)
+
+	for (int i=0; i<count; i++)
 	{
-		delete dataset;
-		throw;
+		if ((data.found & (1 << i)) == 0)
+			continue;
+		H5::DataSet* dataset = NULL;
+		try
+		{
+			dataset = new H5::DataSet(group->openDataSet(names[i]));
+			if (getSimpleArraySize(dataset) != size)
+			{
+				std::ostringstream ss; ss << "Simple array " << names[i] << " has " << getSimpleArraySize(dataset) << " elements instead of " << size;
+				throw OdimH5FormatException(ss.str());
+			}
+			readSimpleArray<double>(dataset, buffers[i], size, 1);
+			delete dataset;
+		}
+		catch (H5::Exception& h5e)
+		{
+			delete dataset;
+			throw OdimH5HDF5LibException("Unable to read simple array " + std::string(names[i]), h5e);
+		}
+		catch (...)
+		{
+			delete dataset;
+			throw;
+		}
 	}
-
+	return data.found;
+}
+/*===========================================================================*/
+/* set simple array */
+/*===========================================================================*/
+void	MetadataGroup::setSimpleArray	(const char* name, const std::vector<int64_t>&	value)  
+{  
+	setSimpleArray_<int64_t>(group, name, value.size() ? &(value[0]) : NULL, value.size(), 1, H5::PredType::NATIVE_INT64);
 }
 void	MetadataGroup::setSimpleArray	(const char* name, const std::vector<double>&	value)  
 {  
-	H5::DataSet* dataset = NULL;
-	try
-	{		
-		if (HDF5Group::exists(group,name)) HDF5Group::removeChild(group, name);
-		const int RANK = 1;
-		hsize_t fdim[] = {value.size()}; // dim sizes of ds (on disk)
-		H5::DataSpace space(RANK, fdim);
-
-		H5::DSetCreatPropList ds_creatplist;  // create dataset creation prop list
-		ds_creatplist.setChunk( 1, fdim );  // then modify it for compression
-		ds_creatplist.setDeflate( 6 );
-
-		//dataset = new H5::DataSet(group->createDataSet(name, elemtype, space, ds_creatplist));			
-		dataset = new H5::DataSet(group->createDataSet(name, H5::PredType::NATIVE_DOUBLE, space, ds_creatplist));			
-		dataset->write(&(value[0]), H5::PredType::NATIVE_DOUBLE);	// mspace1, fspace );
-
-		delete dataset;
-	}
-	catch (H5::Exception& h5e)
-	{
-		delete dataset;		
-		throw OdimH5HDF5LibException("Unable to write odim data into HDF5 dataset", h5e);
-	}
-	catch (...)
-	{
-		delete dataset;
-		throw;
-	}
-
+	setSimpleArray_<double>(group, name, value.size() ? &(value[0]) : NULL, value.size(), 1, H5::PredType::NATIVE_DOUBLE);
+}
+void	MetadataGroup::setSimpleArray	(const char* name, const double* value, size_t count)  
+{  
+	setSimpleArray_<double>(group, name, value, count, 1, H5::PredType::NATIVE_DOUBLE);
 }
 	
 /*===========================================================================*/
@@ -421,30 +555,25 @@ const std::vector<std::pair<std::string,std::string> >	MetadataGroup::getStrPair
 /* set SimpleArray */
 /*===========================================================================*/
 
+/* i vettori di questi tipi sono letti e scritti come array di double con passo 2 o 1 */
+static_assert(std::is_standard_layout<AZTimes>::value && sizeof(AZTimes) == 2 * sizeof(double) && offsetof(AZTimes, stop) == sizeof(double), "AZTimes must be two packed doubles");
+static_assert(std::is_standard_layout<AZAngles>::value && sizeof(AZAngles) == 2 * sizeof(double) && offsetof(AZAngles, stop) == sizeof(double), "AZAngles must be two packed doubles");
+static_assert(std::is_standard_layout<Angles>::value && sizeof(Angles) == sizeof(double), "Angles must be a single double");
+static_assert(std::is_standard_layout<Arotation>::value && sizeof(Arotation) == sizeof(double), "Arotation must be a single double");
+static_assert(std::is_standard_layout<TXpower>::value && sizeof(TXpower) == sizeof(double), "TXpower must be a single double");
+
+/* AZTimes and AZAngles are plain pairs of doubles: write both halves directly from the caller's vector */
 void	MetadataGroup::set	(const char* name, const std::vector<AZTimes>& value)		
 { 
-	std::vector<double> start;
-	std::vector<double> stop;
-	for (size_t i=0; i<value.size(); i++){
-		start.push_back(value[i].start);
-		stop.push_back(value[i].stop);
-	}
-
-	setSimpleArray	(ATTRIBUTE_HOW_STARTAZT, start)  ;
-	setSimpleArray	(ATTRIBUTE_HOW_STOPAZT, stop)  ;
-//	set(name, AZTimes::toString(value));
+	const double* buff = value.size() ? &(value[0].start) : NULL;
+	setSimpleArray_<double>(group, ATTRIBUTE_HOW_STARTAZT, buff,     value.size(), 2, H5::PredType::NATIVE_DOUBLE);
+	setSimpleArray_<double>(group, ATTRIBUTE_HOW_STOPAZT,  buff ? buff + 1 : NULL, value.size(), 2, H5::PredType::NATIVE_DOUBLE);
 }
 void	MetadataGroup::set	(const char* name, const std::vector<AZAngles>& value)		
 { 
-	std::vector<double> start;
-	std::vector<double> stop;
-	for (size_t i=0; i<value.size(); i++){
-		start.push_back(value[i].start);
-		stop.push_back(value[i].stop);
-	}
-
-	setSimpleArray	(ATTRIBUTE_HOW_STARTAZA, start)  ;
-	setSimpleArray	(ATTRIBUTE_HOW_STOPAZA, stop)  ;
+	const double* buff = value.size() ? &(value[0].start) : NULL;
+	setSimpleArray_<double>(group, ATTRIBUTE_HOW_STARTAZA, buff,     value.size(), 2, H5::PredType::NATIVE_DOUBLE);
+	setSimpleArray_<double>(group, ATTRIBUTE_HOW_STOPAZA,  buff ? buff + 1 : NULL, value.size(), 2, H5::PredType::NATIVE_DOUBLE);
 }
 void	MetadataGroup::set	(const char* name, const std::vector<AZAngles>& value, int precision)		
 { 
@@ -462,26 +591,17 @@ void	MetadataGroup::set	(const char* name, const VILHeights& value)
 
 void	MetadataGroup::set	(const char* name, const std::vector<Angles>& value, int precision)		
 { 
-	std::vector<double> result;
-	for (size_t i=0; i<value.size(); i++)
-		result.push_back(value[i].value);
-	setSimpleArray	(name, result)  ;
+	setSimpleArray_<double>(group, name, value.size() ? &(value[0].value) : NULL, value.size(), 1, H5::PredType::NATIVE_DOUBLE);
 }
 
 void	MetadataGroup::set	(const char* name, const std::vector<Arotation>& value, int precision)		
 { 
-	std::vector<double> result;
-	for (size_t i=0; i<value.size(); i++)
-		result.push_back(value[i].value);
-	setSimpleArray	(name, result)  ;
+	setSimpleArray_<double>(group, name, value.size() ? &(value[0].value) : NULL, value.size(), 1, H5::PredType::NATIVE_DOUBLE);
 }
 
 void	MetadataGroup::set	(const char* name, const std::vector<TXpower>& value, int precision)		
 { 
-	std::vector<double> result;
-	for (size_t i=0; i<value.size(); i++)
-		result.push_back(value[i].value);
-	setSimpleArray	(name, result)  ;
+	setSimpleArray_<double>(group, name, value.size() ? &(value[0].value) : NULL, value.size(), 1, H5::PredType::NATIVE_DOUBLE);
 }
 
 void	MetadataGroup::set	(const char* name, const std::vector<Nodes>& value)		
@@ -494,14 +614,54 @@ void	MetadataGroup::set	(const char* name, const std::vector<Nodes>& value)
 /* get sequenze particolari */
 /*===========================================================================*/
 
+/* Read start/stop arrays straight into the pairs, as done by the writers above */
+template <class TPAIR> static std::vector<TPAIR> getPairArrays(H5::Group* group, const char* startName, const char* stopName)
+{
+	HDF5Lock lock;
+	std::vector<TPAIR> result;
+	H5::DataSet* start = NULL;
+	H5::DataSet* stop  = NULL;
+	try
+	{
+		start = openSimpleArray(group, startName, false);
+		stop  = openSimpleArray(group, stopName,  false);
+		if (start && stop)
+		{
+			size_t count = getSimpleArraySize(start);
+			if (getSimpleArraySize(stop) != count)
+				throw OdimH5FormatException(std::string(startName) + " and " + std::string(stopName) + " have different sizes");
+			result.resize(count);
+			if (count)
+			{
+				readSimpleArray<double>(start, &(result[0].start), count, 2);
+				readSimpleArray<double>(stop,  &(result[0].start) + 1, count, 2);
+			}
+		}
+		delete start;
+		delete stop;
+		return result;
+	}
+	catch (H5::Exception& h5e)
+	{
+		delete start;
+		delete stop;
+		throw OdimH5HDF5LibException("Unable to read simple arrays " + std::string(startName) + "/" + std::string(stopName), h5e);
+	}
+	catch (...)
+	{
+		delete start;
+		delete stop;
+		throw;
+	}
+}
+
 std::vector<AZTimes>		MetadataGroup::getAZTimes	(const char* name)			
 { 
-	return  AZTimes::parseSimpleArrays( getSimpleArrayDouble(ATTRIBUTE_HOW_STARTAZT),getSimpleArrayDouble(ATTRIBUTE_HOW_STOPAZT)  );	
-	//return AZTimes::parseSequence( getStr(name,"") );
+	return getPairArrays<AZTimes>(group, ATTRIBUTE_HOW_STARTAZT, ATTRIBUTE_HOW_STOPAZT);
 }
 std::vector<AZAngles>		MetadataGroup::getAZAngles	(const char* name)			
 { 
-	return AZAngles::parseSimpleArrays( getSimpleArrayDouble(ATTRIBUTE_HOW_STARTAZA),getSimpleArrayDouble(ATTRIBUTE_HOW_STOPAZA)  );	
+	return getPairArrays<AZAngles>(group, ATTRIBUTE_HOW_STARTAZA, ATTRIBUTE_HOW_STOPAZA);
 }
 VILHeights			MetadataGroup::getVILHeights	(const char* name)			
 { 
@@ -514,9 +674,39 @@ VILHeights			MetadataGroup::getVILHeights	(const char* name)
 //		return VILHeights(0,0);
 //	return VILHeights(val);
 }
-std::vector<TXpower>		MetadataGroup::getTXpower	(const char* name){ return TXpower::parseSimpleArray( getSimpleArrayDouble(name)); } 
-std::vector<Angles>		MetadataGroup::getAngles	(const char* name){ return Angles::parseSimpleArray( getSimpleArrayDouble(name)); }	
-std::vector<Arotation>		MetadataGroup::getArotation	(const char* name){ return Arotation::parseSimpleArray( getSimpleArrayDouble(name)); } 
+/* Read a simple array straight into objects wrapping a single double 'value' field */
+template <class TVALUE> static std::vector<TVALUE> getValueArray(H5::Group* group, const char* name)
+{
+	HDF5Lock lock;
+	std::vector<TVALUE> result;
+	H5::DataSet* dataset = NULL;
+	try
+	{
+		dataset = openSimpleArray(group, name, false);
+		if (dataset)
+		{
+			result.resize(getSimpleArraySize(dataset));
+			if (result.size())
+				readSimpleArray<double>(dataset, &(result[0].value), result.size(), 1);
+		}
+		delete dataset;
+		return result;
+	}
+	catch (H5::Exception& h5e)
+	{
+		delete dataset;
+		throw OdimH5HDF5LibException("Unable to read simple array " + std::string(name), h5e);
+	}
+	catch (...)
+	{
+		delete dataset;
+		throw;
+	}
+}
+
+std::vector<TXpower>		MetadataGroup::getTXpower	(const char* name){ return getValueArray<TXpower>(group, name); } 
+std::vector<Angles>		MetadataGroup::getAngles	(const char* name){ return getValueArray<Angles>(group, name); }	
+std::vector<Arotation>		MetadataGroup::getArotation	(const char* name){ return getValueArray<Arotation>(group, name); } 
 std::vector<Nodes>		MetadataGroup::getNodes	        (const char* name)
 { 
 	return Nodes::parseSequence( getStr(name,"") );
@@ -368,7 +368,7 @@ public:
 	/*! 
 	 * \brief Set or create a simple array attribute with the given 64 bit signed values
 	 *
-	 * Values are stored as a comma separated string
+	 * Values are stored as a native 1D HDF5 dataset
 	 * \param name					the attribute name
 	 * \param value					the values to write
 	 * \throws OdimH5Exception			if an unexpected error occurs
@@ -377,12 +377,22 @@ public:
 	/*! 
 	 * \brief Set or create a simple array attribute with the given 64 bit floating point values
 	 *
-	 * Values are stored as a comma separated string
+	 * Values are stored as a native 1D HDF5 dataset
 	 * \param name					the attribute name
 	 * \param value					the values to write
 	 * \throws OdimH5Exception			if an unexpected error occurs
 	 */
 	void	setSimpleArray	(const char* name,const std::vector<double>&	value);
+	/*! 
+	 * \brief Set or create a simple array attribute with the given 64 bit floating point buffer
+	 *
+	 * Values are written directly from the buffer, no intermediate copy is made
+	 * \param name					the attribute name
+	 * \param value					the buffer with the values to write
+	 * \param count					the number of values in the buffer
+	 * \throws OdimH5Exception			if an unexpected error occurs
+	 */
+	void	setSimpleArray	(const char* name,const double* value, size_t count);
 
 	/* --- set di sequenze di valori odim --- */
 
@@ -849,6 +859,42 @@ public:
 	 * \param mandatory		throw exception if attribute is not found
 	 */
 	std::vector<double> getSimpleArrayDouble (const char* name, bool mandatory = false);
+	/*!
+	 * \brief Read a long simple array into the given vector
+	 *
+	 * The vector is resized to the array size, its capacity is reused between calls.
+	 * If the array does not exist the vector is cleared.
+	 * \param name			the attribute name
+	 * \param result			the destination vector
+	 * \param mandatory		throw exception if attribute is not found
+	 * \throws OdimH5MissingAttributeException	if mandatory is true and the array does not exists
+	 */
+	std::vector<int64_t>& getSimpleArray (const char* name, std::vector<int64_t>& result, bool mandatory = false);
+	/*!
+	 * \brief Read a float simple array into the given vector
+	 *
+	 * The vector is resized to the array size, its capacity is reused between calls.
+	 * If the array does not exist the vector is cleared.
+	 * \param name			the attribute name
+	 * \param result			the destination vector
+	 * \param mandatory		throw exception if attribute is not found
+	 * \throws OdimH5MissingAttributeException	if mandatory is true and the array does not exists
+	 */
+	std::vector<double>& getSimpleArray (const char* name, std::vector<double>& result, bool mandatory = false);
+	/*!
+	 * \brief Read several float simple arrays of the same size with a single traversal of the group
+	 *
+	 * The group links are visited once, every array found is read into the corresponding buffer.
+	 * Buffers of missing arrays are left untouched.
+	 * \param count			number of arrays to read (at most 30)
+	 * \param names			the array names
+	 * \param buffers		the destination buffers, each one large enough for size values
+	 * \param size			the expected number of elements of every array
+	 * \returns			a bit mask with bit i set if names[i] was found and read
+	 * \throws OdimH5FormatException	if an array has a different size
+	 * \throws OdimH5Exception		if an unexpected error occurs
+	 */
+	int getSimpleArrays (int count, const char* const names[], double* const buffers[], size_t size);
 
 	/* --- get sequenze di coppie --- */
 
@@ -0,0 +1,316 @@
+/*
+ * odimh5v21_rainrate - rain rate from reflectivity and specific differential phase
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <radarlib/odimh5v21_rainrate.hpp>
+#include <radarlib/odimh5v21_const.hpp>
+#include <radarlib/odimh5v21_exceptions.hpp>
+#include <radarlib/parallel.hpp>
+
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace OdimH5v21 {
+namespace products {
+
+/*===========================================================================*/
+/* RAIN RATE LAW */
+/*===========================================================================*/
+
+namespace {
+
+const double DEFAULT_ZR_A = 200.;
+const double DEFAULT_ZR_B = 1.6;
+const double DEFAULT_KR_A = 44.;
+const double DEFAULT_KR_B = 0.822;
+
+/* log of the rate as c0 + c1 * dBZ (Z-R) or c0 + c1 * log(KDP) (K-R) */
+struct Coefficients
+{
+	float	c0;
+	float	c1;
+};
+
+Coefficients coefficients(const RainRateLaw& law)
+{
+	if (!(law.a > 0) || !(law.b > 0))
+		throw std::invalid_argument("Rain rate law coefficients must be positive");
+	Coefficients c;
+	if (law.source == RATE_FROM_DBZ)
+	{
+		c.c0 = (float)(-log(law.a) / law.b);
+		c.c1 = (float)(M_LN10 / (10. * law.b));
+	}
+	else
+	{
+		c.c0 = (float)log(law.a);
+		c.c1 = (float)law.b;
+	}
+	return c;
+}
+
+template <bool KDP> inline float rateOf(const Coefficients& c, float v)
+{
+	float r;
+	if (KDP)
+	{
+		float k = v > 0.f ? v : 1.f;
+		r = fastExp(c.c0 + c.c1 * fastLog(k));
+		r = v > 0.f ? r : 0.f;
+	}
+	else
+		r = fastExp(c.c0 + c.c1 * v);
+	return v != v || v == UNDETECT ? v : r;
+}
+
+template <bool KDP> void convertValues(const Coefficients& c, const float* values, size_t count, float* rates)
+{
+	for (size_t i = 0; i < count; ++i)
+		rates[i] = rateOf<KDP>(c, values[i]);
+}
+
+RainRateLaw readLaw(RainRateSource source, double a1, double b1, double a2, double b2)
+{
+	RainRateLaw law = source == RATE_FROM_DBZ ? RainRateLaw::zr() : RainRateLaw::kr();
+	if (a1 > 0 && b1 > 0)
+	{
+		law.a = a1;
+		law.b = b1;
+	}
+	else if (a2 > 0 && b2 > 0)
+	{
+		law.a = a2;
+		law.b = b2;
+	}
+	return law;
+}
+
+}
+
+RainRateLaw::RainRateLaw()
+	: source(RATE_FROM_DBZ), a(DEFAULT_ZR_A), b(DEFAULT_ZR_B)
+{
+}
+
+RainRateLaw::RainRateLaw(RainRateSource source, double a, double b)
+	: source(source), a(a), b(b)
+{
+}
+
+RainRateLaw RainRateLaw::zr(double a, double b)
+{
+	return RainRateLaw(RATE_FROM_DBZ, a, b);
+}
+
+RainRateLaw RainRateLaw::kr(double a, double b)
+{
+	return RainRateLaw(RATE_FROM_KDP, a, b);
+}
+
+RainRateLaw RainRateLaw::of(PolarScan& scan, PolarVolume& volume, RainRateSource source)
+{
+	if (source == RATE_FROM_DBZ)
+		return readLaw(source, scan.getZR_A(), scan.getZR_B(), volume.getZR_A(), volume.getZR_B());
+	return readLaw(source, scan.getKR_A(), scan.getKR_B(), volume.getKR_A(), volume.getKR_B());
+}
+
+RainRateLaw RainRateLaw::of(Product_2D& dataset, Object_2D& object, RainRateSource source)
+{
+	if (source == RATE_FROM_DBZ)
+		return readLaw(source, dataset.getZR_A(), dataset.getZR_B(), object.getZR_A(), object.getZR_B());
+	return readLaw(source, dataset.getKR_A(), dataset.getKR_B(), object.getKR_A(), object.getKR_B());
+}
+
+float RainRateLaw::rate(float value) const
+{
+	if (value != value || value == UNDETECT)
+		return value;
+	if (source == RATE_FROM_DBZ)
+		return (float)pow(pow(10., value / 10.) / a, 1. / b);
+	return value > 0 ? (float)(a * pow((double)value, b)) : 0.f;
+}
+
+void RainRateLaw::convert(const float* values, size_t count, float* rates) const
+{
+	Coefficients c = coefficients(*this);
+	if (source == RATE_FROM_DBZ)
+		convertValues<false>(c, values, count, rates);
+	else
+		convertValues<true>(c, values, count, rates);
+}
+
+/*===========================================================================*/
+/* RAIN RATE CONVERTER */
+/*===========================================================================*/
+
+namespace {
+
+struct ConvertTask
+{
+	const RainRateLaw&	law;
+	const float*		values;
+	float*			rates;
+
+	void operator()(size_t begin, size_t end) const
+	{
+		law.convert(values + begin, end - begin, rates + begin);
+	}
+};
+
+/*
+ * Decode raw values already converted to float by HDF5, convert them in place
+ * and encode the block to 16 bit when out is not NULL: the block stays in
+ * cache between the three steps. HDF5 types are not used here, since HDF5
+ * may not be thread safe.
+ */
+template <bool KDP> struct RawRateTask
+{
+	Coefficients		c;
+	float			gain, offset, nodata, undetect;
+	float*			values;
+	float			scale, base;
+	float			top;		/* largest raw value, below nodata */
+	unsigned short		nd, ud;
+	unsigned short*		out;
+
+	void operator()(size_t begin, size_t end) const
+	{
+		float* v = values + begin;
+		size_t count = end - begin;
+		for (size_t i = 0; i < count; ++i)
+		{
+			float raw = v[i];
+			float value = raw == nodata ? NODATA : raw == undetect ? UNDETECT : raw * gain + offset;
+			v[i] = rateOf<KDP>(c, value);
+		}
+		if (!out)
+			return;
+		unsigned short* raw = out + begin;
+		for (size_t i = 0; i < count; ++i)
+		{
+			float q = (v[i] - base) * scale;
+			q = q < 0.f ? 0.f : q > top ? top : q;
+			unsigned short e = (unsigned short)(q + 0.5f);
+			/* una pioggia debole non deve diventare undetect */
+			if (e == ud && v[i] > base && e < top)
+				++e;
+			raw[i] = v[i] != v[i] ? nd : v[i] == UNDETECT ? ud : e;
+		}
+	}
+};
+
+}
+
+RainRateConverter::RainRateConverter(int threads)
+	: threads(threads), blockSize(16384)
+{
+}
+
+Encoding RainRateConverter::defaultEncoding()
+{
+	return Encoding(RAW_UINT16, 0.01, 0., 65535., 0.);
+}
+
+void RainRateConverter::convert(const RainRateLaw& law, const float* values, size_t count, float* rates)
+{
+	coefficients(law);
+	ConvertTask task = { law, values, rates };
+	Radar::parallel::forBlocks(count, blockSize, threads, task);
+}
+
+void RainRateConverter::convertRaw(const RainRateLaw& law, const Encoding& input, float* raw, size_t count,
+				   const Encoding& output, void* out)
+{
+	Coefficients c = coefficients(law);
+	bool fused = output.rawtype == RAW_UINT16;
+	float scale = (float)(1. / output.gain);
+	float top = output.nodata == 65535. ? 65534.f : 65535.f;
+	unsigned short* out16 = fused ? (unsigned short*)out : NULL;
+	if (law.source == RATE_FROM_DBZ)
+	{
+		RawRateTask<false> task = { c, (float)input.gain, (float)input.offset, (float)input.nodata, (float)input.undetect,
+					    raw, scale, (float)output.offset, top, (unsigned short)output.nodata, (unsigned short)output.undetect, out16 };
+		Radar::parallel::forBlocks(count, blockSize, threads, task);
+	}
+	else
+	{
+		RawRateTask<true> task = { c, (float)input.gain, (float)input.offset, (float)input.nodata, (float)input.undetect,
+					   raw, scale, (float)output.offset, top, (unsigned short)output.nodata, (unsigned short)output.undetect, out16 };
+		Radar::parallel::forBlocks(count, blockSize, threads, task);
+	}
+	if (!fused)
+		output.encode(raw, count, out);
+}
+
+PolarScanData* RainRateConverter::convert(PolarScan& scan, const std::string& quantity, const RainRateLaw& law,
+					  const Encoding& encoding)
+{
+	std::unique_ptr<PolarScanData> source(scan.getQuantityData(quantity));
+	int width = source->getDataWidth();
+	int height = source->getDataHeight();
+	size_t count = (size_t)width * height;
+	std::vector<float> values(count + 1);
+	source->readData(&values[0], RAW_FLOAT);
+	std::vector<char> raw(count * getRawSize(encoding.rawtype) + 1);
+	convertRaw(law, Encoding::of(*source), &values[0], count, encoding, &raw[0]);
+
+	std::unique_ptr<PolarScanData> data(scan.createQuantityData(PRODUCT_QUANTITY_RATE));
+	encoding.writeTo(*data);
+	data->writeData(&raw[0], width, height, encoding.rawtype);
+	return data.release();
+}
+
+int RainRateConverter::convert(PolarVolume& volume, RainRateSource source, const Encoding& encoding)
+{
+	const char* quantity = source == RATE_FROM_DBZ ? PRODUCT_QUANTITY_DBZH : PRODUCT_QUANTITY_KDP;
+	int converted = 0;
+	int count = volume.getScanCount();
+	for (int i = 0; i < count; ++i)
+	{
+		std::unique_ptr<PolarScan> scan(volume.getScan(i));
+		if (!scan->hasQuantityData(quantity))
+			continue;
+		std::unique_ptr<PolarScanData> data(convert(*scan, quantity, RainRateLaw::of(*scan, volume, source), encoding));
+		++converted;
+	}
+	return converted;
+}
+
+Product_2D_Data* RainRateConverter::convert(Product_2D& dataset, const std::string& quantity, const RainRateLaw& law,
+					    const Encoding& encoding)
+{
+	std::unique_ptr<Product_2D_Data> source(dataset.getQuantityData(quantity));
+	int width = source->getDataWidth();
+	int height = source->getDataHeight();
+	size_t count = (size_t)width * height;
+	std::vector<float> values(count + 1);
+	source->readData(&values[0], RAW_FLOAT);
+	std::vector<char> raw(count * getRawSize(encoding.rawtype) + 1);
+	Encoding input(source->getRawType(), source->getGain(), source->getOffset(), source->getNodata(), source->getUndetect());
+	convertRaw(law, input, &values[0], count, encoding, &raw[0]);
+
+	std::unique_ptr<Product_2D_Data> data(dataset.createQuantityData(PRODUCT_QUANTITY_RATE));
+	encoding.writeTo(*data);
+	data->writeData(&raw[0], width, height, encoding.rawtype);
+	return data.release();
+}
+
+}
+}
@@ -0,0 +1,222 @@
+/*
+ * odimh5v21_rainrate - rain rate from reflectivity and specific differential phase
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef __RADAR_ODIMH5V21_RAINRATE_HPP__
+#define __RADAR_ODIMH5V21_RAINRATE_HPP__
+/*!
+ * \file
+ * \brief Z-R and K-R rain rate conversions of scans and products
+ */
+
+#include <radarlib/odimh5v21_cartesian.hpp>
+
+#include <cstring>
+#include <string>
+
+namespace OdimH5v21 {
+namespace products {
+
+/*===========================================================================*/
+/* FAST MATH */
+/*===========================================================================*/
+
+/*!
+ * \brief Approximation of exp(x) with relative error below 1e-6
+ *
+ * Arguments are clamped to [-87, 88], so results are always normal floats.
+ * The function has no branches and no library calls, so loops using it can
+ * be vectorized by the compiler.
+ */
+inline float fastExp(float x)
+{
+	x = x < -87.f ? -87.f : x > 88.f ? 88.f : x;
+	/* round x / ln(2) to nearest, valid for |x| < 2^21 */
+	float n = (x * 1.44269504f + 12582912.f) - 12582912.f;
+	/* y = x - n ln(2) with ln(2) split in two parts, n * 0.693145752f is exact */
+	float y = (x - n * 0.693145752f) - n * 1.42860677e-6f;
+	/* exp(y) for |y| <= ln(2) / 2 */
+	float p = 1.f + y * (1.f + y * (0.5f + y * (1.f / 6.f + y * (1.f / 24.f + y * (1.f / 120.f + y * (1.f / 720.f))))));
+	int bits = ((int)n + 127) << 23;
+	float scale;
+	memcpy(&scale, &bits, sizeof(scale));
+	return p * scale;
+}
+
+/*!
+ * \brief Approximation of log(x) with error below 1e-6 relative to max(1, |log(x)|)
+ *
+ * Valid for positive normal floats only, the result is undefined otherwise.
+ */
+inline float fastLog(float x)
+{
+	int bits;
+	memcpy(&bits, &x, sizeof(bits));
+	int e = ((bits >> 23) & 255) - 127;
+	bits = (bits & 0x007FFFFF) | 0x3F800000;
+	float m;
+	memcpy(&m, &bits, sizeof(m));
+	/* mantissa in [sqrt(1/2), sqrt(2)) */
+	int high = m > 1.41421356f;
+	m = high ? m * 0.5f : m;
+	e += high;
+	float s = (m - 1.f) / (m + 1.f);
+	float s2 = s * s;
+	return 2.f * s * (1.f + s2 * (1.f / 3.f + s2 * (1.f / 5.f + s2 * (1.f / 7.f + s2 * (1.f / 9.f))))) + e * 0.693147181f;
+}
+
+/*===========================================================================*/
+/* RAIN RATE LAW */
+/*===========================================================================*/
+
+/*!
+ * \brief Quantities rain rate can be computed from
+ */
+enum RainRateSource {
+	RATE_FROM_DBZ,		/*!< Z = a R^b, from reflectivity (dBZ) */
+	RATE_FROM_KDP		/*!< R = a KDP^b, from specific differential phase (degrees/km) */
+};
+
+/*!
+ * \brief Power law between rain rate (mm/h) and reflectivity or KDP
+ *
+ * UNDETECT and NODATA values are kept as they are, KDP values not greater
+ * than 0 give no rain.
+ */
+struct RADAR_API RainRateLaw {
+	RainRateSource	source;
+	double		a;
+	double		b;
+
+	/*!
+	 * \brief Marshall-Palmer Z-R law
+	 */
+	RainRateLaw();
+	RainRateLaw(RainRateSource source, double a, double b);
+
+	/*!
+	 * \brief Z-R law, Marshall-Palmer by default
+	 */
+	static RainRateLaw zr(double a = 200., double b = 1.6);
+	/*!
+	 * \brief K-R law, R = 44 KDP^0.822 by default
+	 */
+	static RainRateLaw kr(double a = 44., double b = 0.822);
+
+	/*!
+	 * \brief Law stored in the metadata of a scan
+	 *
+	 * Coefficients are read from how/zr_a and how/zr_b (or how/kr_a and
+	 * how/kr_b) of the scan, then of the volume, then the defaults of zr()
+	 * and kr() are used.
+	 */
+	static RainRateLaw of(PolarScan& scan, PolarVolume& volume, RainRateSource source);
+	/*!
+	 * \brief Law stored in the metadata of a product dataset, then of its object
+	 */
+	static RainRateLaw of(Product_2D& dataset, Object_2D& object, RainRateSource source);
+
+	/*!
+	 * \brief Rain rate of a single value, computed with the standard library
+	 */
+	float rate(float value) const;
+	/*!
+	 * \brief Rain rate of the given values, computed with fastExp() and fastLog()
+	 *
+	 * Results differ from rate() by less than 1e-5 relative.
+	 * \param values	physical values, input and output may be the same buffer
+	 */
+	void convert(const float* values, size_t count, float* rates) const;
+};
+
+/*===========================================================================*/
+/* RAIN RATE CONVERTER */
+/*===========================================================================*/
+
+/*!
+ * \brief Add RATE quantities to scans and products
+ *
+ * Raw values are read by HDF5 in the calling thread, then decoded, converted
+ * and encoded block by block in parallel, in a single pass over the buffer.
+ * This fused path is used for the 16 bit unsigned encoding, other encodings
+ * convert in parallel and then use Encoding::encode() in the calling thread.
+ */
+class RADAR_API RainRateConverter {
+ public:
+	/*!
+	 * \brief Create a converter
+	 * \param threads	number of threads, 0 for one thread per core
+	 */
+	RainRateConverter(int threads = 0);
+
+	void setThreads(int val)	{ threads = val; }
+	int getThreads() const		{ return threads; }
+	/*!
+	 * \brief Number of values assigned to a thread at a time
+	 */
+	void setBlockSize(size_t val)	{ blockSize = val > 0 ? val : 1; }
+
+	/*!
+	 * \brief 16 bit unsigned, gain 0.01 mm/h, offset 0, nodata 65535, undetect 0
+	 *
+	 * Rates above zero are stored from 1 to 65534, so they never read back as
+	 * nodata or undetect.
+	 */
+	static Encoding defaultEncoding();
+
+	/*!
+	 * \brief Convert physical values in parallel, see RainRateLaw::convert()
+	 */
+	void convert(const RainRateLaw& law, const float* values, size_t count, float* rates);
+
+	/*!
+	 * \brief Add a RATE quantity to a scan
+	 * \param quantity	DBZH, KDP or any quantity in the units of the law
+	 * \returns		the new data
+	 * \remarks		User is responsible for deleting the returned object
+	 */
+	PolarScanData* convert(PolarScan& scan, const std::string& quantity, const RainRateLaw& law,
+			       const Encoding& encoding = defaultEncoding());
+	/*!
+	 * \brief Add a RATE quantity to every scan of a volume that has the source quantity
+	 *
+	 * The source quantity is DBZH for RATE_FROM_DBZ and KDP for RATE_FROM_KDP,
+	 * each scan uses the law stored in its metadata.
+	 * \returns		the number of scans converted
+	 */
+	int convert(PolarVolume& volume, RainRateSource source, const Encoding& encoding = defaultEncoding());
+	/*!
+	 * \brief Add a RATE quantity to a product dataset
+	 * \returns		the new data
+	 * \remarks		User is responsible for deleting the returned object
+	 */
+	Product_2D_Data* convert(Product_2D& dataset, const std::string& quantity, const RainRateLaw& law,
+				 const Encoding& encoding = defaultEncoding());
+
+ private:
+	int	threads;
+	size_t	blockSize;
+
+	void convertRaw(const RainRateLaw& law, const Encoding& input, float* raw, size_t count,
+			const Encoding& output, void* out);
+};
+
+}
+}
+
+#endif
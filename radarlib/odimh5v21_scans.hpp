@@ -0,0 +1,296 @@
+/*
+ * odimh5v21_scans - scan geometry shared by the products of polar volumes
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef __RADAR_ODIMH5V21_SCANS_HPP__
+#define __RADAR_ODIMH5V21_SCANS_HPP__
+/*!
+ * \file
+ * \brief Scan geometry shared by the cartesian and cross section generators
+ *
+ * Internal header of the library, not installed.
+ */
+
+#include <radarlib/odimh5v21_classes.hpp>
+#include <radarlib/odimh5v21_geometry.hpp>
+#include <radarlib/odimh5v21_const.hpp>
+#include <radarlib/odimh5v21_exceptions.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace OdimH5v21 {
+namespace products {
+namespace detail {
+
+const double DEG2RAD = M_PI / 180.;
+const double RAD2DEG = 180. / M_PI;
+
+/* value written with all its digits, for cache keys and PROJ.4 strings */
+inline std::string formatKey(double value)
+{
+	char buff[32];
+	snprintf(buff, sizeof(buff), "%.17g", value);
+	return buff;
+}
+
+/* geometry of a scan used to build the tables of the generators */
+struct ScanGeometry
+{
+	double	elangle;
+	int	nbins;
+	double	rscale;
+	double	rstart;		/* m */
+	int	nrays;
+	double	beamwidth;
+	AzimuthIndex	rays;	/* ray covering each azimuth, from how/startazA and how/stopazA */
+};
+
+inline ScanGeometry readScanGeometry(PolarScan& scan, double defaultBeamWidth)
+{
+	ScanGeometry g;
+	g.elangle	= scan.getEAngle();
+	g.nbins		= scan.getNumBins();
+	g.rscale	= scan.getRangeScale();
+	g.rstart	= scan.getRangeStart() * 1000.;
+	g.nrays		= scan.getNumRays();
+	g.beamwidth	= scan.getBeamWidth(defaultBeamWidth);
+	g.rays		= geometry::RayAzimuths(scan).index(g.nrays);
+	return g;
+}
+
+/* read the geometry of the given scans and compute the first gate of each one */
+inline void readScanGeometries(PolarVolume& volume, const std::vector<int>& scans, double defaultBeamWidth,
+			       std::vector<ScanGeometry>& geometries, std::vector<size_t>& offsets)
+{
+	geometries.resize(scans.size());
+	offsets.assign(1, 0);
+	for (size_t k = 0; k < scans.size(); ++k)
+	{
+		std::unique_ptr<PolarScan> scan(volume.getScan(scans[k]));
+		geometries[k] = readScanGeometry(*scan, defaultBeamWidth);
+		offsets.push_back(offsets.back() + (size_t)geometries[k].nbins * geometries[k].nrays);
+	}
+}
+
+struct ScanElevation
+{
+	int	index;
+	double	elangle;
+
+	bool operator<(const ScanElevation& o) const { return elangle < o.elangle; }
+};
+
+/*
+ * Indexes of the scans containing the quantity, by increasing elevation
+ * \throws OdimH5Exception	if no scan contains the quantity
+ */
+inline std::vector<int> scansByElevation(PolarVolume& volume, const std::string& quantity)
+{
+	std::vector<ScanElevation> found;
+	int count = volume.getScanCount();
+	for (int i = 0; i < count; ++i)
+	{
+		std::unique_ptr<PolarScan> scan(volume.getScan(i));
+		if (!scan->hasQuantityData(quantity))
+			continue;
+		ScanElevation item = { i, scan->getEAngle() };
+		found.push_back(item);
+	}
+	if (found.empty())
+		throw OdimH5Exception("No scan contains quantity " + quantity);
+	std::stable_sort(found.begin(), found.end());
+
+	std::vector<int> scans;
+	for (size_t k = 0; k < found.size(); ++k)
+		scans.push_back(found[k].index);
+	return scans;
+}
+
+/* cache key of the site and of the given scans, to append to the key of the output grid */
+inline std::string scansKey(PolarVolume& volume, const std::vector<int>& scans, double defaultBeamWidth)
+{
+	std::ostringstream key;
+	key << '|' << formatKey(defaultBeamWidth)
+	    << '|' << formatKey(volume.getLatitude()) << '|' << formatKey(volume.getLongitude()) << '|' << formatKey(volume.getAltitude());
+	for (size_t k = 0; k < scans.size(); ++k)
+	{
+		std::unique_ptr<PolarScan> scan(volume.getScan(scans[k]));
+		key << '|' << scans[k] << ':' << formatKey(scan->getEAngle()) << ',' << scan->getNumBins() << ',' << formatKey(scan->getRangeScale())
+		    << ',' << formatKey(scan->getRangeStart()) << ',' << scan->getNumRays() << ',' << formatKey(scan->getBeamWidth(defaultBeamWidth))
+		    << ',' << geometry::RayAzimuths(*scan).key();
+	}
+	return key.str();
+}
+
+/*
+ * Gate of a scan above the point at the given angular distance (radians) and
+ * azimuth (degrees) from the radar, or -1 also when the azimuth falls in a gap
+ * between rays. Range and height (m above the antenna) of the beam centre are
+ * returned only for valid gates.
+ */
+inline int beamGate(const ScanGeometry& g, double theta, double az, double& range, double& height)
+{
+	const double re	= geometry::EFFECTIVE_EARTH_RADIUS;
+	double el	= g.elangle * DEG2RAD;
+	double c	= cos(el + theta);
+	if (c <= 0)
+		return -1;
+	double r = re * sin(theta) / c;
+	int bin = (int)floor((r - g.rstart) / g.rscale);
+	if (bin < 0 || bin >= g.nbins)
+		return -1;
+	int ray = g.rays.findRay(az);
+	if (ray < 0)
+		return -1;
+	range	= r;
+	height	= re * cos(el) / c - re;
+	return ray * g.nbins + bin;
+}
+
+/* beams above a point, by increasing elevation and so by increasing height */
+struct BeamColumn
+{
+	std::vector<int>	gates;
+	std::vector<double>	heights;	/* m above sea level */
+	std::vector<double>	halfwidths;	/* half of the beam width (m) at the gate */
+	int			n;
+
+	explicit BeamColumn(size_t nscans) : gates(nscans), heights(nscans), halfwidths(nscans), n(0) { }
+
+	/* scans must be sorted by elevation, offsets are the first gates of the scans */
+	void collect(const std::vector<ScanGeometry>& scans, const std::vector<size_t>& offsets,
+		     double theta, double az, double sitealt)
+	{
+		n = 0;
+		for (size_t k = 0; k < scans.size(); ++k)
+		{
+			double r, h;
+			int gate = beamGate(scans[k], theta, az, r, h);
+			if (gate < 0)
+				continue;
+			gates[n]	= gate + (int)offsets[k];
+			heights[n]	= h + sitealt;
+			halfwidths[n]	= r * tan(scans[k].beamwidth * 0.5 * DEG2RAD);
+			++n;
+		}
+	}
+
+	/*
+	 * Gates below and above the height h (-1 if missing) and weight of the
+	 * upper one. Between two beams the value is interpolated if linear,
+	 * otherwise and outside the beams the nearest beam whose half width
+	 * covers h is used.
+	 */
+	void interpolate(double h, bool linear, int& lo, int& up, float& w) const
+	{
+		int k = (int)(std::upper_bound(heights.begin(), heights.begin() + n, h) - heights.begin());
+		/* heights[k - 1] <= h < heights[k] */
+		lo = up = -1;
+		w = 0;
+		if (linear && k > 0 && k < n)
+		{
+			lo = gates[k - 1];
+			up = gates[k];
+			w = (float)((h - heights[k - 1]) / (heights[k] - heights[k - 1]));
+			return;
+		}
+		bool below = k > 0 && h - heights[k - 1] <= halfwidths[k - 1];
+		bool above = k < n && heights[k] - h <= halfwidths[k];
+		if (below && above)
+			below = h - heights[k - 1] <= heights[k] - h;
+		if (below)
+			lo = gates[k - 1];
+		else if (above)
+		{
+			up = gates[k];
+			w = 1;
+		}
+	}
+};
+
+/* values of a block of rows interpolated with the gates and weights of a table */
+struct VerticalFillTask
+{
+	const int*	lower;
+	const int*	upper;
+	const float*	weights;
+	const float*	values;
+	float*		out;
+	int		xsize;
+
+	void operator()(size_t begin, size_t end) const
+	{
+		for (size_t i = begin * xsize, last = end * xsize; i < last; ++i)
+		{
+			float lo = lower[i] < 0 ? NODATA : values[lower[i]];
+			float up = upper[i] < 0 ? NODATA : values[upper[i]];
+			float w = weights[i];
+			if (lo != lo)
+				out[i] = up;
+			else if (up != up)
+				out[i] = lo;
+			else if (lo == UNDETECT || up == UNDETECT)
+				out[i] = w < 0.5f ? lo : up;
+			else
+				out[i] = lo + w * (up - lo);
+		}
+	}
+};
+
+/* read the physical values of the given scans, HDF5 reads stay in the calling thread */
+inline void decodeScans(PolarVolume& volume, const std::vector<int>& scans, const std::vector<size_t>& offsets,
+			const std::string& quantity, std::vector<float>& values)
+{
+	values.resize(offsets.back() + 1);
+	for (size_t k = 0; k < scans.size(); ++k)
+	{
+		std::unique_ptr<PolarScan> scan(volume.getScan(scans[k]));
+		std::unique_ptr<PolarScanData> data(scan->getQuantityData(quantity));
+		if ((size_t)data->getNumRays() * data->getNumBins() != offsets[k + 1] - offsets[k])
+			throw OdimH5FormatException("Size of quantity " + quantity + " does not match nrays and nbins of its scan");
+		data->readTranslatedData(&values[offsets[k]], NODATA, UNDETECT);
+	}
+}
+
+/* set start and end times of a product dataset from the scans used */
+inline void setScanTimes(Product_2D& dataset, PolarVolume& volume, const std::vector<int>& scans)
+{
+	time_t start = 0, end = 0;
+	for (size_t k = 0; k < scans.size(); ++k)
+	{
+		std::unique_ptr<PolarScan> scan(volume.getScan(scans[k]));
+		time_t s = scan->getStartDateTime();
+		time_t e = scan->getEndDateTime();
+		if (k == 0 || s < start)	start = s;
+		if (k == 0 || e > end)		end = e;
+	}
+	dataset.setStartDateTime(start);
+	dataset.setEndDateTime(end);
+}
+
+}
+}
+}
+
+#endif
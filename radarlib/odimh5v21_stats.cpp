@@ -0,0 +1,288 @@
+/*
+ * odimh5v21_stats - counters and timing of HDF5 operations
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <radarlib/odimh5v21_stats.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include <algorithm>
+
+namespace OdimH5v21 {
+
+/*===========================================================================*/
+/* PER-THREAD COUNTERS */
+/*===========================================================================*/
+
+namespace {
+
+enum { CALLS, BYTES, NANOSECONDS, FIELDS };
+
+/* counters written only by their own thread, read by snapshot() */
+struct ThreadCounters {
+	std::atomic<uint64_t>	values[HDF5_STATS_OPERATIONS][FIELDS];
+	uint64_t		baseline[HDF5_STATS_OPERATIONS][FIELDS];	/* guarded by Registry::mutex */
+
+	ThreadCounters()
+	{
+		for (int i=0; i<HDF5_STATS_OPERATIONS; i++)
+			for (int f=0; f<FIELDS; f++)
+			{
+				values[i][f].store(0, std::memory_order_relaxed);
+				baseline[i][f] = 0;
+			}
+	}
+
+	uint64_t counted(int op, int field) const
+	{
+		return values[op][field].load(std::memory_order_relaxed) - baseline[op][field];
+	}
+};
+
+struct Registry {
+	std::mutex			mutex;
+	std::vector<ThreadCounters*>	threads;
+	uint64_t			retired[HDF5_STATS_OPERATIONS][FIELDS];	/* counts of ended threads */
+
+	Registry()
+	{
+		memset(retired, 0, sizeof(retired));
+	}
+};
+
+/* never destroyed, threads may end after static destructors have run */
+Registry& registry()
+{
+	static Registry* r = new Registry;
+	return *r;
+}
+
+struct ThreadHolder {
+	ThreadCounters*	counters;
+
+	ThreadHolder() : counters(new ThreadCounters)
+	{
+		Registry& r = registry();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		r.threads.push_back(counters);
+	}
+	~ThreadHolder()
+	{
+		Registry& r = registry();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		for (int i=0; i<HDF5_STATS_OPERATIONS; i++)
+			for (int f=0; f<FIELDS; f++)
+				r.retired[i][f] += counters->counted(i, f);
+		r.threads.erase(std::find(r.threads.begin(), r.threads.end(), counters));
+		delete counters;
+	}
+};
+
+ThreadCounters& threadCounters()
+{
+	static thread_local ThreadHolder holder;
+	return *holder.counters;
+}
+
+inline void add(std::atomic<uint64_t>& counter, uint64_t value)
+{
+	/* only the owning thread writes, a read-modify-write is not needed */
+	counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+bool enabledFromEnvironment()
+{
+	const char* value = getenv("RADARLIB_HDF5_STATS");
+	return value != NULL && *value != 0 && strcmp(value, "0") != 0;
+}
+
+const char* const operationNames[HDF5_STATS_OPERATIONS] = {
+	"file_open",
+	"group_open",
+	"group_create",
+	"group_unlink",
+	"group_iterate",
+	"dataset_open",
+	"attribute_exists",
+	"attribute_read",
+	"attribute_write",
+	"attribute_remove",
+	"attribute_copy",
+	"data_read",
+	"data_write",
+	"translate",
+};
+
+}
+
+/*===========================================================================*/
+/* HDF5 STATS */
+/*===========================================================================*/
+
+std::atomic<bool> HDF5Stats::enabled(enabledFromEnvironment());
+
+void HDF5Stats::record(HDF5StatsOperation op, uint64_t bytes, uint64_t nanoseconds)
+{
+	ThreadCounters& counters = threadCounters();
+	add(counters.values[op][CALLS], 1);
+	add(counters.values[op][BYTES], bytes);
+	add(counters.values[op][NANOSECONDS], nanoseconds);
+}
+
+HDF5StatsSnapshot HDF5Stats::snapshot()
+{
+	HDF5StatsSnapshot result;
+	Registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	for (int i=0; i<HDF5_STATS_OPERATIONS; i++)
+	{
+		uint64_t total[FIELDS];
+		for (int f=0; f<FIELDS; f++)
+		{
+			total[f] = r.retired[i][f];
+			for (size_t t=0; t<r.threads.size(); t++)
+				total[f] += r.threads[t]->counted(i, f);
+		}
+		result.operations[i].calls		= total[CALLS];
+		result.operations[i].bytes		= total[BYTES];
+		result.operations[i].nanoseconds	= total[NANOSECONDS];
+	}
+	for (size_t t=0; t<r.threads.size(); t++)
+		for (int i=0; i<HDF5_STATS_OPERATIONS; i++)
+			if (r.threads[t]->counted(i, CALLS))
+			{
+				result.threads++;
+				break;
+			}
+	return result;
+}
+
+void HDF5Stats::reset()
+{
+	Registry& r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	memset(r.retired, 0, sizeof(r.retired));
+	/* threads keep counting, their current values become the new zero */
+	for (size_t t=0; t<r.threads.size(); t++)
+		for (int i=0; i<HDF5_STATS_OPERATIONS; i++)
+			for (int f=0; f<FIELDS; f++)
+				r.threads[t]->baseline[i][f] = r.threads[t]->values[i][f].load(std::memory_order_relaxed);
+}
+
+const char* HDF5Stats::name(HDF5StatsOperation op)
+{
+	if (op < 0 || op >= HDF5_STATS_OPERATIONS)
+		throw std::invalid_argument("Unknown HDF5 stats operation");
+	return operationNames[op];
+}
+
+void HDF5Stats::writeFile(const std::string& path, const std::string& format)
+{
+	if (format != "json" && format != "prometheus")
+		throw std::invalid_argument("Unknown HDF5 stats format '" + format + "'");
+
+	HDF5StatsSnapshot stats = snapshot();
+	std::string temp = path + ".tmp";
+	{
+		std::ofstream out(temp.c_str());
+		if (!out)
+			throw std::runtime_error("Cannot write " + temp);
+		if (format == "json")
+			stats.writeJSON(out);
+		else
+			stats.writePrometheus(out);
+		out.close();
+		if (!out)
+			throw std::runtime_error("Cannot write " + temp);
+	}
+	if (std::rename(temp.c_str(), path.c_str()) != 0)
+	{
+		std::remove(temp.c_str());
+		throw std::runtime_error("Cannot rename " + temp + " to " + path);
+	}
+}
+
+/*===========================================================================*/
+/* SNAPSHOT */
+/*===========================================================================*/
+
+HDF5StatsSnapshot::HDF5StatsSnapshot()
+ : threads(0)
+{
+	memset(operations, 0, sizeof(operations));
+}
+
+void HDF5StatsSnapshot::writeJSON(std::ostream& out) const
+{
+	out << "{" << std::endl
+	    << "  \"enabled\": " << (HDF5Stats::isEnabled() ? "true" : "false") << "," << std::endl
+	    << "  \"threads\": " << threads << "," << std::endl
+	    << "  \"operations\": {" << std::endl;
+	for (int i=0; i<HDF5_STATS_OPERATIONS; i++)
+	{
+		char seconds[32];
+		snprintf(seconds, sizeof(seconds), "%.9f", operations[i].nanoseconds / 1e9);
+		out << "    \"" << operationNames[i] << "\": {"
+		    << "\"calls\": " << operations[i].calls
+		    << ", \"bytes\": " << operations[i].bytes
+		    << ", \"seconds\": " << seconds << "}"
+		    << (i + 1 < HDF5_STATS_OPERATIONS ? "," : "") << std::endl;
+	}
+	out << "  }" << std::endl
+	    << "}" << std::endl;
+}
+
+void HDF5StatsSnapshot::writePrometheus(std::ostream& out) const
+{
+	static const struct {
+		const char*	metric;
+		const char*	help;
+	} metrics[] = {
+		{ "radarlib_hdf5_calls_total",   "HDF5 operations done by radarlib." },
+		{ "radarlib_hdf5_bytes_total",   "Bytes of data read or written, values for translate." },
+		{ "radarlib_hdf5_seconds_total", "Wall time spent in HDF5 operations." },
+	};
+	for (int m=0; m<3; m++)
+	{
+		out << "# HELP " << metrics[m].metric << " " << metrics[m].help << std::endl
+		    << "# TYPE " << metrics[m].metric << " counter" << std::endl;
+		for (int i=0; i<HDF5_STATS_OPERATIONS; i++)
+		{
+			out << metrics[m].metric << "{operation=\"" << operationNames[i] << "\"} ";
+			if (m == 0)
+				out << operations[i].calls;
+			else if (m == 1)
+				out << operations[i].bytes;
+			else
+			{
+				char seconds[32];
+				snprintf(seconds, sizeof(seconds), "%.9f", operations[i].nanoseconds / 1e9);
+				out << seconds;
+			}
+			out << std::endl;
+		}
+	}
+}
+
+}
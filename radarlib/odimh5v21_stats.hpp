@@ -0,0 +1,175 @@
+/*
+ * odimh5v21_stats - counters and timing of HDF5 operations
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef __RADAR_ODIMH5V21_STATS_HPP__
+#define __RADAR_ODIMH5V21_STATS_HPP__
+/*!
+ * \file
+ * \brief Opt-in counters of calls, bytes and time of HDF5 operations
+ */
+
+#include <radarlib/defs.h>
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <stdint.h>
+
+namespace OdimH5v21 {
+
+/*!
+ * \brief Operations counted by HDF5Stats
+ */
+enum HDF5StatsOperation {
+	HDF5_STATS_FILE_OPEN,		/*!< files opened or created */
+	HDF5_STATS_GROUP_OPEN,
+	HDF5_STATS_GROUP_CREATE,
+	HDF5_STATS_GROUP_UNLINK,
+	HDF5_STATS_GROUP_ITERATE,	/*!< H5Literate walks looking for a child */
+	HDF5_STATS_DATASET_OPEN,
+	HDF5_STATS_ATTRIBUTE_EXISTS,
+	HDF5_STATS_ATTRIBUTE_READ,
+	HDF5_STATS_ATTRIBUTE_WRITE,
+	HDF5_STATS_ATTRIBUTE_REMOVE,
+	HDF5_STATS_ATTRIBUTE_COPY,
+	HDF5_STATS_DATA_READ,		/*!< data matrices read, inflate included */
+	HDF5_STATS_DATA_WRITE,		/*!< data matrices written, deflate included */
+	HDF5_STATS_TRANSLATE,		/*!< conversion between raw and physical values */
+	HDF5_STATS_OPERATIONS
+};
+
+/*!
+ * \brief Totals of an operation
+ */
+struct RADAR_API HDF5OperationStats {
+	uint64_t	calls;
+	uint64_t	bytes;		/*!< bytes of data, or values for HDF5_STATS_TRANSLATE */
+	uint64_t	nanoseconds;	/*!< wall time */
+};
+
+/*!
+ * \brief Totals of every operation over all the threads
+ */
+struct RADAR_API HDF5StatsSnapshot {
+	HDF5OperationStats	operations[HDF5_STATS_OPERATIONS];
+	int			threads;	/*!< threads that recorded operations */
+
+	HDF5StatsSnapshot();
+
+	const HDF5OperationStats& operator[](HDF5StatsOperation op) const	{ return operations[op]; }
+
+	/*!
+	 * \brief Write the totals as a JSON object keyed by operation name
+	 */
+	void writeJSON(std::ostream& out) const;
+	/*!
+	 * \brief Write the totals in the Prometheus text exposition format
+	 */
+	void writePrometheus(std::ostream& out) const;
+};
+
+/*!
+ * \brief Counters of HDF5 operations done by the library
+ *
+ * Counting is disabled by default, or enabled at startup when the environment
+ * variable RADARLIB_HDF5_STATS is set to a value other than 0. While disabled
+ * every instrumented call costs a single relaxed atomic load. \n
+ * Each thread updates its own counters, without locks; snapshot() and reset()
+ * take a lock only to walk the list of threads. Counters of threads that have
+ * ended are kept in the totals.
+ */
+class RADAR_API HDF5Stats {
+ public:
+	static void enable(bool value = true)	{ enabled.store(value, std::memory_order_relaxed); }
+	static bool isEnabled()			{ return enabled.load(std::memory_order_relaxed); }
+
+	/*!
+	 * \brief Current totals
+	 */
+	static HDF5StatsSnapshot snapshot();
+	/*!
+	 * \brief Start counting again from zero
+	 */
+	static void reset();
+
+	/*!
+	 * \brief Name of an operation, as used in the JSON and Prometheus output
+	 */
+	static const char* name(HDF5StatsOperation op);
+
+	/*!
+	 * \brief Write the current totals to a file
+	 *
+	 * The file is written under a temporary name and then renamed, so that
+	 * readers such as a Prometheus textfile collector never see it partially
+	 * written.
+	 * \param format	"json" or "prometheus"
+	 * \throws std::invalid_argument	if the format is unknown
+	 * \throws std::runtime_error	if the file cannot be written
+	 */
+	static void writeFile(const std::string& path, const std::string& format);
+
+	/*!
+	 * \brief Add a call to the counters of the calling thread
+	 */
+	static void record(HDF5StatsOperation op, uint64_t bytes, uint64_t nanoseconds);
+
+ private:
+	static std::atomic<bool> enabled;
+};
+
+/*!
+ * \brief Scope timing an operation
+ *
+ * The clock is read only when HDF5Stats is enabled at construction.
+ */
+class HDF5StatsScope {
+ public:
+	explicit HDF5StatsScope(HDF5StatsOperation op, uint64_t bytes = 0)
+	 : op(op), bytes(bytes), active(HDF5Stats::isEnabled())
+	{
+		if (active)
+			start = std::chrono::steady_clock::now();
+	}
+	~HDF5StatsScope()
+	{
+		if (active)
+			HDF5Stats::record(op, bytes, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	/*!
+	 * \brief True if the operation is recorded: compute the bytes for setBytes() only then
+	 */
+	bool isActive() const			{ return active; }
+	void setBytes(uint64_t value)		{ bytes = value; }
+
+ private:
+	HDF5StatsOperation			op;
+	uint64_t				bytes;
+	bool					active;
+	std::chrono::steady_clock::time_point	start;
+
+	HDF5StatsScope(const HDF5StatsScope&);
+	HDF5StatsScope& operator=(const HDF5StatsScope&);
+};
+
+}
+
+#endif
@@ -31,6 +31,9 @@
 #include <sstream>
 #include <vector>
 #include <cstdio>
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
 
 #include <radarlib/string.hpp>
 #include <radarlib/time.hpp>
@@ -318,6 +321,280 @@ double AZAngles::averagedAngle(int direction){
 }
 
 
+/*===========================================================================*/
+/* RAY TABLE */
+/*===========================================================================*/
+
+RayTable::RayTable()
+:direction(1)
+,a1gate(0)
+,hasAzimuthAngles(false)
+,hasElevationAngles(false)
+,hasAzimuthTimes(false)
+,numrays(0)
+,values()
+,rayIndex()
+{
+}
+
+void RayTable::resize(int numrays)
+{
+	if (numrays < 0)
+		throw std::invalid_argument("Number of rays cannot be negative");
+	this->numrays = numrays;
+	values.assign((size_t)COL_COUNT * numrays, 0.);
+	rayIndex.assign(numrays, 0);
+}
+
+/*===========================================================================*/
+/* POLAR CUBE */
+/*===========================================================================*/
+
+namespace {
+
+/* rays start on 64 byte boundaries */
+const size_t CUBE_ALIGNMENT = 16;
+
+}
+
+PolarCube::PolarCube()
+:scans()
+,rays(0)
+,bins(0)
+,rayStride(0)
+,northAligned(false)
+,buffer()
+,data(NULL)
+{
+}
+
+PolarCube::PolarCube(const PolarCube& other)
+:scans()
+,rays(0)
+,bins(0)
+,rayStride(0)
+,northAligned(false)
+,buffer()
+,data(NULL)
+{
+	*this = other;
+}
+
+PolarCube& PolarCube::operator=(const PolarCube& other)
+{
+	if (this == &other)
+		return *this;
+	std::vector<PolarCubeScan> copy(other.scans);
+	resize(other.getScanCount(), other.rays, other.bins);
+	scans = copy;
+	northAligned = other.northAligned;
+	if (data)
+		std::copy(other.data, other.data + scans.size() * getScanStride(), data);
+	return *this;
+}
+
+void PolarCube::resize(int scans, int rays, int bins)
+{
+	if (scans < 0 || rays < 0 || bins < 0)
+		throw std::invalid_argument("Size of a polar cube cannot be negative");
+	this->scans.assign(scans, PolarCubeScan());
+	this->rays	= rays;
+	this->bins	= bins;
+	rayStride	= (bins + CUBE_ALIGNMENT - 1) / CUBE_ALIGNMENT * CUBE_ALIGNMENT;
+	size_t count	= (size_t)scans * rays * rayStride;
+	if (!count)
+	{
+		buffer.clear();
+		data = NULL;
+		return;
+	}
+	buffer.assign(count + CUBE_ALIGNMENT, std::numeric_limits<float>::quiet_NaN());
+	size_t misalignment = ((size_t)&buffer[0] / sizeof(float)) % CUBE_ALIGNMENT;
+	data = &buffer[0] + (misalignment ? CUBE_ALIGNMENT - misalignment : 0);
+}
+
+size_t PolarCube::memorySize() const
+{
+	return sizeof(*this) + scans.capacity() * sizeof(PolarCubeScan) + buffer.capacity() * sizeof(float);
+}
+
+/*===========================================================================*/
+/* AZIMUTH INDEX */
+/*===========================================================================*/
+
+namespace {
+
+struct AzimuthSector
+{
+	double	lower;
+	double	upper;
+	int	ray;
+	bool operator<(const AzimuthSector& other) const
+	{
+		return lower < other.lower || (lower == other.lower && ray < other.ray);
+	}
+};
+
+inline double normalizeAzimuth(double azimuth)
+{
+	double result = fmod(azimuth, 360.);
+	if (result < 0)
+		result += 360.;
+	return result < 360. ? result : 0.;
+}
+
+}
+
+AzimuthIndex::AzimuthIndex()
+:numrays(0)
+,uniform(false)
+,offset(0)
+,step(0)
+,lead(0)
+,lower()
+,upper()
+,ray()
+{
+}
+
+AzimuthIndex::AzimuthIndex(const RayTable& table)
+:numrays(0)
+,uniform(false)
+,offset(0)
+,step(0)
+,lead(0)
+,lower()
+,upper()
+,ray()
+{
+	build(table);
+}
+
+void AzimuthIndex::build(const RayTable& table)
+{
+	build(table.startAzimuth(), table.stopAzimuth(), table.size(), table.direction);
+}
+
+void AzimuthIndex::build(const double* startaz, const double* stopaz, int numrays, int direction)
+{
+	if (numrays < 0)
+		throw std::invalid_argument("Number of rays cannot be negative");
+
+	this->numrays	= numrays;
+	uniform		= false;
+	offset		= 0;
+	step		= numrays ? 360. / numrays : 0;
+	lead		= 0;
+
+	std::vector<AzimuthSector> sectors;
+	sectors.reserve(numrays + 1);
+
+	/* express every ray as a clockwise sector, splitting the ones crossing north */
+	double minWidth = 360., maxWidth = 0.;
+	for (int i=0; i<numrays; i++)
+	{
+		double first	= normalizeAzimuth(direction >= 0 ? startaz[i] : stopaz[i]);
+		double last	= normalizeAzimuth(direction >= 0 ? stopaz[i]  : startaz[i]);
+		if (std::isnan(first) || std::isnan(last))
+		{
+			minWidth = 0.;
+			continue;
+		}
+		double width	= last - first;
+		if (width < 0)
+			width += 360.;
+		if (width == 0 && numrays == 1)
+			width = 360.;
+		minWidth = std::min(minWidth, width);
+		maxWidth = std::max(maxWidth, width);
+		if (width == 0)
+			continue;
+
+		AzimuthSector sector;
+		sector.ray	= i;
+		sector.lower	= first;
+		sector.upper	= first + width;
+		if (sector.upper > 360.)
+		{
+			AzimuthSector after;
+			after.ray	= i;
+			after.lower	= 0.;
+			after.upper	= sector.upper - 360.;
+			sectors.push_back(after);
+			sector.upper	= 360.;
+		}
+		sectors.push_back(sector);
+	}
+	std::sort(sectors.begin(), sectors.end());
+
+	size_t count = sectors.size();
+	lower.resize(count);
+	upper.resize(count);
+	ray.resize(count);
+	for (size_t i=0; i<count; i++)
+	{
+		lower[i]	= sectors[i].lower;
+		upper[i]	= sectors[i].upper;
+		ray[i]		= sectors[i].ray;
+		/* clip overlaps so that the sectors form a partition */
+		if (i && upper[i-1] > lower[i])
+			upper[i-1] = lower[i];
+	}
+
+	/* within a thousandth of degree every ray is used at most one step away from its guess */
+	if (numrays && (int)count >= numrays && (maxWidth - minWidth) < 1e-3 && fabs(maxWidth - step) < 1e-3)
+	{
+		uniform	= true;
+		lead	= (int)count > numrays ? 1 : 0;
+		offset	= lead ? lower[1] : lower[0];
+	}
+}
+
+int AzimuthIndex::locate(double azimuth, int guess) const
+{
+	int last = (int)lower.size() - 1;
+	if (guess > last)
+		guess = last;
+	if (guess < 0)
+		guess = 0;
+	/* move to the last sector starting before the azimuth */
+	while (guess > 0 && azimuth < lower[guess])
+		guess--;
+	while (guess < last && azimuth >= lower[guess+1])
+		guess++;
+	if (azimuth < lower[guess] || azimuth >= upper[guess])
+		return -1;
+	return ray[guess];
+}
+
+int AzimuthIndex::findRay(double azimuth) const
+{
+	if (lower.empty() || std::isnan(azimuth))
+		return -1;
+	double az = normalizeAzimuth(azimuth);
+	if (uniform)
+		return locate(az, (int)floor((az - offset) / step) + lead);
+	std::vector<double>::const_iterator pos = std::upper_bound(lower.begin(), lower.end(), az);
+	if (pos == lower.begin())
+		return -1;
+	int k = (int)(pos - lower.begin()) - 1;
+	return az < upper[k] ? ray[k] : -1;
+}
+
+void AzimuthIndex::findRays(const double* azimuths, int* rays, size_t count) const
+{
+	for (size_t i=0; i<count; i++)
+		rays[i] = findRay(azimuths[i]);
+}
+
+std::vector<int> AzimuthIndex::findRays(const std::vector<double>& azimuths) const
+{
+	std::vector<int> result(azimuths.size());
+	if (!azimuths.empty())
+		findRays(&azimuths[0], &result[0], azimuths.size());
+	return result;
+}
+
 /*===========================================================================*/
 /* AZIMUTH TIMES */
 /*===========================================================================*/
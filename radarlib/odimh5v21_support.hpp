@@ -29,6 +29,7 @@
 
 /*===========================================================================*/
 
+#include <ctime>
 #include <string>
 #include <vector>
 
@@ -439,6 +440,177 @@ public:
 	static std::string toString(const std::vector<AZTimes>& right);
 };
 
+/*===========================================================================*/
+/* RAY METADATA TABLE */
+/*===========================================================================*/
+
+/*! 
+ * \brief Per-ray geometry of a polar scan
+ *
+ * This class stores the per-ray metadata of a scan as a struct of arrays. \n
+ * All the double columns live in a single contiguous buffer, one column after the other, 
+ * so that algorithms can stream through them linearly. \n
+ * Ray i is the i-th row of the scan matrix (rays are ordered clockwise starting from north). \n
+ * Missing how/ arrays are replaced by values derived from the where/ attributes:
+ * uniform azimuths, where/elangle for the elevation and NaN for the times.
+ * \see PolarScan::getRayTable | AZAngles | AZTimes
+ */
+class RADAR_API RayTable
+{
+public:
+	/*!
+	 * \brief Create an empty table
+	 */
+	RayTable();
+	/*!
+	 * \brief Resize the table to store the given number of rays
+	 *
+	 * Previous values are lost
+	 * \param numrays		number of rays
+	 */
+	void resize(int numrays);
+
+	/*!
+	 * \brief Number of rays in the table
+	 */
+	inline int size() const { return numrays; }
+
+	/*! \brief Start azimuth angle of each ray (how/startazA) */
+	inline double*		startAzimuth	()		{ return column(COL_STARTAZA);	}
+	inline const double*	startAzimuth	() const	{ return column(COL_STARTAZA);	}
+	/*! \brief Stop azimuth angle of each ray (how/stopazA) */
+	inline double*		stopAzimuth	()		{ return column(COL_STOPAZA);	}
+	inline const double*	stopAzimuth	() const	{ return column(COL_STOPAZA);	}
+	/*! \brief Centre azimuth angle of each ray, computed as AZAngles::averagedAngle(direction) */
+	inline double*		centreAzimuth	()		{ return column(COL_CENTREAZA);	}
+	inline const double*	centreAzimuth	() const	{ return column(COL_CENTREAZA);	}
+	/*! \brief Elevation angle of each ray (how/elangles) */
+	inline double*		elevation	()		{ return column(COL_ELANGLES);	}
+	inline const double*	elevation	() const	{ return column(COL_ELANGLES);	}
+	/*! \brief Start acquisition time of each ray (how/startazT) */
+	inline double*		startTime	()		{ return column(COL_STARTAZT);	}
+	inline const double*	startTime	() const	{ return column(COL_STARTAZT);	}
+	/*! \brief Stop acquisition time of each ray (how/stopazT) */
+	inline double*		stopTime	()		{ return column(COL_STOPAZT);	}
+	inline const double*	stopTime	() const	{ return column(COL_STOPAZT);	}
+	/*! \brief Temporal index of each ray, see PolarScan::originaRayIndex */
+	inline int*		originalIndex	()		{ return numrays ? &(rayIndex[0]) : NULL; }
+	inline const int*	originalIndex	() const	{ return numrays ? &(rayIndex[0]) : NULL; }
+
+	/*!
+	 * \brief Scan direction used to compute centre azimuths and original indexes (1 clockwise, -1 counter-clockwise)
+	 */
+	int	direction;
+	/*!
+	 * \brief Value of where/a1gate
+	 */
+	int	a1gate;
+	/*!
+	 * \brief True if start/stop azimuth angles were read from how/startazA and how/stopazA
+	 */
+	bool	hasAzimuthAngles;
+	/*!
+	 * \brief True if elevations were read from how/elangles
+	 */
+	bool	hasElevationAngles;
+	/*!
+	 * \brief True if times were read from how/startazT and how/stopazT
+	 */
+	bool	hasAzimuthTimes;
+
+private:
+	enum { COL_STARTAZA, COL_STOPAZA, COL_CENTREAZA, COL_ELANGLES, COL_STARTAZT, COL_STOPAZT, COL_COUNT };
+
+	inline double*		column(int col)		{ return numrays ? &(values[(size_t)col * numrays]) : NULL; }
+	inline const double*	column(int col) const	{ return numrays ? &(values[(size_t)col * numrays]) : NULL; }
+
+	int			numrays;
+	std::vector<double>	values;
+	std::vector<int>	rayIndex;
+};
+
+/*===========================================================================*/
+/* AZIMUTH INDEX */
+/*===========================================================================*/
+
+/*!
+ * \brief Lookup index from geographic azimuth to ray index
+ *
+ * Each ray covers the sector swept by the antenna from its start to its stop azimuth,
+ * clockwise for clockwise scans and counter-clockwise otherwise. \n
+ * Sectors crossing north are split at 0/360 and overlapping sectors are clipped
+ * at the start of the following one, so that every azimuth belongs to at most one ray. \n
+ * Lookups are O(1) when rays have the same width and O(log n) otherwise.
+ */
+class RADAR_API AzimuthIndex
+{
+public:
+	/*!
+	 * \brief Create an empty index, every lookup returns -1
+	 */
+	AzimuthIndex();
+	/*!
+	 * \brief Create an index for the rays of the given table
+	 * \see build()
+	 */
+	AzimuthIndex(const RayTable& table);
+
+	/*!
+	 * \brief Rebuild the index using start and stop azimuths of the given table
+	 */
+	void build(const RayTable& table);
+	/*!
+	 * \brief Rebuild the index
+	 *
+	 * \param startaz		start azimuth of each ray, in degrees
+	 * \param stopaz		stop azimuth of each ray, in degrees
+	 * \param numrays		number of rays
+	 * \param direction		1 for clockwise scans, -1 for counter-clockwise scans
+	 */
+	void build(const double* startaz, const double* stopaz, int numrays, int direction);
+
+	/*!
+	 * \brief Find the ray covering the given azimuth
+	 *
+	 * \param azimuth		azimuth in degrees, any value is normalized to [0,360)
+	 * \returns			index of the ray, or -1 if the azimuth falls in a gap or is NaN
+	 */
+	int findRay(double azimuth) const;
+	/*!
+	 * \brief Find the rays covering the given azimuths
+	 *
+	 * \param azimuths		azimuths in degrees
+	 * \param rays		buffer of count elements receiving the results of findRay()
+	 * \param count		number of azimuths
+	 */
+	void findRays(const double* azimuths, int* rays, size_t count) const;
+	/*!
+	 * \brief Find the rays covering the given azimuths
+	 */
+	std::vector<int> findRays(const std::vector<double>& azimuths) const;
+
+	/*!
+	 * \brief Number of rays used to build the index
+	 */
+	inline int size() const { return numrays; }
+	/*!
+	 * \brief True if the rays have the same width and lookups are O(1)
+	 */
+	inline bool isUniform() const { return uniform; }
+
+private:
+	int			numrays;
+	bool			uniform;
+	double			offset;		/* azimuth of the first ray boundary after north */
+	double			step;		/* width of rays for uniform scans */
+	int			lead;		/* 1 if the first sector is the part after north of a ray crossing it */
+	std::vector<double>	lower;		/* sectors sorted by lower bound */
+	std::vector<double>	upper;
+	std::vector<int>	ray;
+
+	int locate(double azimuth, int guess) const;
+};
+
 /*===========================================================================*/
 /* VIL HEIGHTS PAIR */
 /*===========================================================================*/
@@ -725,6 +897,100 @@ public:
 	inline int getBinCount() const { return this->cols; }
 };
 
+/*===========================================================================*/
+/* POLAR CUBE */
+/*===========================================================================*/
+
+/*!
+ * \brief Shape and geometry of a scan stored in a PolarCube
+ */
+struct RADAR_API PolarCubeScan
+{
+	int	index;		/*!< index of the scan in the volume */
+	double	elangle;	/*!< elevation angle (degrees) */
+	int	numrays;	/*!< number of rays of the scan, rays after it are padding */
+	int	numbins;	/*!< number of bins of the scan, bins after it are padding */
+	double	rangeStart;	/*!< range of the start of the first bin (km) */
+	double	rangeScale;	/*!< distance between bins (m) */
+	double	beamWidth;	/*!< beam width (degrees) */
+	int	a1gate;		/*!< index of the first ray acquired */
+	time_t	startDateTime;	/*!< start of the scan */
+	time_t	endDateTime;	/*!< end of the scan */
+	double	gain;		/*!< gain of the stored data */
+	double	offset;		/*!< offset of the stored data */
+};
+
+/*!
+ * \brief Physical values of a quantity for every scan of a volume
+ *
+ * Values are stored in a single contiguous buffer indexed by [scan][ray][bin].
+ * Every scan has room for the largest number of rays, every ray for the largest
+ * number of bins rounded up to a multiple of 16 values, and the buffer starts on
+ * a 64 byte boundary, so that every ray starts on a cache line. \n
+ * Gates whose raw value is 'nodata' and padding elements are NaN, gates whose
+ * raw value is 'undetect' are -infinity.
+ * \see PolarVolume::readCube
+ */
+class RADAR_API PolarCube
+{
+public:
+	/*!
+	 * \brief Create an empty cube
+	 */
+	PolarCube();
+	PolarCube(const PolarCube& other);
+	PolarCube& operator=(const PolarCube& other);
+
+	/*!
+	 * \brief Resize the cube, setting every element to NaN
+	 *
+	 * \param scans		number of scans
+	 * \param rays		maximum number of rays of a scan
+	 * \param bins		maximum number of bins of a ray
+	 */
+	void resize(int scans, int rays, int bins);
+
+	/*! \brief Number of scans */
+	inline int getScanCount() const		{ return (int)scans.size(); }
+	/*! \brief Maximum number of rays of a scan */
+	inline int getRayCount() const		{ return rays; }
+	/*! \brief Maximum number of bins of a ray */
+	inline int getBinCount() const		{ return bins; }
+	/*! \brief Distance between the first elements of two consecutive rays */
+	inline size_t getRayStride() const	{ return rayStride; }
+	/*! \brief Distance between the first elements of two consecutive scans */
+	inline size_t getScanStride() const	{ return rayStride * rays; }
+	/*! \brief True if ray i of each scan covers the i-th sector clockwise from north */
+	inline bool isNorthAligned() const	{ return northAligned; }
+	inline void setNorthAligned(bool val)	{ northAligned = val; }
+
+	/*! \brief Shape and geometry of a scan */
+	inline PolarCubeScan&		getScan(int scan)	{ return scans[scan]; }
+	inline const PolarCubeScan&	getScan(int scan) const	{ return scans[scan]; }
+
+	/*! \brief First element of the cube */
+	inline float*		get()			{ return data; }
+	inline const float*	get() const		{ return data; }
+	/*! \brief First element of a ray */
+	inline float*		ray(int scan, int r)		{ return data + scan * getScanStride() + r * rayStride; }
+	inline const float*	ray(int scan, int r) const	{ return data + scan * getScanStride() + r * rayStride; }
+	/*! \brief Element of a gate */
+	inline float&		elem(int scan, int r, int bin)		{ return ray(scan, r)[bin]; }
+	inline float		elem(int scan, int r, int bin) const	{ return ray(scan, r)[bin]; }
+
+	/*! \brief Memory used by the cube, in bytes */
+	size_t memorySize() const;
+
+private:
+	std::vector<PolarCubeScan>	scans;
+	int				rays;
+	int				bins;
+	size_t				rayStride;
+	bool				northAligned;
+	std::vector<float>		buffer;
+	float*				data;
+};
+
 /*===========================================================================*/
 /* ELEVATION ANGLES */
 /*===========================================================================*/
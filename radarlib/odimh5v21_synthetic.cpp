@@ -0,0 +1,610 @@
+/*
+ * odimh5v21_synthetic - seeded synthetic ODIM files for load testing
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <radarlib/odimh5v21_synthetic.hpp>
+#include <radarlib/odimh5v21_const.hpp>
+#include <radarlib/odimh5v21_exceptions.hpp>
+#include <radarlib/odimh5v21_factory.hpp>
+#include <radarlib/odimh5v21_geometry.hpp>
+#include <radarlib/odimh5v21_rainrate.hpp>
+#include <radarlib/io.hpp>
+#include <radarlib/parallel.hpp>
+#include <radarlib/time.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#if !defined(WIN32)
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace OdimH5v21 {
+namespace products {
+
+namespace {
+
+const double DOMAIN_SIZE	= 800.;		/* km */
+const double SITE_RING		= 150.;		/* km */
+const double SCAN_SECONDS	= 12.;
+const double NYQUIST		= 16.;		/* m/s */
+
+/* splitmix64 finalizer, so that sequences do not depend on the standard library */
+uint64_t mix(uint64_t x)
+{
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+/* uniform in [0, 1) */
+double uniform(uint64_t seed, uint64_t counter)
+{
+	return (mix(seed ^ mix(counter)) >> 11) * (1. / 9007199254740992.);
+}
+
+/* position in the domain, wrapped to [-DOMAIN_SIZE / 2, DOMAIN_SIZE / 2) */
+double wrap(double v)
+{
+	return v - DOMAIN_SIZE * floor(v / DOMAIN_SIZE + 0.5);
+}
+
+RawType typeOf(const std::string& name)
+{
+	if (name == "uint8")	return RAW_UINT8;
+	if (name == "uint16")	return RAW_UINT16;
+	if (name == "float")	return RAW_FLOAT;
+	throw std::invalid_argument("Unsupported synthetic data type '" + name + "', use uint8, uint16 or float");
+}
+
+bool isVelocity(const std::string& q)	{ return q == PRODUCT_QUANTITY_VRAD || q == "VRADH"; }
+bool isWidth(const std::string& q)	{ return q == PRODUCT_QUANTITY_WRAD || q == "WRADH"; }
+
+/*
+ * Value of a quantity at a gate with the given reflectivity.
+ * Azimuth and elevation (degrees) are only used for radial velocities.
+ */
+float quantityValue(const std::string& q, float dbz, double az, double el, const SyntheticField& field, float noise)
+{
+	if (std::isnan(dbz) || dbz == UNDETECT)
+		return dbz;
+	if (isVelocity(q))
+	{
+		double v = field.getWindSpeed() * cos((az - field.getWindDirection()) * M_PI / 180.) * cos(el * M_PI / 180.) + noise * 0.5;
+		return (float)(v - 2. * NYQUIST * floor(v / (2. * NYQUIST) + 0.5));
+	}
+	if (isWidth(q))
+		return 1.5f + 0.5f * noise;
+	float zdr = std::min(4.f, std::max(-0.5f, 0.2f + 0.05f * (dbz - 15.f) + 0.2f * noise));
+	if (q == PRODUCT_QUANTITY_ZDR)
+		return zdr;
+	if (q == PRODUCT_QUANTITY_DBZV || q == PRODUCT_QUANTITY_TV)
+		return dbz - zdr;
+	if (q == PRODUCT_QUANTITY_TH)
+		return dbz + 0.5f + 0.5f * fabsf(noise);
+	if (q == PRODUCT_QUANTITY_RHOHV)
+		return 0.985f - 0.015f * fabsf(noise);
+	if (q == PRODUCT_QUANTITY_KDP)
+		return (dbz > 35.f ? 0.08f * (dbz - 35.f) : 0.f) + 0.05f * noise;
+	if (q == PRODUCT_QUANTITY_RATE)
+		return RainRateLaw().rate(dbz);
+	return dbz;
+}
+
+std::string jsonString(const std::string& s)
+{
+	std::string res = "\"";
+	for (size_t i = 0; i < s.size(); ++i)
+	{
+		unsigned char c = (unsigned char)s[i];
+		if (c == '"' || c == '\\')
+			res += '\\';
+		else if (c < 0x20)
+		{
+			char buff[8];
+			snprintf(buff, sizeof(buff), "\\u%04x", c);
+			res += buff;
+			continue;
+		}
+		res += s[i];
+	}
+	return res + "\"";
+}
+
+std::string jsonList(const std::vector<std::string>& values)
+{
+	std::string res = "[";
+	for (size_t i = 0; i < values.size(); ++i)
+		res += (i ? ", " : "") + jsonString(values[i]);
+	return res + "]";
+}
+
+}
+
+/*===========================================================================*/
+/* SYNTHETIC FIELD */
+/*===========================================================================*/
+
+SyntheticField::SyntheticField(uint64_t seed, int count)
+{
+	uint64_t n = 0;
+	windSpeed	= 8. + 17. * uniform(seed, n++);
+	windDirection	= 360. * uniform(seed, n++);
+	for (int i = 0; i < 3; ++i)
+		phase[i] = 2. * M_PI * uniform(seed, n++);
+
+	cells.resize(count);
+	for (int i = 0; i < count; ++i)
+	{
+		Cell& c = cells[i];
+		double dir = (windDirection + 40. * (uniform(seed, n++) - 0.5)) * M_PI / 180.;
+		double speed = windSpeed * (0.8 + 0.4 * uniform(seed, n++));
+		c.x		= DOMAIN_SIZE * (uniform(seed, n++) - 0.5);
+		c.y		= DOMAIN_SIZE * (uniform(seed, n++) - 0.5);
+		c.u		= speed * sin(dir);
+		c.v		= speed * cos(dir);
+		c.radius	= 5. + 30. * uniform(seed, n++);
+		c.peak		= 35. + 25. * uniform(seed, n++);
+	}
+}
+
+float SyntheticField::reflectivity(double x, double y, double height, double t) const
+{
+	/* stratiform background between about -6 and 22 dBZ */
+	double dbz = 8. + 9. * sin(x / 37. + phase[0]) * sin(y / 53. + phase[1]) + 5. * sin((x - y) / 91. + phase[2] + t * 0.0004);
+	for (size_t i = 0; i < cells.size(); ++i)
+	{
+		const Cell& c = cells[i];
+		double dx = wrap(x - c.x - c.u * t * 0.001);
+		double dy = wrap(y - c.y - c.v * t * 0.001);
+		/* gaussian in linear Z, parabolic in dBZ */
+		double cell = c.peak - 12. * (dx * dx + dy * dy) / (c.radius * c.radius);
+		if (cell > dbz)
+			dbz = cell;
+	}
+	if (height > 2000.)
+		dbz -= (height - 2000.) * 0.004;
+	return dbz < 5. ? UNDETECT : (float)dbz;
+}
+
+float SyntheticField::noise(uint64_t seed, uint64_t counter)
+{
+	return (float)(uniform(seed, counter) * 2. - 1.);
+}
+
+/*===========================================================================*/
+/* SPECS */
+/*===========================================================================*/
+
+SyntheticVolumeSpec::SyntheticVolumeSpec()
+ : scans(10), rays(360), bins(500), rscale(250.), type("uint8"), compression(6), rayArrays(true), sites(1)
+{
+	quantities.push_back(PRODUCT_QUANTITY_DBZH);
+	quantities.push_back(PRODUCT_QUANTITY_VRAD);
+}
+
+SyntheticCompSpec::SyntheticCompSpec()
+ : xsize(800), ysize(800), xscale(1000.), yscale(1000.), type("uint8"), compression(6)
+{
+	quantities.push_back(PRODUCT_QUANTITY_DBZH);
+}
+
+/*===========================================================================*/
+/* CORPUS */
+/*===========================================================================*/
+
+SyntheticCorpus::SyntheticCorpus(const std::string& directory, uint64_t seed)
+ : directory(directory), seed(seed), start(Radar::timeutils::mktime(2000,1,1,0,0,0)), interval(300),
+   centreLat(44.5), centreLon(11.5), field(seed)
+{
+}
+
+void SyntheticCorpus::addVolumes(int count, const SyntheticVolumeSpec& spec)
+{
+	typeOf(spec.type);
+	if (count < 0 || spec.scans <= 0 || spec.rays <= 0 || spec.bins <= 0 || spec.rscale <= 0. || spec.sites <= 0)
+		throw std::invalid_argument("Synthetic volumes need positive counts, sizes and range scale");
+	if (spec.quantities.empty())
+		throw std::invalid_argument("Synthetic volumes need at least one quantity");
+	if (spec.compression < 0 || spec.compression > 9)
+		throw std::invalid_argument("Compression must be a deflate level from 0 to 9");
+
+	volumeSpecs.push_back(spec);
+	for (int i = 0; i < count; ++i)
+	{
+		SyntheticEntry entry;
+		entry.path	= entryPath(OBJECT_PVOL);
+		entry.object	= OBJECT_PVOL;
+		entry.spec	= (int)volumeSpecs.size() - 1;
+		entry.site	= i % spec.sites;
+		entry.time	= start + (time_t)(i / spec.sites) * interval;
+		entry.bytes	= 0;
+		entries.push_back(entry);
+	}
+}
+
+void SyntheticCorpus::addComps(int count, const SyntheticCompSpec& spec)
+{
+	typeOf(spec.type);
+	if (count < 0 || spec.xsize <= 0 || spec.ysize <= 0 || spec.xscale <= 0. || spec.yscale <= 0.)
+		throw std::invalid_argument("Synthetic composites need positive counts, sizes and scales");
+	if (spec.quantities.empty())
+		throw std::invalid_argument("Synthetic composites need at least one quantity");
+	if (spec.compression < 0 || spec.compression > 9)
+		throw std::invalid_argument("Compression must be a deflate level from 0 to 9");
+
+	compSpecs.push_back(spec);
+	for (int i = 0; i < count; ++i)
+	{
+		SyntheticEntry entry;
+		entry.path	= entryPath(OBJECT_COMP);
+		entry.object	= OBJECT_COMP;
+		entry.spec	= (int)compSpecs.size() - 1;
+		entry.site	= -1;
+		entry.time	= start + (time_t)i * interval;
+		entry.bytes	= 0;
+		entries.push_back(entry);
+	}
+}
+
+std::string SyntheticCorpus::entryPath(const char* object) const
+{
+	std::ostringstream ss;
+	ss << directory << "/" << prefix << object << "-" << std::setw(6) << std::setfill('0') << entries.size() << ".h5";
+	return ss.str();
+}
+
+std::string SyntheticCorpus::siteNode(int site)
+{
+	std::ostringstream ss;
+	ss << "syn" << std::setw(2) << std::setfill('0') << site;
+	return ss.str();
+}
+
+void SyntheticCorpus::siteOffset(const SyntheticVolumeSpec& spec, int site, double& x, double& y) const
+{
+	if (spec.sites == 1)
+	{
+		x = y = 0.;
+		return;
+	}
+	double az = 2. * M_PI * site / spec.sites;
+	x = SITE_RING * sin(az);
+	y = SITE_RING * cos(az);
+}
+
+void SyntheticCorpus::getSite(const SyntheticVolumeSpec& spec, int site, double& lat, double& lon) const
+{
+	double x, y;
+	siteOffset(spec, site, x, y);
+	double ground = sqrt(x * x + y * y) * 1000.;
+	geometry::PolarGeometry::computeRadial(centreLat, centreLon, atan2(x, y) * 180. / M_PI, &ground, 1, &lat, &lon);
+}
+
+Encoding SyntheticCorpus::encodingFor(const std::string& quantity, const std::string& type)
+{
+	RawType rawtype = typeOf(type);
+	if (type == "float")
+		return Encoding(rawtype, 1., 0., -9999., -9998.);
+
+	double gain = 0.5, offset = -32.;
+	if (isVelocity(quantity))			{ gain = 0.25;		offset = -32.; }
+	else if (isWidth(quantity))			{ gain = 0.1;		offset = 0.; }
+	else if (quantity == PRODUCT_QUANTITY_ZDR)	{ gain = 0.0625;	offset = -8.; }
+	else if (quantity == PRODUCT_QUANTITY_RHOHV)	{ gain = 0.005;		offset = 0.; }
+	else if (quantity == PRODUCT_QUANTITY_KDP)	{ gain = 0.1;		offset = -5.; }
+	else if (quantity == PRODUCT_QUANTITY_RATE)	{ gain = 0.5;		offset = 0.; }
+
+	if (type == "uint16")
+		return Encoding(rawtype, gain / 128., offset, 65535., 0.);
+	return Encoding(rawtype, gain, offset, 255., 0.);
+}
+
+void SyntheticCorpus::createVolume(const std::string& path, const SyntheticVolumeSpec& spec, int site, time_t time) const
+{
+	double sx, sy, lat, lon;
+	siteOffset(spec, site, sx, sy);
+	getSite(spec, site, lat, lon);
+	/* the blocked sector of a radar does not change with time */
+	double blocked = 360. * uniform(seed, 1000 + site);
+
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.createPolarVolume(path));
+	volume->setDateTime(time);
+	SourceInfo source;
+	source.setOperaRadarNode(siteNode(site));
+	volume->setSource(source);
+	volume->setLatitude(lat);
+	volume->setLongitude(lon);
+	volume->setAltitude(100.);
+
+	size_t gates = (size_t)spec.rays * spec.bins;
+	std::vector<double> ground(spec.bins), height(spec.bins);
+	std::vector<float> dbz(gates), values(gates);
+	std::vector<char> raw;
+
+	for (int s = 0; s < spec.scans; ++s)
+	{
+		double el = 0.5 + s;
+		double scanStart = time + s * SCAN_SECONDS;
+		uint64_t scanSeed = mix(mix(mix(seed) ^ (uint64_t)time) ^ (uint64_t)(site * 256 + s));
+
+		std::unique_ptr<PolarScan> scan(volume->createScan());
+		scan->setStartDateTime((time_t)scanStart);
+		scan->setEndDateTime((time_t)(scanStart + SCAN_SECONDS));
+		scan->setEAngle(el);
+		scan->setA1Gate(0);
+		scan->setNumBins(spec.bins);
+		scan->setNumRays(spec.rays);
+		scan->setRangeStart(0);
+		scan->setRangeScale(spec.rscale);
+		scan->setBeamWidth(1.);
+
+		geometry::PolarGeometry::computeBins(el, 0., spec.rscale, spec.bins, NULL, &ground[0], &height[0]);
+		for (int r = 0; r < spec.rays; ++r)
+		{
+			double az = (r + 0.5) * 360. / spec.rays;
+			double sinAz = sin(az * M_PI / 180.), cosAz = cos(az * M_PI / 180.);
+			bool inSector = fmod(az - blocked + 360., 360.) < 4.;
+			float* row = &dbz[(size_t)r * spec.bins];
+			for (int b = 0; b < spec.bins; ++b)
+			{
+				if (inSector && ground[b] > 20000.)
+				{
+					row[b] = NODATA;
+					continue;
+				}
+				double km = ground[b] * 0.001;
+				float z = field.reflectivity(sx + km * sinAz, sy + km * cosAz, height[b], scanStart - start);
+				if (z != UNDETECT)
+					z += SyntheticField::noise(scanSeed, (uint64_t)r * spec.bins + b);
+				row[b] = z;
+			}
+		}
+
+		if (spec.rayArrays)
+		{
+			std::vector<double> startA(spec.rays), stopA(spec.rays), startT(spec.rays), stopT(spec.rays), elangles(spec.rays);
+			for (int r = 0; r < spec.rays; ++r)
+			{
+				startA[r]	= r * 360. / spec.rays;
+				stopA[r]	= (r + 1) * 360. / spec.rays;
+				startT[r]	= scanStart + r * SCAN_SECONDS / spec.rays;
+				stopT[r]	= scanStart + (r + 1) * SCAN_SECONDS / spec.rays;
+				elangles[r]	= el + 0.01 * SyntheticField::noise(scanSeed ^ 1, r);
+			}
+			scan->setStartAzimuthAngles(startA);
+			scan->setStopAzimuthAngles(stopA);
+			scan->setStartAzimuthTimes(startT);
+			scan->setStopAzimuthTimes(stopT);
+			scan->setElevationAngles(elangles);
+		}
+
+		for (size_t q = 0; q < spec.quantities.size(); ++q)
+		{
+			const std::string& quantity = spec.quantities[q];
+			uint64_t quantitySeed = mix(scanSeed ^ (q + 1));
+			for (int r = 0; r < spec.rays; ++r)
+			{
+				double az = (r + 0.5) * 360. / spec.rays;
+				size_t base = (size_t)r * spec.bins;
+				for (int b = 0; b < spec.bins; ++b)
+					values[base + b] = quantityValue(quantity, dbz[base + b], az, el, field,
+									 SyntheticField::noise(quantitySeed, base + b));
+			}
+			Encoding encoding = encodingFor(quantity, spec.type);
+			raw.resize(gates * getRawSize(encoding.rawtype));
+			encoding.encode(&values[0], gates, &raw[0]);
+			std::unique_ptr<PolarScanData> data(scan->createQuantityData(quantity));
+			encoding.writeTo(*data);
+			data->writeData(&raw[0], spec.bins, spec.rays, encoding.rawtype, spec.compression);
+		}
+	}
+}
+
+void SyntheticCorpus::createComp(const std::string& path, const SyntheticCompSpec& spec, time_t time) const
+{
+	double t = difftime(time, start);
+	uint64_t compSeed = mix(mix(seed) ^ (uint64_t)time);
+	CartesianGrid grid = CartesianGrid::centeredOn(centreLat, centreLon, spec.xsize, spec.ysize, spec.xscale, spec.yscale);
+
+	OdimFactory factory;
+	std::unique_ptr<CompObject> comp(factory.createCompObject(path));
+	comp->setDateTime(time);
+	SourceInfo source;
+	source.setOperaRadarNode("syncmp");
+	comp->setSource(source);
+	grid.writeTo(*comp);
+
+	std::unique_ptr<Product_COMP> dataset(comp->createProductCOMP());
+	dataset->setStartDateTime(time - interval);
+	dataset->setEndDateTime(time);
+	grid.writeTo(*dataset);
+
+	size_t pixels = (size_t)spec.xsize * spec.ysize;
+	std::vector<float> dbz(pixels), values(pixels);
+	for (int r = 0; r < spec.ysize; ++r)
+		for (int c = 0; c < spec.xsize; ++c)
+		{
+			size_t i = (size_t)r * spec.xsize + c;
+			float z = field.reflectivity(grid.pixelX(c) * 0.001, grid.pixelY(r) * 0.001, 1000., t);
+			if (z != UNDETECT)
+				z += SyntheticField::noise(compSeed, i);
+			dbz[i] = z;
+		}
+
+	std::vector<char> raw;
+	for (size_t q = 0; q < spec.quantities.size(); ++q)
+	{
+		const std::string& quantity = spec.quantities[q];
+		uint64_t quantitySeed = mix(compSeed ^ (q + 1));
+		for (size_t i = 0; i < pixels; ++i)
+			values[i] = quantityValue(quantity, dbz[i], 0., 0., field, SyntheticField::noise(quantitySeed, i));
+		Encoding encoding = encodingFor(quantity, spec.type);
+		raw.resize(pixels * getRawSize(encoding.rawtype));
+		encoding.encode(&values[0], pixels, &raw[0]);
+		std::unique_ptr<Product_2D_Data> data(dataset->createQuantityData(quantity));
+		encoding.writeTo(*data);
+		data->writeData(&raw[0], spec.xsize, spec.ysize, encoding.rawtype, spec.compression);
+	}
+}
+
+bool SyntheticCorpus::createEntry(const SyntheticEntry& entry) const
+{
+	try
+	{
+		if (entry.object == OBJECT_PVOL)
+			createVolume(entry.path, volumeSpecs[entry.spec], entry.site, entry.time);
+		else
+			createComp(entry.path, compSpecs[entry.spec], entry.time);
+		return true;
+	}
+	catch (...)
+	{
+		std::remove(entry.path.c_str());
+		return false;
+	}
+}
+
+size_t SyntheticCorpus::generate(int workers)
+{
+	failed.clear();
+	if (!Radar::FileSystem::dirExists(directory))
+		Radar::FileSystem::mkDirTree(directory);
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		std::remove(entries[i].path.c_str());
+		entries[i].bytes = 0;
+	}
+
+	size_t count = std::min((size_t)Radar::parallel::threadCount(workers), entries.size());
+	size_t done = 0;
+#if !defined(WIN32)
+	if (count > 1)
+	{
+		/* buffered output would be written again by every child */
+		fflush(NULL);
+		std::vector<pid_t> pids;
+		for (; done < count; ++done)
+		{
+			pid_t pid = fork();
+			if (pid < 0)
+				break;
+			if (pid == 0)
+			{
+				int status = 0;
+				for (size_t i = done; i < entries.size(); i += count)
+					if (!createEntry(entries[i]))
+						status = 1;
+				_exit(status);
+			}
+			pids.push_back(pid);
+		}
+		for (size_t w = 0; w < pids.size(); ++w)
+		{
+			/* a worker killed or failed may have left partial files */
+			int status;
+			if (waitpid(pids[w], &status, 0) == pids[w] && WIFEXITED(status) && WEXITSTATUS(status) == 0)
+				continue;
+			for (size_t i = w; i < entries.size(); i += count)
+				std::remove(entries[i].path.c_str());
+		}
+	}
+#endif
+	/* entries of the workers that could not be started, or of the only worker */
+	if (count < 1)
+		count = 1;
+	for (size_t w = done; w < count; ++w)
+		for (size_t i = w; i < entries.size(); i += count)
+			createEntry(entries[i]);
+
+	size_t written = 0;
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		if (Radar::FileSystem::fileExists(entries[i].path))
+		{
+			entries[i].bytes = Radar::FileSystem::getFileSize(entries[i].path);
+			++written;
+		}
+		else
+			failed.push_back(entries[i].path);
+	}
+	return written;
+}
+
+void SyntheticCorpus::writeManifest(std::ostream& out) const
+{
+	out << "{" << std::endl
+	    << "  \"seed\": " << seed << "," << std::endl
+	    << "  \"start\": " << jsonString(Radar::timeutils::absoluteToString(start)) << "," << std::endl
+	    << "  \"interval\": " << interval << "," << std::endl
+	    << "  \"centre\": [" << centreLat << ", " << centreLon << "]," << std::endl;
+
+	out << "  \"volumes\": [";
+	for (size_t i = 0; i < volumeSpecs.size(); ++i)
+	{
+		const SyntheticVolumeSpec& s = volumeSpecs[i];
+		out << (i ? "," : "") << std::endl
+		    << "    { \"scans\": " << s.scans << ", \"rays\": " << s.rays << ", \"bins\": " << s.bins
+		    << ", \"rscale\": " << s.rscale << ", \"quantities\": " << jsonList(s.quantities)
+		    << ", \"type\": " << jsonString(s.type) << ", \"compression\": " << s.compression
+		    << ", \"ray_arrays\": " << (s.rayArrays ? "true" : "false") << ", \"sites\": " << s.sites << " }";
+	}
+	out << std::endl << "  ]," << std::endl;
+
+	out << "  \"composites\": [";
+	for (size_t i = 0; i < compSpecs.size(); ++i)
+	{
+		const SyntheticCompSpec& s = compSpecs[i];
+		out << (i ? "," : "") << std::endl
+		    << "    { \"xsize\": " << s.xsize << ", \"ysize\": " << s.ysize
+		    << ", \"xscale\": " << s.xscale << ", \"yscale\": " << s.yscale
+		    << ", \"quantities\": " << jsonList(s.quantities)
+		    << ", \"type\": " << jsonString(s.type) << ", \"compression\": " << s.compression << " }";
+	}
+	out << std::endl << "  ]," << std::endl;
+
+	out << "  \"files\": [";
+	bool first = true;
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		const SyntheticEntry& e = entries[i];
+		if (!e.bytes)
+			continue;
+		out << (first ? "" : ",") << std::endl
+		    << "    { \"path\": " << jsonString(e.path) << ", \"object\": " << jsonString(e.object)
+		    << ", \"spec\": " << e.spec;
+		if (e.site >= 0)
+			out << ", \"source\": " << jsonString("NOD:" + siteNode(e.site));
+		out << ", \"time\": " << jsonString(Radar::timeutils::absoluteToString(e.time))
+		    << ", \"bytes\": " << e.bytes << " }";
+		first = false;
+	}
+	out << std::endl << "  ]" << std::endl << "}" << std::endl;
+}
+
+}
+}
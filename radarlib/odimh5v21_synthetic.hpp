@@ -0,0 +1,251 @@
+/*
+ * odimh5v21_synthetic - seeded synthetic ODIM files for load testing
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef __RADAR_ODIMH5V21_SYNTHETIC_HPP__
+#define __RADAR_ODIMH5V21_SYNTHETIC_HPP__
+/*!
+ * \file
+ * \brief Deterministic synthetic polar volumes and composites
+ */
+
+#include <radarlib/odimh5v21_cartesian.hpp>
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace OdimH5v21 {
+namespace products {
+
+/*===========================================================================*/
+/* SYNTHETIC FIELD */
+/*===========================================================================*/
+
+/*!
+ * \brief Weather-like reflectivity field moving over a plane
+ *
+ * The field is a weak stratiform background with convective cells moving with
+ * their own velocity, wrapping around a domain of 800 x 800 km. Everything is
+ * derived from the seed, so the same seed gives the same field on every
+ * platform.
+ */
+class RADAR_API SyntheticField {
+ public:
+	SyntheticField(uint64_t seed, int cells = 12);
+
+	/*!
+	 * \brief Reflectivity at a point
+	 * \param x, y		distance (km) east and north of the centre of the domain
+	 * \param height	height (m) above the ground
+	 * \param t		seconds from the start of the series
+	 * \returns		dBZ, or UNDETECT where there is no echo
+	 */
+	float reflectivity(double x, double y, double height, double t) const;
+
+	/*!
+	 * \brief Speed (m/s) of the wind used for radial velocities
+	 */
+	double getWindSpeed() const		{ return windSpeed; }
+	/*!
+	 * \brief Direction (degrees) the wind is blowing to
+	 */
+	double getWindDirection() const		{ return windDirection; }
+
+	/*!
+	 * \brief Deterministic noise in [-1, 1] for the given seed and counter
+	 */
+	static float noise(uint64_t seed, uint64_t counter);
+
+ private:
+	struct Cell {
+		double	x, y;		/* position at t = 0 (km) */
+		double	u, v;		/* velocity (m/s) */
+		double	radius;		/* km */
+		double	peak;		/* dBZ */
+	};
+	std::vector<Cell>	cells;
+	double			phase[3];
+	double			windSpeed, windDirection;
+};
+
+/*===========================================================================*/
+/* CORPUS */
+/*===========================================================================*/
+
+/*!
+ * \brief Layout of synthetic polar volumes
+ */
+struct RADAR_API SyntheticVolumeSpec {
+	int				scans;		/*!< default 10, elevations 0.5, 1.5, ... */
+	int				rays;		/*!< default 360 */
+	int				bins;		/*!< default 500 */
+	double				rscale;		/*!< bin length (m), default 250 */
+	std::vector<std::string>	quantities;	/*!< default DBZH and VRAD */
+	std::string			type;		/*!< "uint8" (default), "uint16" or "float" */
+	int				compression;	/*!< deflate level, 0 for none, default 6 */
+	bool				rayArrays;	/*!< write per-ray how/ arrays, default true */
+	int				sites;		/*!< radars the volumes are spread over, default 1 */
+
+	SyntheticVolumeSpec();
+};
+
+/*!
+ * \brief Layout of synthetic composites
+ */
+struct RADAR_API SyntheticCompSpec {
+	int				xsize;		/*!< default 800 */
+	int				ysize;		/*!< default 800 */
+	double				xscale;		/*!< pixel size (m), default 1000 */
+	double				yscale;		/*!< pixel size (m), default 1000 */
+	std::vector<std::string>	quantities;	/*!< default DBZH */
+	std::string			type;		/*!< "uint8" (default), "uint16" or "float" */
+	int				compression;	/*!< deflate level, 0 for none, default 6 */
+
+	SyntheticCompSpec();
+};
+
+/*!
+ * \brief A file of a synthetic corpus
+ */
+struct RADAR_API SyntheticEntry {
+	std::string	path;
+	std::string	object;		/*!< OBJECT_PVOL or OBJECT_COMP */
+	int		spec;		/*!< index of the volume or composite spec */
+	int		site;		/*!< radar of a volume, -1 for composites */
+	time_t		time;
+	size_t		bytes;		/*!< size after generate(), 0 if it failed */
+};
+
+/*!
+ * \brief Generator of a seeded corpus of PVOL and COMP files
+ *
+ * Files are added in batches sharing a layout, then generate() writes them
+ * with several worker processes. Volumes of a batch cycle over the radars of
+ * the spec, each time step covering every radar once; composites of a batch
+ * are consecutive time steps. All the files see the same SyntheticField, so
+ * consecutive files form a coherent sequence. \n
+ * Files are named <prefix><object>-<number>.h5 in the output directory.
+ */
+class RADAR_API SyntheticCorpus {
+ public:
+	/*!
+	 * \param directory	output directory, created if missing
+	 * \param seed		seed of the field and of the noise
+	 */
+	SyntheticCorpus(const std::string& directory, uint64_t seed = 1);
+
+	uint64_t getSeed() const			{ return seed; }
+	void setPrefix(const std::string& val)		{ prefix = val; }
+	/*!
+	 * \brief Time of the first step, default 2000-01-01 00:00:00
+	 */
+	void setStartTime(time_t val)			{ start = val; }
+	/*!
+	 * \brief Seconds between time steps, default 300
+	 */
+	void setInterval(int val)			{ interval = val; }
+	/*!
+	 * \brief Centre of the domain, default 44.5 N 11.5 E
+	 */
+	void setCentre(double lat, double lon)		{ centreLat = lat; centreLon = lon; }
+
+	/*!
+	 * \brief Add a batch of volumes
+	 * \throws std::invalid_argument	if the spec is not valid
+	 */
+	void addVolumes(int count, const SyntheticVolumeSpec& spec);
+	/*!
+	 * \brief Add a batch of composites
+	 * \throws std::invalid_argument	if the spec is not valid
+	 */
+	void addComps(int count, const SyntheticCompSpec& spec);
+
+	const std::vector<SyntheticEntry>& getEntries() const	{ return entries; }
+	const SyntheticVolumeSpec& getVolumeSpec(int i) const	{ return volumeSpecs[i]; }
+	const SyntheticCompSpec& getCompSpec(int i) const	{ return compSpecs[i]; }
+	/*!
+	 * \brief Files that generate() could not write
+	 */
+	const std::vector<std::string>& getFailedFiles() const	{ return failed; }
+
+	/*!
+	 * \brief Write all the files
+	 *
+	 * Entries are assigned round robin to the workers, each a separate process
+	 * with its own HDF5 library state. Where processes are not available, or
+	 * with one worker, the files are written by the calling process. The files
+	 * of a worker that is killed or exits with an error are removed and
+	 * reported by getFailedFiles().
+	 * \param workers	number of processes, 0 for one per core
+	 * \returns		number of files written
+	 */
+	size_t generate(int workers = 0);
+
+	/*!
+	 * \brief Write a single volume of the given spec, radar and time
+	 */
+	void createVolume(const std::string& path, const SyntheticVolumeSpec& spec, int site, time_t time) const;
+	/*!
+	 * \brief Write a single composite of the given spec and time
+	 */
+	void createComp(const std::string& path, const SyntheticCompSpec& spec, time_t time) const;
+
+	/*!
+	 * \brief Node of the given radar, e.g. "syn03"
+	 */
+	static std::string siteNode(int site);
+	/*!
+	 * \brief Position of the given radar of a spec
+	 */
+	void getSite(const SyntheticVolumeSpec& spec, int site, double& lat, double& lon) const;
+	/*!
+	 * \brief Encoding used for a quantity and a type name
+	 */
+	static Encoding encodingFor(const std::string& quantity, const std::string& type);
+
+	/*!
+	 * \brief Write a JSON manifest of the seed, the layouts and the generated files
+	 *
+	 * Files that generate() could not write are not listed.
+	 */
+	void writeManifest(std::ostream& out) const;
+
+ private:
+	std::string				directory;
+	std::string				prefix;
+	uint64_t				seed;
+	time_t					start;
+	int					interval;
+	double					centreLat, centreLon;
+	SyntheticField				field;
+	std::vector<SyntheticVolumeSpec>	volumeSpecs;
+	std::vector<SyntheticCompSpec>		compSpecs;
+	std::vector<SyntheticEntry>		entries;
+	std::vector<std::string>		failed;
+
+	void siteOffset(const SyntheticVolumeSpec& spec, int site, double& x, double& y) const;
+	std::string entryPath(const char* object) const;
+	bool createEntry(const SyntheticEntry& entry) const;
+};
+
+}
+}
+
+#endif
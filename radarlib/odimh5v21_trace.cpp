@@ -0,0 +1,193 @@
+/*
+ * odimh5v21_trace - tracing hooks of ODIM operations
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <radarlib/odimh5v21_trace.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+#if !defined(WIN32)
+#include <unistd.h>
+#endif
+
+namespace OdimH5v21 {
+
+/*===========================================================================*/
+/* TRACING */
+/*===========================================================================*/
+
+std::atomic<TraceHook*> Tracing::current(NULL);
+
+uint64_t Tracing::now()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+unsigned Tracing::threadNumber()
+{
+	static std::atomic<unsigned> threads(0);
+	static thread_local unsigned number = ++threads;
+	return number;
+}
+
+TraceHook::~TraceHook()
+{
+}
+
+void TraceHook::begin(const TraceEvent& /*event*/)
+{
+}
+
+/*===========================================================================*/
+
+TraceScope::TraceScope(const char* category, const char* name, int index)
+ : hook(Tracing::getHook())
+{
+	if (hook)
+		start(category, name, index);
+}
+
+TraceScope::TraceScope(const char* category, const char* name, const std::string& detail, int index)
+ : hook(Tracing::getHook())
+{
+	if (hook)
+	{
+		event.detail = detail;
+		start(category, name, index);
+	}
+}
+
+TraceScope::TraceScope(const char* category, const char* name, const char* detail, int index)
+ : hook(Tracing::getHook())
+{
+	if (hook)
+	{
+		event.detail = detail;
+		start(category, name, index);
+	}
+}
+
+void TraceScope::start(const char* category, const char* name, int index)
+{
+	event.category	= category;
+	event.name	= name;
+	event.index	= index;
+	event.duration	= 0;
+	event.thread	= Tracing::threadNumber();
+	event.start	= Tracing::now();
+	hook->begin(event);
+}
+
+TraceScope::~TraceScope()
+{
+	if (hook == NULL)
+		return;
+	event.duration = Tracing::now() - event.start;
+	try
+	{
+		hook->end(event);
+	}
+	catch (...)
+	{
+		/* a destructor may run while unwinding an exception */
+	}
+}
+
+/*===========================================================================*/
+/* CHROME TRACE WRITER */
+/*===========================================================================*/
+
+static void writeJSONString(std::ostream& out, const std::string& value)
+{
+	out << '"';
+	for (size_t i=0; i<value.size(); i++)
+	{
+		unsigned char c = (unsigned char)value[i];
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (c < 0x20)
+		{
+			char buff[8];
+			snprintf(buff, sizeof(buff), "\\u%04x", c);
+			out << buff;
+		}
+		else
+			out << c;
+	}
+	out << '"';
+}
+
+ChromeTraceWriter::ChromeTraceWriter(const std::string& path)
+ : out(path.c_str())
+ , origin(Tracing::now())
+ , count(0)
+#if defined(WIN32)
+ , pid(1)
+#else
+ , pid((int)getpid())
+#endif
+{
+	if (!out)
+		throw std::runtime_error("Cannot create trace file " + path);
+	out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+}
+
+ChromeTraceWriter::~ChromeTraceWriter()
+{
+	close();
+}
+
+void ChromeTraceWriter::end(const TraceEvent& event)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!out.is_open())
+		return;
+	out << (count ? ",\n" : "\n")
+	    << "{\"ph\": \"X\", \"cat\": \"" << event.category << "\", \"name\": \"" << event.name << "\""
+	    << ", \"pid\": " << pid << ", \"tid\": " << event.thread
+	    << ", \"ts\": " << (event.start >= origin ? event.start - origin : 0)
+	    << ", \"dur\": " << event.duration;
+	if (!event.detail.empty() || event.index >= 0)
+	{
+		out << ", \"args\": {";
+		if (!event.detail.empty())
+		{
+			out << "\"detail\": ";
+			writeJSONString(out, event.detail);
+		}
+		if (event.index >= 0)
+			out << (event.detail.empty() ? "" : ", ") << "\"index\": " << event.index;
+		out << "}";
+	}
+	out << "}";
+	count++;
+}
+
+void ChromeTraceWriter::close()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!out.is_open())
+		return;
+	out << "\n]}\n";
+	out.close();
+}
+
+}
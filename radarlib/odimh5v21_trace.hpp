@@ -0,0 +1,180 @@
+/*
+ * odimh5v21_trace - tracing hooks of ODIM operations
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef __RADAR_ODIMH5V21_TRACE_HPP__
+#define __RADAR_ODIMH5V21_TRACE_HPP__
+/*!
+ * \file
+ * \brief Tracing hooks around ODIM operations and a Chrome trace-event writer
+ */
+
+#include <radarlib/defs.h>
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <stdint.h>
+
+namespace OdimH5v21 {
+
+/*===========================================================================*/
+/* TRACE EVENTS */
+/*===========================================================================*/
+
+/*!
+ * \brief A traced operation
+ */
+struct RADAR_API TraceEvent {
+	const char*	category;	/*!< "file", "object" or "data" */
+	const char*	name;		/*!< operation, e.g. "openPolarVolume" or "readData" */
+	std::string	detail;		/*!< file path, quantity, HDF5 path of the group or both, may be empty */
+	int		index;		/*!< scan, product or quantity index, -1 if none */
+	uint64_t	start;		/*!< microseconds of a monotonic clock */
+	uint64_t	duration;	/*!< microseconds, set only for TraceHook::end() */
+	unsigned	thread;		/*!< small number identifying the calling thread */
+};
+
+/*!
+ * \brief Callbacks invoked around traced operations
+ *
+ * Callbacks run in the thread doing the operation, nested operations give
+ * nested begin/end pairs. A hook must not use radarlib objects itself.
+ */
+class RADAR_API TraceHook {
+ public:
+	virtual ~TraceHook();
+
+	/*!
+	 * \brief Called when an operation starts
+	 */
+	virtual void begin(const TraceEvent& event);
+	/*!
+	 * \brief Called when an operation ends, also when it ends with an exception
+	 */
+	virtual void end(const TraceEvent& event) = 0;
+};
+
+/*!
+ * \brief Installed trace hook
+ *
+ * Without a hook every traced operation costs a relaxed atomic load. The
+ * library does not take ownership of the hook: it must stay alive until it
+ * is removed and the operations in progress have ended.
+ */
+class RADAR_API Tracing {
+ public:
+	/*!
+	 * \brief Install a hook, NULL to stop tracing
+	 *
+	 * Operations already started keep calling the previous hook until they
+	 * end: the caller must not destroy it before then.
+	 */
+	static void setHook(TraceHook* hook)	{ current.store(hook, std::memory_order_release); }
+	static TraceHook* getHook()		{ return current.load(std::memory_order_acquire); }
+	static bool isActive()			{ return current.load(std::memory_order_relaxed) != NULL; }
+
+	/*!
+	 * \brief Microseconds of the clock used for TraceEvent::start
+	 */
+	static uint64_t now();
+	/*!
+	 * \brief Number of the calling thread used for TraceEvent::thread
+	 */
+	static unsigned threadNumber();
+
+ private:
+	static std::atomic<TraceHook*> current;
+};
+
+/*!
+ * \brief Scope tracing an operation
+ *
+ * The event is built only when a hook is installed at construction. Details
+ * that are expensive to compute can be set with setDetail() and setIndex()
+ * after checking isActive(); they are then seen only by TraceHook::end().
+ */
+class RADAR_API TraceScope {
+ public:
+	/*!
+	 * \brief Start the operation with the hook installed now, which is also
+	 * the one called when the scope ends, even if setHook() replaced it
+	 */
+	TraceScope(const char* category, const char* name, int index = -1);
+	TraceScope(const char* category, const char* name, const std::string& detail, int index = -1);
+	TraceScope(const char* category, const char* name, const char* detail, int index = -1);
+	~TraceScope();
+
+	bool isActive() const			{ return hook != NULL; }
+	void setDetail(const std::string& val)	{ if (hook) event.detail = val; }
+	void setDetail(const char* val)		{ if (hook) event.detail = val; }
+	void setIndex(int val)			{ if (hook) event.index = val; }
+
+ private:
+	TraceHook*	hook;
+	TraceEvent	event;
+
+	void start(const char* category, const char* name, int index);
+
+	TraceScope(const TraceScope&);
+	TraceScope& operator=(const TraceScope&);
+};
+
+/*===========================================================================*/
+/* CHROME TRACE WRITER */
+/*===========================================================================*/
+
+/*!
+ * \brief Hook writing events in the Chrome trace-event JSON format
+ *
+ * Each operation is written as a complete ("X") event when it ends, with the
+ * detail and index as arguments, so the file can be loaded in
+ * chrome://tracing or in the Perfetto UI. Times are relative to the creation
+ * of the writer. The file is completed by close() or by the destructor.
+ */
+class RADAR_API ChromeTraceWriter : public TraceHook {
+ public:
+	/*!
+	 * \throws std::runtime_error	if the file cannot be created
+	 */
+	ChromeTraceWriter(const std::string& path);
+	virtual ~ChromeTraceWriter();
+
+	virtual void end(const TraceEvent& event);
+
+	/*!
+	 * \brief Terminate the JSON document and close the file; later events are ignored
+	 */
+	void close();
+	/*!
+	 * \brief Number of events written
+	 */
+	size_t getEventCount() const		{ return count; }
+
+ private:
+	std::mutex	mutex;
+	std::ofstream	out;
+	uint64_t	origin;
+	size_t		count;
+	int		pid;
+};
+
+}
+
+#endif
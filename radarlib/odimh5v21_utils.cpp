@@ -31,6 +31,8 @@ void OdimObjectVisitor::visitObject(OdimObject& obj) {
 		castAndVisitObject<ImageObject>(obj);
 	else if (type == OBJECT_COMP)
 		castAndVisitObject<CompObject>(obj);
+	else if (type == OBJECT_CVOL)
+		castAndVisitObject<CvolObject>(obj);
 	else if (type == OBJECT_XSEC)
 		castAndVisitObject<XsecObject>(obj);
 	else
@@ -76,6 +76,8 @@ class OdimObjectVisitor {
 	virtual void visit(OdimH5v21::ImageObject& obj) {}
 	/// Called when the visited OdimObject is a CompObject (noop)
 	virtual void visit(OdimH5v21::CompObject& obj) {}
+	/// Called when the visited OdimObject is a CvolObject (noop)
+	virtual void visit(OdimH5v21::CvolObject& obj) {}
 	/// Called when the visited OdimObject is a XsecObject (noop)
 	virtual void visit(OdimH5v21::XsecObject& obj) {}
 
@@ -0,0 +1,635 @@
+/*
+ * odimh5v21_watcher - notification of ODIM files arriving in directories
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <radarlib/odimh5v21_watcher.hpp>
+#include <radarlib/odimh5v21_batch.hpp>
+#include <radarlib/odimh5v21_exceptions.hpp>
+#include <radarlib/io.hpp>
+#include <radarlib/parallel.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__linux__) || defined(linux)
+	#define RADAR_HAVE_INOTIFY
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <poll.h>
+	#include <unistd.h>
+	#include <sys/file.h>
+	#include <sys/inotify.h>
+	#include <sys/stat.h>
+#endif
+
+namespace OdimH5v21 {
+
+/*===========================================================================*/
+/* HANDLER */
+/*===========================================================================*/
+
+WatchHandler::~WatchHandler()
+{
+}
+
+void WatchHandler::fileRejected(const std::string& /*path*/, const std::string& /*reason*/)
+{
+}
+
+void WatchHandler::fileFailed(const WatchEvent& event, const std::string& message)
+{
+	std::cerr << "Processing " << event.path << " failed: " << message << std::endl;
+}
+
+void WatchHandler::watcherFailed(const std::string& message)
+{
+	std::cerr << "Directory watcher stopped: " << message << std::endl;
+}
+
+/*===========================================================================*/
+/* SUPERBLOCK */
+/*===========================================================================*/
+
+namespace {
+
+const unsigned char HDF5_SIGNATURE[8] = { 0x89, 'H', 'D', 'F', '\r', '\n', 0x1a, '\n' };
+
+/* indirizzi little endian di 2, 4 o 8 byte */
+uint64_t readAddress(const unsigned char* p, int size)
+{
+	uint64_t result = 0;
+	for (int i=size-1; i>=0; i--)
+		result = (result << 8) | p[i];
+	return result;
+}
+
+}
+
+bool OdimWatcher::checkHDF5(const std::string& path, std::string& reason)
+{
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if (!in)
+	{
+		reason = "cannot open the file";
+		return false;
+	}
+	in.seekg(0, std::ios::end);
+	uint64_t size = (uint64_t)in.tellg();
+
+	/* il superblocco segue un eventuale user block, a 0, 512, 1024, 2048... */
+	unsigned char sb[64];
+	uint64_t base = 0;
+	for (;; base = base ? base * 2 : 512)
+	{
+		if (base + sizeof(HDF5_SIGNATURE) > size)
+		{
+			reason = "HDF5 signature not found";
+			return false;
+		}
+		in.seekg((std::streamoff)base);
+		in.read((char*)sb, sizeof(HDF5_SIGNATURE));
+		if (in && memcmp(sb, HDF5_SIGNATURE, sizeof(HDF5_SIGNATURE)) == 0)
+			break;
+		in.clear();
+	}
+	in.seekg((std::streamoff)base);
+	memset(sb, 0, sizeof(sb));
+	in.read((char*)sb, sizeof(sb));
+	in.clear();
+	uint64_t available = size - base;
+
+	int		version		= sb[8];
+	int		offsetSize	= 0;
+	uint32_t	flags		= 0;
+	size_t		addresses	= 0;	/* base address, seguito dall'end of file address dopo un altro indirizzo */
+	switch (version)
+	{
+		case 0:
+		case 1:
+			offsetSize	= sb[13];
+			flags		= (uint32_t)readAddress(sb + 20, 4);
+			addresses	= version == 0 ? 24 : 28;
+			break;
+		case 2:
+		case 3:
+			offsetSize	= sb[9];
+			flags		= sb[11];
+			addresses	= 12;
+			break;
+		default:
+		{
+			std::ostringstream ss;
+			ss << "unknown superblock version " << version;
+			reason = ss.str();
+			return false;
+		}
+	}
+	if (offsetSize != 2 && offsetSize != 4 && offsetSize != 8)
+	{
+		reason = "invalid superblock";
+		return false;
+	}
+	if (addresses + 3 * offsetSize > available)
+	{
+		reason = "truncated superblock";
+		return false;
+	}
+	/* bit 0: aperto in scrittura, bit 2: aperto in scrittura SWMR */
+	if (flags & 0x5)
+	{
+		reason = "file still open for writing";
+		return false;
+	}
+
+	uint64_t baseAddress	= readAddress(sb + addresses, offsetSize);
+	uint64_t eof		= readAddress(sb + addresses + 2 * offsetSize, offsetSize);
+	uint64_t undefined	= offsetSize == 8 ? ~(uint64_t)0 : ((uint64_t)1 << (8 * offsetSize)) - 1;
+	if (eof == undefined)
+	{
+		reason = "end of file address not set";
+		return false;
+	}
+	if (baseAddress + eof > size)
+	{
+		std::ostringstream ss;
+		ss << "truncated file, " << size << " of " << baseAddress + eof << " bytes";
+		reason = ss.str();
+		return false;
+	}
+	return true;
+}
+
+/*===========================================================================*/
+/* WATCHER */
+/*===========================================================================*/
+
+OdimWatcher::OdimWatcher(WatchHandler* handler, int workers, size_t queueSize)
+:handler(handler)
+,workers(Radar::parallel::threadCount(workers))
+,queueSize(queueSize ? queueSize : 1)
+,extension(".h5")
+,settleTime(1000)
+,inotifyFd(-1)
+,watches()
+,queue()
+,mutex()
+,running(false)
+,draining(false)
+,stopping(false)
+,ready(0)
+,rejected(0)
+,failed(0)
+,unsettled(0)
+,overflows(0)
+,fullWaits(0)
+{
+	wakeup[0] = wakeup[1] = -1;
+#if defined(RADAR_HAVE_INOTIFY)
+	inotifyFd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+	if (inotifyFd < 0)
+		throw std::runtime_error(std::string("Cannot initialize inotify: ") + strerror(errno));
+	if (pipe(wakeup) != 0)
+	{
+		close(inotifyFd);
+		throw std::runtime_error(std::string("Cannot create pipe: ") + strerror(errno));
+	}
+	for (int i=0; i<2; i++)
+		fcntl(wakeup[i], F_SETFD, FD_CLOEXEC);
+#else
+	throw OdimH5UnsupportedException("Directory watching needs inotify, not available on this system");
+#endif
+}
+
+OdimWatcher::~OdimWatcher()
+{
+	stop();
+#if defined(RADAR_HAVE_INOTIFY)
+	close(inotifyFd);
+	close(wakeup[0]);
+	close(wakeup[1]);
+#endif
+}
+
+void OdimWatcher::setExtension(const std::string& val)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	extension = val;
+}
+
+std::string OdimWatcher::getExtension() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return extension;
+}
+
+void OdimWatcher::setSettleTime(std::chrono::milliseconds val)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	settleTime = val;
+}
+
+std::chrono::milliseconds OdimWatcher::getSettleTime() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return settleTime;
+}
+
+size_t OdimWatcher::getQueued() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return queue.size();
+}
+
+void OdimWatcher::addDirectory(const std::string& path, bool recursive)
+{
+	watch(path, recursive);
+}
+
+#if defined(RADAR_HAVE_INOTIFY)
+
+namespace {
+
+/* dimensione e data di modifica in nanosecondi, false se il file non esiste piu' */
+bool fileState(const std::string& path, uint64_t& size, int64_t& mtime)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		return false;
+	size	= (uint64_t)st.st_size;
+	mtime	= (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+	return true;
+}
+
+/* HDF5 1.10 e successive tengono un lock esclusivo sui file aperti in scrittura */
+bool lockedForWriting(const std::string& path)
+{
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	bool locked = flock(fd, LOCK_SH | LOCK_NB) != 0 && errno == EWOULDBLOCK;
+	close(fd);	/* rilascia anche il lock */
+	return locked;
+}
+
+}
+
+void OdimWatcher::watch(const std::string& path, bool recursive)
+{
+	uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR;
+	if (recursive)
+		mask |= IN_CREATE;
+	int wd = inotify_add_watch(inotifyFd, path.c_str(), mask);
+	if (wd < 0)
+		throw std::runtime_error("Cannot watch " + path + ": " + strerror(errno));
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Watch& w	= watches[wd];
+		w.path		= path;
+		w.recursive	= recursive;
+	}
+	if (recursive)
+	{
+		std::vector<std::string> dirs;
+		Radar::FileSystem::listDirs(dirs, path);
+		for (size_t i=0; i<dirs.size(); i++)
+			watch(path + "/" + dirs[i], true);
+	}
+}
+
+void OdimWatcher::scan(const std::string& path, bool recursive, std::vector<std::string>& found)
+{
+	std::vector<std::string> files = BatchRunner::listFiles(path, getExtension(), recursive);
+	found.insert(found.end(), files.begin(), files.end());
+}
+
+/*
+ * I file trovati rileggendo le directory non hanno avuto un evento di chiusura:
+ * si riportano solo quelli rimasti uguali per settleTime e non bloccati da chi
+ * li scrive. Gli altri hanno gia' un watch e arriveranno con la loro chiusura.
+ */
+void OdimWatcher::reportSettled(const std::vector<std::string>& files)
+{
+	if (files.empty())
+		return;
+	std::vector<uint64_t>	sizes(files.size());
+	std::vector<int64_t>	mtimes(files.size());
+	std::vector<bool>	present(files.size());
+	for (size_t i=0; i<files.size(); i++)
+	{
+		uint64_t size = 0;
+		int64_t mtime = 0;
+		present[i]	= fileState(files[i], size, mtime);
+		sizes[i]	= size;
+		mtimes[i]	= mtime;
+	}
+
+	/* l'attesa e' interrotta da stop() attraverso la pipe, che resta da leggere */
+	std::chrono::steady_clock::time_point until = std::chrono::steady_clock::now() + getSettleTime();
+	while (!stopping)
+	{
+		long left = (long)std::chrono::duration_cast<std::chrono::milliseconds>(until - std::chrono::steady_clock::now()).count();
+		if (left <= 0)
+			break;
+		struct pollfd fd;
+		fd.fd = wakeup[0];	fd.events = POLLIN;	fd.revents = 0;
+		int result = poll(&fd, 1, (int)left);
+		if (result > 0)
+			return;
+		if (result < 0 && errno != EINTR)
+			throw std::runtime_error(std::string("poll failed: ") + strerror(errno));
+	}
+
+	for (size_t i=0; i<files.size() && !stopping; i++)
+	{
+		uint64_t size = 0;
+		int64_t mtime = 0;
+		if (!present[i] || !fileState(files[i], size, mtime))
+			continue;	/* rimosso nel frattempo */
+		if (size != sizes[i] || mtime != mtimes[i] || lockedForWriting(files[i]))
+		{
+			++unsettled;
+			continue;
+		}
+		fileCompleted(files[i]);
+	}
+}
+
+/* le directory osservate e le sottodirectory nuove di quelle ricorsive, dopo l'avvio o eventi persi */
+void OdimWatcher::scanWatched()
+{
+	std::vector<Watch> dirs;
+	std::set<std::string> watched;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (std::map<int, Watch>::const_iterator i = watches.begin(); i != watches.end(); ++i)
+		{
+			dirs.push_back(i->second);
+			watched.insert(i->second.path);
+		}
+	}
+	std::vector<std::string> found;
+	for (size_t i=0; i<dirs.size() && !stopping; i++)
+	{
+		/* le sottodirectory gia' osservate hanno un watch proprio */
+		scan(dirs[i].path, false, found);
+		if (!dirs[i].recursive)
+			continue;
+		std::vector<std::string> subdirs;
+		try {
+			Radar::FileSystem::listDirs(subdirs, dirs[i].path);
+		} catch (std::exception&) {
+			continue;	/* rimossa nel frattempo */
+		}
+		for (size_t j=0; j<subdirs.size() && !stopping; j++)
+		{
+			std::string path = dirs[i].path + "/" + subdirs[j];
+			if (watched.count(path))
+				continue;
+			try {
+				watch(path, true);
+			} catch (std::exception&) {
+				continue;
+			}
+			scan(path, true, found);
+		}
+	}
+	reportSettled(found);
+}
+
+void OdimWatcher::fileCompleted(const std::string& path)
+{
+	std::string ext = getExtension();
+	if (!ext.empty() && (path.size() < ext.size() || path.compare(path.size() - ext.size(), ext.size(), ext) != 0))
+		return;
+
+	std::string reason;
+	if (!checkHDF5(path, reason))
+	{
+		++rejected;
+		handler->fileRejected(path, reason);
+		return;
+	}
+
+	WatchEvent event;
+	event.path	= path;
+	event.size	= 0;
+	event.detected	= std::chrono::steady_clock::now();
+	try {
+		event.size = Radar::FileSystem::getFileSize(path);
+	} catch (std::exception&) {
+		/* rimosso nel frattempo: il handler riportera' l'errore */
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	if (queue.size() >= queueSize && !stopping)
+	{
+		/* gli eventi restano nella coda del kernel */
+		++fullWaits;
+		notFull.wait(lock, [this] { return queue.size() < queueSize || stopping; });
+	}
+	if (stopping)
+		return;
+	queue.push_back(event);
+	notEmpty.notify_one();
+}
+
+void OdimWatcher::watcherMain(bool scanExisting)
+{
+	try
+	{
+		if (scanExisting)
+			scanWatched();
+
+		alignas(struct inotify_event) char buffer[64 * 1024];
+		while (!stopping)
+		{
+			struct pollfd fds[2];
+			fds[0].fd = inotifyFd;	fds[0].events = POLLIN;	fds[0].revents = 0;
+			fds[1].fd = wakeup[0];	fds[1].events = POLLIN;	fds[1].revents = 0;
+			if (poll(fds, 2, -1) < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				throw std::runtime_error(std::string("poll failed: ") + strerror(errno));
+			}
+			if (fds[1].revents)
+				break;
+
+			ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+			if (length < 0)
+			{
+				if (errno == EINTR || errno == EAGAIN)
+					continue;
+				throw std::runtime_error(std::string("Cannot read inotify events: ") + strerror(errno));
+			}
+
+			bool lost = false;
+			for (char* p = buffer; p < buffer + length && !stopping; )
+			{
+				const struct inotify_event* event = (const struct inotify_event*)p;
+				p += sizeof(struct inotify_event) + event->len;
+
+				if (event->mask & IN_Q_OVERFLOW)
+				{
+					++overflows;
+					lost = true;
+					continue;
+				}
+				Watch w;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					std::map<int, Watch>::iterator i = watches.find(event->wd);
+					if (i == watches.end())
+						continue;
+					if (event->mask & IN_IGNORED)
+					{
+						/* directory rimossa */
+						watches.erase(i);
+						continue;
+					}
+					w = i->second;
+				}
+				if (!event->len)
+					continue;
+				std::string path = w.path + "/" + event->name;
+
+				if (event->mask & IN_ISDIR)
+				{
+					if (w.recursive && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+					{
+						try {
+							watch(path, true);
+						} catch (std::exception&) {
+							continue;	/* rimossa prima di poterla osservare */
+						}
+						std::vector<std::string> found;
+						scan(path, true, found);
+						reportSettled(found);
+					}
+				}
+				else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+					fileCompleted(path);
+			}
+			/* i file arrivati mentre la coda del kernel era piena si trovano solo rileggendo le directory */
+			if (lost)
+				scanWatched();
+		}
+	}
+	catch (std::exception& e)
+	{
+		/* i worker finiscono la coda, stop() raccoglie i thread */
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = draining = true;
+		}
+		notEmpty.notify_all();
+		running = false;
+		handler->watcherFailed(e.what());
+	}
+}
+
+void OdimWatcher::workerMain()
+{
+	while (true)
+	{
+		WatchEvent event;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			notEmpty.wait(lock, [this] { return !queue.empty() || draining; });
+			if (queue.empty())
+				return;
+			event = queue.front();
+			queue.pop_front();
+			notFull.notify_one();
+		}
+		++ready;
+		try {
+			handler->fileReady(event);
+		} catch (std::exception& e) {
+			++failed;
+			handler->fileFailed(event, e.what());
+		} catch (...) {
+			++failed;
+			handler->fileFailed(event, "unknown error");
+		}
+	}
+}
+
+void OdimWatcher::start(bool scanExisting)
+{
+	if (running)
+		return;
+	/* i thread di un watcher fermato da un errore */
+	stop();
+	stopping = draining = false;
+	running = true;
+	for (int i=0; i<workers; i++)
+		pool.push_back(std::thread(&OdimWatcher::workerMain, this));
+	watcher = std::thread(&OdimWatcher::watcherMain, this, scanExisting);
+}
+
+void OdimWatcher::stop()
+{
+	if (!watcher.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	notFull.notify_all();
+	char c = 0;
+	while (write(wakeup[1], &c, 1) < 0 && errno == EINTR)
+		;
+	watcher.join();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		draining = true;
+	}
+	notEmpty.notify_all();
+	for (size_t i=0; i<pool.size(); i++)
+		pool[i].join();
+	pool.clear();
+
+	while (read(wakeup[0], &c, 1) < 0 && errno == EINTR)
+		;
+	running = false;
+}
+
+#else
+
+void OdimWatcher::watch(const std::string& path, bool recursive)	{ }
+void OdimWatcher::scan(const std::string& path, bool recursive, std::vector<std::string>& found)	{ }
+void OdimWatcher::scanWatched()						{ }
+void OdimWatcher::reportSettled(const std::vector<std::string>& files)	{ }
+void OdimWatcher::fileCompleted(const std::string& path)		{ }
+void OdimWatcher::watcherMain(bool scanExisting)			{ }
+void OdimWatcher::workerMain()						{ }
+void OdimWatcher::start(bool scanExisting)				{ }
+void OdimWatcher::stop()						{ }
+
+#endif
+
+/*===========================================================================*/
+
+}
@@ -0,0 +1,227 @@
+/*
+ * odimh5v21_watcher - notification of ODIM files arriving in directories
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef __RADAR_ODIMH5V21_WATCHER_HPP__
+#define __RADAR_ODIMH5V21_WATCHER_HPP__
+/*!
+ * \file
+ * \brief Notification of complete ODIM files arriving in directories
+ */
+
+#include <radarlib/defs.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+namespace OdimH5v21 {
+
+/*!
+ * \brief A complete file arrived in a watched directory
+ */
+struct WatchEvent {
+	std::string				path;
+	uint64_t				size;
+	std::chrono::steady_clock::time_point	detected;	/*!< when the watcher saw the file complete */
+};
+
+/*!
+ * \brief Receives the files found by an OdimWatcher
+ */
+class RADAR_API WatchHandler {
+ public:
+	virtual ~WatchHandler();
+
+	/*!
+	 * \brief Process a file, called by the worker threads of the watcher
+	 */
+	virtual void fileReady(const WatchEvent& event) = 0;
+	/*!
+	 * \brief A file that is not a complete HDF5 file, called by the watcher thread. Does nothing by default.
+	 */
+	virtual void fileRejected(const std::string& path, const std::string& reason);
+	/*!
+	 * \brief fileReady() threw an exception. Prints the message on std::cerr by default.
+	 */
+	virtual void fileFailed(const WatchEvent& event, const std::string& message);
+	/*!
+	 * \brief The watcher thread stopped on an error, called by that thread
+	 *
+	 * The workers process the files already queued and the watcher is no
+	 * longer running. Prints the message on std::cerr by default.
+	 */
+	virtual void watcherFailed(const std::string& message);
+};
+
+/*!
+ * \brief Watch directories with inotify and process the ODIM files arriving
+ *
+ * A file is complete when its writer closes it (IN_CLOSE_WRITE) or when it is
+ * renamed into the directory (IN_MOVED_TO), as producers writing aside do.
+ * Its HDF5 superblock is then checked with checkHDF5(), so that truncated or
+ * still open files are rejected instead of processed. \n
+ * Files found by scanning a directory, at start, after an overflow or in a new
+ * subdirectory, have no such event: a scan reports only the files whose size
+ * and modification time do not change during the settle time and that no
+ * process holds locked for writing, as HDF5 1.10 and later do with file
+ * locking enabled. The others are left to the event of their close. A writer
+ * that neither locks the file (older HDF5, HDF5_USE_FILE_LOCKING=FALSE, some
+ * network filesystems) nor writes to it for longer than the settle time is not
+ * detected, and checkHDF5() may then accept a file that is still open. \n
+ * Complete files go to a bounded queue consumed by a pool of worker threads,
+ * that call the handler. When the queue is full the watcher waits, leaving
+ * the events in the kernel queue; when that queue overflows, events are lost:
+ * overflows are counted by getOverflows() and the watched directories are
+ * scanned again, so files already processed may be reported twice. \n
+ * New subdirectories of a recursive watch are watched as soon as they appear,
+ * and the files they already contain are processed: a file written while the
+ * subdirectory is being added may be reported twice. \n
+ * Available on Linux only.
+ */
+class RADAR_API OdimWatcher {
+ public:
+	/*!
+	 * \param handler	receives the files, must outlive the watcher
+	 * \param workers	number of worker threads, 0 for one per core
+	 * \param queueSize	maximum number of files waiting for a worker
+	 * \throws OdimH5UnsupportedException	if inotify is not available
+	 */
+	OdimWatcher(WatchHandler* handler, int workers = 0, size_t queueSize = 256);
+	/*!
+	 * \brief Stops the watcher
+	 */
+	~OdimWatcher();
+
+	/*!
+	 * \brief Watch a directory, also while the watcher is running
+	 * \param recursive	also watch its subdirectories, present and future
+	 * \throws std::runtime_error	if the directory cannot be watched
+	 */
+	void addDirectory(const std::string& path, bool recursive = false);
+	/*!
+	 * \brief Extension of the files to process, empty for all, default ".h5"
+	 */
+	void setExtension(const std::string& val);
+	std::string getExtension() const;
+	/*!
+	 * \brief How long the files found by a scan must stay unchanged, default 1 second
+	 */
+	void setSettleTime(std::chrono::milliseconds val);
+	std::chrono::milliseconds getSettleTime() const;
+
+	/*!
+	 * \brief Start the watcher and worker threads
+	 * \param scanExisting	also process the files already in the directories
+	 */
+	void start(bool scanExisting = false);
+	/*!
+	 * \brief Stop watching; the files already queued are processed before returning
+	 *
+	 * Also joins the threads of a watcher stopped by an error.
+	 */
+	void stop();
+	bool isRunning() const				{ return running; }
+
+	/*!
+	 * \brief Files given to the handler
+	 */
+	uint64_t getReady() const			{ return ready.load(); }
+	/*!
+	 * \brief Files rejected by checkHDF5()
+	 */
+	uint64_t getRejected() const			{ return rejected.load(); }
+	/*!
+	 * \brief Files for which the handler threw
+	 */
+	uint64_t getFailed() const			{ return failed.load(); }
+	/*!
+	 * \brief Files found by a scan while still being written, left to their close event
+	 */
+	uint64_t getUnsettled() const			{ return unsettled.load(); }
+	/*!
+	 * \brief Kernel queue overflows, each losing an unknown number of events
+	 */
+	uint64_t getOverflows() const			{ return overflows.load(); }
+	/*!
+	 * \brief Times the watcher waited for room in the queue
+	 */
+	uint64_t getFullWaits() const			{ return fullWaits.load(); }
+	/*!
+	 * \brief Files waiting for a worker
+	 */
+	size_t getQueued() const;
+
+	/*!
+	 * \brief Check that a file is a complete HDF5 file
+	 *
+	 * Looks for the superblock at the offsets allowed by HDF5 (0, 512, 1024,
+	 * ...), rejects files still marked as open for writing and files shorter
+	 * than the end of file address recorded in the superblock. Only version 3
+	 * superblocks record that a file is open: with older versions, the default
+	 * of HDF5, a file being written may pass the check.
+	 * \param reason	why the file is not complete
+	 */
+	static bool checkHDF5(const std::string& path, std::string& reason);
+
+ private:
+	struct Watch {
+		std::string	path;
+		bool		recursive;
+	};
+
+	WatchHandler*			handler;
+	int				workers;
+	size_t				queueSize;
+	std::string			extension;
+	std::chrono::milliseconds	settleTime;
+	int				inotifyFd;
+	int				wakeup[2];	/* wakes the watcher thread on stop */
+	std::map<int, Watch>		watches;	/* by watch descriptor */
+	std::deque<WatchEvent>		queue;
+	mutable std::mutex		mutex;		/* watches, queue, extension, settleTime */
+	std::condition_variable		notEmpty, notFull;
+	std::atomic<bool>		running;	/* reset by the watcher thread if it fails */
+	bool				draining;
+	std::atomic<bool>		stopping;	/* also read outside the mutex */
+	std::thread			watcher;
+	std::vector<std::thread>	pool;
+	std::atomic<uint64_t>		ready, rejected, failed, unsettled, overflows, fullWaits;
+
+	void watch(const std::string& path, bool recursive);
+	void scan(const std::string& path, bool recursive, std::vector<std::string>& found);
+	void scanWatched();
+	void reportSettled(const std::vector<std::string>& files);
+	void fileCompleted(const std::string& path);
+	void watcherMain(bool scanExisting);
+	void workerMain();
+
+	OdimWatcher(const OdimWatcher&);
+	OdimWatcher& operator=(const OdimWatcher&);
+};
+
+}
+
+#endif
@@ -0,0 +1,282 @@
+/*
+ * odimh5v21_xsec - vertical cross sections of polar volumes
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <radarlib/odimh5v21_xsec.hpp>
+#include <radarlib/odimh5v21_scans.hpp>
+#include <radarlib/odimh5v21_geometry.hpp>
+#include <radarlib/odimh5v21_const.hpp>
+#include <radarlib/odimh5v21_exceptions.hpp>
+#include <radarlib/parallel.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+namespace OdimH5v21 {
+namespace products {
+
+using namespace detail;
+
+/*===========================================================================*/
+/* SECTION GEOMETRY */
+/*===========================================================================*/
+
+SectionGeometry::SectionGeometry()
+	: startLat(0), startLon(0), stopLat(0), stopLon(0), xsize(0), ysize(0), minHeight(0), maxHeight(0)
+{
+}
+
+SectionGeometry::SectionGeometry(double startLat, double startLon, double stopLat, double stopLon,
+				 int xsize, int ysize, double minHeight, double maxHeight)
+	: startLat(startLat), startLon(startLon), stopLat(stopLat), stopLon(stopLon),
+	  xsize(xsize), ysize(ysize), minHeight(minHeight), maxHeight(maxHeight)
+{
+}
+
+SectionGeometry SectionGeometry::radial(PolarVolume& volume, double azimuth, double range,
+					int xsize, int ysize, double minHeight, double maxHeight)
+{
+	double lat = volume.getLatitude();
+	double lon = volume.getLongitude();
+	double ground = range * 1000.;
+	double stopLat, stopLon;
+	geometry::PolarGeometry::computeRadial(lat, lon, azimuth, &ground, 1, &stopLat, &stopLon);
+	return SectionGeometry(lat, lon, stopLat, stopLon, xsize, ysize, minHeight, maxHeight);
+}
+
+double SectionGeometry::length() const
+{
+	double distance, azimuth;
+	geometry::distanceAzimuth(startLat, startLon, stopLat, stopLon, distance, azimuth);
+	return distance;
+}
+
+void SectionGeometry::writeTo(WHEREXSECMetadata& where) const
+{
+	where.setXSize(xsize);
+	where.setYSize(ysize);
+	where.setXScale(xscale());
+	where.setYScale(yscale());
+	where.setMinHeight(minHeight);
+	where.setMaxHeight(maxHeight);
+}
+
+void SectionGeometry::writeTo(WHEREPanelMetadata& where) const
+{
+	where.setStartLatitude(startLat);
+	where.setStartLongitude(startLon);
+	where.setStopLatitude(stopLat);
+	where.setStopLongitude(stopLon);
+}
+
+std::string SectionGeometry::key() const
+{
+	std::ostringstream key;
+	key << formatKey(startLat) << ',' << formatKey(startLon) << ',' << formatKey(stopLat) << ',' << formatKey(stopLon)
+	    << ',' << xsize << ',' << ysize << ',' << formatKey(minHeight) << ',' << formatKey(maxHeight);
+	return key.str();
+}
+
+/*===========================================================================*/
+/* SECTION TABLE */
+/*===========================================================================*/
+
+SectionTable::SectionTable()
+	: xsize(0), ysize(0), scans(), offsets(), lower(), upper(), weights()
+{
+}
+
+size_t SectionTable::memorySize() const
+{
+	return sizeof(*this) + scans.capacity() * sizeof(int) + offsets.capacity() * sizeof(size_t)
+		+ (lower.capacity() + upper.capacity()) * sizeof(int) + weights.capacity() * sizeof(float);
+}
+
+/*===========================================================================*/
+/* SECTION GENERATOR */
+/*===========================================================================*/
+
+namespace {
+
+/* computes the cells of a block of columns, scans are sorted by elevation */
+struct SectionTableTask
+{
+	const SectionGeometry&		section;
+	const std::vector<ScanGeometry>& scans;
+	const std::vector<size_t>&	offsets;
+	double				sitelat, sitelon, sitealt;
+	int*				lower;
+	int*				upper;
+	float*				weights;
+
+	void operator()(size_t begin, size_t end) const
+	{
+		const size_t xsize	= section.xsize;
+		const double yscale	= section.yscale();
+		BeamColumn column(scans.size());
+
+		for (size_t col = begin; col < end; ++col)
+		{
+			double lat, lon, s, az;
+			geometry::greatCirclePoint(section.startLat, section.startLon, section.stopLat, section.stopLon,
+						   (col + 0.5) / xsize, lat, lon);
+			geometry::distanceAzimuth(sitelat, sitelon, lat, lon, s, az);
+			column.collect(scans, offsets, s / geometry::EFFECTIVE_EARTH_RADIUS, az, sitealt);
+
+			for (int row = 0; row < section.ysize; ++row)
+			{
+				size_t cell = (size_t)row * xsize + col;
+				column.interpolate(section.maxHeight - (row + 0.5) * yscale, true, lower[cell], upper[cell], weights[cell]);
+			}
+		}
+	}
+};
+
+}
+
+SectionGenerator::SectionGenerator(int threads)
+	: threads(threads), rowsPerBlock(16), defaultBeamWidth(1.)
+{
+}
+
+Radar::LRUCache<std::string, const SectionTable>& SectionGenerator::cache()
+{
+	static Radar::LRUCache<std::string, const SectionTable> tables(16);
+	return tables;
+}
+
+SectionGenerator::SectionTablePtr SectionGenerator::getSectionTable(PolarVolume& volume, const SectionGeometry& section, const std::string& quantity)
+{
+	if (section.xsize <= 0 || section.ysize <= 0 || !(section.maxHeight > section.minHeight))
+		throw std::invalid_argument("Invalid cross section size or heights");
+
+	std::vector<int> scans = scansByElevation(volume, quantity);
+	std::string key = "SECTION|" + section.key() + scansKey(volume, scans, defaultBeamWidth);
+	return cache().get(key, [&](const std::string&) { return buildSectionTable(volume, scans, section); });
+}
+
+SectionTable* SectionGenerator::buildSectionTable(PolarVolume& volume, const std::vector<int>& scans, const SectionGeometry& section)
+{
+	std::unique_ptr<SectionTable> table(new SectionTable());
+	std::vector<ScanGeometry> geometries;
+	readScanGeometries(volume, scans, defaultBeamWidth, geometries, table->offsets);
+	table->xsize	= section.xsize;
+	table->ysize	= section.ysize;
+	table->scans	= scans;
+	size_t size = (size_t)section.xsize * section.ysize;
+	table->lower.resize(size);
+	table->upper.resize(size);
+	table->weights.resize(size);
+
+	SectionTableTask task = {
+		section, geometries, table->offsets,
+		volume.getLatitude(), volume.getLongitude(), volume.getAltitude(),
+		&table->lower[0], &table->upper[0], &table->weights[0]
+	};
+	Radar::parallel::forBlocks((size_t)section.xsize, rowsPerBlock, threads, task);
+	return table.release();
+}
+
+void SectionGenerator::compute(PolarVolume& volume, const SectionGeometry& section, const std::string& quantity, DataMatrix<float>& out)
+{
+	fill(volume, *getSectionTable(volume, section, quantity), quantity, out);
+}
+
+void SectionGenerator::fill(PolarVolume& volume, const SectionTable& table, const std::string& quantity, DataMatrix<float>& out)
+{
+	std::vector<float> values;
+	decodeScans(volume, table.getScans(), table.getScanOffsets(), quantity, values);
+
+	out.resize(table.getYSize(), table.getXSize());
+	VerticalFillTask task = {
+		&table.getLowerGates()[0], &table.getUpperGates()[0], &table.getWeights()[0],
+		&values[0], &out.elem(0, 0), table.getXSize()
+	};
+	Radar::parallel::forBlocks((size_t)table.getYSize(), rowsPerBlock, threads, task);
+}
+
+void SectionGenerator::prepareObject(XsecObject& object, PolarVolume& volume, const SectionGeometry& section)
+{
+	object.setDateTime(volume.getDateTime());
+	object.setSource(volume.getSource());
+	section.writeTo(static_cast<WHEREXSECMetadata&>(object));
+	section.writeTo(static_cast<WHEREPanelMetadata&>(object));
+}
+
+void SectionGenerator::prepareDataset(Vertical_Product_2D& dataset, PolarVolume& volume, const SectionTable& table, const SectionGeometry& section)
+{
+	setScanTimes(dataset, volume, table.getScans());
+	section.writeTo(dataset);
+}
+
+Product_XSEC* SectionGenerator::generateXSEC(XsecObject& object, PolarVolume& volume, const SectionGeometry& section,
+					     const std::string& quantity, const Encoding& encoding)
+{
+	SectionTablePtr table = getSectionTable(volume, section, quantity);
+	DataMatrix<float> values;
+	fill(volume, *table, quantity, values);
+
+	prepareObject(object, volume, section);
+	std::unique_ptr<Product_XSEC> dataset(object.createProductXSEC());
+	prepareDataset(*dataset, volume, *table, section);
+	std::unique_ptr<Product_2D_Data> data(dataset->createQuantityData(quantity));
+	encoding.write(values, *data);
+	return dataset.release();
+}
+
+Product_RHI* SectionGenerator::generateRHI(XsecObject& object, PolarVolume& volume, double azimuth, double range,
+					   int xsize, int ysize, double minHeight, double maxHeight,
+					   const std::string& quantity, const Encoding& encoding)
+{
+	SectionGeometry section = SectionGeometry::radial(volume, azimuth, range, xsize, ysize, minHeight, maxHeight);
+	SectionTablePtr table = getSectionTable(volume, section, quantity);
+	DataMatrix<float> values;
+	fill(volume, *table, quantity, values);
+
+	std::vector<Angles> angles;
+	for (size_t k = 0; k < table->getScans().size(); ++k)
+	{
+		std::unique_ptr<PolarScan> scan(volume.getScan(table->getScans()[k]));
+		angles.push_back(Angles(scan->getEAngle()));
+	}
+
+	prepareObject(object, volume, section);
+	object.setRHILat(volume.getLatitude());
+	object.setRHILon(volume.getLongitude());
+	object.setAzimuthAngle(azimuth);
+	object.setRange(range);
+	object.setAngles(angles);
+
+	std::unique_ptr<Product_RHI> dataset(object.createProductRHI());
+	prepareDataset(*dataset, volume, *table, section);
+	dataset->setRHILat(volume.getLatitude());
+	dataset->setRHILon(volume.getLongitude());
+	dataset->setAzimuthAngle(azimuth);
+	dataset->setRange(range);
+	dataset->setAngles(angles);
+	std::unique_ptr<Product_2D_Data> data(dataset->createQuantityData(quantity));
+	encoding.write(values, *data);
+	return dataset.release();
+}
+
+}
+}
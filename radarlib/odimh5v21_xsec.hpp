@@ -0,0 +1,244 @@
+/*
+ * odimh5v21_xsec - vertical cross sections of polar volumes
+ *
+ * Copyright (C) 2013 ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef __RADAR_ODIMH5V21_XSEC_HPP__
+#define __RADAR_ODIMH5V21_XSEC_HPP__
+/*!
+ * \file
+ * \brief Vertical cross sections and RHI computed from polar volumes
+ */
+
+#include <radarlib/odimh5v21_cartesian.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace OdimH5v21 {
+namespace products {
+
+/*===========================================================================*/
+/* SECTION GEOMETRY */
+/*===========================================================================*/
+
+/*!
+ * \brief Vertical plane of a cross section
+ *
+ * The section follows the great circle from the start point to the stop
+ * point. Columns are equally spaced along the section, rows are equally
+ * spaced heights (m above sea level) from maxHeight (first row) down to
+ * minHeight. The fields match the ones of WHEREXSECMetadata and
+ * WHEREPanelMetadata.
+ */
+struct RADAR_API SectionGeometry {
+	double	startLat, startLon;
+	double	stopLat, stopLon;
+	int	xsize;
+	int	ysize;
+	double	minHeight;
+	double	maxHeight;
+
+	SectionGeometry();
+	SectionGeometry(double startLat, double startLon, double stopLat, double stopLon,
+			int xsize, int ysize, double minHeight, double maxHeight);
+
+	/*!
+	 * \brief Section along a radial of the volume, as the one of an RHI
+	 * \param azimuth	azimuth of the radial (degrees)
+	 * \param range		length of the section (km)
+	 */
+	static SectionGeometry radial(PolarVolume& volume, double azimuth, double range,
+				      int xsize, int ysize, double minHeight, double maxHeight);
+
+	/*!
+	 * \brief Length (m) of the section
+	 */
+	double length() const;
+	/*!
+	 * \brief Distance (m) between the centres of two columns
+	 */
+	double xscale() const	{ return length() / xsize; }
+	/*!
+	 * \brief Distance (m) between the centres of two rows
+	 */
+	double yscale() const	{ return (maxHeight - minHeight) / ysize; }
+
+	/*!
+	 * \brief Write size, scales and heights into the given metadata
+	 */
+	void writeTo(WHEREXSECMetadata& where) const;
+	/*!
+	 * \brief Write the start and stop points into the given metadata
+	 */
+	void writeTo(WHEREPanelMetadata& where) const;
+
+	/*!
+	 * \brief String that identifies the geometry in caches
+	 */
+	std::string key() const;
+};
+
+/*===========================================================================*/
+/* SECTION TABLE */
+/*===========================================================================*/
+
+/*!
+ * \brief Precomputed gates sampled by every cell of a cross section
+ *
+ * Each cell interpolates linearly in height between the gates of the two
+ * scans whose beams are just below and above it: getWeights() is the weight
+ * of the upper gate. Cells above or below every beam use the nearest scan if
+ * they are within half beam width from it, otherwise both gates are -1. Cells
+ * are stored row by row from the top, gates are numbered as in RemapTable.
+ */
+class RADAR_API SectionTable {
+ public:
+	SectionTable();
+
+	/*!
+	 * \brief Indexes in the volume of the scans used by the table
+	 */
+	const std::vector<int>& getScans() const		{ return scans; }
+	/*!
+	 * \brief Number of the first gate of each scan, plus the total number of gates
+	 */
+	const std::vector<size_t>& getScanOffsets() const	{ return offsets; }
+	/*!
+	 * \brief Gate of the lower scan of each cell
+	 */
+	const std::vector<int>& getLowerGates() const		{ return lower; }
+	/*!
+	 * \brief Gate of the upper scan of each cell
+	 */
+	const std::vector<int>& getUpperGates() const		{ return upper; }
+	/*!
+	 * \brief Weight of the upper gate of each cell
+	 */
+	const std::vector<float>& getWeights() const		{ return weights; }
+	int getXSize() const	{ return xsize; }
+	int getYSize() const	{ return ysize; }
+
+	/*!
+	 * \brief Memory used by the table, in bytes
+	 */
+	size_t memorySize() const;
+
+ private:
+	friend class SectionGenerator;
+	int			xsize, ysize;
+	std::vector<int>	scans;
+	std::vector<size_t>	offsets;
+	std::vector<int>	lower;
+	std::vector<int>	upper;
+	std::vector<float>	weights;
+};
+
+/*===========================================================================*/
+/* SECTION GENERATOR */
+/*===========================================================================*/
+
+/*!
+ * \brief Generator of XSEC and RHI products from polar volumes
+ *
+ * Heights follow the 4/3 effective earth radius model, as CartesianGenerator.
+ * Values are interpolated linearly between two valid gates, a cell with a
+ * single valid gate or with UNDETECT gates takes the value of the nearest
+ * one. \n
+ * Section tables are cached by radar site, scan geometries and section
+ * geometry. Rows are filled in parallel blocks.
+ */
+class RADAR_API SectionGenerator {
+ public:
+	typedef std::shared_ptr<const SectionTable> SectionTablePtr;
+
+	/*!
+	 * \brief Create a generator
+	 * \param threads	number of threads, 0 for one thread per core
+	 */
+	SectionGenerator(int threads = 0);
+
+	void setThreads(int val)	{ threads = val; }
+	int getThreads() const		{ return threads; }
+	/*!
+	 * \brief Number of rows assigned to a thread at a time
+	 */
+	void setRowsPerBlock(int val)	{ rowsPerBlock = val > 0 ? val : 1; }
+	/*!
+	 * \brief Beam width (degrees) used when scans do not store how/beamwidth
+	 */
+	void setDefaultBeamWidth(double val)	{ defaultBeamWidth = val; }
+
+	/*!
+	 * \brief Get the section table of a volume, computing it if it is not cached
+	 * \param quantity	only scans with this quantity are used
+	 */
+	SectionTablePtr getSectionTable(PolarVolume& volume, const SectionGeometry& section, const std::string& quantity);
+
+	/*!
+	 * \brief Compute the physical values of a cross section
+	 * \param out		resized to the section, undetect and nodata cells are UNDETECT and NODATA
+	 */
+	void compute(PolarVolume& volume, const SectionGeometry& section, const std::string& quantity, DataMatrix<float>& out);
+
+	/*!
+	 * \brief Compute a cross section and store it in an XSEC object as an XSEC product
+	 *
+	 * Root what/ of the object is set from the volume, root where/ and the
+	 * where/ of the new dataset describe the section.
+	 * \returns		the new product dataset
+	 * \remarks		User is responsible for deleting the returned object
+	 */
+	Product_XSEC* generateXSEC(XsecObject& object, PolarVolume& volume, const SectionGeometry& section,
+				   const std::string& quantity, const Encoding& encoding);
+
+	/*!
+	 * \brief Compute a section along a radial and store it in an XSEC object as an RHI product
+	 *
+	 * Besides the section, where/ stores the radar position, the azimuth, the
+	 * range and the elevation angles of the scans used.
+	 * \param azimuth	azimuth of the radial (degrees)
+	 * \param range		length of the section (km)
+	 * \returns		the new product dataset
+	 * \remarks		User is responsible for deleting the returned object
+	 * \see SectionGeometry::radial()
+	 */
+	Product_RHI* generateRHI(XsecObject& object, PolarVolume& volume, double azimuth, double range,
+				 int xsize, int ysize, double minHeight, double maxHeight,
+				 const std::string& quantity, const Encoding& encoding);
+
+	/*!
+	 * \brief Cache of section tables shared by every generator
+	 */
+	static Radar::LRUCache<std::string, const SectionTable>& cache();
+
+ private:
+	int		threads;
+	int		rowsPerBlock;
+	double		defaultBeamWidth;
+
+	SectionTable* buildSectionTable(PolarVolume& volume, const std::vector<int>& scans, const SectionGeometry& section);
+	void fill(PolarVolume& volume, const SectionTable& table, const std::string& quantity, DataMatrix<float>& out);
+	void prepareObject(XsecObject& object, PolarVolume& volume, const SectionGeometry& section);
+	void prepareDataset(Vertical_Product_2D& dataset, PolarVolume& volume, const SectionTable& table, const SectionGeometry& section);
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ * Radar Library
+ *
+ * Copyright (C) 2009-2010  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*! \file
+ *  \brief Functions to split loops between threads
+ */
+
+#ifndef __RADAR_PARALLEL_HPP__
+#define __RADAR_PARALLEL_HPP__
+
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <radarlib/defs.h>
+
+namespace Radar {
+
+/*!\brief Functions to split loops between threads
+ */
+namespace parallel {
+
+/*===========================================================================*/
+
+/*!
+ * \brief Get the number of threads to use
+ * \param threads		requested number of threads, 0 or less for one thread per core
+ */
+static inline int threadCount(int threads)
+{
+	if (threads > 0)
+		return threads;
+	unsigned int cores = std::thread::hardware_concurrency();
+	return cores ? (int)cores : 1;
+}
+
+/*!
+ * \brief Split the range [0,count) in consecutive blocks and process them in parallel
+ *
+ * Blocks are assigned to threads in round robin, each block is processed by a single
+ * call to func(begin, end). The calling thread takes part in the work. \n
+ * The first exception thrown by func is rethrown once every thread has finished. \n
+ * If a thread cannot be started, the blocks assigned to it and to the following
+ * threads are processed by the calling thread.
+ * \param count			number of elements
+ * \param blockSize		number of elements of each block
+ * \param threads		number of threads, see threadCount()
+ * \param func			functor called as func(size_t begin, size_t end)
+ */
+template <class FUNC> void forBlocks(size_t count, size_t blockSize, int threads, FUNC func)
+{
+	if (blockSize == 0)
+		blockSize = 1;
+	size_t blocks = (count + blockSize - 1) / blockSize;
+	size_t nthreads = (size_t)threadCount(threads);
+	if (nthreads > blocks)
+		nthreads = blocks;
+	if (nthreads <= 1)
+	{
+		if (count)
+			func((size_t)0, count);
+		return;
+	}
+
+	std::vector<std::exception_ptr> errors(nthreads);
+	struct Worker
+	{
+		static void run(FUNC& func, size_t first, size_t step, size_t blocks, size_t blockSize, size_t count, std::exception_ptr& error)
+		{
+			try
+			{
+				for (size_t b = first; b < blocks; b += step)
+				{
+					size_t begin = b * blockSize;
+					size_t end = begin + blockSize < count ? begin + blockSize : count;
+					func(begin, end);
+				}
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	workers.reserve(nthreads - 1);
+	size_t t = 1;
+	try
+	{
+		for (; t < nthreads; t++)
+			workers.push_back(std::thread(Worker::run, std::ref(func), t, nthreads, blocks, blockSize, count, std::ref(errors[t])));
+	}
+	catch (...)
+	{
+		/* a thread could not be started: its blocks are processed by the calling thread */
+	}
+	for (size_t u = t; u < nthreads; u++)
+		Worker::run(func, u, nthreads, blocks, blockSize, count, errors[u]);
+	Worker::run(func, 0, nthreads, blocks, blockSize, count, errors[0]);
+	for (size_t w = 0; w < workers.size(); w++)
+		workers[w].join();
+	for (size_t e = 0; e < nthreads; e++)
+		if (errors[e])
+			std::rethrow_exception(errors[e]);
+}
+
+/*===========================================================================*/
+
+} }
+
+#endif
@@ -0,0 +1,164 @@
+#include <radarlib/radar.hpp>
+#include <assert.h>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+#define XSIZE 20
+#define YSIZE 10
+
+static const time_t T0 = Radar::timeutils::mktime(2000,1,2,3,0,0);
+
+static CartesianGrid test_grid()
+{
+	return CartesianGrid::centeredOn(44.4567, 11.6236, XSIZE, YSIZE, 2000., 2000.);
+}
+
+static std::string frame_path(int i)
+{
+	char buff[64];
+	snprintf(buff, sizeof(buff), "/ACRR-RATE-%02d-ODIMH5V21.h5", i);
+	return std::string(TESTDIR) + buff;
+}
+
+/* composite with a RATE product of 'rate' mm/h everywhere but the first column, which is undetect */
+static void create_frame(int i, time_t time, float rate)
+{
+	OdimFactory factory;
+	std::unique_ptr<CompObject> comp(factory.createCompObject(frame_path(i)));
+	comp->setDateTime(time);
+	SourceInfo source;
+	source.setOperaRadarSite("comp");
+	comp->setSource(source);
+	CartesianGrid grid = test_grid();
+	grid.writeTo(*comp);
+
+	std::unique_ptr<Product_COMP> dataset(comp->createProductCOMP());
+	dataset->setStartDateTime(time - 300);
+	dataset->setEndDateTime(time);
+	grid.writeTo(*dataset);
+	DataMatrix<float> values(YSIZE, XSIZE);
+	for (int r=0; r<YSIZE; r++)
+		for (int c=0; c<XSIZE; c++)
+			values.elem(r, c) = c == 0 ? UNDETECT : rate;
+	std::unique_ptr<Product_2D_Data> data(dataset->createQuantityData(PRODUCT_QUANTITY_RATE));
+	Encoding(RAW_UINT16, 0.01, 0., 65535., 0.).write(values, *data);
+}
+
+void test_matrices()
+{
+	RainAccumulator acc(test_grid(), 3);
+	acc.setRowsPerBlock(3);
+	DataMatrix<float> rates(YSIZE, XSIZE);
+
+	/* one hour of 12 mm/h: pixel (0,1) misses 6 frames, pixel (0,2) 7 frames */
+	for (int i=0; i<12; i++)
+	{
+		rates.fill(12.f);
+		rates.elem(0, 0) = UNDETECT;
+		if (i < 6)
+			rates.elem(0, 1) = NODATA;
+		if (i < 7)
+			rates.elem(0, 2) = NODATA;
+		acc.addFrame(T0 + i * 300, rates);
+	}
+	assert(acc.getFrameCount() == 12);
+	assert(acc.getStartDateTime() == T0 - 300);
+	assert(acc.getEndDateTime() == T0 + 11 * 300);
+
+	DataMatrix<float> out;
+	acc.compute(out);
+	assert(out.getRowCount() == YSIZE && out.getColCount() == XSIZE);
+	assert(fabs(out.elem(5, 5) - 12.) < 1e-5);
+	assert(out.elem(0, 0) == 0.f);
+	/* half of the period is enough and is scaled to the whole one */
+	assert(fabs(out.elem(0, 1) - 12.) < 1e-5);
+	assert(std::isnan(out.elem(0, 2)));
+
+	/* frames out of order or of the wrong size */
+	try {
+		acc.addFrame(T0, rates);
+		assert(false);
+	} catch (std::invalid_argument&) {
+	}
+	DataMatrix<float> small(2, 2);
+	try {
+		acc.addFrame(T0 + 3600, small);
+		assert(false);
+	} catch (std::invalid_argument&) {
+	}
+
+	/* a missing frame: the next one covers only the maximum gap */
+	acc.clear();
+	acc.setMaxGap(300);
+	acc.setMinCoverage(0.);
+	rates.fill(6.f);
+	acc.addFrame(T0, rates);
+	rates.fill(3.f);
+	acc.addFrame(T0 + 300, rates);
+	acc.addFrame(T0 + 900, rates);
+	acc.compute(out);
+	/* period of 1200 s observed for 900 s: (6 * 300 + 3 * 600) / 3600 scaled by 4/3 */
+	assert(acc.getStartDateTime() == T0 - 300);
+	assert(fabs(out.elem(3, 3) - 1.0 * 4. / 3.) < 1e-5);
+	acc.setMinCoverage(0.8);
+	acc.compute(out);
+	assert(std::isnan(out.elem(3, 3)));
+}
+
+void test_files()
+{
+	/* half an hour of frames, the one at 03:20 is missing */
+	for (int i=0; i<6; i++)
+		if (i != 4)
+			create_frame(i, T0 + i * 300, i + 1.f);
+
+	RainAccumulator acc(2);
+	for (int i=0; i<6; i++)
+		if (i != 4)
+			acc.addFile(frame_path(i));
+	assert(acc.getFrameCount() == 5);
+	assert(acc.getGrid().xsize == XSIZE);
+
+	OdimFactory factory;
+	{
+		std::unique_ptr<CompObject> comp(factory.createCompObject(TESTDIR"/ACRR-ODIMH5V21.h5"));
+		std::unique_ptr<Product_RR> rr(acc.generate(*comp));
+		assert(rr->getProduct() == PRODUCT_RR);
+	}
+
+	std::unique_ptr<OdimObject> object(factory.open(TESTDIR"/ACRR-ODIMH5V21.h5"));
+	CompObject* comp = dynamic_cast<CompObject*>(object.get());
+	assert(comp != NULL);
+	assert(comp->getDateTime() == T0 + 1500);
+	assert(comp->getSource().OperaRadarSite == "comp");
+	assert(comp->getXSize() == XSIZE);
+	std::unique_ptr<Product_2D> rr(comp->getProduct(0));
+	assert(rr->getStartDateTime() == T0 - 300);
+	assert(rr->getEndDateTime() == T0 + 1500);
+	std::unique_ptr<Product_2D_Data> data(rr->getQuantityData(PRODUCT_QUANTITY_ACRR));
+	DataMatrix<unsigned short> raw(YSIZE, XSIZE);
+	data->readData(&raw.elem(0, 0));
+	/* the frame at 03:25 covers the 10 minutes since 03:15 */
+	double mm = (1. + 2. + 3. + 4.) * 300. / 3600. + 6. * 600. / 3600.;
+	assert(fabs(raw.elem(4, 4) * 0.01 - mm) < 0.006);
+	assert(raw.elem(4, 0) == 0);
+
+	/* frames of another grid are refused */
+	RainAccumulator other(CartesianGrid::centeredOn(44., 11., XSIZE, YSIZE, 2000., 2000.));
+	try {
+		other.addFile(frame_path(0));
+		assert(false);
+	} catch (std::invalid_argument&) {
+	}
+}
+
+int main()
+{
+	test_matrices();
+	test_files();
+	return 0;
+}
@@ -0,0 +1,177 @@
+#include <radarlib/radar.hpp>
+#include "test-volume.hpp"
+#include <assert.h>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <unistd.h>
+
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+#define DIR		TESTDIR"/BATCH-DIR"
+#define CHECKPOINT	DIR"/checkpoint.txt"
+
+static void create_files()
+{
+	Radar::FileSystem::rmDirTree(DIR);
+	Radar::FileSystem::mkDirTree(DIR"/sub");
+	create_test_volume(DIR"/VOL-1.h5", 1);
+	create_test_volume(DIR"/VOL-2.h5", 3);
+	create_test_volume(DIR"/sub/VOL-3.h5", 2);
+	Radar::FileSystem::createFile(DIR"/BAD.h5", "not an HDF5 file");
+	Radar::FileSystem::createFile(DIR"/sub/readme.txt", "skipped");
+}
+
+/* fails, crashes or hangs depending on the name of the file */
+class NameTask : public BatchTask {
+ public:
+	virtual void process(const std::string& path)
+	{
+		if (path.find("BAD") != std::string::npos)
+			throw std::runtime_error("bad\tfile");
+		if (path.find("CRASH") != std::string::npos)
+			abort();
+		if (path.find("SLOW") != std::string::npos)
+			sleep(30);
+	}
+	static BatchTask* create()	{ return new NameTask(); }
+};
+
+class Recorder : public BatchListener {
+ public:
+	std::vector<BatchResult> results;
+	virtual void fileDone(const BatchResult& result, int finished, int total)
+	{
+		results.push_back(result);
+		assert(finished <= total);
+	}
+};
+
+static const BatchResult* find(const std::vector<BatchResult>& results, const std::string& name)
+{
+	for (size_t i=0; i<results.size(); i++)
+		if (results[i].path.find(name) != std::string::npos)
+			return &results[i];
+	return NULL;
+}
+
+void test_list()
+{
+	std::vector<std::string> files = BatchRunner::listFiles(DIR);
+	assert(files.size() == 4);
+	assert(files[0] == DIR"/BAD.h5" && files[1] == DIR"/VOL-1.h5" && files[3] == DIR"/sub/VOL-3.h5");
+	assert(BatchRunner::listFiles(DIR, ".h5", false).size() == 3);
+	assert(BatchRunner::listFiles(DIR, "", true).size() == 5);
+}
+
+void test_tasks()
+{
+	assert(BatchTasks::exists("check") && BatchTasks::exists("dump"));
+	try {
+		BatchRunner runner("missing");
+		assert(false);
+	} catch (std::invalid_argument&) {
+	}
+
+	std::vector<std::string> files = BatchRunner::listFiles(DIR);
+	BatchRunner check("check", 2);
+	BatchReport report = check.run(files);
+	assert(report.files == 4 && report.done == 3 && report.resumed == 0);
+	assert(report.failures.size() == 1 && report.failures[0].path == DIR"/BAD.h5");
+	assert(!report.failures[0].message.empty());
+	assert(report.bytes > 0);
+
+	BatchRunner dump("dump", 2);
+	BatchOptions options;
+	options["output"] = DIR"/dump";
+	dump.setOptions(options);
+	report = dump.run(std::vector<std::string>(files.begin() + 1, files.end()));
+	assert(report.done == 3 && report.failures.empty());
+	assert(Radar::FileSystem::fileExists(DIR"/dump/VOL-3.h5.txt"));
+
+	/* every file fails when the task cannot start */
+	report = BatchRunner("dump", 2).run(files);
+	assert(report.done == 0 && report.failures.size() == 4);
+	assert(report.failures[0].message.find("output") != std::string::npos);
+}
+
+void test_balancing()
+{
+	/* a single worker receives the files largest first */
+	Recorder recorder;
+	BatchRunner runner("check", 1);
+	runner.setListener(&recorder);
+	std::vector<std::string> files = BatchRunner::listFiles(DIR);
+	runner.run(files);
+	assert(recorder.results.size() == 4);
+	for (size_t i=1; i<recorder.results.size(); i++)
+		assert(Radar::FileSystem::getFileSize(recorder.results[i - 1].path) >= Radar::FileSystem::getFileSize(recorder.results[i].path));
+}
+
+void test_checkpoint()
+{
+	BatchTasks::add("test-name", NameTask::create, "test task");
+	std::vector<std::string> files = BatchRunner::listFiles(DIR);
+	files.push_back(DIR"/CRASH.h5");
+
+	BatchRunner runner("test-name", 2);
+	runner.setCheckpoint(CHECKPOINT);
+	BatchReport report = runner.run(files);
+	assert(report.done == 3 && report.failures.size() == 2);
+	assert(find(report.failures, "BAD")->message == "bad\tfile");
+	assert(find(report.failures, "CRASH")->message.find("signal") != std::string::npos);
+
+	/* an interrupted run leaves a truncated line, parsed but never matched */
+	{
+		std::ofstream out(CHECKPOINT, std::ios::app);
+		out << "done\t" DIR "/VOL";
+	}
+
+	/* resumed: nothing is processed, failures are reported again */
+	Recorder recorder;
+	runner.setListener(&recorder);
+	report = runner.run(files);
+	assert(report.resumed == 5 && report.done == 0 && report.failures.size() == 2);
+	assert(find(report.failures, "BAD")->message == "bad file");
+	assert(recorder.results.empty());
+
+	files.push_back(DIR"/NEW.h5");
+	runner.setRetryFailed(true);
+	report = runner.run(files);
+	assert(report.resumed == 3 && report.done == 1 && report.failures.size() == 2 && recorder.results.size() == 3);
+
+	std::ifstream in(CHECKPOINT);
+	std::string line;
+	int lines = 0;
+	while (std::getline(in, line))
+		if (line.compare(0, 5, "done\t") == 0 || line.compare(0, 7, "failed\t") == 0)
+			lines++;
+	assert(lines == 5 + 1 + 3);
+}
+
+void test_timeout()
+{
+	std::vector<std::string> files;
+	files.push_back(DIR"/SLOW.h5");
+	files.push_back(DIR"/VOL-1.h5");
+	BatchRunner runner("test-name", 1);
+	runner.setTimeout(1);
+	BatchReport report = runner.run(files);
+	assert(report.done == 1 && report.failures.size() == 1);
+	assert(report.failures[0].message == "timeout after 1 s");
+	assert(report.seconds < 10);
+}
+
+int main()
+{
+	create_files();
+	/* the workers inherit the setting, BAD.h5 fails on purpose */
+	HDF5Library::instance().setPrintErrors(false);
+	test_list();
+	test_tasks();
+	test_balancing();
+	test_checkpoint();
+	test_timeout();
+	return 0;
+}
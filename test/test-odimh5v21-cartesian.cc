@@ -0,0 +1,340 @@
+#include <radarlib/radar.hpp>
+#include "test-volume.hpp"
+#include <assert.h>
+#include <cmath>
+#include <memory>
+
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+#define NUMRAYS 360
+#define NUMBINS 100
+
+/* two scans, raw value of each gate is its bin number plus 10 times the scan */
+void create_volume()
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.createPolarVolume(TESTDIR"/CARTESIAN-PVOL-ODIMH5V21.h5"));
+	set_test_radar(*volume);
+
+	for (int s=0; s<2; s++)
+	{
+		std::unique_ptr<PolarScan> scan(volume->createScan());
+		scan->setStartDateTime(Radar::timeutils::mktime(2000,1,2,3,4,5+s));
+		scan->setEndDateTime(Radar::timeutils::mktime(2000,1,2,3,4,6+s));
+		scan->setEAngle(0.5 + s * 4.5);
+		scan->setA1Gate(0);
+		scan->setNumBins(NUMBINS);
+		scan->setNumRays(NUMRAYS);
+		scan->setRangeStart(0);
+		scan->setRangeScale(1000);
+		scan->setBeamWidth(1.);
+
+		std::unique_ptr<PolarScanData> data(scan->createQuantityData(PRODUCT_QUANTITY_DBZH));
+		data->setNodata(255.);
+		data->setUndetect(0.);
+		data->setOffset(-10.);
+		data->setGain(0.5);
+		RayMatrix<unsigned char> matrix(NUMRAYS, NUMBINS);
+		for (int r=0; r<NUMRAYS; r++)
+			for (int b=0; b<NUMBINS; b++)
+				matrix.elem(r,b) = r == 90 ? 255 : b == 0 ? 0 : b + 10 * s;
+		data->writeData(matrix);
+	}
+}
+
+void test_projection()
+{
+	Projection proj("+proj=gnom +lat_0=44.7914N +lon_0=10.4992E +units=m +ellps=sphere");
+	double x, y, lat, lon;
+	proj.forward(45.5, 11.2, x, y);
+	proj.inverse(x, y, lat, lon);
+	assert(fabs(lat - 45.5) < 1e-9 && fabs(lon - 11.2) < 1e-9);
+
+	CartesianGrid grid = CartesianGrid::centeredOn(44.4567, 11.6236, 200, 200, 1000., 1000.);
+	Projection aeqd(grid.projdef);
+	aeqd.forward(44.4567, 11.6236, x, y);
+	assert(fabs(x) < 1e-6 && fabs(y) < 1e-6);
+	aeqd.inverse(0., 50000., lat, lon);
+	assert(fabs(lat - 44.4567 - 50000. / (geometry::EARTH_RADIUS * M_PI / 180.)) < 1e-9);
+
+	try {
+		Projection unsupported("+proj=lcc +lat_1=30");
+		assert(false);
+	} catch (std::invalid_argument&) {
+	}
+}
+
+void test_generator()
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(TESTDIR"/CARTESIAN-PVOL-ODIMH5V21.h5"));
+
+	CartesianGrid grid = CartesianGrid::centeredOn(volume->getLatitude(), volume->getLongitude(), 240, 240, 1000., 1000.);
+	CartesianGenerator generator(grid, 4);
+	generator.setRowsPerBlock(7);
+
+	DataMatrix<float> ppi;
+	generator.compute(*volume, PRODUCT_PPI, 0.5, PRODUCT_QUANTITY_DBZH, ppi);
+	assert(ppi.getRowCount() == 240 && ppi.getColCount() == 240);
+	/* 40.5 km north of the radar (row 79, column 120), a little farther on the slant range */
+	float v = ppi.elem(79, 120);
+	assert(v == (float)(40 * 0.5 - 10.));
+	/* first bin is undetect, ray 90 (east) is nodata, outside the range is nodata */
+	assert(ppi.elem(119, 120) == UNDETECT);
+	assert(std::isnan(ppi.elem(120, 150)));
+	assert(std::isnan(ppi.elem(0, 0)));
+
+	/* the table is cached: a second generator with the same grid reuses it */
+	size_t hits = CartesianGenerator::cache().getHits();
+	CartesianGenerator::RemapTablePtr table = generator.getRemapTable(*volume, PRODUCT_PPI, 0.5, PRODUCT_QUANTITY_DBZH);
+	CartesianGenerator other(grid, 1);
+	assert(other.getRemapTable(*volume, PRODUCT_PPI, 0.5, PRODUCT_QUANTITY_DBZH) == table);
+	assert(CartesianGenerator::cache().getHits() == hits + 2);
+
+	/* single thread and multi thread results are equal */
+	DataMatrix<float> single;
+	other.compute(*volume, PRODUCT_PPI, 0.5, PRODUCT_QUANTITY_DBZH, single);
+	for (int r=0; r<240; r++)
+		for (int c=0; c<240; c++)
+			assert(single.elem(r,c) == ppi.elem(r,c) || (std::isnan(single.elem(r,c)) && std::isnan(ppi.elem(r,c))));
+
+	/* at 3000 m the 5 degrees scan is nearer close to the radar, the 0.5 degrees one far away */
+	DataMatrix<float> pcappi, cappi;
+	generator.compute(*volume, PRODUCT_PCAPPI, 3000., PRODUCT_QUANTITY_DBZH, pcappi);
+	generator.compute(*volume, PRODUCT_CAPPI, 3000., PRODUCT_QUANTITY_DBZH, cappi);
+	assert(pcappi.elem(119 - 30, 120) == (float)((30 + 10) * 0.5 - 10.));
+	assert(pcappi.elem(119 - 90, 120) == (float)(90 * 0.5 - 10.));
+	assert(pcappi.elem(119 - 5, 120) == (float)((5 + 10) * 0.5 - 10.));
+	/* 5 km from the radar both beams are far below 3000 m */
+	assert(std::isnan(cappi.elem(119 - 5, 120)));
+	assert(cappi.elem(119 - 30, 120) == pcappi.elem(119 - 30, 120));
+
+	/* write the product */
+	std::unique_ptr<ImageObject> image(factory.createImageObject(TESTDIR"/CARTESIAN-PPI-ODIMH5V21.h5"));
+	std::unique_ptr<Horizontal_Product_2D> product(generator.generate(*image, *volume, PRODUCT_PPI, 0.5, PRODUCT_QUANTITY_DBZH, Encoding(RAW_UINT8, 0.5, -10., 255., 0.)));
+	assert(image->getXSize() == 240);
+	assert(product->getProduct() == PRODUCT_PPI);
+	assert(product->getProdPar() == 0.5);
+	assert(product->getStartDateTime() == Radar::timeutils::mktime(2000,1,2,3,4,5));
+	assert(fabs(product->getUL_Latitude() - image->getUL_Latitude()) < 1e-12);
+	assert(product->getUL_Latitude() > volume->getLatitude() + 1.);
+	std::unique_ptr<Product_2D_Data> data(product->getQuantityData(PRODUCT_QUANTITY_DBZH));
+	assert(data->getGain() == 0.5);
+	DataMatrix<unsigned char> raw(240, 240);
+	data->readData(&raw.elem(0, 0));
+	assert(raw.elem(79, 120) == 40);
+	assert(raw.elem(119, 120) == 0);
+	assert(raw.elem(0, 0) == 255);
+}
+
+/* one scan whose rays start 90 degrees east of north, ray 0 is nodata */
+void test_azimuths()
+{
+	OdimFactory factory;
+	{
+		std::unique_ptr<PolarVolume> volume(factory.createPolarVolume(TESTDIR"/CARTESIAN-ROTATED-PVOL-ODIMH5V21.h5"));
+		set_test_radar(*volume);
+		std::unique_ptr<PolarScan> scan(volume->createScan());
+		scan->setStartDateTime(Radar::timeutils::mktime(2000,1,2,3,4,5));
+		scan->setEndDateTime(Radar::timeutils::mktime(2000,1,2,3,4,6));
+		scan->setEAngle(0.5);
+		scan->setA1Gate(0);
+		scan->setNumBins(NUMBINS);
+		scan->setNumRays(NUMRAYS);
+		scan->setRangeStart(0);
+		scan->setRangeScale(1000);
+		scan->setBeamWidth(1.);
+		std::vector<double> start(NUMRAYS), stop(NUMRAYS);
+		for (int r=0; r<NUMRAYS; r++)
+		{
+			start[r] = (r + 90) % 360;
+			stop[r] = (r + 91) % 360;
+		}
+		scan->setStartAzimuthAngles(start);
+		scan->setStopAzimuthAngles(stop);
+
+		std::unique_ptr<PolarScanData> data(scan->createQuantityData(PRODUCT_QUANTITY_DBZH));
+		data->setNodata(255.);
+		data->setUndetect(0.);
+		data->setOffset(-10.);
+		data->setGain(0.5);
+		RayMatrix<unsigned char> matrix(NUMRAYS, NUMBINS);
+		for (int r=0; r<NUMRAYS; r++)
+			for (int b=0; b<NUMBINS; b++)
+				matrix.elem(r,b) = r == 0 ? 255 : b;
+		data->writeData(matrix);
+	}
+
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(TESTDIR"/CARTESIAN-ROTATED-PVOL-ODIMH5V21.h5"));
+	CartesianGrid grid = CartesianGrid::centeredOn(volume->getLatitude(), volume->getLongitude(), 240, 240, 1000., 1000.);
+	CartesianGenerator generator(grid, 2);
+	DataMatrix<float> ppi;
+	generator.compute(*volume, PRODUCT_PPI, 0.5, PRODUCT_QUANTITY_DBZH, ppi);
+	/* east of the radar is ray 0, north is ray 270 */
+	assert(std::isnan(ppi.elem(120, 150)));
+	assert(ppi.elem(79, 120) == (float)(40 * 0.5 - 10.));
+}
+
+/* height (m above sea level) of the beam centre at the given ground distance from the radar */
+double beam_height(double elangle, double ground)
+{
+	double re = geometry::EFFECTIVE_EARTH_RADIUS;
+	double el = elangle * M_PI / 180.;
+	return re * cos(el) / cos(el + ground / re) - re + 31.;
+}
+
+void test_columns()
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(TESTDIR"/CARTESIAN-PVOL-ODIMH5V21.h5"));
+
+	CartesianGrid grid = CartesianGrid::centeredOn(volume->getLatitude(), volume->getLongitude(), 240, 240, 1000., 1000.);
+	ColumnGenerator generator(grid, 4);
+	generator.setTileSize(50);
+
+	ColumnRequest request;
+	request.etopThreshold = 7.;
+	DataMatrix<float> max, etop, vil;
+	generator.compute(*volume, PRODUCT_QUANTITY_DBZH, request, max, etop, vil);
+	assert(max.getRowCount() == 240 && etop.getColCount() == 240 && vil.getRowCount() == 240);
+
+	/* 30.5 km north both scans use bin 30, the upper one is 5 dBZ stronger */
+	assert(max.elem(89, 120) == (float)((30 + 10) * 0.5 - 10.));
+	double ground = sqrt(30500. * 30500. + 500. * 500.);
+	double h0 = beam_height(0.5, ground);
+	double h1 = beam_height(5., ground);
+	assert(fabs(etop.elem(89, 120) - h1 / 1000.) < 1e-4);
+	double z0 = 3.44e-6 * pow(10., (30 * 0.5 - 10.) * 4. / 70.);
+	double z1 = 3.44e-6 * pow(10., ((30 + 10) * 0.5 - 10.) * 4. / 70.);
+	double mid = (h0 + h1) * 0.5;
+	/* the lower layer is clipped at the ground */
+	assert(h0 - (h1 - h0) * 0.5 < 0.);
+	double expected = z0 * mid + z1 * (h1 + (h1 - h0) * 0.5 - mid);
+	assert(fabs(vil.elem(89, 120) - expected) < expected * 1e-4);
+
+	/* first bins are undetect, beyond the range there is no data */
+	assert(max.elem(119, 120) == UNDETECT);
+	assert(etop.elem(119, 120) == UNDETECT);
+	assert(vil.elem(119, 120) == UNDETECT);
+	assert(std::isnan(max.elem(0, 0)) && std::isnan(etop.elem(0, 0)) && std::isnan(vil.elem(0, 0)));
+
+	/* the table is cached, results do not depend on threads and tiles */
+	ColumnGenerator::ColumnTablePtr table = generator.getColumnTable(*volume, PRODUCT_QUANTITY_DBZH);
+	assert(table->getLevels() == 2);
+	ColumnGenerator other(grid, 1);
+	other.setTileSize(240);
+	assert(other.getColumnTable(*volume, PRODUCT_QUANTITY_DBZH) == table);
+	request.etopThreshold = 20.;
+	request.vilHeights = VILHeights(0., 1000.);
+	DataMatrix<float> max1, etop1, vil1;
+	other.compute(*volume, PRODUCT_QUANTITY_DBZH, request, max1, etop1, vil1);
+	for (int r=0; r<240; r++)
+		for (int c=0; c<240; c++)
+			assert(max1.elem(r,c) == max.elem(r,c) || (std::isnan(max1.elem(r,c)) && std::isnan(max.elem(r,c))));
+	assert(etop1.elem(89, 120) == UNDETECT);
+	/* only the lower gate is in the layer */
+	assert(mid > 1000.);
+	assert(fabs(vil1.elem(89, 120) - z0 * 1000.) < z0 * 1000. * 1e-4);
+
+	/* write the products */
+	std::unique_ptr<ImageObject> image(factory.createImageObject(TESTDIR"/CARTESIAN-COLUMN-ODIMH5V21.h5"));
+	std::vector<Horizontal_Product_2D*> products = generator.generate(*image, *volume, PRODUCT_QUANTITY_DBZH, request);
+	assert(products.size() == 3);
+	assert(image->getProductCount() == 3);
+	assert(products[0]->getProduct() == PRODUCT_MAX);
+	assert(products[1]->getProduct() == PRODUCT_ETOP);
+	assert(products[1]->getProdPar() == 20.);
+	assert(products[2]->getProduct() == PRODUCT_VIL);
+	assert(products[2]->getProdParVIL().top == 1000.);
+	assert(products[2]->getStartDateTime() == Radar::timeutils::mktime(2000,1,2,3,4,5));
+	assert(products[2]->getEndDateTime() == Radar::timeutils::mktime(2000,1,2,3,4,7));
+	std::unique_ptr<Product_2D_Data> data(products[1]->getQuantityData(PRODUCT_QUANTITY_HGHT));
+	assert(data->getGain() == 0.1);
+	std::unique_ptr<Product_2D_Data> maxdata(products[0]->getQuantityData(PRODUCT_QUANTITY_DBZH));
+	DataMatrix<unsigned char> raw(240, 240);
+	maxdata->readData(&raw.elem(0, 0));
+	assert(raw.elem(89, 120) == 84);
+	for (size_t i = 0; i < products.size(); i++)
+		delete products[i];
+}
+
+void test_cvol()
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(TESTDIR"/CARTESIAN-PVOL-ODIMH5V21.h5"));
+
+	CartesianGrid grid = CartesianGrid::centeredOn(volume->getLatitude(), volume->getLongitude(), 240, 240, 1000., 1000.);
+	double ground = sqrt(30500. * 30500. + 500. * 500.);
+	double h0 = beam_height(0.5, ground);
+	double h1 = beam_height(5., ground);
+	std::vector<double> heights;
+	heights.push_back(h0 + 100.);
+	heights.push_back((h0 + h1) * 0.5);
+	heights.push_back(h1 + 100.);
+	heights.push_back(10000.);
+
+	CvolGenerator linear(grid, heights, 4);
+	linear.setRowsPerBlock(7);
+	std::vector<DataMatrix<float> > levels;
+	linear.compute(*volume, PRODUCT_QUANTITY_DBZH, levels);
+	assert(levels.size() == 4);
+	assert(levels[0].getRowCount() == 240 && levels[0].getColCount() == 240);
+
+	/* 30.5 km north both scans use bin 30: 5 dBZ below, 10 dBZ above */
+	assert(fabs(levels[0].elem(89, 120) - (5. + 5. * 100. / (h1 - h0))) < 1e-3);
+	assert(fabs(levels[1].elem(89, 120) - 7.5) < 1e-3);
+	/* above the highest beam within half beam width, then nothing */
+	assert(levels[2].elem(89, 120) == 10.f);
+	assert(std::isnan(levels[3].elem(89, 120)));
+	/* close to the radar the level is far above both beams, outside the range there is no data */
+	assert(std::isnan(levels[0].elem(119, 120)));
+	assert(std::isnan(levels[0].elem(0, 0)));
+
+	/* nearest takes a single beam and only within half beam width */
+	CvolGenerator nearest(grid, heights, 1);
+	nearest.setInterpolation(VERTICAL_NEAREST);
+	std::vector<DataMatrix<float> > near;
+	nearest.compute(*volume, PRODUCT_QUANTITY_DBZH, near);
+	assert(near[0].elem(89, 120) == 5.f);
+	assert(std::isnan(near[1].elem(89, 120)));
+	assert(near[2].elem(89, 120) == 10.f);
+
+	/* tables are cached per geometry, levels and interpolation */
+	CvolGenerator::CvolTablePtr table = linear.getCvolTable(*volume, PRODUCT_QUANTITY_DBZH);
+	assert(table->getLevelCount() == 4);
+	CvolGenerator other(grid, heights, 1);
+	assert(other.getCvolTable(*volume, PRODUCT_QUANTITY_DBZH) == table);
+	assert(nearest.getCvolTable(*volume, PRODUCT_QUANTITY_DBZH) != table);
+
+	/* write a level per dataset and read it back */
+	{
+		std::unique_ptr<CvolObject> cvol(factory.createCvolObject(TESTDIR"/CARTESIAN-CVOL-ODIMH5V21.h5"));
+		linear.generate(*cvol, *volume, PRODUCT_QUANTITY_DBZH, Encoding(RAW_UINT8, 0.5, -10., 255., 0.));
+	}
+	std::unique_ptr<OdimObject> object(factory.open(TESTDIR"/CARTESIAN-CVOL-ODIMH5V21.h5"));
+	assert(object->getObject() == OBJECT_CVOL);
+	CvolObject* cvol = dynamic_cast<CvolObject*>(object.get());
+	assert(cvol != NULL);
+	assert(cvol->getXSize() == 240);
+	assert(cvol->getProductCount() == 4);
+	std::unique_ptr<Product_2D> level(cvol->getProduct(1));
+	assert(level->getProduct() == PRODUCT_CAPPI);
+	assert(level->getProdPar() == heights[1]);
+	std::unique_ptr<Product_2D_Data> data(level->getQuantityData(PRODUCT_QUANTITY_DBZH));
+	DataMatrix<unsigned char> raw(240, 240);
+	data->readData(&raw.elem(0, 0));
+	assert(raw.elem(89, 120) == 35);
+	assert(raw.elem(0, 0) == 255);
+}
+
+int main()
+{
+	create_volume();
+	test_projection();
+	test_generator();
+	test_azimuths();
+	test_columns();
+	test_cvol();
+	return 0;
+}
@@ -0,0 +1,180 @@
+#include <radarlib/radar.hpp>
+#include "test-volume.hpp"
+#include <assert.h>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+#define NUMRAYS 36
+#define NUMBINS 20
+#define VOLUMES 7
+
+static const time_t T0 = Radar::timeutils::mktime(2000,1,2,3,0,0);
+
+static std::string volume_path(int i)
+{
+	char buff[64];
+	snprintf(buff, sizeof(buff), "/CLUTTER-PVOL-%02d-ODIMH5V21.h5", i);
+	return std::string(TESTDIR) + buff;
+}
+
+/* dBZ of a gate in volume v: clutter (43) below bin v, exactly the threshold (20) at bin v, undetect above */
+static double gate_dbz(int v, int b)
+{
+	return b < v ? 43. : b == v ? 20. : -100.;
+}
+
+/*
+ * Scan 0 is 8 bit with ray 5 always nodata, scan 1 is stored as float values
+ * with a slightly different elevation in volume 3, volume 4 has its second
+ * scan at another elevation and volume 5 has no second scan.
+ */
+static void create_volume(int v)
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.createPolarVolume(volume_path(v)));
+	set_test_radar(*volume);
+	volume->setDateTime(T0 + v * 300);
+
+	for (int s=0; s<2; s++)
+	{
+		if (s == 1 && v == 5)
+			break;
+		std::unique_ptr<PolarScan> scan(volume->createScan());
+		scan->setEAngle(s == 0 ? 0.5 : v == 3 ? 1.52 : v == 4 ? 3.0 : 1.5);
+		scan->setA1Gate(0);
+		scan->setNumBins(NUMBINS);
+		scan->setNumRays(NUMRAYS);
+		scan->setRangeStart(0);
+		scan->setRangeScale(1000);
+
+		std::unique_ptr<PolarScanData> data(scan->createQuantityData(PRODUCT_QUANTITY_DBZH));
+		if (s == 0)
+		{
+			data->setNodata(255.);
+			data->setUndetect(0.);
+			data->setOffset(-32.);
+			data->setGain(0.5);
+			RayMatrix<unsigned char> matrix(NUMRAYS, NUMBINS);
+			for (int r=0; r<NUMRAYS; r++)
+				for (int b=0; b<NUMBINS; b++)
+				{
+					double dbz = gate_dbz(v, b);
+					matrix.elem(r, b) = r == 5 ? 255 : dbz < -32. ? 0 : (unsigned char)((dbz + 32.) / 0.5);
+				}
+			data->writeData(matrix);
+		}
+		else
+		{
+			data->setNodata(-9999.);
+			data->setUndetect(-8888.);
+			data->setOffset(0.);
+			data->setGain(1.);
+			RayMatrix<float> matrix(NUMRAYS, NUMBINS);
+			for (int r=0; r<NUMRAYS; r++)
+				for (int b=0; b<NUMBINS; b++)
+				{
+					double dbz = gate_dbz(v, b);
+					matrix.elem(r, b) = dbz < -32. ? -8888.f : (float)dbz;
+				}
+			data->writeData(matrix);
+		}
+	}
+}
+
+/* number of volumes among the given ones where bin b is clutter */
+static int expected_hits(int b, int v0, int v1, int skip1 = -1, int skip2 = -1)
+{
+	int n = 0;
+	for (int v=v0; v<v1; v++)
+		if (v != skip1 && v != skip2 && b < v)
+			n++;
+	return n;
+}
+
+void test_builder()
+{
+	std::vector<std::string> paths;
+	for (int v=0; v<VOLUMES; v++)
+		paths.push_back(volume_path(v));
+	paths.push_back(TESTDIR"/CLUTTER-MISSING-ODIMH5V21.h5");
+
+	ClutterMapBuilder builder(20., PRODUCT_QUANTITY_DBZH, 3);
+	assert(builder.addFiles(paths) == VOLUMES);
+	assert(builder.getVolumeCount() == VOLUMES);
+	assert(builder.getFailedFiles().size() == 1);
+	assert(builder.getFailedFiles()[0] == paths.back());
+	assert(builder.getStartDateTime() == T0);
+	assert(builder.getEndDateTime() == T0 + (VOLUMES - 1) * 300);
+
+	assert(builder.getScanCount() == 2);
+	assert(builder.getScan(0).elangle == 0.5 && builder.getScan(0).volumes == VOLUMES);
+	assert(builder.getScan(1).elangle == 1.5 && builder.getScan(1).volumes == VOLUMES - 2);
+	assert(builder.getScan(1).nrays == NUMRAYS && builder.getScan(1).nbins == NUMBINS);
+
+	RayMatrix<float> f0, f1;
+	builder.getFrequency(0, f0);
+	builder.getFrequency(1, f1);
+	assert(f0.getRowCount() == NUMRAYS && f0.getColCount() == NUMBINS);
+	for (int b=0; b<NUMBINS; b++)
+	{
+		assert(std::isnan(f0.elem(5, b)));
+		assert(fabs(f0.elem(0, b) - expected_hits(b, 0, VOLUMES) / (double)VOLUMES) < 1e-6);
+		assert(fabs(f1.elem(7, b) - expected_hits(b, 0, VOLUMES, 4, 5) / (double)(VOLUMES - 2)) < 1e-6);
+	}
+
+	/* one thread, one volume at a time, gives the same map */
+	ClutterMapBuilder single(20.);
+	single.setThreads(1);
+	for (int v=0; v<VOLUMES; v++)
+		single.addFile(volume_path(v));
+	RayMatrix<float> g0;
+	single.getFrequency(0, g0);
+	for (int r=0; r<NUMRAYS; r++)
+		for (int b=0; b<NUMBINS; b++)
+			assert(r == 5 || g0.elem(r, b) == f0.elem(r, b));
+
+	/* more volumes after a merge keep counting */
+	single.addFile(volume_path(VOLUMES - 1));
+	single.getFrequency(0, g0);
+	assert(fabs(g0.elem(0, 0) - (VOLUMES) / (double)(VOLUMES + 1)) < 1e-6);
+
+	/* write and read back */
+	OdimFactory factory;
+	{
+		std::unique_ptr<PolarVolume> volume(factory.createPolarVolume(TESTDIR"/CLUTTER-ODIMH5V21.h5"));
+		builder.write(*volume);
+	}
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(TESTDIR"/CLUTTER-ODIMH5V21.h5"));
+	assert(volume->getDateTime() == T0 + (VOLUMES - 1) * 300);
+	assert(volume->getSource().OperaRadarSite == "rad");
+	assert(volume->getScanCount() == 2);
+	std::unique_ptr<PolarScan> scan(volume->getScan(1));
+	assert(scan->getEAngle() == 1.5);
+	assert(scan->getStartDateTime() == T0);
+	std::unique_ptr<PolarScanData> data(scan->getQuantityData(PRODUCT_QUANTITY_CMAP));
+	assert(data.get() != NULL);
+	RayMatrix<unsigned char> raw(NUMRAYS, NUMBINS);
+	data->readData(&raw.elem(0, 0));
+	for (int b=0; b<NUMBINS; b++)
+		assert(raw.elem(0, b) == (unsigned char)floor(f1.elem(0, b) / 0.004 + 0.5));
+
+	builder.clear();
+	assert(builder.getScanCount() == 0 && builder.getVolumeCount() == 0);
+	try {
+		builder.write(*volume);
+		assert(false);
+	} catch (OdimH5Exception&) {
+	}
+}
+
+int main()
+{
+	for (int v=0; v<VOLUMES; v++)
+		create_volume(v);
+	test_builder();
+	return 0;
+}
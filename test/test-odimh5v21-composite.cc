@@ -0,0 +1,186 @@
+#include <radarlib/radar.hpp>
+#include <assert.h>
+#include <cmath>
+#include <memory>
+
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+#define NUMRAYS 360
+#define NUMBINS 100
+
+/* one scan with the same value in every gate but the first bin, which is undetect */
+void create_volume(const char* path, const char* site, double lon, unsigned char value, int qind, int second)
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.createPolarVolume(path));
+	volume->setDateTime(Radar::timeutils::mktime(2000,1,2,3,4,0));
+	SourceInfo source;
+	source.setOperaRadarNode(site);
+	volume->setSource(source);
+	volume->setLongitude(lon);
+	volume->setLatitude(44.);
+	volume->setAltitude(0.);
+
+	std::unique_ptr<PolarScan> scan(volume->createScan());
+	scan->setStartDateTime(Radar::timeutils::mktime(2000,1,2,3,4,second));
+	scan->setEndDateTime(Radar::timeutils::mktime(2000,1,2,3,5,second));
+	scan->setEAngle(0.5);
+	scan->setA1Gate(0);
+	scan->setNumBins(NUMBINS);
+	scan->setNumRays(NUMRAYS);
+	scan->setRangeStart(0);
+	scan->setRangeScale(1000);
+
+	RayMatrix<unsigned char> matrix(NUMRAYS, NUMBINS);
+	std::unique_ptr<PolarScanData> data(scan->createQuantityData(PRODUCT_QUANTITY_DBZH));
+	data->setNodata(255.);
+	data->setUndetect(0.);
+	data->setOffset(-32.);
+	data->setGain(0.5);
+	for (int r=0; r<NUMRAYS; r++)
+		for (int b=0; b<NUMBINS; b++)
+			matrix.elem(r,b) = b == 0 ? 0 : value;
+	data->writeData(matrix);
+
+	if (qind < 0)
+		return;
+	std::unique_ptr<PolarScanData> quality(scan->createQuantityData(PRODUCT_QUANTITY_QIND));
+	quality->setNodata(255.);
+	quality->setUndetect(254.);
+	quality->setOffset(0.);
+	quality->setGain(0.01);
+	for (int r=0; r<NUMRAYS; r++)
+		for (int b=0; b<NUMBINS; b++)
+			matrix.elem(r,b) = qind;
+	quality->writeData(matrix);
+}
+
+/* value of the pixel that contains the given point */
+float at(const CartesianGrid& grid, const DataMatrix<float>& m, double lat, double lon)
+{
+	Projection proj(grid.projdef);
+	double x, y;
+	proj.forward(lat, lon, x, y);
+	int col = (int)floor((x - grid.ulx) / grid.xscale);
+	int row = (int)floor((grid.uly - y) / grid.yscale);
+	assert(row >= 0 && col >= 0 && row < grid.ysize && col < grid.xsize);
+	return m.get()[(size_t)row * grid.xsize + col];
+}
+
+bool same(const DataMatrix<float>& a, const DataMatrix<float>& b)
+{
+	for (int r=0; r<a.getRowCount(); r++)
+		for (int c=0; c<a.getColCount(); c++)
+		{
+			float x = a.get()[(size_t)r * a.getColCount() + c];
+			float y = b.get()[(size_t)r * b.getColCount() + c];
+			if (x != y && !(std::isnan(x) && std::isnan(y)))
+				return false;
+		}
+	return true;
+}
+
+void test_volumes()
+{
+	OdimFactory factory;
+	/* radar A at 11.0E with 10 dBZ, radar B 56 km east with 30 dBZ and quality 0.2 */
+	std::unique_ptr<PolarVolume> a(factory.openPolarVolume(TESTDIR"/COMPOSITE-A-PVOL-ODIMH5V21.h5"));
+	std::unique_ptr<PolarVolume> b(factory.openPolarVolume(TESTDIR"/COMPOSITE-B-PVOL-ODIMH5V21.h5"));
+	CartesianGrid grid = CartesianGrid::centeredOn(44., 11.35, 300, 300, 1000., 1000.);
+
+	Compositor comp(grid, COMPOSITE_MAXIMUM, 4);
+	comp.setTileSize(7);
+	comp.setDefaultQuality(0.5);
+	assert(comp.addVolume(*a, PRODUCT_PPI, 0.5, PRODUCT_QUANTITY_DBZH));
+	assert(comp.addVolume(*b, PRODUCT_PPI, 0.5, PRODUCT_QUANTITY_DBZH));
+	assert(comp.getInputCount() == 2);
+	assert(comp.getNodes()[1].get() == "'radb'");
+
+	DataMatrix<float> max, quality;
+	comp.compute(max, quality);
+	assert(at(grid, max, 44., 10.2) == 10.f);	/* only A */
+	assert(at(grid, max, 44., 11.0) == 30.f);	/* undetect of A, echo of B */
+	assert(at(grid, max, 44., 11.2) == 30.f);
+	assert(at(grid, max, 44., 12.5) == 30.f);	/* only B */
+	assert(std::isnan(at(grid, max, 45.2, 11.35)));	/* no radar */
+	assert(fabs(at(grid, quality, 44., 11.2) - 0.2) < 1e-6);
+	assert(at(grid, quality, 44., 10.2) == 0.5f);
+
+	DataMatrix<float> single;
+	comp.setThreads(1);
+	comp.setTileSize(300);
+	comp.compute(single);
+	assert(same(single, max));
+
+	DataMatrix<float> nearest;
+	comp.setRule(COMPOSITE_NEAREST);
+	comp.compute(nearest);
+	assert(at(grid, nearest, 44., 11.0) == UNDETECT);
+	assert(at(grid, nearest, 44., 11.2) == 10.f);
+	assert(at(grid, nearest, 44., 11.5) == 30.f);
+	assert(at(grid, nearest, 44., 12.5) == 30.f);
+
+	DataMatrix<float> best;
+	comp.setRule(COMPOSITE_QUALITY);
+	comp.compute(best);
+	assert(at(grid, best, 44., 11.5) == 10.f);
+	assert(at(grid, best, 44., 12.5) == 30.f);
+
+	/* write the composite */
+	std::unique_ptr<CompObject> object(factory.createCompObject(TESTDIR"/COMPOSITE-COMP-ODIMH5V21.h5"));
+	std::unique_ptr<Product_COMP> product(comp.generate(*object, PRODUCT_QUANTITY_DBZH, Encoding(RAW_UINT8, 0.5, -32., 255., 0.)));
+	assert(object->getXSize() == 300);
+	assert(object->getDateTime() == Radar::timeutils::mktime(2000,1,2,3,4,0));
+	assert(product->getStartDateTime() == Radar::timeutils::mktime(2000,1,2,3,4,10));
+	assert(product->getEndDateTime() == Radar::timeutils::mktime(2000,1,2,3,5,20));
+	assert(product->getACCnum() == 2);
+	assert(object->getSource().Comment == "composite of 2 radars");
+	assert(product->getNodes().size() == 2);
+	assert(product->getNodes()[0].get() == "'rada'");
+	assert(product->getCAMethod() == "QMAXIMUM");
+	assert(product->hasQuantityData(PRODUCT_QUANTITY_QIND));
+}
+
+void test_images()
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> a(factory.openPolarVolume(TESTDIR"/COMPOSITE-A-PVOL-ODIMH5V21.h5"));
+	std::unique_ptr<PolarVolume> b(factory.openPolarVolume(TESTDIR"/COMPOSITE-B-PVOL-ODIMH5V21.h5"));
+
+	/* single radar image of A on its own grid */
+	{
+		CartesianGenerator generator(CartesianGrid::centeredOn(44., 11., 200, 200, 1000., 1000.), 2);
+		std::unique_ptr<ImageObject> image(factory.createImageObject(TESTDIR"/COMPOSITE-A-PPI-ODIMH5V21.h5"));
+		std::unique_ptr<Horizontal_Product_2D> ppi(generator.generate(*image, *a, PRODUCT_PPI, 0.5, PRODUCT_QUANTITY_DBZH, Encoding(RAW_UINT8, 0.5, -32., 255., 0.)));
+	}
+	std::unique_ptr<ImageObject> image(factory.openImageObject(TESTDIR"/COMPOSITE-A-PPI-ODIMH5V21.h5"));
+
+	CartesianGrid grid = CartesianGrid::centeredOn(44., 11.35, 300, 300, 2000., 2000.);
+	Compositor comp(grid, COMPOSITE_MAXIMUM, 3);
+	assert(comp.addImage(*image, 0, PRODUCT_QUANTITY_DBZH));
+	assert(comp.addVolume(*b, PRODUCT_PPI, 0.5, PRODUCT_QUANTITY_DBZH));
+	assert(comp.getNodes()[0].get() == "'rada'");
+
+	DataMatrix<float> max;
+	comp.compute(max);
+	assert(at(grid, max, 44., 10.2) == 10.f);
+	assert(at(grid, max, 44., 11.2) == 30.f);
+	assert(at(grid, max, 44., 12.5) == 30.f);
+	assert(std::isnan(at(grid, max, 45.2, 11.35)));
+
+	/* inputs outside the grid are ignored */
+	Compositor far(CartesianGrid::centeredOn(60., 11., 100, 100, 1000., 1000.));
+	assert(!far.addImage(*image, 0, PRODUCT_QUANTITY_DBZH));
+	assert(!far.addVolume(*b, PRODUCT_PPI, 0.5, PRODUCT_QUANTITY_DBZH));
+	assert(far.getInputCount() == 0);
+}
+
+int main()
+{
+	create_volume(TESTDIR"/COMPOSITE-A-PVOL-ODIMH5V21.h5", "rada", 11.0, 84, -1, 10);
+	create_volume(TESTDIR"/COMPOSITE-B-PVOL-ODIMH5V21.h5", "radb", 11.7, 124, 20, 20);
+	test_volumes();
+	test_images();
+	return 0;
+}
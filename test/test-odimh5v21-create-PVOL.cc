@@ -120,6 +120,16 @@ bool test_creazione_Pvol ()
 					elangles.push_back(i);
 			scan->setElevationAngles(elangles);
 
+			std::vector<double> startazT, stopazT, txpower;
+			for (int i=0; i<NUMRAYS; i++) {
+					startazT.push_back(946782245. + i * 0.05);
+					stopazT.push_back(946782245. + (i + 1) * 0.05);
+					txpower.push_back(250. + i);
+			}
+			scan->setStartAzimuthTimes(startazT);
+			scan->setStopAzimuthTimes(stopazT);
+			scan->setTXPower(txpower);
+
 			/* creiamo un gruppo per ogni quantita' standard */
 			for (std::set<std::string>::iterator i=quantities.begin(); i!=quantities.end(); i++)			
 			{
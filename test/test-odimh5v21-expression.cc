@@ -0,0 +1,194 @@
+#include <radarlib/radar.hpp>
+#include "test-volume.hpp"
+#include <assert.h>
+#include <cmath>
+#include <memory>
+
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+#define NUMRAYS 36
+#define NUMBINS 50
+
+/* decoded values of the test scan: ray 3 of DBZH is nodata, bin 0 of DBZH and DBZV is undetect */
+static float dbzh(int r, int b)	{ return r == 3 ? NODATA : b == 0 ? UNDETECT : (b + r) * 0.5f - 10.f; }
+static float dbzv(int r, int b)	{ return b == 0 ? UNDETECT : (b + r) * 0.5f - 11.f; }
+static float rhohv(int r, int b)	{ return (r * NUMBINS + b) % 100 / 100.f; }
+static float vrad(int r, int b)	{ return (b - 25) * 0.5f; }
+
+static void write_quantity(PolarScan& scan, const char* quantity, float (*value)(int, int), const Encoding& encoding)
+{
+	RayMatrix<float> values(NUMRAYS, NUMBINS);
+	for (int r=0; r<NUMRAYS; r++)
+		for (int b=0; b<NUMBINS; b++)
+			values.elem(r, b) = value(r, b);
+	std::vector<char> raw(NUMRAYS * NUMBINS * getRawSize(encoding.rawtype));
+	encoding.encode(&values.elem(0, 0), NUMRAYS * NUMBINS, &raw[0]);
+	std::unique_ptr<PolarScanData> data(scan.createQuantityData(quantity));
+	encoding.writeTo(*data);
+	data->writeData(&raw[0], NUMBINS, NUMRAYS, encoding.rawtype);
+}
+
+void create_volume()
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.createPolarVolume(TESTDIR"/EXPRESSION-PVOL-ODIMH5V21.h5"));
+	set_test_radar(*volume);
+
+	std::unique_ptr<PolarScan> scan(volume->createScan());
+	scan->setEAngle(0.5);
+	scan->setA1Gate(0);
+	scan->setNumBins(NUMBINS);
+	scan->setNumRays(NUMRAYS);
+	scan->setRangeStart(0);
+	scan->setRangeScale(1000);
+	write_quantity(*scan, PRODUCT_QUANTITY_DBZH, dbzh, Encoding(RAW_UINT8, 0.5, -32., 255., 0.));
+	write_quantity(*scan, PRODUCT_QUANTITY_DBZV, dbzv, Encoding(RAW_UINT8, 0.5, -32., 255., 0.));
+	write_quantity(*scan, PRODUCT_QUANTITY_RHOHV, rhohv, Encoding(RAW_UINT16, 0.01, 0., 65535., 65534.));
+	write_quantity(*scan, PRODUCT_QUANTITY_VRAD, vrad, Encoding(RAW_FLOAT, 1., 0., -9999., -9998.));
+}
+
+void test_parser()
+{
+	Expression expr("DBZH > 5 && RHOHV > 0.85 && abs(VRAD) > 1");
+	assert(expr.getQuantities().size() == 3);
+	assert(expr.getQuantities()[0] == "DBZH" && expr.getQuantities()[2] == "VRAD");
+	assert(Expression("DBZH - DBZV + DBZH").getQuantities().size() == 2);
+
+	const char* wrong[] = { "DBZH >", "(DBZH", "foo(DBZH)", "DBZH $ 3", "pow(DBZH)", "", "DBZH ? 1" };
+	for (int i=0; i<7; i++)
+	{
+		try {
+			Expression e(wrong[i]);
+			assert(false);
+		} catch (std::invalid_argument&) {
+		}
+	}
+
+	/* deep nesting is a parse error, not a stack overflow */
+	std::string deep = std::string(100, '(') + "DBZH" + std::string(100, ')');
+	assert(Expression(deep).getQuantities().size() == 1);
+	try {
+		Expression e(std::string(100000, '(') + "DBZH" + std::string(100000, ')'));
+		assert(false);
+	} catch (std::invalid_argument&) {
+	}
+	try {
+		Expression e(std::string(100000, '!') + "DBZH");
+		assert(false);
+	} catch (std::invalid_argument&) {
+	}
+}
+
+void test_values()
+{
+	float a[6] = { 1.f, 2.f, -3.f, NODATA, UNDETECT, 9.f };
+	float b[6] = { 2.f, 2.f, 4.f, 1.f, 1.f, 0.f };
+	std::vector<const float*> values;
+	values.push_back(a);
+	values.push_back(b);
+	float out[6];
+
+	Expression("a * 2 + b / 2 - -1", 2).evaluate(values, 6, out);
+	assert(out[0] == 4.f && out[1] == 6.f && out[2] == -3.f);
+	assert(std::isnan(out[3]) && out[4] == UNDETECT && out[5] == 19.f);
+
+	Expression("a >= b || a == 9", 2).evaluate(values, 6, out);
+	assert(out[0] == 0.f && out[1] == 1.f && out[2] == 0.f && out[3] == 0.f && out[4] == 0.f && out[5] == 1.f);
+
+	Expression("a < b ? min(a, b) : pow(a, 2)").evaluate(values, 6, out);
+	assert(out[0] == 1.f && out[1] == 4.f && out[2] == -3.f && std::isnan(out[3]));
+	assert(out[4] == UNDETECT && out[5] == 81.f);
+
+	Expression("valid(a) + 2 * nodata(a) + 4 * undetect(a) + !b").evaluate(values, 6, out);
+	assert(out[0] == 1.f && out[3] == 2.f && out[4] == 4.f && out[5] == 2.f);
+
+	std::vector<const float*> one(1, a);
+	Expression("!a").evaluate(one, 6, out);
+	assert(out[0] == 0.f && std::isnan(out[3]) && out[4] == 0.f && out[5] == 0.f);
+
+	try {
+		Expression("a + b").evaluate(one, 6, out);
+		assert(false);
+	} catch (std::invalid_argument&) {
+	}
+}
+
+void test_scan()
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(TESTDIR"/EXPRESSION-PVOL-ODIMH5V21.h5", H5F_ACC_RDWR));
+	std::unique_ptr<PolarScan> scan(volume->getScan(0));
+
+	Expression filter("DBZH > 5 && RHOHV > 0.845 && abs(VRAD) > 1", 3);
+	filter.setBlockSize(100);
+	RayMatrix<unsigned char> mask;
+	filter.mask(*scan, mask);
+	assert(mask.getRowCount() == NUMRAYS && mask.getColCount() == NUMBINS);
+	int count = 0;
+	for (int r=0; r<NUMRAYS; r++)
+		for (int b=0; b<NUMBINS; b++)
+		{
+			bool expected = r != 3 && b != 0 && dbzh(r, b) > 5 && rhohv(r, b) > 0.845f && fabs(vrad(r, b)) > 1;
+			assert(mask.elem(r, b) == (expected ? 1 : 0));
+			count += expected;
+		}
+	assert(count > 0);
+
+	Expression zdr("DBZH - DBZV", 2);
+	RayMatrix<float> values;
+	zdr.evaluate(*scan, values);
+	assert(std::isnan(values.elem(3, 10)));
+	assert(values.elem(5, 0) == UNDETECT);
+	assert(fabs(values.elem(5, 10) - 1.) < 1e-5);
+
+	std::unique_ptr<PolarScanData> data(zdr.derive(*scan, PRODUCT_QUANTITY_ZDR, Encoding(RAW_UINT8, 0.1, -5., 255., 0.)));
+	assert(data->getQuantity() == PRODUCT_QUANTITY_ZDR);
+	RayMatrix<unsigned char> raw(NUMRAYS, NUMBINS);
+	data->readData(&raw.elem(0, 0));
+	assert(raw.elem(3, 10) == 255 && raw.elem(5, 0) == 0 && raw.elem(5, 10) == 60);
+
+	try {
+		RayMatrix<float> missing;
+		Expression("KDP * 2").evaluate(*scan, missing);
+		assert(false);
+	} catch (OdimH5Exception&) {
+	}
+}
+
+void test_product()
+{
+	OdimFactory factory;
+	std::unique_ptr<ImageObject> image(factory.createImageObject(TESTDIR"/EXPRESSION-IMAGE-ODIMH5V21.h5"));
+	std::unique_ptr<Product_CAPPI> cappi(image->createProductCAPPI());
+	DataMatrix<float> values(10, 20);
+	for (int r=0; r<10; r++)
+		for (int c=0; c<20; c++)
+			values.elem(r, c) = r == 0 ? NODATA : c == 0 ? UNDETECT : c * 2.5f;
+	{
+		std::unique_ptr<Product_2D_Data> data(cappi->createQuantityData(PRODUCT_QUANTITY_DBZH));
+		Encoding(RAW_UINT8, 0.5, -32., 255., 0.).write(values, *data);
+	}
+
+	DataMatrix<unsigned char> mask;
+	Expression("DBZH >= 20", 2).mask(*cappi, mask);
+	assert(mask.elem(0, 19) == 0 && mask.elem(1, 7) == 0 && mask.elem(1, 8) == 1);
+
+	std::unique_ptr<Product_2D_Data> rate(Expression("pow(pow(10, DBZH / 10) / 200, 1 / 1.6)").derive(*cappi, PRODUCT_QUANTITY_RATE,
+								 Encoding(RAW_FLOAT, 1., 0., -1., -2.)));
+	DataMatrix<float> raw(10, 20);
+	rate->readData(&raw.elem(0, 0));
+	assert(raw.elem(0, 3) == -1.f);
+	assert(raw.elem(3, 0) == -2.f);
+	assert(fabs(raw.elem(3, 8) - RainRateLaw().rate(20.f)) < 1e-4);
+}
+
+int main()
+{
+	create_volume();
+	test_parser();
+	test_values();
+	test_scan();
+	test_product();
+	return 0;
+}
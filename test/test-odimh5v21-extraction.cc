@@ -0,0 +1,315 @@
+#include <radarlib/radar.hpp>
+#include <assert.h>
+#include <cmath>
+#include <memory>
+#include <sstream>
+
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+#define NUMRAYS 360
+#define NUMBINS 100
+#define SITE_LAT 44.5
+#define SITE_LON 11.5
+
+static const time_t T0 = Radar::timeutils::mktime(2000,1,2,3,4,0);
+
+/* latitude and longitude at the given azimuth and ground distance (m) from the radar */
+static void polar_point(double azimuth, double ground, double& lat, double& lon)
+{
+	geometry::PolarGeometry::computeRadial(SITE_LAT, SITE_LON, azimuth, &ground, 1, &lat, &lon);
+}
+
+/* ground distance of the centre of a bin of the scan at 0.5 degrees */
+static double bin_ground(int bin)
+{
+	double ground[NUMBINS];
+	geometry::PolarGeometry::computeBins(0.5, 0., 1000., NUMBINS, NULL, ground, NULL);
+	return ground[bin];
+}
+
+/* raw DBZH is the ray number modulo 100 plus one, ray 200 is nodata and bin 0 undetect */
+static double ray_dbz(int ray)
+{
+	return (ray % 100 + 1) * 0.5 - 32.;
+}
+
+void create_volume()
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.createPolarVolume(TESTDIR"/EXTRACT-PVOL-ODIMH5V21.h5"));
+	volume->setDateTime(T0);
+	SourceInfo source;
+	source.setOperaRadarSite("rad");
+	volume->setSource(source);
+	volume->setLongitude(SITE_LON);
+	volume->setLatitude(SITE_LAT);
+	volume->setAltitude(0.);
+
+	for (int s=0; s<2; s++)
+	{
+		std::unique_ptr<PolarScan> scan(volume->createScan());
+		scan->setEAngle(0.5 + s);
+		scan->setA1Gate(0);
+		scan->setNumBins(NUMBINS);
+		scan->setNumRays(NUMRAYS);
+		scan->setRangeStart(0);
+		scan->setRangeScale(1000);
+
+		std::unique_ptr<PolarScanData> data(scan->createQuantityData(PRODUCT_QUANTITY_DBZH));
+		data->setNodata(255.);
+		data->setUndetect(0.);
+		data->setOffset(-32.);
+		data->setGain(0.5);
+		RayMatrix<unsigned char> matrix(NUMRAYS, NUMBINS);
+		for (int r=0; r<NUMRAYS; r++)
+			for (int b=0; b<NUMBINS; b++)
+				matrix.elem(r, b) = r == 200 ? 255 : b == 0 ? 0 : r % 100 + 1;
+		data->writeData(matrix);
+	}
+}
+
+static CartesianGrid image_grid()
+{
+	return CartesianGrid::centeredOn(SITE_LAT, SITE_LON, 50, 40, 2000., 2000.);
+}
+
+/* RATE is the column number, row 0 is nodata */
+void create_image()
+{
+	OdimFactory factory;
+	std::unique_ptr<ImageObject> image(factory.createImageObject(TESTDIR"/EXTRACT-IMAGE-ODIMH5V21.h5"));
+	image->setDateTime(T0 + 300);
+	SourceInfo source;
+	source.setOperaRadarSite("rad");
+	image->setSource(source);
+	CartesianGrid grid = image_grid();
+	grid.writeTo(*image);
+	std::unique_ptr<Product_CAPPI> cappi(image->createProductCAPPI());
+	grid.writeTo(*cappi);
+	DataMatrix<float> values(grid.ysize, grid.xsize);
+	for (int r=0; r<grid.ysize; r++)
+		for (int c=0; c<grid.xsize; c++)
+			values.elem(r, c) = r == 0 ? NODATA : (float)c;
+	std::unique_ptr<Product_2D_Data> data(cappi->createQuantityData(PRODUCT_QUANTITY_DBZH));
+	Encoding(RAW_UINT16, 0.01, 0., 65535., 0.).write(values, *data);
+}
+
+/* annular sector between two azimuths and two ground distances */
+static ExtractionPolygon sector(const std::string& name, double az1, double az2, double ground1, double ground2)
+{
+	ExtractionPolygon polygon;
+	polygon.name = name;
+	for (int i=0; i<=10; i++)
+	{
+		double lat, lon;
+		polar_point(az1 + (az2 - az1) * i / 10., ground1, lat, lon);
+		polygon.lats.push_back(lat);
+		polygon.lons.push_back(lon);
+	}
+	for (int i=10; i>=0; i--)
+	{
+		double lat, lon;
+		polar_point(az1 + (az2 - az1) * i / 10., ground2, lat, lon);
+		polygon.lats.push_back(lat);
+		polygon.lons.push_back(lon);
+	}
+	return polygon;
+}
+
+static Extractor* polar_extractor()
+{
+	std::vector<ExtractionPoint> points(2);
+	points[0].name = "gauge";
+	polar_point(45.5, bin_ground(29), points[0].lat, points[0].lon);
+	points[1].name = "far";
+	polar_point(10., 500000., points[1].lat, points[1].lon);
+	std::vector<ExtractionPolygon> polygons;
+	polygons.push_back(sector("basin", 80., 100., 20000., 40000.));
+	polygons.push_back(sector("blocked", 195., 205., 20000., 40000.));
+	return new Extractor(points, polygons, 3);
+}
+
+void test_volume()
+{
+	std::unique_ptr<Extractor> extractor(polar_extractor());
+	extractor->setTargetsPerBlock(1);
+	assert(extractor->getTargetCount() == 4);
+	assert(extractor->getTargetName(2) == "basin");
+
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(TESTDIR"/EXTRACT-PVOL-ODIMH5V21.h5"));
+	std::unique_ptr<PolarScan> scan(volume->getScan(0));
+	Extractor::IndexPtr index = extractor->getIndex(*volume, *scan);
+	assert(index->getTargetCount() == 4);
+	/* the point is the centre of gate (45, 29), the far point is outside */
+	assert(index->getFirst()[1] - index->getFirst()[0] == 1);
+	assert(index->getCells()[0] == 45 * NUMBINS + 29);
+	assert(index->getFirst()[2] == index->getFirst()[1]);
+	/* the basin has the gates of rays 80-99 between 20 and 40 km */
+	size_t gates = index->getFirst()[3] - index->getFirst()[2];
+	assert(gates >= 18 * 19 && gates <= 21 * 21);
+	double total = 0;
+	for (size_t e = index->getFirst()[2]; e < index->getFirst()[3]; e++)
+	{
+		int ray = index->getCells()[e] / NUMBINS;
+		assert(ray >= 80 && ray < 100);
+		total += index->getWeights()[e];
+	}
+	assert(fabs(total - 1.) < 1e-5);
+
+	ExtractionTable table;
+	assert(extractor->extract(*volume, PRODUCT_QUANTITY_DBZH, table) == 2);
+	assert(table.targets.size() == 4);
+	assert(table.rows.size() == 8);
+	const ExtractionRow& gauge = table.rows[0];
+	assert(gauge.file == -1 && gauge.time == T0 && gauge.target == 0 && gauge.dataset == 0);
+	assert(gauge.elangle == 0.5);
+	assert(fabs(gauge.value - ray_dbz(45)) < 1e-5 && gauge.coverage == 1.f);
+	assert(std::isnan(table.rows[1].value) && table.rows[1].coverage == 0.f);
+	const ExtractionRow& basin = table.rows[2];
+	assert(basin.value > ray_dbz(80) && basin.value < ray_dbz(99));
+	assert(fabs(basin.coverage - 1.) < 1e-5);
+	/* ray 200 of the ten is nodata */
+	const ExtractionRow& blocked = table.rows[3];
+	assert(blocked.coverage > 0.85 && blocked.coverage < 0.95);
+	assert(blocked.value > ray_dbz(201) && blocked.value < ray_dbz(199));
+	assert(table.rows[4].dataset == 1 && table.rows[4].elangle == 1.5);
+
+	/* the second volume reuses the indexes */
+	size_t misses = extractor->getIndexMisses();
+	extractor->extract(*volume, PRODUCT_QUANTITY_DBZH, table);
+	assert(extractor->getIndexMisses() == misses);
+	assert(table.rows.size() == 16);
+}
+
+/* one scan whose rays start 10 degrees east of north */
+void test_azimuths()
+{
+	OdimFactory factory;
+	{
+		std::unique_ptr<PolarVolume> volume(factory.createPolarVolume(TESTDIR"/EXTRACT-ROTATED-PVOL-ODIMH5V21.h5"));
+		volume->setDateTime(T0);
+		volume->setLongitude(SITE_LON);
+		volume->setLatitude(SITE_LAT);
+		volume->setAltitude(0.);
+		std::unique_ptr<PolarScan> scan(volume->createScan());
+		scan->setEAngle(0.5);
+		scan->setA1Gate(0);
+		scan->setNumBins(NUMBINS);
+		scan->setNumRays(NUMRAYS);
+		scan->setRangeStart(0);
+		scan->setRangeScale(1000);
+		std::vector<double> start(NUMRAYS), stop(NUMRAYS);
+		for (int r=0; r<NUMRAYS; r++)
+		{
+			start[r] = (r + 10) % 360;
+			stop[r] = (r + 11) % 360;
+		}
+		scan->setStartAzimuthAngles(start);
+		scan->setStopAzimuthAngles(stop);
+	}
+
+	std::unique_ptr<Extractor> extractor(polar_extractor());
+	std::unique_ptr<PolarVolume> uniform(factory.openPolarVolume(TESTDIR"/EXTRACT-PVOL-ODIMH5V21.h5"));
+	std::unique_ptr<PolarScan> uscan(uniform->getScan(0));
+	Extractor::IndexPtr uindex = extractor->getIndex(*uniform, *uscan);
+
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(TESTDIR"/EXTRACT-ROTATED-PVOL-ODIMH5V21.h5"));
+	std::unique_ptr<PolarScan> scan(volume->getScan(0));
+	Extractor::IndexPtr index = extractor->getIndex(*volume, *scan);
+	assert(index != uindex);
+	/* the point at azimuth 45.5 is in ray 35, the basin has the gates of rays 70-89 */
+	assert(index->getCells()[0] == 35 * NUMBINS + 29);
+	for (size_t e = index->getFirst()[2]; e < index->getFirst()[3]; e++)
+	{
+		int ray = index->getCells()[e] / NUMBINS;
+		assert(ray >= 70 && ray < 90);
+	}
+}
+
+void test_image()
+{
+	CartesianGrid grid = image_grid();
+	Projection projection(grid.projdef);
+	std::vector<ExtractionPoint> points(1);
+	points[0].name = "pixel";
+	projection.inverse(grid.pixelX(7), grid.pixelY(3), points[0].lat, points[0].lon);
+	/* rectangle around the centres of columns 10-19 of rows 5-9 */
+	ExtractionPolygon rectangle;
+	rectangle.name = "rectangle";
+	double xs[4] = { grid.pixelX(10) - 500., grid.pixelX(19) + 500., grid.pixelX(19) + 500., grid.pixelX(10) - 500. };
+	double ys[4] = { grid.pixelY(5) + 500., grid.pixelY(5) + 500., grid.pixelY(9) - 500., grid.pixelY(9) - 500. };
+	for (int i=0; i<4; i++)
+	{
+		double lat, lon;
+		projection.inverse(xs[i], ys[i], lat, lon);
+		rectangle.lats.push_back(lat);
+		rectangle.lons.push_back(lon);
+	}
+	Extractor extractor(points, std::vector<ExtractionPolygon>(1, rectangle), 2);
+
+	Extractor::IndexPtr index = extractor.getIndex(grid);
+	assert(index->getCells()[0] == 3 * grid.xsize + 7);
+	assert(index->getFirst()[2] - index->getFirst()[1] == 50);
+
+	OdimFactory factory;
+	std::unique_ptr<OdimObject> object(factory.open(TESTDIR"/EXTRACT-IMAGE-ODIMH5V21.h5"));
+	ImageObject* image = dynamic_cast<ImageObject*>(object.get());
+	ExtractionTable table;
+	assert(extractor.extract(*image, PRODUCT_QUANTITY_DBZH, table) == 1);
+	assert(table.rows.size() == 2);
+	assert(std::isnan(table.rows[0].elangle));
+	assert(fabs(table.rows[0].value - 7.) < 1e-4);
+	assert(fabs(table.rows[1].value - 14.5) < 1e-4);
+}
+
+void test_files()
+{
+	std::unique_ptr<Extractor> extractor(polar_extractor());
+	std::vector<std::string> paths;
+	paths.push_back(TESTDIR"/EXTRACT-PVOL-ODIMH5V21.h5");
+	paths.push_back(TESTDIR"/EXTRACT-MISSING-ODIMH5V21.h5");
+	paths.push_back(TESTDIR"/EXTRACT-IMAGE-ODIMH5V21.h5");
+	ExtractionTable table;
+	assert(extractor->extractFiles(paths, PRODUCT_QUANTITY_DBZH, table) == 2);
+	assert(extractor->getFailedFiles().size() == 1);
+	assert(extractor->getFailedFiles()[0] == paths[1]);
+	assert(table.files.size() == 2 && table.files[1] == paths[2]);
+	assert(table.rows.size() == 4 * 3);
+	assert(table.rows[0].file == 0 && table.rows[8].file == 1);
+	assert(table.rows[8].time == T0 + 300);
+
+	std::ostringstream csv;
+	table.writeCSV(csv);
+	std::istringstream lines(csv.str());
+	std::string line;
+	int count = 0;
+	std::getline(lines, line);
+	assert(line == "file,time,target,dataset,elangle,value,coverage");
+	std::getline(lines, line);
+	assert(line.find(paths[0] + ",2000-01-02 03:04:00,gauge,0,0.5,") == 0);
+	while (std::getline(lines, line))
+		count++;
+	assert(count == 11);
+
+	std::vector<ExtractionPolygon> bad(1);
+	bad[0].lats.resize(2);
+	bad[0].lons.resize(2);
+	try {
+		Extractor wrong(std::vector<ExtractionPoint>(), bad);
+		assert(false);
+	} catch (std::invalid_argument&) {
+	}
+}
+
+int main()
+{
+	create_volume();
+	create_image();
+	test_volume();
+	test_azimuths();
+	test_image();
+	test_files();
+	return 0;
+}
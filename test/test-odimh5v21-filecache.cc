@@ -0,0 +1,161 @@
+#include <radarlib/radar.hpp>
+#include "test-volume.hpp"
+#include <assert.h>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+#define PVOL_A TESTDIR"/FILECACHE-A-ODIMH5V21.h5"
+#define PVOL_B TESTDIR"/FILECACHE-B-ODIMH5V21.h5"
+#define PVOL_C TESTDIR"/FILECACHE-C-ODIMH5V21.h5"
+#define PVOL_TMP TESTDIR"/FILECACHE-TMP-ODIMH5V21.h5"
+
+/* written aside and renamed, as producers replace files */
+static void create_volume(const char* path, int scans)
+{
+	create_test_volume(PVOL_TMP, scans);
+	assert(std::rename(PVOL_TMP, path) == 0);
+}
+
+/* objects handed out by the cache on the same open file */
+template <class A, class B> static bool same_file(const std::shared_ptr<A>& a, const std::shared_ptr<B>& b)
+{
+	return a->getFile()->getId() == b->getFile()->getId();
+}
+
+void test_lru_weight()
+{
+	Radar::LRUCache<int, int> cache(10);
+	cache.setMaxWeight(100);
+	cache.insert(1, std::make_shared<int>(1), 40);
+	cache.insert(2, std::make_shared<int>(2), 40);
+	assert(cache.getWeight() == 80);
+	cache.find(1);
+	cache.insert(3, std::make_shared<int>(3), 40);
+	assert(cache.size() == 2 && cache.getWeight() == 80);
+	assert(cache.find(1) && !cache.find(2) && cache.find(3));
+
+	/* too heavy to be cached at all */
+	std::shared_ptr<int> big = cache.insert(4, std::make_shared<int>(4), 101);
+	assert(*big == 4 && !cache.find(4) && cache.size() == 2);
+
+	cache.erase(1);
+	assert(cache.getWeight() == 40);
+	cache.setMaxWeight(30);
+	assert(cache.size() == 0 && cache.getWeight() == 0);
+}
+
+void test_hits()
+{
+	create_volume(PVOL_A, 1);
+	OdimFileCache cache;
+	std::shared_ptr<PolarVolume> volume = cache.openPolarVolume(PVOL_A);
+	assert(volume->getScanCount() == 1);
+	std::shared_ptr<OdimObject> again = cache.open(PVOL_A);
+	assert(again != volume && same_file(again, volume));
+	assert(cache.getHits() == 1 && cache.getMisses() == 1);
+	assert(cache.size() == 1 && cache.getBytes() == Radar::FileSystem::getFileSize(PVOL_A));
+
+	try {
+		cache.openImageObject(PVOL_A);
+		assert(false);
+	} catch (OdimH5FormatException&) {
+	}
+
+	HDF5Library::instance().setPrintErrors(false);
+	try {
+		cache.open(TESTDIR"/FILECACHE-MISSING-ODIMH5V21.h5");
+		assert(false);
+	} catch (OdimH5Exception&) {
+	}
+	HDF5Library::instance().setPrintErrors(true);
+
+	cache.invalidate(PVOL_A);
+	assert(cache.size() == 0 && cache.getBytes() == 0);
+	assert(!same_file(cache.open(PVOL_A), volume));
+	assert(cache.getMisses() == 2);
+}
+
+void test_changes()
+{
+	create_volume(PVOL_A, 1);
+	OdimFileCache cache;
+	std::shared_ptr<PolarVolume> volume = cache.openPolarVolume(PVOL_A);
+
+	create_volume(PVOL_A, 2);
+	std::shared_ptr<PolarVolume> changed = cache.openPolarVolume(PVOL_A);
+	assert(!same_file(changed, volume) && changed->getScanCount() == 2);
+	assert(cache.getInvalidations() == 1 && cache.size() == 1);
+	assert(cache.getBytes() == Radar::FileSystem::getFileSize(PVOL_A));
+
+	/* the old handle still reads the replaced file */
+	assert(volume->getScanCount() == 1);
+	assert(same_file(cache.openPolarVolume(PVOL_A), changed));
+}
+
+void test_limits()
+{
+	create_volume(PVOL_A, 1);
+	create_volume(PVOL_B, 1);
+	create_volume(PVOL_C, 1);
+	OdimFileCache cache(2);
+	std::shared_ptr<PolarVolume> a = cache.openPolarVolume(PVOL_A);
+	cache.open(PVOL_B);
+	cache.open(PVOL_A);
+	cache.open(PVOL_C);
+	assert(cache.size() == 2 && cache.getMaxFiles() == 2);
+	assert(same_file(cache.open(PVOL_A), a));
+	uint64_t misses = cache.getMisses();
+	cache.open(PVOL_B);
+	assert(cache.getMisses() == misses + 1);
+
+	/* room for a single file */
+	uint64_t size = Radar::FileSystem::getFileSize(PVOL_A);
+	cache.setMaxFiles(10);
+	cache.setMaxBytes(size + size / 2);
+	assert(cache.size() == 1 && cache.getBytes() == size && cache.getMaxBytes() == size + size / 2);
+	cache.open(PVOL_C);
+	assert(cache.size() == 1);
+
+	/* an evicted handle stays valid */
+	assert(a->getScanCount() == 1);
+	cache.clear();
+	assert(cache.size() == 0 && a->getSource().OperaRadarSite == "rad");
+}
+
+/* every thread gets an object of its own, with the metadata it loads */
+void test_threads()
+{
+	create_volume(PVOL_A, 2);
+	OdimFileCache cache;
+	std::atomic<int> errors(0);
+	std::vector<std::thread> threads;
+	for (int t=0; t<4; t++)
+		threads.push_back(std::thread([&] {
+			for (int i=0; i<50; i++)
+			{
+				std::shared_ptr<PolarVolume> volume = cache.openPolarVolume(PVOL_A);
+				if (volume->getScanCount() != 2 || volume->getSource().OperaRadarSite != "rad")
+					++errors;
+			}
+		}));
+	for (size_t t=0; t<threads.size(); t++)
+		threads[t].join();
+	assert(errors == 0 && cache.size() == 1);
+	assert(cache.getHits() + cache.getMisses() == 200);
+}
+
+int main()
+{
+	test_lru_weight();
+	test_hits();
+	test_changes();
+	test_limits();
+	test_threads();
+	return 0;
+}
@@ -0,0 +1,123 @@
+#include <radarlib/radar.hpp>
+#include <assert.h>
+#include <cmath>
+
+using namespace OdimH5v21::geometry;
+
+void test_geometry()
+{
+	PolarGeometryKey key;
+	key.lon		= 11.6236;
+	key.lat		= 44.4567;
+	key.height	= 31.;
+	key.elangle	= 0.5;
+	key.nbins	= 250;
+	key.rscale	= 1000.;
+	key.rstart	= 0.;
+	key.nrays	= 360;
+
+	PolarGeometry geo(key);
+	assert(geo.getNumBins() == 250);
+	assert(geo.getNumRays() == 360);
+	assert(geo.range()[0] == 500.);
+	assert(geo.range()[249] == 249500.);
+	for (int i=1; i<250; i++) {
+		assert(geo.height()[i] > geo.height()[i-1]);
+		assert(geo.groundDistance()[i] < geo.range()[i]);
+	}
+	/* 4/3 earth: at 100 km and 0.5 degrees the beam is about 1451 m above the antenna */
+	assert(fabs(geo.height()[99] - 31. - 1451.) < 5.);
+	assert(fabs(geo.groundDistance()[99] - 99481.) < 5.);
+
+	/* ray 0 points north, ray 90 east, ray 180 south */
+	const double* lat = geo.latitude();
+	const double* lon = geo.longitude();
+	double degree = 6371000. * M_PI / 180.;
+	assert(fabs(lat[99] - key.lat - geo.groundDistance()[99] / degree) < 1e-3);
+	assert(fabs(lon[99] - key.lon) < 0.02);
+	assert(lon[90 * 250 + 99] > key.lon + 1.);
+	assert(lat[180 * 250 + 99] < key.lat - 0.8);
+}
+
+void test_azimuths()
+{
+	PolarGeometryKey key;
+	key.nbins	= 10;
+	key.rscale	= 1000.;
+	key.nrays	= 4;
+
+	/* without how/ arrays ray 0 is centred at 45 degrees */
+	assert(key.azimuths.centre(0, 4) == 45.);
+	assert(key.azimuths.index(4).findRay(10.) == 0);
+	assert(key.azimuths.key().empty());
+
+	/* rays rotated by 45 degrees: ray 0 points east, ray 3 covers north */
+	PolarGeometryKey rotated = key;
+	double start[] = { 45., 135., 225., 315. };
+	double stop[] = { 135., 225., 315., 45. };
+	rotated.azimuths.start.assign(start, start + 4);
+	rotated.azimuths.stop.assign(stop, stop + 4);
+	assert(rotated.azimuths.centre(0, 4) == 90.);
+	assert(rotated.azimuths.centre(3, 4) == 0.);
+	assert(rotated.azimuths.index(4).findRay(10.) == 3);
+	assert(rotated.azimuths.index(4).findRay(100.) == 0);
+	assert(!rotated.azimuths.key().empty());
+	assert(!(rotated == key) && (rotated < key || key < rotated));
+
+	PolarGeometry geo(rotated);
+	assert(fabs(geo.latitude()[9] - key.lat) < 1e-9);
+	assert(geo.longitude()[9] > key.lon);
+	assert(geo.latitude()[3 * 10 + 9] > key.lat);
+}
+
+void test_cache()
+{
+	PolarGeometryCache cache(2);
+	PolarGeometryKey key;
+	key.nbins = 10;
+	key.rscale = 1000.;
+	key.nrays = 4;
+
+	PolarGeometryCache::GeometryPtr first = cache.get(key);
+	assert(cache.get(key) == first);
+	assert(cache.getHits() == 1 && cache.getMisses() == 1);
+
+	key.elangle = 1.;
+	PolarGeometryCache::GeometryPtr second = cache.get(key);
+	key.elangle = 2.;
+	cache.get(key);
+	assert(cache.size() == 2);
+	/* the first geometry was evicted but it is still usable */
+	assert(first->range()[9] == 9500.);
+	key.elangle = 0.;
+	assert(cache.get(key) != first);
+	assert(cache.getMisses() == 4);
+
+	cache.setCapacity(0);
+	assert(cache.size() == 0);
+}
+
+void test_volume()
+{
+	OdimH5v21::OdimFactory factory;
+	OdimH5v21::PolarVolume* volume = factory.openPolarVolume(TESTDIR"/PVOL-ODIMH5V21.h5");
+	OdimH5v21::PolarScan* scan = volume->getScan(0);
+
+	PolarGeometryCache::GeometryPtr geo = PolarGeometryCache::global().get(*volume, *scan);
+	assert(geo->getNumBins() == scan->getNumBins());
+	assert(geo->getNumRays() == scan->getNumRays());
+	assert(geo->getKey().lat == volume->getLatitude());
+	assert(PolarGeometryCache::global().get(*volume, *scan) == geo);
+
+	delete scan;
+	delete volume;
+}
+
+int main()
+{
+	test_geometry();
+	test_azimuths();
+	test_cache();
+	test_volume();
+	return 0;
+}
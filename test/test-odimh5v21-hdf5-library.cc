@@ -0,0 +1,154 @@
+#include <radarlib/radar.hpp>
+#include "test-volume.hpp"
+#include <assert.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace OdimH5v21;
+
+#define PVOL TESTDIR"/HDF5LIB-PVOL-ODIMH5V21.h5"
+#define PVOL20 TESTDIR"/HDF5LIB-PVOL-ODIMH5V20.h5"
+
+/* opens the volume with a factory of its own, as batch tools do */
+static void open_volume()
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(PVOL, H5F_ACC_RDONLY));
+	assert(volume->getSource().OperaRadarSite == "rad");
+}
+
+/* the OdimH5v20 classes follow the same policy */
+static void create_volume20()
+{
+	OdimH5v20::OdimFactory factory;
+	std::unique_ptr<OdimH5v20::PolarVolume> volume(factory.createPolarVolume(PVOL20));
+}
+
+void test_policies()
+{
+	HDF5Library& library = HDF5Library::instance();
+	assert(&library == &HDF5Library::instance());
+	assert(library.getGCPolicy() == HDF5_GC_EVERY_FACTORY);
+
+	create_test_volume(PVOL, 0);
+	uint64_t files = library.getFileCount();
+	uint64_t gc = library.getGCCount();
+	open_volume();
+	open_volume();
+	assert(library.getFileCount() == files + 2);
+	/* when the volume is closed and when its factory is released */
+	assert(library.getGCCount() == gc + 4);
+
+	files = library.getFileCount();
+	gc = library.getGCCount();
+	create_volume20();
+	assert(library.getFileCount() == files + 1 && library.getGCCount() == gc + 2);
+
+	library.setGCPolicy(HDF5_GC_NEVER);
+	gc = library.getGCCount();
+	for (int i=0; i<5; i++)
+		open_volume();
+	create_volume20();
+	assert(library.getGCCount() == gc);
+	library.garbageCollect();
+	assert(library.getGCCount() == gc + 1);
+
+	/* collected when the third file has been opened and its factory released */
+	library.setGCPolicy(HDF5_GC_EVERY_N_FILES, 3);
+	assert(library.getGCParameter() == 3);
+	gc = library.getGCCount();
+	open_volume();
+	open_volume();
+	assert(library.getGCCount() == gc);
+	open_volume();
+	assert(library.getGCCount() == gc + 1);
+	for (int i=0; i<6; i++)
+		open_volume();
+	assert(library.getGCCount() == gc + 3);
+
+	try {
+		library.setGCPolicy(HDF5_GC_EVERY_N_FILES, 0);
+		assert(false);
+	} catch (std::invalid_argument&) {
+	}
+	assert(library.getGCPolicy() == HDF5_GC_EVERY_N_FILES);
+
+	if (HDF5Library::getFreeListSize() > 0 || library.getGCCount() > 0)
+	{
+		try {
+			/* any block left in the free lists triggers a collection */
+			library.setGCPolicy(HDF5_GC_MEMORY_THRESHOLD, 1);
+			gc = library.getGCCount();
+			open_volume();
+			open_volume();
+			assert(library.getGCCount() > gc);
+		} catch (std::invalid_argument&) {
+			/* HDF5 older than 1.10.7 */
+		}
+	}
+
+	library.setGCPolicy(HDF5_GC_EVERY_FACTORY);
+}
+
+void test_errors()
+{
+	HDF5Library& library = HDF5Library::instance();
+	assert(library.getPrintErrors());
+	library.setPrintErrors(false);
+	assert(!library.getPrintErrors());
+	try {
+		OdimFactory factory;
+		delete factory.openPolarVolume(TESTDIR"/HDF5LIB-MISSING.h5", H5F_ACC_RDONLY);
+		assert(false);
+	} catch (OdimH5HDF5LibException&) {
+	}
+	library.setPrintErrors(true);
+	assert(library.getPrintErrors());
+}
+
+void test_locking()
+{
+	HDF5Library& library = HDF5Library::instance();
+	assert(library.getLockPolicy() == HDF5_LOCK_AUTO);
+	assert(library.isLocking() == !HDF5Library::isThreadSafe());
+
+	library.setLockPolicy(HDF5_LOCK_NEVER);
+	assert(!library.isLocking());
+	uint64_t count = library.getLockCount();
+	open_volume();
+	assert(library.getLockCount() == count);
+
+	library.setLockPolicy(HDF5_LOCK_ALWAYS);
+	assert(library.isLocking());
+	{
+		/* nested locks, as taken by the wrappers */
+		HDF5Lock outer;
+		HDF5Lock inner;
+		open_volume();
+	}
+	assert(library.getLockCount() > count + 2);
+
+	/* threads reading the same file through factories of their own */
+	std::vector<std::thread> threads;
+	for (int t=0; t<4; t++)
+		threads.push_back(std::thread([] {
+			for (int i=0; i<10; i++)
+				open_volume();
+		}));
+	for (size_t t=0; t<threads.size(); t++)
+		threads[t].join();
+	assert(library.getLockWaits() <= library.getLockCount());
+	assert(library.getLockWaits() > 0 || library.getLockWaitTime() == 0);
+
+	library.setLockPolicy(HDF5_LOCK_AUTO);
+	assert(library.isLocking() == !HDF5Library::isThreadSafe());
+}
+
+int main()
+{
+	test_policies();
+	test_errors();
+	test_locking();
+	return 0;
+}
@@ -3,10 +3,108 @@
 #include <stdio.h>
 
 #include <assert.h>
+#include <cmath>
+#include <memory>
 #define NUMRAYS 100
 
+/* raw value of each gate of the cube volume */
+int cube_raw(int scan, int ray, int bin)
+{
+	return bin == 0 ? 0 : bin == 5 ? 255 : (ray * 7 + bin + scan) % 250 + 1;
+}
+
+/* two scans of different shape, the higher one first; rays of the lower one start 30 degrees from north */
+void test_cube()
+{
+	OdimH5v21::OdimFactory factory;
+	{
+		std::unique_ptr<OdimH5v21::PolarVolume> volume(factory.createPolarVolume(TESTDIR"/CUBE-PVOL-ODIMH5V21.h5"));
+		volume->setDateTime(Radar::timeutils::mktime(2000,1,2,3,4,5));
+		volume->setLongitude(11.6236);
+		volume->setLatitude(44.4567);
+		volume->setAltitude(31.);
+		for (int s=0; s<2; s++)
+		{
+			int rays = s == 0 ? 90 : 120;
+			int bins = s == 0 ? 50 : 70;
+			std::unique_ptr<OdimH5v21::PolarScan> scan(volume->createScan());
+			scan->setStartDateTime(Radar::timeutils::mktime(2000,1,2,3,4,5+s));
+			scan->setEndDateTime(Radar::timeutils::mktime(2000,1,2,3,4,6+s));
+			scan->setEAngle(s == 0 ? 3. : 0.5);
+			scan->setA1Gate(s);
+			scan->setNumBins(bins);
+			scan->setNumRays(rays);
+			scan->setRangeStart(0);
+			scan->setRangeScale(s == 0 ? 1000 : 500);
+			scan->setBeamWidth(1.);
+			if (s == 1)
+			{
+				std::vector<OdimH5v21::AZAngles> azangles;
+				for (int i=0; i<rays; i++)
+					azangles.push_back(OdimH5v21::AZAngles(fmod(30. + 3. * i, 360.), fmod(33. + 3. * i, 360.)));
+				scan->setAzimuthAngles(azangles);
+			}
+
+			std::unique_ptr<OdimH5v21::PolarScanData> data(scan->createQuantityData(OdimH5v21::PRODUCT_QUANTITY_DBZH));
+			data->setNodata(255.);
+			data->setUndetect(0.);
+			data->setOffset(-32.);
+			data->setGain(0.5);
+			OdimH5v21::RayMatrix<unsigned char> matrix(rays, bins);
+			for (int r=0; r<rays; r++)
+				for (int b=0; b<bins; b++)
+					matrix.elem(r,b) = cube_raw(s, r, b);
+			data->writeData(matrix);
+		}
+	}
+
+	std::unique_ptr<OdimH5v21::PolarVolume> volume(factory.openPolarVolume(TESTDIR"/CUBE-PVOL-ODIMH5V21.h5"));
+	OdimH5v21::PolarCube cube;
+	volume->readCube(OdimH5v21::PRODUCT_QUANTITY_DBZH, cube, false, 3);
+	assert(cube.getScanCount() == 2);
+	assert(cube.getRayCount() == 120 && cube.getBinCount() == 70);
+	assert(cube.getRayStride() == 80 && cube.getScanStride() == 120 * 80);
+	assert(((size_t)cube.get()) % 64 == 0);
+	assert(!cube.isNorthAligned());
+
+	/* scans are sorted by elevation */
+	const OdimH5v21::PolarCubeScan& low = cube.getScan(0);
+	assert(low.index == 1 && low.elangle == 0.5 && low.numrays == 120 && low.numbins == 70);
+	assert(low.rangeScale == 500. && low.a1gate == 1 && low.gain == 0.5 && low.offset == -32.);
+	assert(low.startDateTime == Radar::timeutils::mktime(2000,1,2,3,4,6));
+	assert(cube.getScan(1).index == 0 && cube.getScan(1).numrays == 90);
+
+	assert(cube.elem(0, 17, 9) == cube_raw(1, 17, 9) * 0.5f - 32.f);
+	assert(cube.elem(1, 89, 49) == cube_raw(0, 89, 49) * 0.5f - 32.f);
+	assert(cube.elem(0, 3, 0) == -std::numeric_limits<float>::infinity());
+	assert(std::isnan(cube.elem(0, 3, 5)));
+	/* padding */
+	assert(std::isnan(cube.elem(1, 10, 50)) && std::isnan(cube.elem(1, 95, 0)));
+
+	/* rays of the lower scan start 10 rays after north */
+	OdimH5v21::PolarCube north;
+	volume->readCube(OdimH5v21::PRODUCT_QUANTITY_DBZH, north, true, 1);
+	assert(north.isNorthAligned());
+	assert(north.elem(0, 15, 9) == cube.elem(0, 5, 9));
+	assert(north.elem(0, 3, 9) == cube.elem(0, 113, 9));
+	assert(north.elem(1, 40, 9) == cube.elem(1, 40, 9));
+
+	/* copies are aligned too */
+	OdimH5v21::PolarCube copy(cube);
+	assert(((size_t)copy.get()) % 64 == 0);
+	assert(copy.elem(0, 17, 9) == cube.elem(0, 17, 9) && copy.getScan(1).index == 0);
+
+	try {
+		volume->readCube("missing", cube);
+		assert(false);
+	} catch (OdimH5v21::OdimH5Exception&) {
+	}
+}
+
 int main()
 {
+	test_cube();
+
 	OdimH5v21::OdimFactory factory;
 
 	OdimH5v21::PolarVolume *volume = factory.openPolarVolume(TESTDIR"/PVOL-ODIMH5V21.h5");
@@ -27,6 +125,43 @@ int main()
 	}
 
 
+	std::vector<OdimH5v21::AZTimes> aztimes = Scan->getAzimuthTimes();
+	std::vector<double> elangles, txpower;
+	Scan->getHow()->getSimpleArray(OdimH5v21::ATTRIBUTE_HOW_ELANGLES, elangles);
+	txpower = Scan->getTXPower();
+	assert (aztimes.size() == NUMRAYS);
+	assert (elangles.size() == NUMRAYS);
+	assert (txpower.size() == NUMRAYS);
+	for (int i=0; i<NUMRAYS; i++){
+	   assert (aztimes[i].start == 946782245. + i * 0.05);
+	   assert (aztimes[i].stop  == 946782245. + (i + 1) * 0.05);
+	   assert (elangles[i] == i);
+	   assert (txpower[i] == 250. + i);
+	}
+	assert (Scan->getDirection() == 1);
+	assert (Scan->getHow()->getSimpleArrayDouble("missing").empty());
+
+	OdimH5v21::PolarScan *Scan1 = volume->getScan(1);
+	const OdimH5v21::RayTable& rays = Scan1->getRayTable();
+	assert (&rays == &Scan1->getRayTable());
+	assert (rays.size() == NUMRAYS);
+	assert (rays.direction == 1);
+	assert (rays.a1gate == 1);
+	assert (rays.hasAzimuthAngles && rays.hasElevationAngles && rays.hasAzimuthTimes);
+	for (int i=0; i<NUMRAYS; i++){
+	   assert (rays.startAzimuth()[i]  == azangles[i].start);
+	   assert (rays.stopAzimuth()[i]   == azangles[i].stop);
+	   assert (rays.centreAzimuth()[i] == azangles[i].averagedAngle());
+	   assert (rays.elevation()[i]     == i);
+	   assert (rays.startTime()[i]     == aztimes[i].start);
+	   assert (rays.stopTime()[i]      == aztimes[i].stop);
+	   assert (rays.originalIndex()[i] == (i + 1) % NUMRAYS);
+	}
+	const OdimH5v21::AzimuthIndex& azindex = Scan1->getAzimuthIndex();
+	assert (azindex.isUniform());
+	assert (azindex.findRay(azangles[10].averagedAngle()) == 10);
+	delete Scan1;
+
 	assert(volume->getObject() == OdimH5v21::OBJECT_PVOL);
 	int NumScans=volume->getScanCount();
 	assert ( NumScans  == 10) ;
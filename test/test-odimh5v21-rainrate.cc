@@ -0,0 +1,217 @@
+#include <radarlib/radar.hpp>
+#include "test-volume.hpp"
+#include <assert.h>
+#include <cmath>
+#include <memory>
+
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+#define NUMRAYS 360
+#define NUMBINS 100
+
+/* raw DBZH of each gate is its bin number plus a quarter of its ray, KDP is (bin - 10) / 10 */
+void create_volume()
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.createPolarVolume(TESTDIR"/RAINRATE-PVOL-ODIMH5V21.h5"));
+	set_test_radar(*volume);
+	volume->setZR_A(300.);
+	volume->setZR_B(1.5);
+
+	for (int s=0; s<2; s++)
+	{
+		std::unique_ptr<PolarScan> scan(volume->createScan());
+		scan->setEAngle(0.5 + s);
+		scan->setA1Gate(0);
+		scan->setNumBins(NUMBINS);
+		scan->setNumRays(NUMRAYS);
+		scan->setRangeStart(0);
+		scan->setRangeScale(1000);
+		if (s == 1)
+		{
+			scan->setZR_A(250.);
+			scan->setZR_B(1.2);
+		}
+
+		std::unique_ptr<PolarScanData> data(scan->createQuantityData(PRODUCT_QUANTITY_DBZH));
+		data->setNodata(255.);
+		data->setUndetect(0.);
+		data->setOffset(-32.);
+		data->setGain(0.5);
+		RayMatrix<unsigned char> matrix(NUMRAYS, NUMBINS);
+		for (int r=0; r<NUMRAYS; r++)
+			for (int b=0; b<NUMBINS; b++)
+				matrix.elem(r,b) = r == 90 ? 255 : b == 0 ? 0 : b + r / 4;
+		data->writeData(matrix);
+
+		if (s == 0)
+		{
+			std::unique_ptr<PolarScanData> kdp(scan->createQuantityData(PRODUCT_QUANTITY_KDP));
+			kdp->setNodata(255.);
+			kdp->setUndetect(0.);
+			kdp->setOffset(-1.);
+			kdp->setGain(0.1);
+			RayMatrix<unsigned char> kmatrix(NUMRAYS, NUMBINS);
+			for (int r=0; r<NUMRAYS; r++)
+				for (int b=0; b<NUMBINS; b++)
+					kmatrix.elem(r,b) = b == 0 ? 0 : b;
+			kdp->writeData(kmatrix);
+		}
+	}
+}
+
+void test_fastmath()
+{
+	for (float x = -80.f; x <= 80.f; x += 0.0137f)
+		assert(fabs(fastExp(x) / exp((double)x) - 1.) < 1e-6);
+	assert(fastExp(-200.f) > 0.f && fastExp(200.f) < INFINITY);
+	for (double x = 1e-30; x < 1e30; x *= 1.37)
+	{
+		double l = log((double)(float)x);
+		assert(fabs(fastLog((float)x) - l) < 1e-6 * (fabs(l) > 1. ? fabs(l) : 1.));
+	}
+}
+
+void test_law()
+{
+	RainRateLaw mp;
+	assert(mp.source == RATE_FROM_DBZ && mp.a == 200. && mp.b == 1.6);
+	/* Marshall-Palmer: 23 dBZ is about 1 mm/h */
+	assert(fabs(mp.rate(23.) - 1.) < 0.02);
+
+	float values[4] = { 30.f, NODATA, UNDETECT, -20.f };
+	float rates[4];
+	mp.convert(values, 4, rates);
+	assert(fabs(rates[0] / mp.rate(30.f) - 1.) < 1e-5);
+	assert(std::isnan(rates[1]));
+	assert(rates[2] == UNDETECT);
+	assert(fabs(rates[3] / mp.rate(-20.f) - 1.) < 1e-5);
+
+	RainRateLaw kr = RainRateLaw::kr();
+	for (float k = 0.01f; k < 20.f; k *= 1.3f)
+	{
+		float r;
+		kr.convert(&k, 1, &r);
+		assert(fabs(r / kr.rate(k) - 1.) < 1e-5);
+	}
+	float kvalues[3] = { 0.f, -0.5f, UNDETECT };
+	kr.convert(kvalues, 3, kvalues);
+	assert(kvalues[0] == 0.f && kvalues[1] == 0.f && kvalues[2] == UNDETECT);
+
+	/* parallel conversion gives the same results */
+	std::vector<float> many(100000), out1(100000), out2(100000);
+	for (size_t i = 0; i < many.size(); i++)
+		many[i] = -30.f + (i % 1000) * 0.1f;
+	RainRateConverter converter(4);
+	converter.setBlockSize(777);
+	converter.convert(mp, &many[0], many.size(), &out1[0]);
+	mp.convert(&many[0], many.size(), &out2[0]);
+	assert(out1 == out2);
+
+	try {
+		converter.convert(RainRateLaw::zr(0., 1.), &many[0], 1, &out1[0]);
+		assert(false);
+	} catch (std::invalid_argument&) {
+	}
+}
+
+void test_volume()
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(TESTDIR"/RAINRATE-PVOL-ODIMH5V21.h5", H5F_ACC_RDWR));
+	std::unique_ptr<PolarScan> scan0(volume->getScan(0));
+	std::unique_ptr<PolarScan> scan1(volume->getScan(1));
+
+	/* coefficients come from the scan, then from the volume, then the defaults */
+	RainRateLaw law0 = RainRateLaw::of(*scan0, *volume, RATE_FROM_DBZ);
+	RainRateLaw law1 = RainRateLaw::of(*scan1, *volume, RATE_FROM_DBZ);
+	RainRateLaw lawk = RainRateLaw::of(*scan0, *volume, RATE_FROM_KDP);
+	assert(law0.a == 300. && law0.b == 1.5);
+	assert(law1.a == 250. && law1.b == 1.2);
+	assert(lawk.a == 44. && lawk.b == 0.822);
+
+	RainRateConverter converter(3);
+	converter.setBlockSize(1000);
+	assert(converter.convert(*volume, RATE_FROM_DBZ) == 2);
+
+	for (int s=0; s<2; s++)
+	{
+		std::unique_ptr<PolarScan> scan(volume->getScan(s));
+		RainRateLaw law = s == 0 ? law0 : law1;
+		std::unique_ptr<PolarScanData> rate(scan->getQuantityData(PRODUCT_QUANTITY_RATE));
+		assert(rate->getDataType() == H5::PredType::NATIVE_UINT16);
+		assert(rate->getGain() == 0.01 && rate->getNodata() == 65535.);
+		RayMatrix<unsigned short> raw(NUMRAYS, NUMBINS);
+		rate->readData(&raw.elem(0, 0));
+		for (int r=0; r<NUMRAYS; r++)
+			for (int b=0; b<NUMBINS; b++)
+			{
+				unsigned short v = raw.elem(r, b);
+				if (r == 90)
+					assert(v == 65535);
+				else if (b == 0)
+					assert(v == 0);
+				else
+				{
+					/* 65535 is nodata and 0 undetect */
+					double expected = law.rate((b + r / 4) * 0.5 - 32.) / 0.01;
+					if (expected > 65534.)
+						expected = 65534.;
+					if (expected < 1.)
+						expected = 1.;
+					assert(fabs(v - expected) <= 0.5 + expected * 1e-5);
+				}
+			}
+	}
+
+	/* K-R with an explicit 8 bit encoding */
+	std::unique_ptr<PolarScanData> kdp(converter.convert(*scan0, PRODUCT_QUANTITY_KDP, lawk,
+							     Encoding(RAW_UINT8, 1., 0., 255., 254.)));
+	RayMatrix<unsigned char> kraw(NUMRAYS, NUMBINS);
+	kdp->readData(&kraw.elem(0, 0));
+	assert(kraw.elem(0, 0) == 254);
+	/* bins up to 10 have KDP <= 0 */
+	assert(kraw.elem(0, 5) == 0 && kraw.elem(0, 10) == 0);
+	assert(kraw.elem(0, 30) == (unsigned char)floor(lawk.rate(2.f) + 0.5));
+}
+
+void test_product()
+{
+	OdimFactory factory;
+	std::unique_ptr<ImageObject> image(factory.createImageObject(TESTDIR"/RAINRATE-IMAGE-ODIMH5V21.h5"));
+	image->setZR_A(100.);
+	image->setZR_B(2.);
+	std::unique_ptr<Product_CAPPI> cappi(image->createProductCAPPI());
+	DataMatrix<float> values(10, 20);
+	for (int r=0; r<10; r++)
+		for (int c=0; c<20; c++)
+			values.elem(r, c) = r == 0 ? NODATA : c == 0 ? UNDETECT : c * 2.5f;
+	{
+		std::unique_ptr<Product_2D_Data> data(cappi->createQuantityData(PRODUCT_QUANTITY_DBZH));
+		Encoding(RAW_UINT8, 0.5, -32., 255., 0.).write(values, *data);
+	}
+
+	RainRateLaw law = RainRateLaw::of(*cappi, *image, RATE_FROM_DBZ);
+	assert(law.a == 100. && law.b == 2.);
+	RainRateConverter converter(2);
+	std::unique_ptr<Product_2D_Data> rate(converter.convert(*cappi, PRODUCT_QUANTITY_DBZH, law,
+							       Encoding(RAW_FLOAT, 1., 0., -1., -2.)));
+	assert(rate->getQuantity() == PRODUCT_QUANTITY_RATE);
+	DataMatrix<float> raw(10, 20);
+	rate->readData(&raw.elem(0, 0));
+	assert(raw.elem(0, 5) == -1.f);
+	assert(raw.elem(3, 0) == -2.f);
+	/* R = sqrt(Z / 100) */
+	assert(fabs(raw.elem(3, 8) - sqrt(pow(10., 2.) / 100.)) < 1e-5);
+}
+
+int main()
+{
+	create_volume();
+	test_fastmath();
+	test_law();
+	test_volume();
+	test_product();
+	return 0;
+}
@@ -0,0 +1,142 @@
+#include <radarlib/radar.hpp>
+#include "test-volume.hpp"
+#include <assert.h>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+#define NUMRAYS 36
+#define NUMBINS 50
+
+static void read_volume()
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(TESTDIR"/STATS-PVOL-ODIMH5V21.h5"));
+	std::unique_ptr<PolarScan> scan(volume->getScan(0));
+	std::unique_ptr<PolarScanData> data(scan->getQuantityData(PRODUCT_QUANTITY_DBZH));
+	RayMatrix<float> values;
+	data->readTranslatedData(values);
+	assert(values.elem(1, 1) == 10.f);
+}
+
+static std::string readFile(const char* path)
+{
+	std::ifstream in(path);
+	std::ostringstream ss;
+	ss << in.rdbuf();
+	return ss.str();
+}
+
+void test_disabled()
+{
+	HDF5Stats::enable(false);
+	HDF5Stats::reset();
+	create_test_volume(TESTDIR"/STATS-PVOL-ODIMH5V21.h5");
+	read_volume();
+	HDF5StatsSnapshot stats = HDF5Stats::snapshot();
+	for (int i=0; i<HDF5_STATS_OPERATIONS; i++)
+		assert(stats.operations[i].calls == 0);
+	assert(stats.threads == 0);
+}
+
+void test_counters()
+{
+	HDF5Stats::enable();
+	HDF5Stats::reset();
+	create_test_volume(TESTDIR"/STATS-PVOL-ODIMH5V21.h5");
+	HDF5StatsSnapshot written = HDF5Stats::snapshot();
+	assert(written[HDF5_STATS_FILE_OPEN].calls == 1);
+	assert(written[HDF5_STATS_DATA_WRITE].calls == 1);
+	assert(written[HDF5_STATS_DATA_WRITE].bytes == NUMRAYS * NUMBINS);
+	assert(written[HDF5_STATS_TRANSLATE].bytes == NUMRAYS * NUMBINS);
+	assert(written[HDF5_STATS_GROUP_CREATE].calls > 0);
+	assert(written[HDF5_STATS_ATTRIBUTE_WRITE].calls > 0);
+	assert(written[HDF5_STATS_DATA_READ].calls == 0);
+	assert(written.threads == 1);
+
+	read_volume();
+	HDF5StatsSnapshot read = HDF5Stats::snapshot();
+	assert(read[HDF5_STATS_FILE_OPEN].calls == 2);
+	assert(read[HDF5_STATS_DATA_READ].calls == 1);
+	assert(read[HDF5_STATS_DATA_READ].bytes == NUMRAYS * NUMBINS);
+	assert(read[HDF5_STATS_TRANSLATE].calls == 2);
+	assert(read[HDF5_STATS_ATTRIBUTE_READ].calls > 0);
+	assert(read[HDF5_STATS_DATA_READ].nanoseconds > 0);
+	assert(read[HDF5_STATS_ATTRIBUTE_WRITE].calls == written[HDF5_STATS_ATTRIBUTE_WRITE].calls);
+
+	HDF5Stats::reset();
+	HDF5StatsSnapshot empty = HDF5Stats::snapshot();
+	assert(empty[HDF5_STATS_FILE_OPEN].calls == 0 && empty[HDF5_STATS_DATA_READ].bytes == 0);
+	read_volume();
+	assert(HDF5Stats::snapshot()[HDF5_STATS_FILE_OPEN].calls == 1);
+}
+
+void test_threads()
+{
+	HDF5Stats::enable();
+	HDF5Stats::reset();
+	/* HDF5 is not thread safe: the threads only record, the totals must add up */
+	std::vector<std::thread> threads;
+	for (int t=0; t<4; t++)
+		threads.push_back(std::thread([] {
+			for (int i=0; i<1000; i++)
+				HDF5Stats::record(HDF5_STATS_DATA_READ, 10, 1);
+		}));
+	for (size_t t=0; t<threads.size(); t++)
+		threads[t].join();
+	HDF5Stats::record(HDF5_STATS_DATA_READ, 5, 1);
+	HDF5StatsSnapshot stats = HDF5Stats::snapshot();
+	assert(stats[HDF5_STATS_DATA_READ].calls == 4001);
+	assert(stats[HDF5_STATS_DATA_READ].bytes == 40005);
+	assert(stats[HDF5_STATS_DATA_READ].nanoseconds == 4001);
+	assert(stats.threads == 1);
+
+	HDF5Stats::reset();
+	assert(HDF5Stats::snapshot()[HDF5_STATS_DATA_READ].calls == 0);
+}
+
+void test_output()
+{
+	HDF5Stats::enable();
+	HDF5Stats::reset();
+	HDF5Stats::record(HDF5_STATS_DATA_WRITE, 2048, 1500000000);
+	HDF5StatsSnapshot stats = HDF5Stats::snapshot();
+	assert(std::string(HDF5Stats::name(HDF5_STATS_GROUP_ITERATE)) == "group_iterate");
+
+	std::ostringstream json;
+	stats.writeJSON(json);
+	assert(json.str().find("\"enabled\": true,") != std::string::npos);
+	assert(json.str().find("\"data_write\": {\"calls\": 1, \"bytes\": 2048, \"seconds\": 1.500000000},") != std::string::npos);
+	assert(json.str().find("\"translate\": {\"calls\": 0, \"bytes\": 0, \"seconds\": 0.000000000}\n") != std::string::npos);
+
+	std::ostringstream prom;
+	stats.writePrometheus(prom);
+	assert(prom.str().find("# TYPE radarlib_hdf5_calls_total counter\n") != std::string::npos);
+	assert(prom.str().find("radarlib_hdf5_calls_total{operation=\"data_write\"} 1\n") != std::string::npos);
+	assert(prom.str().find("radarlib_hdf5_bytes_total{operation=\"data_write\"} 2048\n") != std::string::npos);
+	assert(prom.str().find("radarlib_hdf5_seconds_total{operation=\"data_write\"} 1.500000000\n") != std::string::npos);
+
+	HDF5Stats::writeFile(TESTDIR"/STATS.json", "json");
+	HDF5Stats::writeFile(TESTDIR"/STATS.prom", "prometheus");
+	assert(readFile(TESTDIR"/STATS.json") == json.str());
+	assert(readFile(TESTDIR"/STATS.prom") == prom.str());
+	try {
+		HDF5Stats::writeFile(TESTDIR"/STATS.xml", "xml");
+		assert(false);
+	} catch (std::invalid_argument&) {
+	}
+	HDF5Stats::enable(false);
+}
+
+int main()
+{
+	test_disabled();
+	test_counters();
+	test_threads();
+	test_output();
+	return 0;
+}
@@ -17,6 +17,8 @@
  */
 #include <radarlib/odimh5v21_support.hpp>
 #include <assert.h>
+#include <cmath>
+#include <vector>
 
 void test_nodes()
 {
@@ -50,8 +52,64 @@ void test_nodes()
 	assert(nodes.at(0).get() == "'aaa'");
 }
 
+void test_azimuth_index()
+{
+	using OdimH5v21::AzimuthIndex;
+
+	/* uniform clockwise scan starting from north */
+	std::vector<double> start, stop;
+	for (int i=0; i<360; i++) {
+		start.push_back(i);
+		stop.push_back(fmod(i + 1., 360.));
+	}
+	AzimuthIndex index;
+	assert(index.findRay(10.) == -1);
+	index.build(&start[0], &stop[0], 360, 1);
+	assert(index.isUniform());
+	assert(index.findRay(0.) == 0);
+	assert(index.findRay(10.5) == 10);
+	assert(index.findRay(359.99) == 359);
+	assert(index.findRay(360.) == 0);
+	assert(index.findRay(-0.5) == 359);
+	assert(index.findRay(720.5) == 0);
+	assert(index.findRay(NAN) == -1);
+
+	/* uniform scan with rays centred on whole degrees, the first crosses north */
+	for (int i=0; i<360; i++) {
+		start[i] = fmod(i - 0.5 + 360., 360.);
+		stop[i]  = i + 0.5;
+	}
+	index.build(&start[0], &stop[0], 360, 1);
+	assert(index.isUniform());
+	assert(index.findRay(359.7) == 0);
+	assert(index.findRay(0.2) == 0);
+	assert(index.findRay(0.5) == 1);
+	assert(index.findRay(180.) == 180);
+
+	/* counter-clockwise scan: start and stop are swapped */
+	index.build(&stop[0], &start[0], 360, -1);
+	assert(index.isUniform());
+	assert(index.findRay(359.7) == 0);
+	assert(index.findRay(45.2) == 45);
+
+	/* non uniform scan with a gap between 90 and 100 */
+	double nstart[]	= { 0., 10., 30., 100., 200. };
+	double nstop[]	= { 10., 30., 90., 200., 0. };
+	index.build(nstart, nstop, 5, 1);
+	assert(!index.isUniform());
+	double az[]	= { 5., 10., 29.9, 95., 100., 359.9, -1. };
+	int expected[]	= { 0, 1, 1, -1, 3, 4, 4 };
+	int rays[7];
+	index.findRays(az, rays, 7);
+	for (int i=0; i<7; i++)
+		assert(rays[i] == expected[i]);
+	std::vector<int> result = index.findRays(std::vector<double>(az, az + 7));
+	assert(result.size() == 7 && result[3] == -1 && result[6] == 4);
+}
+
 int main()
 {
 	test_nodes();
+	test_azimuth_index();
 	return 0;
 }
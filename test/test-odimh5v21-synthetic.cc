@@ -0,0 +1,162 @@
+#include <radarlib/radar.hpp>
+#include <assert.h>
+#include <cmath>
+#include <memory>
+#include <sstream>
+
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+#define NUMRAYS 36
+#define NUMBINS 50
+
+void test_field()
+{
+	SyntheticField a(7), b(7), c(8);
+	int undetect = 0, echoes = 0, differ = 0;
+	for (int y=-200; y<200; y+=10)
+		for (int x=-200; x<200; x+=10)
+		{
+			float v = a.reflectivity(x, y, 500., 600.);
+			assert(v == b.reflectivity(x, y, 500., 600.));
+			differ += v != c.reflectivity(x, y, 500., 600.);
+			if (v == UNDETECT)
+				undetect++;
+			else
+			{
+				assert(v >= 5.f && v <= 60.f);
+				echoes++;
+			}
+		}
+	assert(undetect > 0 && echoes > 0 && differ > 0);
+	assert(a.getWindSpeed() == b.getWindSpeed());
+	assert(SyntheticField::noise(1, 2) == SyntheticField::noise(1, 2));
+	assert(fabs(SyntheticField::noise(1, 2)) <= 1.f);
+}
+
+void test_encoding()
+{
+	Encoding e = SyntheticCorpus::encodingFor(PRODUCT_QUANTITY_DBZH, "uint8");
+	assert(e.rawtype == RAW_UINT8 && e.gain == 0.5 && e.offset == -32. && e.nodata == 255.);
+	e = SyntheticCorpus::encodingFor(PRODUCT_QUANTITY_VRAD, "uint16");
+	assert(e.rawtype == RAW_UINT16 && e.gain == 0.25 / 128. && e.nodata == 65535.);
+	e = SyntheticCorpus::encodingFor(PRODUCT_QUANTITY_RHOHV, "float");
+	assert(e.rawtype == RAW_FLOAT && e.gain == 1.);
+	try {
+		SyntheticCorpus::encodingFor(PRODUCT_QUANTITY_DBZH, "int32");
+		assert(false);
+	} catch (std::invalid_argument&) {
+	}
+}
+
+static void add_batches(SyntheticCorpus& corpus)
+{
+	SyntheticVolumeSpec volumes;
+	volumes.scans = 2;
+	volumes.rays = NUMRAYS;
+	volumes.bins = NUMBINS;
+	volumes.rscale = 2000.;
+	volumes.quantities.push_back(PRODUCT_QUANTITY_ZDR);
+	volumes.type = "uint16";
+	volumes.compression = 0;
+	volumes.sites = 2;
+	corpus.addVolumes(4, volumes);
+
+	SyntheticCompSpec comps;
+	comps.xsize = 60;
+	comps.ysize = 40;
+	comps.xscale = comps.yscale = 5000.;
+	comps.quantities.push_back(PRODUCT_QUANTITY_RATE);
+	corpus.addComps(2, comps);
+}
+
+static std::vector<unsigned short> read_dbzh(const std::string& path, int scan)
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(path));
+	std::unique_ptr<PolarScan> s(volume->getScan(scan));
+	std::unique_ptr<PolarScanData> data(s->getQuantityData(PRODUCT_QUANTITY_DBZH));
+	std::vector<unsigned short> raw(NUMRAYS * NUMBINS);
+	data->readData(&raw[0]);
+	return raw;
+}
+
+void test_corpus()
+{
+	SyntheticCorpus corpus(TESTDIR, 7);
+	corpus.setPrefix("SYNTHETIC-A-");
+	add_batches(corpus);
+	const std::vector<SyntheticEntry>& entries = corpus.getEntries();
+	assert(entries.size() == 6);
+	assert(entries[0].path == std::string(TESTDIR) + "/SYNTHETIC-A-PVOL-000000.h5");
+	assert(entries[1].site == 1 && entries[2].site == 0);
+	assert(entries[2].time == entries[0].time + 300);
+	assert(entries[4].object == OBJECT_COMP && entries[5].time == entries[4].time + 300);
+
+	assert(corpus.generate(3) == 6);
+	assert(corpus.getFailedFiles().empty());
+	for (size_t i=0; i<entries.size(); i++)
+		assert(entries[i].bytes > 0);
+
+	OdimFactory factory;
+	{
+		std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(entries[1].path));
+		assert(volume->getSource().OperaRadarNode == "syn01");
+		assert(volume->getScanCount() == 2);
+		std::unique_ptr<PolarScan> scan(volume->getScan(1));
+		assert(scan->getEAngle() == 1.5);
+		assert(scan->getQuantityDataCount() == 3);
+		std::vector<double> startaz;
+		scan->getHow()->getSimpleArray(ATTRIBUTE_HOW_STARTAZA, startaz);
+		assert(startaz.size() == NUMRAYS && startaz[1] == 10.);
+		std::unique_ptr<PolarScanData> data(scan->getQuantityData(PRODUCT_QUANTITY_DBZH));
+		assert(data->getDataType() == H5::PredType::NATIVE_UINT16);
+		double lat0, lon0, lat1, lon1;
+		corpus.getSite(corpus.getVolumeSpec(0), 0, lat0, lon0);
+		corpus.getSite(corpus.getVolumeSpec(0), 1, lat1, lon1);
+		assert(fabs(volume->getLatitude() - lat1) < 1e-6 && fabs(lat0 - lat1) > 1.);
+	}
+	{
+		std::unique_ptr<CompObject> comp(factory.openCompObject(entries[4].path));
+		std::unique_ptr<Product_2D> product(comp->getProduct(0));
+		std::unique_ptr<Product_2D_Data> rate(product->getQuantityData(PRODUCT_QUANTITY_RATE));
+		assert(rate->getDataWidth() == 60 && rate->getDataHeight() == 40);
+	}
+
+	/* same seed, same data, whatever the number of workers */
+	SyntheticCorpus again(TESTDIR, 7);
+	again.setPrefix("SYNTHETIC-B-");
+	add_batches(again);
+	assert(again.generate(1) == 6);
+	assert(read_dbzh(entries[2].path, 0) == read_dbzh(again.getEntries()[2].path, 0));
+
+	SyntheticCorpus other(TESTDIR, 8);
+	other.setPrefix("SYNTHETIC-C-");
+	add_batches(other);
+	assert(other.generate(2) == 6);
+	assert(read_dbzh(entries[2].path, 0) != read_dbzh(other.getEntries()[2].path, 0));
+
+	std::ostringstream manifest;
+	corpus.writeManifest(manifest);
+	std::string text = manifest.str();
+	assert(text.find("\"seed\": 7,") != std::string::npos);
+	assert(text.find("\"quantities\": [\"DBZH\", \"VRAD\", \"ZDR\"]") != std::string::npos);
+	assert(text.find("\"path\": \"" + entries[5].path + "\", \"object\": \"COMP\"") != std::string::npos);
+	assert(text.find("\"source\": \"NOD:syn01\"") != std::string::npos);
+
+	SyntheticVolumeSpec wrong;
+	wrong.compression = 12;
+	try {
+		corpus.addVolumes(1, wrong);
+		assert(false);
+	} catch (std::invalid_argument&) {
+	}
+}
+
+int main()
+{
+	test_field();
+	test_encoding();
+	test_corpus();
+	return 0;
+}
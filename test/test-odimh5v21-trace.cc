@@ -0,0 +1,127 @@
+#include <radarlib/radar.hpp>
+#include "test-volume.hpp"
+#include <assert.h>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+#define NUMRAYS 36
+#define NUMBINS 50
+#define PVOL TESTDIR"/TRACE-PVOL-ODIMH5V21.h5"
+
+/* keeps begin and end events, in order */
+class Recorder : public TraceHook {
+ public:
+	std::vector<TraceEvent>	events;
+	std::vector<bool>	ends;
+
+	virtual void begin(const TraceEvent& event)	{ events.push_back(event); ends.push_back(false); }
+	virtual void end(const TraceEvent& event)	{ events.push_back(event); ends.push_back(true); }
+
+	int find(const char* name, bool end, int from = 0) const
+	{
+		for (size_t i=from; i<events.size(); i++)
+			if (ends[i] == end && std::string(events[i].name) == name)
+				return (int)i;
+		return -1;
+	}
+};
+
+static void read_volume()
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(PVOL, H5F_ACC_RDONLY));
+	std::unique_ptr<PolarScan> scan(volume->getScan(1));
+	std::unique_ptr<PolarScanData> data(scan->getQuantityData(PRODUCT_QUANTITY_DBZH));
+	RayMatrix<float> values;
+	data->readTranslatedData(values);
+}
+
+void test_hook()
+{
+	Recorder recorder;
+	create_test_volume(PVOL, 2);
+	assert(!Tracing::isActive());
+
+	Tracing::setHook(&recorder);
+	assert(Tracing::getHook() == &recorder);
+	read_volume();
+	Tracing::setHook(NULL);
+	read_volume();
+
+	const std::vector<TraceEvent>& events = recorder.events;
+	assert(events.size() % 2 == 0);
+	int open = recorder.find("openPolarVolume", false);
+	assert(open == 0);
+	assert(std::string(events[open].category) == "file" && events[open].detail == PVOL);
+	int openEnd = recorder.find("openPolarVolume", true);
+	assert(openEnd > open && events[openEnd].start == events[open].start);
+
+	int scan = recorder.find("getScan", true);
+	assert(scan > openEnd && events[scan].index == 1 && std::string(events[scan].category) == "object");
+	assert(events[scan].detail == "/dataset2");
+
+	/* lookup by name goes through the lookup by index */
+	int byName = recorder.find("getQuantityData", false);
+	assert(events[byName].detail == PRODUCT_QUANTITY_DBZH && events[byName].index == -1);
+	int byIndex = recorder.find("getQuantityData", false, byName + 1);
+	assert(byIndex == byName + 1 && events[byIndex].index == 0);
+	int byIndexEnd = recorder.find("getQuantityData", true, byIndex);
+	assert(events[byIndexEnd].detail == "DBZH /dataset2/data1");
+
+	/* the read is nested in the translated read */
+	int translated = recorder.find("readTranslatedData", false);
+	int read = recorder.find("readData", false);
+	int readEnd = recorder.find("readData", true);
+	int translatedEnd = recorder.find("readTranslatedData", true);
+	assert(translated < read && read < readEnd && readEnd < translatedEnd);
+	assert(events[readEnd].detail == "DBZH /dataset2/data1" && events[translatedEnd].detail == events[readEnd].detail);
+	assert(events[translatedEnd].duration >= events[readEnd].duration);
+	assert(events[readEnd].start >= events[translated].start);
+	assert(events[readEnd].thread == Tracing::threadNumber());
+
+	/* nothing was traced without the hook */
+	assert(recorder.find("openPolarVolume", false, openEnd) == -1);
+}
+
+void test_chrome()
+{
+	{
+		ChromeTraceWriter writer(TESTDIR"/TRACE.json");
+		Tracing::setHook(&writer);
+		read_volume();
+		{
+			TraceScope scope("test", "quoted");
+			scope.setDetail("a \"b\"\\c");
+		}
+		Tracing::setHook(NULL);
+		assert(writer.getEventCount() > 6);
+	}
+
+	std::ifstream in(TESTDIR"/TRACE.json");
+	std::ostringstream ss;
+	ss << in.rdbuf();
+	std::string text = ss.str();
+	assert(text.find("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n{\"ph\": \"X\", \"cat\": \"file\", \"name\": \"openPolarVolume\"") == 0);
+	assert(text.find("\"name\": \"getScan\"") != std::string::npos);
+	assert(text.find("\"args\": {\"detail\": \"" PVOL "\"}}") != std::string::npos);
+	assert(text.find("\"args\": {\"detail\": \"/dataset2\", \"index\": 1}}") != std::string::npos);
+	assert(text.find("\"args\": {\"detail\": \"a \\\"b\\\"\\\\c\"}}") != std::string::npos);
+	assert(text.compare(text.size() - 4, 4, "\n]}\n") == 0);
+
+	try {
+		ChromeTraceWriter writer(TESTDIR"/missing/TRACE.json");
+		assert(false);
+	} catch (std::runtime_error&) {
+	}
+}
+
+int main()
+{
+	test_hook();
+	test_chrome();
+	return 0;
+}
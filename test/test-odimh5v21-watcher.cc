@@ -0,0 +1,213 @@
+#include <radarlib/radar.hpp>
+#include "test-volume.hpp"
+#include <assert.h>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+#define DIR		TESTDIR"/WATCH-DIR"
+#define STAGING		TESTDIR"/WATCH-DIR-TMP.h5"
+
+/* written outside the watched directory and renamed, as producers do */
+static void deliver(const std::string& path)
+{
+	create_test_volume(STAGING);
+	assert(std::rename(STAGING, path.c_str()) == 0);
+}
+
+static void copy_prefix(const std::string& src, const std::string& dst, size_t bytes)
+{
+	std::ifstream in(src.c_str(), std::ios::binary);
+	std::vector<char> buffer(bytes);
+	in.read(&buffer[0], bytes);
+	std::ofstream out(dst.c_str(), std::ios::binary);
+	out.write(&buffer[0], in.gcount());
+}
+
+class Collector : public WatchHandler {
+ public:
+	std::mutex			mutex;
+	std::condition_variable		changed;
+	std::multiset<std::string>	ready;
+	std::set<std::string>		rejected;
+	bool				blocked;
+
+	Collector() : blocked(false) { }
+
+	virtual void fileReady(const WatchEvent& event)
+	{
+		/* the file must be readable as soon as it is reported */
+		OdimFactory factory;
+		std::unique_ptr<OdimObject> object(factory.open(event.path, H5F_ACC_RDONLY));
+		assert(event.size == Radar::FileSystem::getFileSize(event.path));
+		if (Radar::Path::getFileName(event.path) == "fail.h5")
+			throw std::runtime_error("failed on purpose");
+
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this] { return !blocked; });
+		ready.insert(Radar::Path::getFileName(event.path));
+		changed.notify_all();
+	}
+	virtual void fileRejected(const std::string& path, const std::string& reason)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		rejected.insert(Radar::Path::getFileName(path));
+		changed.notify_all();
+	}
+	virtual void fileFailed(const WatchEvent& event, const std::string& message)
+	{
+		assert(message == "failed on purpose");
+	}
+
+	void block(bool val)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		blocked = val;
+		changed.notify_all();
+	}
+	bool waitReady(const std::string& name)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		return changed.wait_for(lock, std::chrono::seconds(10), [&] { return ready.count(name) > 0; });
+	}
+	bool waitRejected(const std::string& name)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		return changed.wait_for(lock, std::chrono::seconds(10), [&] { return rejected.count(name) > 0; });
+	}
+};
+
+/* truncated and garbage files are rejected before HDF5 sees them */
+void test_check()
+{
+	std::string reason;
+	create_test_volume(DIR"/complete.h5");
+	assert(OdimWatcher::checkHDF5(DIR"/complete.h5", reason));
+
+	size_t size = Radar::FileSystem::getFileSize(DIR"/complete.h5");
+	copy_prefix(DIR"/complete.h5", DIR"/partial.h5", size / 2);
+	assert(!OdimWatcher::checkHDF5(DIR"/partial.h5", reason));
+	assert(reason.find("truncated") != std::string::npos);
+
+	copy_prefix(DIR"/complete.h5", DIR"/header.h5", 20);
+	assert(!OdimWatcher::checkHDF5(DIR"/header.h5", reason));
+
+	Radar::FileSystem::createFile(DIR"/text.h5", "not an HDF5 file");
+	assert(!OdimWatcher::checkHDF5(DIR"/text.h5", reason));
+	assert(reason == "HDF5 signature not found");
+	assert(!OdimWatcher::checkHDF5(DIR"/missing.h5", reason));
+
+	Radar::FileSystem::rmDirTree(DIR);
+	Radar::FileSystem::mkDirTree(DIR);
+}
+
+void test_events()
+{
+	Collector collector;
+	OdimWatcher watcher(&collector, 2, 4);
+	watcher.addDirectory(DIR, true);
+	watcher.start();
+	assert(watcher.isRunning());
+
+	deliver(DIR"/renamed.h5");
+	assert(collector.waitReady("renamed.h5"));
+
+	/* written in place: reported when the writer closes it */
+	create_test_volume(DIR"/written.h5");
+	assert(collector.waitReady("written.h5"));
+
+	/* the extension filter skips the temporary name */
+	create_test_volume(DIR"/staging.tmp");
+	assert(std::rename(DIR"/staging.tmp", DIR"/moved.h5") == 0);
+	assert(collector.waitReady("moved.h5"));
+
+	Radar::FileSystem::createFile(DIR"/garbage.h5", "not an HDF5 file");
+	assert(collector.waitRejected("garbage.h5"));
+
+	/* a new subdirectory is watched */
+	Radar::FileSystem::mkDirTree(DIR"/sub/deeper");
+	deliver(DIR"/sub/deeper/nested.h5");
+	assert(collector.waitReady("nested.h5"));
+
+	deliver(DIR"/fail.h5");
+	deliver(DIR"/after-fail.h5");
+	assert(collector.waitReady("after-fail.h5"));
+
+	watcher.stop();
+	assert(!watcher.isRunning());
+	assert(watcher.getFailed() == 1 && watcher.getRejected() >= 1);
+	assert(collector.ready.count("staging.tmp") == 0);
+
+	/* nothing is reported once stopped */
+	size_t count = collector.ready.size();
+	deliver(DIR"/late.h5");
+	assert(collector.ready.size() == count);
+}
+
+void test_backpressure()
+{
+	Collector collector;
+	OdimWatcher watcher(&collector, 1, 1);
+	watcher.addDirectory(DIR);
+	watcher.start();
+
+	collector.block(true);
+	deliver(DIR"/queue-1.h5");
+	deliver(DIR"/queue-2.h5");
+	deliver(DIR"/queue-3.h5");
+	for (int i=0; i<1000 && watcher.getFullWaits() == 0; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	assert(watcher.getFullWaits() > 0 && watcher.getQueued() == 1);
+	collector.block(false);
+
+	assert(collector.waitReady("queue-3.h5"));
+	assert(collector.ready.count("queue-1.h5") == 1 && collector.ready.count("queue-2.h5") == 1);
+	watcher.stop();
+	assert(watcher.getReady() == 3);
+}
+
+void test_scan()
+{
+	/* still open for writing: HDF5 keeps it locked */
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> writing(factory.createPolarVolume(DIR"/writing.h5"));
+	set_test_radar(*writing);
+	add_test_scan(*writing, 0.5);
+
+	Collector collector;
+	OdimWatcher watcher(&collector, 2);
+	watcher.setSettleTime(std::chrono::milliseconds(100));
+	assert(watcher.getSettleTime() == std::chrono::milliseconds(100));
+	watcher.addDirectory(DIR, true);
+	watcher.start(true);
+	assert(collector.waitReady("late.h5"));
+	assert(collector.waitReady("nested.h5"));
+	assert(collector.waitRejected("garbage.h5"));
+	for (int i=0; i<1000 && watcher.getUnsettled() == 0; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	assert(watcher.getUnsettled() == 1);
+	assert(collector.ready.count("writing.h5") == 0 && collector.rejected.count("writing.h5") == 0);
+
+	/* reported when its writer closes it */
+	writing.reset();
+	assert(collector.waitReady("writing.h5"));
+	watcher.stop();
+}
+
+int main()
+{
+	if (Radar::FileSystem::dirExists(DIR))
+		Radar::FileSystem::rmDirTree(DIR);
+	Radar::FileSystem::mkDirTree(DIR);
+	test_check();
+	test_events();
+	test_backpressure();
+	test_scan();
+	return 0;
+}
@@ -0,0 +1,269 @@
+#include <radarlib/radar.hpp>
+#include "test-volume.hpp"
+#include <assert.h>
+#include <cmath>
+#include <memory>
+
+using namespace OdimH5v21;
+using namespace OdimH5v21::products;
+
+#define NUMRAYS 360
+#define NUMBINS 100
+
+/* two scans, raw value of each gate is its bin number, plus 10 in the higher scan */
+void create_volume()
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.createPolarVolume(TESTDIR"/XSEC-PVOL-ODIMH5V21.h5"));
+	set_test_radar(*volume);
+
+	for (int s=0; s<2; s++)
+	{
+		std::unique_ptr<PolarScan> scan(volume->createScan());
+		scan->setStartDateTime(Radar::timeutils::mktime(2000,1,2,3,4,5+s));
+		scan->setEndDateTime(Radar::timeutils::mktime(2000,1,2,3,4,6+s));
+		/* the higher scan is stored first */
+		scan->setEAngle(5. - s * 4.5);
+		scan->setA1Gate(0);
+		scan->setNumBins(NUMBINS);
+		scan->setNumRays(NUMRAYS);
+		scan->setRangeStart(0);
+		scan->setRangeScale(1000);
+		scan->setBeamWidth(1.);
+
+		std::unique_ptr<PolarScanData> data(scan->createQuantityData(PRODUCT_QUANTITY_DBZH));
+		data->setNodata(255.);
+		data->setUndetect(0.);
+		data->setOffset(-10.);
+		data->setGain(0.5);
+		RayMatrix<unsigned char> matrix(NUMRAYS, NUMBINS);
+		for (int r=0; r<NUMRAYS; r++)
+			for (int b=0; b<NUMBINS; b++)
+				matrix.elem(r,b) = r == 90 ? 255 : b == 0 ? 0 : b + 10 * (1 - s);
+		data->writeData(matrix);
+	}
+}
+
+double beam_height(double elangle, double ground)
+{
+	double re = geometry::EFFECTIVE_EARTH_RADIUS;
+	double el = elangle * M_PI / 180.;
+	return re * cos(el) / cos(el + ground / re) - re + 31.;
+}
+
+double beam_range(double elangle, double ground)
+{
+	double re = geometry::EFFECTIVE_EARTH_RADIUS;
+	double el = elangle * M_PI / 180.;
+	return re * sin(ground / re) / cos(el + ground / re);
+}
+
+float value(const DataMatrix<float>& m, int r, int c)
+{
+	return m.get()[(size_t)r * m.getColCount() + c];
+}
+
+bool same(const DataMatrix<float>& a, const DataMatrix<float>& b)
+{
+	if (a.getRowCount() != b.getRowCount() || a.getColCount() != b.getColCount())
+		return false;
+	for (int r=0; r<a.getRowCount(); r++)
+		for (int c=0; c<a.getColCount(); c++)
+			if (value(a,r,c) != value(b,r,c) && !(std::isnan(value(a,r,c)) && std::isnan(value(b,r,c))))
+				return false;
+	return true;
+}
+
+void test_geometry()
+{
+	double distance, azimuth;
+	geometry::distanceAzimuth(44., 11., 45., 11., distance, azimuth);
+	assert(fabs(distance - geometry::EARTH_RADIUS * M_PI / 180.) < 1e-6);
+	assert(fabs(azimuth) < 1e-9);
+	double lat, lon;
+	geometry::greatCirclePoint(44., 11., 44., 13., 0.5, lat, lon);
+	assert(fabs(lon - 12.) < 1e-9 && lat > 44.);
+
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(TESTDIR"/XSEC-PVOL-ODIMH5V21.h5"));
+	SectionGeometry section = SectionGeometry::radial(*volume, 45., 100., 100, 40, 0., 10000.);
+	assert(section.startLat == volume->getLatitude());
+	assert(fabs(section.length() - 100000.) < 1e-3);
+	assert(fabs(section.xscale() - 1000.) < 1e-6);
+	assert(section.yscale() == 250.);
+}
+
+void test_sections()
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(TESTDIR"/XSEC-PVOL-ODIMH5V21.h5"));
+
+	SectionGenerator generator(4);
+	generator.setRowsPerBlock(3);
+	SectionGeometry section = SectionGeometry::radial(*volume, 45., 100., 100, 40, 0., 10000.);
+	DataMatrix<float> out;
+	generator.compute(*volume, section, PRODUCT_QUANTITY_DBZH, out);
+	assert(out.getRowCount() == 40 && out.getColCount() == 100);
+
+	/* column 30 is 30.5 km from the radar, both scans use bin 30 */
+	double h0 = beam_height(0.5, 30500.);
+	double h1 = beam_height(5., 30500.);
+	assert((int)(beam_range(0.5, 30500.) / 1000.) == 30 && (int)(beam_range(5., 30500.) / 1000.) == 30);
+	float v0 = 30 * 0.5 - 10.;
+	float v1 = (30 + 10) * 0.5 - 10.;
+
+	/* row 33 is 1625 m high, between the two beams */
+	assert(h0 < 1625. && h1 > 1625.);
+	double w = (1625. - h0) / (h1 - h0);
+	assert(fabs(out.elem(33, 30) - (v0 + w * (v1 - v0))) < 1e-4);
+	/* row 39 is 125 m high, within half beam width below the lower beam */
+	assert(h0 - 125. < 30500. * tan(0.5 * M_PI / 180.));
+	assert(out.elem(39, 30) == v0);
+	/* row 0 is far above the upper beam */
+	assert(std::isnan(out.elem(0, 30)));
+
+	/* the table is cached and stores the scans by elevation */
+	SectionGenerator::SectionTablePtr table = generator.getSectionTable(*volume, section, PRODUCT_QUANTITY_DBZH);
+	assert(table->getScans().size() == 2 && table->getScans()[0] == 1);
+	SectionGenerator other(1);
+	other.setRowsPerBlock(40);
+	assert(other.getSectionTable(*volume, section, PRODUCT_QUANTITY_DBZH) == table);
+	DataMatrix<float> single;
+	other.compute(*volume, section, PRODUCT_QUANTITY_DBZH, single);
+	assert(same(single, out));
+
+	/* near the radar both scans are undetect */
+	DataMatrix<float> fine;
+	generator.compute(*volume, SectionGeometry::radial(*volume, 45., 100., 100, 400, 0., 10000.), PRODUCT_QUANTITY_DBZH, fine);
+	assert(beam_height(0.5, 500.) < 62.5 && beam_height(5., 500.) > 62.5);
+	assert(fine.elem(397, 0) == UNDETECT);
+
+	/* ray 90 is nodata */
+	DataMatrix<float> missing;
+	generator.compute(*volume, SectionGeometry::radial(*volume, 90.5, 100., 100, 40, 0., 10000.), PRODUCT_QUANTITY_DBZH, missing);
+	assert(std::isnan(missing.elem(33, 30)));
+
+	try {
+		generator.compute(*volume, SectionGeometry(44., 11., 45., 11., 10, 10, 100., 100.), PRODUCT_QUANTITY_DBZH, out);
+		assert(false);
+	} catch (std::invalid_argument&) {
+	}
+}
+
+void test_products()
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(TESTDIR"/XSEC-PVOL-ODIMH5V21.h5"));
+	SectionGenerator generator(2);
+	Encoding encoding(RAW_UINT8, 0.5, -10., 255., 0.);
+
+	{
+		std::unique_ptr<XsecObject> object(factory.createXsecObject(TESTDIR"/XSEC-XSEC-ODIMH5V21.h5"));
+		SectionGeometry section(44.2, 11.3, 44.7, 12., 200, 50, 0., 12000.);
+		std::unique_ptr<Product_XSEC> xsec(generator.generateXSEC(*object, *volume, section, PRODUCT_QUANTITY_DBZH, encoding));
+		assert(xsec->getProduct() == PRODUCT_XSEC);
+		assert(xsec->getXSize() == 200 && xsec->getYSize() == 50);
+		assert(xsec->getMaxHeight() == 12000.);
+		assert(fabs(xsec->getXScale() - section.length() / 200) < 1e-6);
+		assert(xsec->getStartDateTime() == Radar::timeutils::mktime(2000,1,2,3,4,5));
+		assert(xsec->getEndDateTime() == Radar::timeutils::mktime(2000,1,2,3,4,7));
+		assert(object->getStartLongitude() == 11.3);
+		assert(object->getStopLatitude() == 44.7);
+		assert(object->getDateTime() == volume->getDateTime());
+	}
+	{
+		std::unique_ptr<XsecObject> object(factory.createXsecObject(TESTDIR"/XSEC-RHI-ODIMH5V21.h5"));
+		std::unique_ptr<Product_RHI> rhi(generator.generateRHI(*object, *volume, 45., 100., 100, 40, 0., 10000., PRODUCT_QUANTITY_DBZH, encoding));
+		assert(rhi->getProduct() == PRODUCT_RHI);
+		assert(rhi->getAzimuthAngle() == 45.);
+		assert(rhi->getRange() == 100.);
+		assert(rhi->getRHILat() == volume->getLatitude());
+		std::vector<Angles> angles = rhi->getAngles();
+		assert(angles.size() == 2 && angles[0].value == 0.5 && angles[1].value == 5.);
+
+		std::unique_ptr<Product_2D_Data> data(rhi->getQuantityData(PRODUCT_QUANTITY_DBZH));
+		DataMatrix<unsigned char> raw(40, 100);
+		data->readData(&raw.elem(0, 0));
+		assert(raw.elem(39, 30) == 30);
+		assert(raw.elem(0, 30) == 255);
+	}
+	std::unique_ptr<XsecObject> object(factory.openXsecObject(TESTDIR"/XSEC-RHI-ODIMH5V21.h5"));
+	assert(object->getProductCount() == 1);
+	assert(object->getAzimuthAngle() == 45.);
+}
+
+/* the maximum of the side panels along the height is the maximum of the MAX image */
+float panel_max(const DataMatrix<float>& m, int index, bool byrow)
+{
+	int count = byrow ? m.getColCount() : m.getRowCount();
+	float result = NODATA;
+	for (int i=0; i<count; i++)
+	{
+		float v = byrow ? value(m, index, i) : value(m, i, index);
+		if (!std::isnan(v) && (std::isnan(result) || v > result))
+			result = v;
+	}
+	return result;
+}
+
+bool same_value(float a, float b)
+{
+	return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+void test_panels()
+{
+	OdimFactory factory;
+	std::unique_ptr<PolarVolume> volume(factory.openPolarVolume(TESTDIR"/XSEC-PVOL-ODIMH5V21.h5"));
+
+	CartesianGrid grid = CartesianGrid::centeredOn(volume->getLatitude(), volume->getLongitude(), 240, 240, 1000., 1000.);
+	ColumnGenerator generator(grid, 4);
+	generator.setTileSize(16);
+	ColumnRequest request;
+	request.etop = request.vil = false;
+	DataMatrix<float> max, etop, vil;
+	generator.compute(*volume, PRODUCT_QUANTITY_DBZH, request, max, etop, vil);
+
+	DataMatrix<float> hsp, vsp;
+	generator.computePanels(*volume, PRODUCT_QUANTITY_DBZH, 80, 0., 20000., hsp, vsp);
+	assert(hsp.getRowCount() == 80 && hsp.getColCount() == 240);
+	assert(vsp.getRowCount() == 240 && vsp.getColCount() == 80);
+	for (int i=0; i<240; i++)
+	{
+		DataMatrix<float> column(240, 1), row(1, 240);
+		for (int j=0; j<240; j++)
+		{
+			column.elem(j, 0) = max.elem(j, i);
+			row.elem(0, j) = max.elem(i, j);
+		}
+		assert(same_value(panel_max(hsp, i, false), panel_max(column, 0, false)));
+		assert(same_value(panel_max(vsp, i, true), panel_max(row, 0, true)));
+	}
+	/* the lowest layer is at the bottom of HSP and on the left of VSP */
+	assert(!std::isnan(hsp.elem(79, 125)) && std::isnan(hsp.elem(0, 125)));
+	assert(!std::isnan(vsp.elem(125, 0)) && std::isnan(vsp.elem(125, 79)));
+
+	std::unique_ptr<ImageObject> image(factory.createImageObject(TESTDIR"/XSEC-PANELS-ODIMH5V21.h5"));
+	std::vector<Product_Panel*> panels = generator.generatePanels(*image, *volume, PRODUCT_QUANTITY_DBZH, 80, 0., 20000.,
+								      Encoding(RAW_UINT8, 0.5, -10., 255., 0.));
+	assert(panels.size() == 2);
+	assert(panels[0]->getProduct() == PRODUCT_HSP && panels[1]->getProduct() == PRODUCT_VSP);
+	assert(panels[0]->getXSize() == 240 && panels[0]->getYSize() == 80 && panels[0]->getYScale() == 250.);
+	assert(panels[1]->getXSize() == 80 && panels[1]->getYSize() == 240);
+	assert(panels[0]->getStartLongitude() < panels[0]->getStopLongitude());
+	assert(panels[1]->getStartLatitude() > panels[1]->getStopLatitude());
+	assert(fabs(panels[0]->getStopLatitude() - panels[1]->getStopLatitude()) < 1e-9);
+	assert(image->getProductCount() == 2);
+	for (size_t i = 0; i < panels.size(); i++)
+		delete panels[i];
+}
+
+int main()
+{
+	create_volume();
+	test_geometry();
+	test_sections();
+	test_products();
+	test_panels();
+	return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * Volumes of the test radar, shared by the tests that only need a valid
+ * PVOL: radar "rad" at 11.6236 E 44.4567 N, 31 m, 2000-01-02 03:04:05
+ */
+#ifndef __RADAR_TEST_VOLUME_HPP__
+#define __RADAR_TEST_VOLUME_HPP__
+
+#include <radarlib/radar.hpp>
+#include <memory>
+#include <string>
+
+/* root what/ and where/ of the test radar */
+inline void set_test_radar(OdimH5v21::PolarVolume& volume)
+{
+	volume.setDateTime(Radar::timeutils::mktime(2000,1,2,3,4,5));
+	OdimH5v21::SourceInfo source;
+	source.setOperaRadarSite("rad");
+	volume.setSource(source);
+	volume.setLongitude(11.6236);
+	volume.setLatitude(44.4567);
+	volume.setAltitude(31.);
+}
+
+/* a scan of 10 dBZ gates, DBZH stored as 8 bit with gain 0.5 and offset -32 */
+inline void add_test_scan(OdimH5v21::PolarVolume& volume, double elangle, int nrays = 36, int nbins = 50)
+{
+	std::unique_ptr<OdimH5v21::PolarScan> scan(volume.createScan());
+	scan->setEAngle(elangle);
+	scan->setNumRays(nrays);
+	scan->setNumBins(nbins);
+	std::unique_ptr<OdimH5v21::PolarScanData> data(scan->createQuantityData(OdimH5v21::PRODUCT_QUANTITY_DBZH));
+	data->setGain(0.5);
+	data->setOffset(-32.);
+	OdimH5v21::RayMatrix<float> values(nrays, nbins, 10.f);
+	data->writeAndTranslate(values, -32.f, 0.5f, H5::PredType::NATIVE_UINT8);
+}
+
+/* a volume of the test radar with the given number of scans, at 0.5, 1.5, ... degrees */
+inline void create_test_volume(const std::string& path, int scans = 1)
+{
+	OdimH5v21::OdimFactory factory;
+	std::unique_ptr<OdimH5v21::PolarVolume> volume(factory.createPolarVolume(path));
+	set_test_radar(*volume);
+	for (int s = 0; s < scans; s++)
+		add_test_scan(*volume, 0.5 + s);
+}
+
+#endif